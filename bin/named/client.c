@@ -42,6 +42,7 @@
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>
 #include <dns/view.h>
@@ -563,6 +564,7 @@ exit_check(ns_client_t *client) {
 
 		ns_query_free(client);
 		isc_mem_put(client->mctx, client->recvbuf, RECV_BUFFER_SIZE);
+		isc_mem_put(client->mctx, client->sendbuf, SEND_BUFFER_SIZE);
 		isc_event_free((isc_event_t **)&client->sendevent);
 		isc_event_free((isc_event_t **)&client->recvevent);
 		isc_timer_detach(&client->timer);
@@ -815,7 +817,7 @@ client_senddone(isc_task_t *task, isc_event_t *event) {
 static isc_result_t
 client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 		    isc_buffer_t *tcpbuffer, isc_uint32_t length,
-		    unsigned char *sendbuf, unsigned char **datap)
+		    unsigned char **datap)
 {
 	unsigned char *data;
 	isc_uint32_t bufsize;
@@ -846,7 +848,7 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 			isc_buffer_putuint16(buffer, (isc_uint16_t)length);
 		}
 	} else {
-		data = sendbuf;
+		data = client->sendbuf;
 		if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0) {
 			if (client->view != NULL)
 				bufsize = client->view->nocookieudp;
@@ -898,7 +900,11 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 				  &match, NULL) == ISC_R_SUCCESS &&
 		    match > 0)
 			return (DNS_R_BLACKHOLED);
-		sockflags |= ISC_SOCKFLAG_NORETRY;
+		/*
+		 * Let the socket code coalesce this datagram with other
+		 * responses queued on the same socket.
+		 */
+		sockflags |= ISC_SOCKFLAG_NORETRY | ISC_SOCKFLAG_BATCH;
 	}
 
 	if ((client->attributes & NS_CLIENTATTR_PKTINFO) != 0 &&
@@ -948,6 +954,29 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	return (result);
 }
 
+/*
+ * Count a response of 'respsize' octets in the response size histograms.
+ */
+static void
+client_sizestats(ns_client_t *client, size_t respsize) {
+	isc_stats_t *stats;
+
+	switch (isc_sockaddr_pf(&client->peeraddr)) {
+	case AF_INET:
+		stats = TCP_CLIENT(client) ? ns_g_server->tcpoutstats4
+					   : ns_g_server->udpoutstats4;
+		break;
+	case AF_INET6:
+		stats = TCP_CLIENT(client) ? ns_g_server->tcpoutstats6
+					   : ns_g_server->udpoutstats6;
+		break;
+	default:
+		INSIST(0);
+		return;
+	}
+	isc_stats_increment(stats, ISC_MIN((int)respsize / 16, 256));
+}
+
 void
 ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	isc_result_t result;
@@ -955,7 +984,6 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	isc_buffer_t buffer;
 	isc_region_t r;
 	isc_region_t *mr;
-	unsigned char sendbuf[SEND_BUFFER_SIZE];
 
 	REQUIRE(NS_CLIENT_VALID(client));
 
@@ -968,7 +996,7 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	}
 
 	result = client_allocsendbuf(client, &buffer, NULL, mr->length,
-				     sendbuf, &data);
+				     &data);
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
@@ -994,6 +1022,243 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	ns_client_next(client, result);
 }
 
+/*
+ * Append the OPT record for this client to the cached response in
+ * 'buffer' and count it in the header.
+ */
+static isc_result_t
+client_respcacheopt(ns_client_t *client, isc_buffer_t *buffer) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	unsigned char *arcount;
+	unsigned int count = 0;
+	isc_uint16_t ar;
+
+	result = ns_client_addopt(client, client->message, &client->opt);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = dns_compress_init(&cctx, -1, client->mctx);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_NONE);
+	result = dns_rdataset_towire(client->opt, dns_rootname, &cctx,
+				     buffer, 0, &count);
+	dns_compress_invalidate(&cctx);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	arcount = (unsigned char *)isc_buffer_base(buffer) + 10;
+	ar = (arcount[0] << 8 | arcount[1]) + 1;
+	arcount[0] = ar >> 8;
+	arcount[1] = ar & 0xff;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	/*
+	 * The response will be rendered normally, and that builds its
+	 * own OPT record.
+	 */
+	dns_rdataset_disassociate(client->opt);
+	dns_message_puttemprdataset(client->message, &client->opt);
+	return (result);
+}
+
+isc_boolean_t
+ns_client_sendcached(ns_client_t *client) {
+	isc_result_t result;
+	unsigned char *data;
+	isc_buffer_t buffer;
+	isc_buffer_t tcpbuffer;
+	dns_respcacheinfo_t info;
+	isc_statscounter_t anscounter;
+	dns_rcode_t rcode;
+	size_t respsize;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(client->view != NULL && client->view->respcache != NULL);
+
+	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0, &data);
+	if (result != ISC_R_SUCCESS)
+		goto miss;
+
+	result = dns_respcache_find(client->view->respcache,
+				    &client->query.respcache.key,
+				    client->message->id, &buffer, &info);
+	if (result != ISC_R_SUCCESS)
+		goto miss;
+
+	/*
+	 * Cached responses are stored without their OPT record, which
+	 * carries per-client options such as COOKIE; build a fresh one.
+	 */
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		result = client_respcacheopt(client, &buffer);
+		if (result != ISC_R_SUCCESS) {
+			if (info.zonestats != NULL)
+				isc_stats_detach(&info.zonestats);
+			if (info.querystats != NULL)
+				dns_stats_detach(&info.querystats);
+			goto miss;
+		}
+	}
+
+	CTRACE("sendcached");
+
+	/*
+	 * Credit the same statistics query_send() and client_send()
+	 * would have.
+	 */
+	if ((data[TCP_CLIENT(client) ? 4 : 2] & 0x04) != 0)
+		anscounter = dns_nsstatscounter_authans;
+	else
+		anscounter = dns_nsstatscounter_nonauthans;
+	isc_stats_increment(ns_g_server->nsstats, anscounter);
+	isc_stats_increment(ns_g_server->nsstats, info.counter);
+	if (info.zonestats != NULL) {
+		isc_stats_increment(info.zonestats, anscounter);
+		isc_stats_increment(info.zonestats, info.counter);
+		isc_stats_detach(&info.zonestats);
+	}
+	if (info.querystats != NULL) {
+		if (anscounter == dns_nsstatscounter_authans)
+			dns_rdatatypestats_increment(info.querystats,
+						     client->query.qtype);
+		dns_stats_detach(&info.querystats);
+	}
+	rcode = data[TCP_CLIENT(client) ? 5 : 3] & 0x0f;
+	respsize = isc_buffer_usedlength(&buffer);
+	client_sizestats(client, respsize);
+	isc_stats_increment(ns_g_server->nsstats, dns_nsstatscounter_response);
+	dns_rcodestats_increment(ns_g_server->rcodestats, rcode);
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0)
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_edns0out);
+
+	if (TCP_CLIENT(client)) {
+		isc_buffer_putuint16(&tcpbuffer, (isc_uint16_t)respsize);
+		isc_buffer_add(&tcpbuffer, respsize);
+		result = client_sendpkg(client, &tcpbuffer);
+	} else
+		result = client_sendpkg(client, &buffer);
+	if (result != ISC_R_SUCCESS) {
+		if (client->tcpbuf != NULL) {
+			isc_mem_put(client->mctx, client->tcpbuf,
+				    TCP_BUFFER_SIZE);
+			client->tcpbuf = NULL;
+		}
+		ns_client_next(client, result);
+	}
+	return (ISC_TRUE);
+
+ miss:
+	if (client->tcpbuf != NULL) {
+		isc_mem_put(client->mctx, client->tcpbuf, TCP_BUFFER_SIZE);
+		client->tcpbuf = NULL;
+	}
+	return (ISC_FALSE);
+}
+
+/*
+ * Return ISC_TRUE if every RRset rendered into the response would be
+ * rendered in the same order again: a response with a multi-record
+ * RRset in random or cyclic order (see "rrset-order") must not be
+ * replayed from the response cache.
+ */
+static isc_boolean_t
+client_respcachefixed(ns_client_t *client) {
+	dns_message_t *message = client->message;
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	dns_section_t section;
+
+	for (section = DNS_SECTION_ANSWER;
+	     section <= DNS_SECTION_ADDITIONAL;
+	     section++)
+	{
+		for (name = ISC_LIST_HEAD(message->sections[section]);
+		     name != NULL;
+		     name = ISC_LIST_NEXT(name, link))
+		{
+			for (rdataset = ISC_LIST_HEAD(name->list);
+			     rdataset != NULL;
+			     rdataset = ISC_LIST_NEXT(rdataset, link))
+			{
+				if ((rdataset->attributes &
+				     DNS_RDATASETATTR_RENDERED) == 0 ||
+				    (rdataset->attributes &
+				     DNS_RDATASETATTR_FIXEDORDER) != 0 ||
+				    rdataset->type == dns_rdatatype_rrsig)
+					continue;
+				if (dns_rdataset_count(rdataset) > 1)
+					return (ISC_FALSE);
+			}
+		}
+	}
+
+	return (ISC_TRUE);
+}
+
+/*
+ * Store the response just rendered in 'buffer' in the view's response
+ * cache.  Only complete positive and NXDOMAIN answers whose RRsets are
+ * in a fixed order are kept.
+ *
+ * The OPT record, always the last record rendered, is left out; see
+ * client_respcacheopt().
+ */
+static void
+client_respcacheadd(ns_client_t *client, isc_buffer_t *buffer) {
+	dns_zone_t *zone = client->query.authzone;
+	dns_respcacheinfo_t info;
+	dns_rdataset_t *opt;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned char *arcount;
+	isc_uint16_t ar;
+	isc_region_t r;
+
+	if (client->view == NULL || client->view->respcache == NULL)
+		return;
+	if ((client->message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (client->message->rcode != dns_rcode_noerror &&
+	     client->message->rcode != dns_rcode_nxdomain))
+		return;
+	if (!client_respcachefixed(client))
+		return;
+
+	info.counter = client->query.respcache.counter;
+	info.zonestats = NULL;
+	info.querystats = NULL;
+	if (zone != NULL) {
+		info.zonestats = dns_zone_getrequeststats(zone);
+		info.querystats = dns_zone_getrcvquerystats(zone);
+	}
+
+	isc_buffer_usedregion(buffer, &r);
+	arcount = r.base + 10;
+	ar = arcount[0] << 8 | arcount[1];
+	opt = dns_message_getopt(client->message);
+	if (opt != NULL) {
+		/*
+		 * Hide the OPT record from the copy taken by the cache.
+		 */
+		INSIST(ar > 0);
+		RUNTIME_CHECK(dns_rdataset_first(opt) == ISC_R_SUCCESS);
+		dns_rdataset_current(opt, &rdata);
+		INSIST(r.length >= DNS_MESSAGE_HEADERLEN + 11 + rdata.length);
+		r.length -= 11 + rdata.length;
+		arcount[0] = (ar - 1) >> 8;
+		arcount[1] = (ar - 1) & 0xff;
+	}
+
+	(void)dns_respcache_add(client->view->respcache,
+				client->query.respcache.generation,
+				&client->query.respcache.key, &r, &info);
+
+	arcount[0] = ar >> 8;
+	arcount[1] = ar & 0xff;
+}
+
 static void
 client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -1003,7 +1268,6 @@ client_send(ns_client_t *client) {
 	isc_region_t r;
 	dns_compress_t cctx;
 	isc_boolean_t cleanup_cctx = ISC_FALSE;
-	unsigned char sendbuf[SEND_BUFFER_SIZE];
 	unsigned int render_opts;
 	unsigned int preferred_glue;
 	isc_boolean_t opt_included = ISC_FALSE;
@@ -1074,7 +1338,7 @@ client_send(ns_client_t *client) {
 	 * XXXRTH  The following doesn't deal with TCP buffer resizing.
 	 */
 	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0,
-				     sendbuf, &data);
+				     &data);
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
@@ -1157,6 +1421,9 @@ client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
+	if ((client->query.attributes & NS_QUERYATTR_RESPCACHE) != 0)
+		client_respcacheadd(client, &buffer);
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -1200,20 +1467,7 @@ client_send(ns_client_t *client) {
 		/* don't count the 2-octet length header */
 		respsize = isc_buffer_usedlength(&tcpbuffer) - 2;
 		result = client_sendpkg(client, &tcpbuffer);
-
-		switch (isc_sockaddr_pf(&client->peeraddr)) {
-		case AF_INET:
-			isc_stats_increment(ns_g_server->tcpoutstats4,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		case AF_INET6:
-			isc_stats_increment(ns_g_server->tcpoutstats6,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		default:
-			INSIST(0);
-			break;
-		}
+		client_sizestats(client, respsize);
 	} else {
 		respsize = isc_buffer_usedlength(&buffer);
 		result = client_sendpkg(client, &buffer);
@@ -1226,19 +1480,7 @@ client_send(ns_client_t *client) {
 		}
 #endif /* HAVE_DNSTAP */
 
-		switch (isc_sockaddr_pf(&client->peeraddr)) {
-		case AF_INET:
-			isc_stats_increment(ns_g_server->udpoutstats4,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		case AF_INET6:
-			isc_stats_increment(ns_g_server->udpoutstats6,
-					    ISC_MIN((int)respsize / 16, 256));
-			break;
-		default:
-			INSIST(0);
-			break;
-		}
+		client_sizestats(client, respsize);
 	}
 
 	/* update statistics (XXXJT: is it okay to access message->xxxkey?) */
@@ -2951,12 +3193,18 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 		goto cleanup_sendevent;
 	}
 
+	client->sendbuf = isc_mem_get(client->mctx, SEND_BUFFER_SIZE);
+	if  (client->sendbuf == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_recvbuf;
+	}
+
 	client->recvevent = isc_socket_socketevent(client->mctx, client,
 						   ISC_SOCKEVENT_RECVDONE,
 						   client_request, client);
 	if (client->recvevent == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_recvbuf;
+		goto cleanup_sendbuf;
 	}
 
 	client->magic = NS_CLIENT_MAGIC;
@@ -3040,6 +3288,9 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
  cleanup_recvevent:
 	isc_event_free((isc_event_t **)&client->recvevent);
 
+ cleanup_sendbuf:
+	isc_mem_put(client->mctx, client->sendbuf, SEND_BUFFER_SIZE);
+
  cleanup_recvbuf:
 	isc_mem_put(client->mctx, client->recvbuf, RECV_BUFFER_SIZE);
 
@@ -94,6 +94,7 @@ options {\n\
 "\
 	recursive-clients 1000;\n\
 	resolver-query-timeout 10;\n\
+	reuseport no;\n\
 	rrset-order { order random; };\n\
 #	serial-queries <obsolete>;\n\
 	serial-query-rate 20;\n\
@@ -155,6 +156,9 @@ options {\n\
 	servfail-ttl 1;\n\
 	max-ncache-ttl 10800; /* 3 hours */\n\
 	max-cache-ttl 604800; /* 1 week */\n\
+	max-stale-ttl 604800; /* 1 week */\n\
+	stale-answer-enable false;\n\
+	stale-answer-ttl 1; /* 1 second */\n\
 	transfer-format many-answers;\n\
 	max-cache-size 90%;\n\
 	check-names master fail;\n\
@@ -166,9 +170,12 @@ options {\n\
 	acache-enable no;\n\
 	acache-cleaning-interval 60;\n\
 	max-acache-size 16M;\n\
+	response-cache-entries 0;\n\
 	dnssec-enable yes;\n\
 	dnssec-validation yes; \n\
 	dnssec-accept-expired no;\n\
+	dnssec-key-cache-entries 2048;\n\
+	dnssec-verify-cache-entries 16384;\n\
 	fetches-per-zone 0;\n\
 	fetch-quota-params 100 0.1 0.3 0.7;\n\
 	clients-per-query 10;\n\
@@ -222,6 +229,7 @@ options {\n\
 	max-transfer-idle-in 60;\n\
 	max-transfer-idle-out 60;\n\
 	max-records 0;\n\
+	parallel-load no;\n\
 	max-retry-time 1209600; /* 2 weeks */\n\
 	min-retry-time 500;\n\
 	max-refresh-time 2419200; /* 4 weeks */\n\
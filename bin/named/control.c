@@ -219,6 +219,8 @@ ns_control_docommand(isccc_sexpr_t *message, isc_boolean_t readonly,
 		result = ISC_R_SUCCESS;
 	} else if (command_compare(command, NS_COMMAND_FLUSH)) {
 		result = ns_server_flushcache(ns_g_server, lex);
+	} else if (command_compare(command, NS_COMMAND_SAVECACHE)) {
+		result = ns_server_savecache(ns_g_server, lex, text);
 	} else if (command_compare(command, NS_COMMAND_FLUSHNAME)) {
 		result = ns_server_flushnode(ns_g_server, lex, ISC_FALSE);
 	} else if (command_compare(command, NS_COMMAND_FLUSHTREE)) {
@@ -112,6 +112,7 @@ struct ns_client {
 	isc_socketevent_t *	sendevent;
 	isc_socketevent_t *	recvevent;
 	unsigned char *		recvbuf;
+	unsigned char *		sendbuf;
 	dns_rdataset_t *	opt;
 	isc_uint16_t		udpsize;
 	isc_uint16_t		extflags;
@@ -226,6 +227,15 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_boolean_t
+ns_client_sendcached(ns_client_t *client);
+/*%
+ * Look for a response to the current request in the view's response
+ * cache, using the key in client->query.respcache.  If there is one,
+ * finish processing the request by sending it and return ISC_TRUE;
+ * otherwise return ISC_FALSE and leave the request untouched.
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%
@@ -16,6 +16,7 @@
 #include <isc/netaddr.h>
 
 #include <dns/rdataset.h>
+#include <dns/respcache.h>
 #include <dns/rpz.h>
 #include <dns/types.h>
 
@@ -70,6 +71,11 @@ struct ns_query {
 		dns_rdataset_t *	sigrdataset;
 		isc_boolean_t		authoritative;
 	} redirect;
+	struct {
+		dns_respcachekey_t	key;
+		unsigned int		generation;
+		isc_statscounter_t	counter;
+	} respcache;
 
 };
 
@@ -91,6 +97,7 @@ struct ns_query {
 #define NS_QUERYATTR_DNS64EXCLUDE	0x8000
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #define NS_QUERYATTR_REDIRECT		0x20000
+#define NS_QUERYATTR_RESPCACHE		0x40000
 
 isc_result_t
 ns_query_init(ns_client_t *client);
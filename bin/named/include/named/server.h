@@ -205,7 +205,9 @@ enum {
 	dns_nsstatscounter_cookienew = 54,
 	dns_nsstatscounter_badcookie = 55,
 
-	dns_nsstatscounter_max = 56
+	dns_nsstatscounter_usedstale = 56,
+
+	dns_nsstatscounter_max = 57
 };
 
 /*%
@@ -617,6 +619,14 @@ ns_server_setdebuglevel(ns_server_t *server, isc_lex_t *lex);
 isc_result_t
 ns_server_flushcache(ns_server_t *server, isc_lex_t *lex);
 
+/*%
+ * Write the cache file of each view that has one (or of the named
+ * view), without blocking the server while the cache is written.
+ */
+isc_result_t
+ns_server_savecache(ns_server_t *server, isc_lex_t *lex,
+		    isc_buffer_t **text);
+
 /*%
  * Flush a particular name from the server's cache.  If 'tree' is false,
  * also flush the name from the ADB and badcache.  If 'tree' is true, also
@@ -411,6 +411,19 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 	return (ISC_R_UNEXPECTED);
 }
 
+static isc_result_t
+getudpdispatch(ns_interface_t *ifp, unsigned int attrs, unsigned int attrmask,
+	       dns_dispatch_t **dispp, dns_dispatch_t *dup_dispatch)
+{
+	return (dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
+					ns_g_socketmgr,
+					ns_g_taskmgr, &ifp->addr,
+					4096, UDPBUFFERS,
+					32768, 8219, 8237,
+					attrs, attrmask,
+					dispp, dup_dispatch));
+}
+
 static isc_result_t
 ns_interface_listenudp(ns_interface_t *ifp) {
 	isc_result_t result;
@@ -429,18 +442,32 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
+	/*
+	 * With "reuseport", every listener gets a SO_REUSEPORT socket of
+	 * its own and the kernel spreads the queries over them; otherwise
+	 * the listeners share dup()s of the first listener's socket.
+	 */
+	if (ns_g_reuseport && ns_g_udpdisp > 1)
+		attrs |= DNS_DISPATCHATTR_REUSEPORT;
+
 	ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
-		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
-						 ns_g_socketmgr,
-						 ns_g_taskmgr, &ifp->addr,
-						 4096, UDPBUFFERS,
-						 32768, 8219, 8237,
-						 attrs, attrmask,
-						 &ifp->udpdispatch[disp],
-						 disp == 0
-						    ? NULL
-						    : ifp->udpdispatch[0]);
+		result = getudpdispatch(ifp, attrs, attrmask,
+					&ifp->udpdispatch[disp],
+					(disp == 0 ||
+					 (attrs & DNS_DISPATCHATTR_REUSEPORT) != 0)
+					    ? NULL
+					    : ifp->udpdispatch[0]);
+		if (result == ISC_R_NOTIMPLEMENTED && disp == 0 &&
+		    (attrs & DNS_DISPATCHATTR_REUSEPORT) != 0)
+		{
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "SO_REUSEPORT is not supported; "
+				      "UDP listeners will share a socket");
+			attrs &= ~DNS_DISPATCHATTR_REUSEPORT;
+			result = getudpdispatch(ifp, attrs, attrmask,
+						&ifp->udpdispatch[disp], NULL);
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
@@ -809,15 +809,17 @@ create_managers(void) {
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_timermgr_create(ns_g_mctx, &ns_g_timermgr);
+	result = isc_timermgr_create2(ns_g_mctx, ISC_TIMERMGR_WHEEL,
+				      &ns_g_timermgr);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_timermgr_create() failed: %s",
+				 "isc_timermgr_create2() failed: %s",
 				 isc_result_totext(result));
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr, maxsocks);
+	result = isc_socketmgr_create3(ns_g_mctx, &ns_g_socketmgr, maxsocks,
+				       ns_g_udpdisp);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
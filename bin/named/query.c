@@ -30,6 +30,7 @@
 #include <dns/dns64.h>
 #include <dns/dnssec.h>
 #include <dns/events.h>
+#include <dns/keycache.h>
 #include <dns/message.h>
 #include <dns/ncache.h>
 #include <dns/nsec3.h>
@@ -42,6 +43,7 @@
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -100,6 +102,9 @@
 /*% Client presented a COOKIE. */
 #define WANTCOOKIE(c)		(((c)->attributes & \
 				  NS_CLIENTATTR_WANTCOOKIE) != 0)
+/*% Client wants NSID. */
+#define WANTNSID(c)		(((c)->attributes & \
+				  NS_CLIENTATTR_WANTNSID) != 0)
 /*% No authority? */
 #define NOAUTHORITY(c)		(((c)->query.attributes & \
 				  NS_QUERYATTR_NOAUTHORITY) != 0)
@@ -119,6 +124,22 @@
 #define REDIRECT(c)		(((c)->query.attributes & \
 				  NS_QUERYATTR_REDIRECT) != 0)
 
+/*% May the response be stored in the response cache? */
+#define RESPCACHE(c)		(((c)->query.attributes & \
+				  NS_QUERYATTR_RESPCACHE) != 0)
+
+/*
+ * Response cache key flags, above the 16 bits of DNS message flags.
+ */
+#define RESPCACHE_DO		0x010000
+#define RESPCACHE_EDNS		0x020000
+#define RESPCACHE_TCP		0x040000
+#define RESPCACHE_RA		0x080000
+#define RESPCACHE_INET6		0x100000
+#define RESPCACHE_NSID		0x200000
+#define RESPCACHE_COOKIE	0x400000
+#define RESPCACHE_SERVERCOOKIE	0x800000
+
 /*% No QNAME Proof? */
 #define NOQNAME(r)		(((r)->attributes & \
 				  DNS_RDATASETATTR_NOQNAME) != 0)
@@ -275,6 +296,7 @@ query_send(ns_client_t *client) {
 	else /* We end up here in case of YXDOMAIN, and maybe others */
 		counter = dns_nsstatscounter_failure;
 
+	client->query.respcache.counter = counter;
 	inc_stats(client, counter);
 	ns_client_send(client);
 }
@@ -805,6 +827,24 @@ query_validatezonedb(ns_client_t *client, dns_name_t *name,
 		return (DNS_R_SERVFAIL);
 	}
 
+	/*
+	 * Responses built from this zone can only be cached if changes
+	 * to it flush the view's response cache, and if everyone gets
+	 * the same answer.
+	 */
+	if (RESPCACHE(client)) {
+		queryacl = dns_zone_getqueryacl(zone);
+		if (queryacl == NULL)
+			queryacl = client->view->queryacl;
+		queryonacl = dns_zone_getqueryonacl(zone);
+		if (queryonacl == NULL)
+			queryonacl = client->view->queryonacl;
+		if (dns_zone_getrespcache(zone) != client->view->respcache ||
+		    (queryacl != NULL && !dns_acl_isany(queryacl)) ||
+		    (queryonacl != NULL && !dns_acl_isany(queryonacl)))
+			client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+	}
+
 	if ((options & DNS_GETDB_IGNOREACL) != 0)
 		goto approved;
 	if (dbversion->acl_checked) {
@@ -1097,6 +1137,14 @@ query_getcachedb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 
 	if (!USECACHE(client))
 		return (DNS_R_REFUSED);
+
+	/*
+	 * Unless nobody may use the cache, the answer now depends on
+	 * who is asking.
+	 */
+	if (RESPCACHE(client) && !dns_acl_isnone(client->view->cacheacl))
+		client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	dns_db_attach(client->view->cachedb, &db);
 
 	if ((client->query.attributes & NS_QUERYATTR_CACHEACLOKVALID) != 0) {
@@ -3082,10 +3130,17 @@ get_key(ns_client_t *client, dns_db_t *db, dns_rdata_rrsig_t *rrsig,
 		isc_buffer_t b;
 
 		dns_rdataset_current(keyrdataset, &rdata);
-		isc_buffer_init(&b, rdata.data, rdata.length);
-		isc_buffer_add(&b, rdata.length);
-		result = dst_key_fromdns(&rrsig->signer, rdata.rdclass, &b,
-					 client->mctx, keyp);
+		if (client->view->keycache != NULL) {
+			result = dns_keycache_get(client->view->keycache,
+						  &rrsig->signer, &rdata,
+						  keyp);
+		} else {
+			isc_buffer_init(&b, rdata.data, rdata.length);
+			isc_buffer_add(&b, rdata.length);
+			result = dst_key_fromdns(&rrsig->signer,
+						 rdata.rdclass, &b,
+						 client->mctx, keyp);
+		}
 		if (result != ISC_R_SUCCESS)
 			continue;
 		if (rrsig->algorithm == (dns_secalg_t)dst_key_alg(*keyp) &&
@@ -3110,9 +3165,9 @@ verify(dst_key_t *key, dns_name_t *name, dns_rdataset_t *rdataset,
 	dns_fixedname_init(&fixed);
 
 again:
-	result = dns_dnssec_verify3(name, rdataset, key, ignore,
+	result = dns_dnssec_verify4(name, rdataset, key, ignore,
 				    client->view->maxbits, client->mctx,
-				    rdata, NULL);
+				    rdata, NULL, client->view->verifycache);
 	if (result == DNS_R_SIGEXPIRED && client->view->acceptexpired) {
 		ignore = ISC_TRUE;
 		goto again;
@@ -3942,20 +3997,19 @@ prefetch_done(isc_task_t *task, isc_event_t *event) {
 	ns_client_detach(&client);
 }
 
+/*
+ * Start a fetch that refreshes 'qname'/'qtype' in the cache; nobody
+ * waits for its result.  A client runs at most one such fetch.
+ */
 static void
-query_prefetch(ns_client_t *client, dns_name_t *qname,
-	       dns_rdataset_t *rdataset)
-{
+query_refresh(ns_client_t *client, dns_name_t *qname, dns_rdatatype_t qtype) {
 	isc_result_t result;
 	isc_sockaddr_t *peeraddr;
 	dns_rdataset_t *tmprdataset;
 	ns_client_t *dummy = NULL;
 	unsigned int options;
 
-	if (client->query.prefetch != NULL ||
-	    client->view->prefetch_trigger == 0U ||
-	    rdataset->ttl > client->view->prefetch_trigger ||
-	    (rdataset->attributes & DNS_RDATASETATTR_PREFETCH) == 0)
+	if (client->query.prefetch != NULL)
 		return;
 
 	if (client->recursionquota == NULL) {
@@ -3979,7 +4033,7 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 	ns_client_attach(client, &dummy);
 	options = client->query.fetchoptions | DNS_FETCHOPT_PREFETCH;
 	result = dns_resolver_createfetch3(client->view->resolver,
-					   qname, rdataset->type, NULL, NULL,
+					   qname, qtype, NULL, NULL,
 					   NULL, peeraddr, client->message->id,
 					   options, 0, NULL, client->task,
 					   prefetch_done, client,
@@ -3989,9 +4043,45 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 		query_putrdataset(client, &tmprdataset);
 		ns_client_detach(&dummy);
 	}
+}
+
+static void
+query_prefetch(ns_client_t *client, dns_name_t *qname,
+	       dns_rdataset_t *rdataset)
+{
+	if (client->query.prefetch != NULL ||
+	    client->view->prefetch_trigger == 0U ||
+	    rdataset->ttl > client->view->prefetch_trigger ||
+	    (rdataset->attributes & DNS_RDATASETATTR_PREFETCH) == 0)
+		return;
+
+	query_refresh(client, qname, rdataset->type);
 	dns_rdataset_clearprefetch(rdataset);
 }
 
+/*
+ * The cache answered with data that has expired but is still within
+ * the view's stale window.  Answer with it at once, with a short TTL,
+ * and refresh it in the background so that the next client gets a
+ * fresh answer.
+ */
+static void
+query_usestale(ns_client_t *client, dns_name_t *qname,
+	       dns_rdatatype_t qtype, dns_rdataset_t *rdataset,
+	       dns_rdataset_t *sigrdataset)
+{
+	dns_ttl_t ttl = client->view->staleanswerttl;
+
+	if (rdataset->ttl > ttl)
+		rdataset->ttl = ttl;
+	if (sigrdataset != NULL && dns_rdataset_isassociated(sigrdataset) &&
+	    sigrdataset->ttl > ttl)
+		sigrdataset->ttl = ttl;
+
+	inc_stats(client, dns_nsstatscounter_usedstale);
+	query_refresh(client, qname, qtype);
+}
+
 static isc_result_t
 query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	      dns_name_t *qdomain, dns_rdataset_t *nameservers,
@@ -6499,7 +6589,7 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 	dns_zone_t *zone;
 	dns_rdata_cname_t cname;
 	dns_rdata_dname_t dname;
-	unsigned int options;
+	unsigned int options, dboptions;
 	isc_boolean_t empty_wild;
 	dns_rdataset_t *noqname;
 	dns_rpz_st_t *rpz_st;
@@ -6961,15 +7051,43 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 	}
 
 	/*
-	 * Now look for an answer in the database.
-	 */
+	 * Now look for an answer in the database.  If the view serves
+	 * stale answers, a cache lookup for a client we may recurse for
+	 * also finds data that has expired but is still in the stale
+	 * window.
+	 */
+	dboptions = client->query.dboptions;
+	if (!is_zone && client->view->staleanswersenable &&
+	    RECURSIONOK(client) && type != dns_rdatatype_any)
+		dboptions |= DNS_DBFIND_STALEOK;
 	result = dns_db_findext(db, client->query.qname, version, type,
-				client->query.dboptions, client->now,
+				dboptions, client->now,
 				&node, fname, &cm, &ci, rdataset, sigrdataset);
 
 	if (!is_zone)
 		dns_cache_updatestats(client->view->cache, result);
 
+	if ((dboptions & DNS_DBFIND_STALEOK) != 0 &&
+	    dns_rdataset_isassociated(rdataset) &&
+	    (rdataset->attributes & DNS_RDATASETATTR_STALE) != 0)
+	{
+		switch (result) {
+		case ISC_R_SUCCESS:
+		case DNS_R_CNAME:
+		case DNS_R_DNAME:
+		case DNS_R_NCACHENXDOMAIN:
+		case DNS_R_NCACHENXRRSET:
+			query_usestale(client, client->query.qname, type,
+				       rdataset, sigrdataset);
+			break;
+		default:
+			/*
+			 * A stale delegation: recurse as usual.
+			 */
+			break;
+		}
+	}
+
  resume:
 	CTRACE(ISC_LOG_DEBUG(3), "query_find: resume");
 
@@ -9003,6 +9121,95 @@ log_queryerror(ns_client_t *client, isc_result_t result, int line, int level) {
 		      classp, sep2, typep, __FILE__, line);
 }
 
+/*
+ * Can the response to this query be shared with other clients asking
+ * the same question?  Anything that makes the answer depend on the
+ * client, or on data that changes without a zone update, rules it out.
+ */
+static isc_boolean_t
+query_respcacheok(ns_client_t *client) {
+	dns_view_t *view = client->view;
+	dns_message_t *message = client->message;
+
+	if (view->respcache == NULL || RECURSIONOK(client))
+		return (ISC_FALSE);
+
+	if (view->rpzs != NULL || !ISC_LIST_EMPTY(view->dns64) ||
+	    view->sortlist != NULL || view->rrl != NULL ||
+	    view->nocasecompress != NULL || view->requireservercookie ||
+	    view->redirect != NULL || view->redirectzone != NULL ||
+	    !ISC_LIST_EMPTY(view->dlz_searched))
+		return (ISC_FALSE);
+#ifdef ALLOW_FILTER_AAAA
+	if (view->v4_aaaa != dns_aaaa_ok || view->v6_aaaa != dns_aaaa_ok)
+		return (ISC_FALSE);
+#endif
+#ifdef HAVE_DNSTAP
+	if (view->dtenv != NULL)
+		return (ISC_FALSE);
+#endif
+
+	/*
+	 * Signed requests get signed responses.  The EXPIRE and
+	 * CLIENT-SUBNET options change the answer itself; other EDNS
+	 * options only change the OPT record, which is not cached.
+	 */
+	if (message->tsigkey != NULL || message->sig0 != NULL ||
+	    (client->attributes & (NS_CLIENTATTR_WANTEXPIRE |
+				   NS_CLIENTATTR_HAVEECS)) != 0)
+		return (ISC_FALSE);
+
+	return (ISC_TRUE);
+}
+
+/*
+ * Set up the response cache key for this query: the question, the
+ * query flags that are echoed or acted on, and whatever decides how
+ * the response is rendered and truncated.
+ */
+static void
+query_respcachekey(ns_client_t *client) {
+	dns_respcachekey_t *key = &client->query.respcache.key;
+	unsigned int flags;
+
+	flags = client->message->flags &
+		(DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_CD | DNS_MESSAGEFLAG_AD);
+	if (WANTDNSSEC(client))
+		flags |= RESPCACHE_DO;
+	if (client->ednsversion >= 0)
+		flags |= RESPCACHE_EDNS;
+	if (TCP(client))
+		flags |= RESPCACHE_TCP;
+	if ((client->attributes & NS_CLIENTATTR_RA) != 0)
+		flags |= RESPCACHE_RA;
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6)
+		flags |= RESPCACHE_INET6;
+	/*
+	 * These options do not change the cached part of the response,
+	 * but they change the size of the OPT record sent with it, and
+	 * a valid server cookie raises the UDP response size limit.
+	 */
+	if (WANTNSID(client))
+		flags |= RESPCACHE_NSID;
+	if (WANTCOOKIE(client))
+		flags |= RESPCACHE_COOKIE;
+	if (HAVECOOKIE(client))
+		flags |= RESPCACHE_SERVERCOOKIE;
+
+	key->qname = client->query.qname;
+	key->qtype = client->query.qtype;
+	key->qclass = client->message->rdclass;
+	key->flags = flags;
+	key->udpsize = 0;
+	if (!TCP(client))
+		key->udpsize = (client->ednsversion >= 0) ? client->udpsize
+							  : 512;
+
+	client->query.respcache.generation =
+		dns_respcache_generation(client->view->respcache);
+	client->query.respcache.counter = dns_nsstatscounter_success;
+}
+
 void
 ns_query_start(ns_client_t *client) {
 	isc_result_t result;
@@ -9155,6 +9362,17 @@ ns_query_start(ns_client_t *client) {
 		}
 	}
 
+	/*
+	 * Answer from the response cache if we can, and if not, note
+	 * whether the response we are about to build may be stored.
+	 */
+	if (query_respcacheok(client)) {
+		query_respcachekey(client);
+		if (ns_client_sendcached(client))
+			return;
+		client->query.attributes |= NS_QUERYATTR_RESPCACHE;
+	}
+
 	/*
 	 * Turn on minimal response for DNSKEY and DS queries.
 	 */
@@ -66,6 +66,7 @@
 #include <dns/forward.h>
 #include <dns/fixedname.h>
 #include <dns/journal.h>
+#include <dns/keycache.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/lib.h>
@@ -82,6 +83,7 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
 #include <dns/secalg.h>
@@ -90,6 +92,7 @@
 #include <dns/tkey.h>
 #include <dns/tsig.h>
 #include <dns/ttl.h>
+#include <dns/verifycache.h>
 #include <dns/view.h>
 #include <dns/zone.h>
 #include <dns/zt.h>
@@ -2420,6 +2423,7 @@ configure_catz_zone(dns_view_t *view, const cfg_obj_t *config,
 			dns_zone_setview(dnszone, view);
 			if (view->acache != NULL)
 				dns_zone_setacache(dnszone, view->acache);
+			dns_zone_setrespcache(dnszone, view->respcache);
 			dns_view_addzone(view, dnszone);
 		}
 
@@ -3136,6 +3140,25 @@ create_mapped_acl(void) {
 	return (result);
 }
 
+/*
+ * Choose the number of node locks for a new cache database: four per
+ * worker thread, but no more than one per megabyte of 'max-cache-size'
+ * so that small caches are not spread over many mostly empty buckets.
+ * The result must fit in the node's DNS_RBT_LOCKLENGTH bit lock number.
+ */
+static unsigned int
+cache_nodelocks(size_t max_cache_size) {
+	unsigned int count = ns_g_cpus * 4;
+
+	if (max_cache_size != 0U && count > max_cache_size / (1024 * 1024))
+		count = (unsigned int)(max_cache_size / (1024 * 1024));
+	if (count < 16)
+		count = 16;
+	if (count >= (1U << DNS_RBT_LOCKLENGTH))
+		count = (1U << DNS_RBT_LOCKLENGTH) - 1;
+	return (count);
+}
+
 /*
  * Configure 'view' according to 'vconfig', taking defaults from 'config'
  * where values are missing in 'vconfig'.
@@ -3177,9 +3200,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	size_t max_acache_size;
 	size_t max_adb_size;
 	isc_uint32_t lame_ttl, fail_ttl;
+	isc_uint32_t max_stale_ttl = 0;
 	dns_tsig_keyring_t *ring = NULL;
 	dns_view_t *pview = NULL;	/* Production view */
 	isc_mem_t *cmctx = NULL, *hmctx = NULL;
+	char nodelocks[sizeof("4294967295")];
+	char *db_argv[1];
 	dns_dispatch_t *dispatch4 = NULL;
 	dns_dispatch_t *dispatch6 = NULL;
 	isc_boolean_t reused_cache = ISC_FALSE;
@@ -3288,6 +3314,16 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		dns_acache_setcachesize(view->acache, max_acache_size);
 	}
 
+	/*
+	 * Create the response cache if it is enabled.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "response-cache-entries", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asuint32(obj) != 0)
+		CHECK(dns_respcache_create(mctx, cfg_obj_asuint32(obj),
+					   &view->respcache));
+
 	CHECK(configure_view_acl(vconfig, config, "allow-query", NULL, actx,
 				 ns_g_mctx, &view->queryacl));
 	if (view->queryacl == NULL) {
@@ -3637,6 +3673,24 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		auto_root = ISC_TRUE;
 	}
 
+	/*
+	 * Create the DNSKEY and signature check caches if the view
+	 * validates.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "dnssec-key-cache-entries", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (view->enablevalidation && cfg_obj_asuint32(obj) != 0)
+		CHECK(dns_keycache_create(mctx, cfg_obj_asuint32(obj),
+					  &view->keycache));
+
+	obj = NULL;
+	result = ns_config_get(maps, "dnssec-verify-cache-entries", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (view->enablevalidation && cfg_obj_asuint32(obj) != 0)
+		CHECK(dns_verifycache_create(mctx, cfg_obj_asuint32(obj),
+					     &view->verifycache));
+
 	obj = NULL;
 	result = ns_config_get(maps, "max-cache-ttl", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -3649,6 +3703,23 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	if (view->maxncachettl > 7 * 24 * 3600)
 		view->maxncachettl = 7 * 24 * 3600;
 
+	obj = NULL;
+	result = ns_config_get(maps, "stale-answer-enable", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->staleanswersenable = cfg_obj_asboolean(obj);
+
+	obj = NULL;
+	result = ns_config_get(maps, "stale-answer-ttl", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->staleanswerttl = ISC_MAX(cfg_obj_asuint32(obj), 1);
+
+	if (view->staleanswersenable) {
+		obj = NULL;
+		result = ns_config_get(maps, "max-stale-ttl", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		max_stale_ttl = cfg_obj_asuint32(obj);
+	}
+
 	/*
 	 * Configure the view's cache.
 	 *
@@ -3744,9 +3815,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 			isc_mem_setname(cmctx, "cache", NULL);
 			CHECK(isc_mem_create(0, 0, &hmctx));
 			isc_mem_setname(hmctx, "cache_heap", NULL);
+			snprintf(nodelocks, sizeof(nodelocks), "%u",
+				 cache_nodelocks(max_cache_size));
+			db_argv[0] = nodelocks;
 			CHECK(dns_cache_create3(cmctx, hmctx, ns_g_taskmgr,
 						ns_g_timermgr, view->rdclass,
-						cachename, "rbt", 0, NULL,
+						cachename, "rbt", 1, db_argv,
 						&cache));
 			isc_mem_detach(&cmctx);
 			isc_mem_detach(&hmctx);
@@ -3775,12 +3849,30 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	result = ns_config_get(maps, "cache-file", &obj);
 	if (result == ISC_R_SUCCESS && strcmp(view->name, "_bind") != 0) {
 		CHECK(dns_cache_setfilename(cache, cfg_obj_asstring(obj)));
-		if (!reused_cache && !shared_cache)
-			CHECK(dns_cache_load(cache));
+		/*
+		 * The cache file only warms the cache up; failing to
+		 * load it is not fatal.
+		 */
+		if (!reused_cache && !shared_cache) {
+			result = dns_cache_load(cache);
+			if (result != ISC_R_SUCCESS &&
+			    result != ISC_R_FILENOTFOUND)
+				isc_log_write(ns_g_lctx,
+					      NS_LOGCATEGORY_GENERAL,
+					      NS_LOGMODULE_SERVER,
+					      ISC_LOG_WARNING,
+					      "view '%s': loading cache "
+					      "file '%s' failed: %s",
+					      view->name,
+					      cfg_obj_asstring(obj),
+					      isc_result_totext(result));
+			result = ISC_R_SUCCESS;
+		}
 	}
 
 	dns_cache_setcleaninginterval(cache, cleaning_interval);
 	dns_cache_setcachesize(cache, max_cache_size);
+	dns_cache_setservestalettl(cache, max_stale_ttl);
 
 	dns_cache_detach(&cache);
 
@@ -3804,12 +3896,14 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	}
 
 	if (resstats == NULL) {
-		CHECK(isc_stats_create(mctx, &resstats,
-				       dns_resstatscounter_max));
+		CHECK(isc_stats_create2(mctx, &resstats,
+					dns_resstatscounter_max,
+					ISC_STATS_SHARDED));
 	}
 	dns_view_setresstats(view, resstats);
 	if (resquerystats == NULL)
-		CHECK(dns_rdatatypestats_create(mctx, &resquerystats));
+		CHECK(dns_rdatatypestats_create2(mctx, &resquerystats,
+						 ISC_STATS_SHARDED));
 	dns_view_setresquerystats(view, resquerystats);
 
 	ndisp = 4 * ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
@@ -5468,6 +5562,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 		dns_zone_setview(zone, view);
 		if (view->acache != NULL)
 			dns_zone_setacache(zone, view->acache);
+		dns_zone_setrespcache(zone, view->respcache);
 	} else {
 		/*
 		 * We cannot reuse an existing zone, we have
@@ -5478,6 +5573,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 		dns_zone_setview(zone, view);
 		if (view->acache != NULL)
 			dns_zone_setacache(zone, view->acache);
+		dns_zone_setrespcache(zone, view->respcache);
 		CHECK(dns_zonemgr_managezone(ns_g_server->zonemgr, zone));
 		dns_zone_setstats(zone, ns_g_server->zonestats);
 	}
@@ -7393,6 +7489,14 @@ load_configuration(const char *filename, ns_server_t *server,
 	if ((ns_g_listen > 0) && (ns_g_listen < 10))
 		ns_g_listen = 10;
 
+	/*
+	 * Should each UDP listener have a SO_REUSEPORT socket of its own?
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_g_reuseport = cfg_obj_asboolean(obj);
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -8489,8 +8593,9 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->tcpoutstats4 = NULL;
 	server->tcpinstats6 = NULL;
 	server->tcpoutstats6 = NULL;
-	CHECKFATAL(isc_stats_create(server->mctx, &server->sockstats,
-				    isc_sockstatscounter_max),
+	CHECKFATAL(isc_stats_create2(server->mctx, &server->sockstats,
+				     isc_sockstatscounter_max,
+				     ISC_STATS_SHARDED),
 		   "isc_stats_create");
 	isc_socketmgr_setstats(ns_g_socketmgr, server->sockstats);
 
@@ -8519,12 +8624,14 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->server_usehostname = ISC_FALSE;
 	server->server_id = NULL;
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->nsstats,
-				    dns_nsstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->nsstats,
+				     dns_nsstatscounter_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (server)");
 
-	CHECKFATAL(dns_rdatatypestats_create(ns_g_mctx,
-					     &server->rcvquerystats),
+	CHECKFATAL(dns_rdatatypestats_create2(ns_g_mctx,
+					      &server->rcvquerystats,
+					      ISC_STATS_SHARDED),
 		   "dns_stats_create (rcvquery)");
 
 	CHECKFATAL(dns_opcodestats_create(ns_g_mctx, &server->opcodestats),
@@ -8537,40 +8644,49 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 				    dns_zonestatscounter_max),
 		   "dns_stats_create (zone)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->resolverstats,
-				    dns_resstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->resolverstats,
+				     dns_resstatscounter_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (resolver)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (inbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (outbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (inbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (outbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (inbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (outbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (inbound TCP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATS_SHARDED),
 		   "dns_stats_create (outbound TCP IPv6 traffic size)");
 
 	server->flushonshutdown = ISC_FALSE;
@@ -10057,6 +10173,121 @@ ns_server_flushcache(ns_server_t *server, isc_lex_t *lex) {
 	return (result);
 }
 
+struct savecache {
+	isc_mem_t		*mctx;
+	dns_cache_t		*cache;
+	dns_dumpctx_t		*dctx;
+	char			*viewname;
+};
+
+static void
+savecache_done(void *arg, isc_result_t result) {
+	struct savecache *sc = arg;
+
+	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+		      NS_LOGMODULE_SERVER,
+		      (result == ISC_R_SUCCESS) ? ISC_LOG_INFO : ISC_LOG_ERROR,
+		      "saving cache in view '%s': %s", sc->viewname,
+		      isc_result_totext(result));
+
+	dns_dumpctx_detach(&sc->dctx);
+	dns_cache_detach(&sc->cache);
+	isc_mem_free(sc->mctx, sc->viewname);
+	isc_mem_putanddetach(&sc->mctx, sc, sizeof(*sc));
+}
+
+static isc_result_t
+savecache(ns_server_t *server, ns_cache_t *nsc) {
+	struct savecache *sc;
+	isc_result_t result;
+
+	sc = isc_mem_get(server->mctx, sizeof(*sc));
+	if (sc == NULL)
+		return (ISC_R_NOMEMORY);
+	sc->mctx = NULL;
+	sc->cache = NULL;
+	sc->dctx = NULL;
+	sc->viewname = isc_mem_strdup(server->mctx, nsc->primaryview->name);
+	if (sc->viewname == NULL) {
+		isc_mem_put(server->mctx, sc, sizeof(*sc));
+		return (ISC_R_NOMEMORY);
+	}
+	isc_mem_attach(server->mctx, &sc->mctx);
+	dns_cache_attach(nsc->cache, &sc->cache);
+
+	result = dns_cache_dumpinc(sc->cache, server->task, savecache_done,
+				   sc, &sc->dctx);
+	if (result == DNS_R_CONTINUE)
+		return (ISC_R_SUCCESS);
+
+	dns_cache_detach(&sc->cache);
+	isc_mem_free(sc->mctx, sc->viewname);
+	isc_mem_putanddetach(&sc->mctx, sc, sizeof(*sc));
+	return (result);
+}
+
+isc_result_t
+ns_server_savecache(ns_server_t *server, isc_lex_t *lex,
+		    isc_buffer_t **text)
+{
+	char *ptr;
+	char msg[DNS_NAME_FORMATSIZE + 100];
+	ns_cache_t *nsc;
+	isc_result_t result, tresult = ISC_R_SUCCESS;
+	unsigned int started = 0;
+	isc_boolean_t found = ISC_FALSE;
+
+	/* Skip the command name. */
+	ptr = next_token(lex, NULL);
+	if (ptr == NULL)
+		return (ISC_R_UNEXPECTEDEND);
+
+	/* Look for the view name. */
+	ptr = next_token(lex, NULL);
+
+	result = isc_task_beginexclusive(server->task);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	for (nsc = ISC_LIST_HEAD(server->cachelist);
+	     nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		if (ptr != NULL && strcasecmp(ptr, nsc->primaryview->name) != 0)
+			continue;
+		found = ISC_TRUE;
+		result = savecache(server, nsc);
+		if (result == ISC_R_SUCCESS) {
+			started++;
+			continue;
+		}
+		if (result == ISC_R_NOTFOUND && ptr == NULL)
+			continue;	/* no cache-file */
+		snprintf(msg, sizeof(msg),
+			 "view '%s': %s\n", nsc->primaryview->name,
+			 (result == ISC_R_NOTFOUND) ? "no cache-file"
+						    : isc_result_totext(result));
+		CHECK(putstr(text, msg));
+		tresult = result;
+	}
+
+	if (!found) {
+		CHECK(putstr(text, "view '"));
+		CHECK(putstr(text, ptr));
+		CHECK(putstr(text, "' not found"));
+		tresult = ISC_R_NOTFOUND;
+	} else {
+		snprintf(msg, sizeof(msg), "saving cache in %u view%s",
+			 started, (started == 1) ? "" : "s");
+		CHECK(putstr(text, msg));
+	}
+	CHECK(putnull(text));
+	result = tresult;
+
+ cleanup:
+	isc_task_endexclusive(server->task);
+	return (result);
+}
+
 isc_result_t
 ns_server_flushnode(ns_server_t *server, isc_lex_t *lex, isc_boolean_t tree) {
 	char *ptr, *viewname;
@@ -998,6 +998,12 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 	if (zone != mayberaw)
 		dns_zone_setmaxrecords(zone, 0);
 
+	obj = NULL;
+	result = ns_config_get(maps, "parallel-load", &obj);
+	INSIST(result == ISC_R_SUCCESS && obj != NULL);
+	dns_zone_setoption2(mayberaw, DNS_ZONEOPT2_PARALLELLOAD,
+			    cfg_obj_asboolean(obj));
+
 	if (raw != NULL && filename != NULL) {
 #define SIGNED ".signed"
 		size_t signedlen = strlen(filename) + sizeof(SIGNED);
@@ -1770,6 +1770,8 @@ check_zoneconf(const cfg_obj_t *zconfig, const cfg_obj_t *voptions,
 	{ "notify", MASTERZONE | SLAVEZONE },
 	{ "notify-source", MASTERZONE | SLAVEZONE },
 	{ "notify-source-v6", MASTERZONE | SLAVEZONE },
+	{ "parallel-load", MASTERZONE | SLAVEZONE | STUBZONE |
+	  REDIRECTZONE },
 	{ "pubkey", MASTERZONE | SLAVEZONE | STUBZONE },
 	{ "request-expire", SLAVEZONE | REDIRECTZONE },
 	{ "request-ixfr", SLAVEZONE | REDIRECTZONE },
@@ -19,6 +19,7 @@
 
 #include <limits.h>
 
+#include <isc/atomic.h>
 #include <isc/mutexblock.h>
 #include <isc/netaddr.h>
 #include <isc/print.h>
@@ -89,6 +90,33 @@ typedef ISC_LIST(dns_adbentry_t) dns_adbentrylist_t;
 typedef struct dns_adbfetch dns_adbfetch_t;
 typedef struct dns_adbfetch6 dns_adbfetch6_t;
 
+/*%
+ * A hash index over the live names or entries of one bucket.  An index
+ * doubles its number of chains when it averages more than two items
+ * per chain.  This happens under the bucket lock, so the tables grow a
+ * bucket at a time while the other buckets stay in use.
+ */
+typedef struct adbnameindex {
+	dns_adbnamelist_t		*chains;
+	unsigned int			nchains;	/* power of two */
+	unsigned int			count;
+} adbnameindex_t;
+
+typedef struct adbentryindex {
+	dns_adbentrylist_t		*chains;
+	unsigned int			nchains;	/* power of two */
+	unsigned int			count;
+} adbentryindex_t;
+
+#define ADB_INDEX_MINCHAINS	4
+
+/*%
+ * The bucket is chosen by the hash value modulo the (prime) number of
+ * buckets; the chain within the bucket's index by the quotient.
+ */
+#define ADB_CHAIN(index, nbuckets, hashval) \
+	(((hashval) / (nbuckets)) & ((index)->nchains - 1))
+
 /*% dns adb structure */
 struct dns_adb {
 	unsigned int                    magic;
@@ -101,7 +129,6 @@ struct dns_adb {
 
 	isc_taskmgr_t                  *taskmgr;
 	isc_task_t                     *task;
-	isc_task_t                     *excl;
 
 	isc_interval_t                  tick_interval;
 	int                             next_cleanbucket;
@@ -127,6 +154,7 @@ struct dns_adb {
 	isc_mutex_t                     namescntlock;
 	unsigned int			namescnt;
 	dns_adbnamelist_t               *names;
+	adbnameindex_t			*nameindex;
 	dns_adbnamelist_t               *deadnames;
 	isc_mutex_t                     *namelocks;
 	isc_boolean_t                   *name_sd;
@@ -141,6 +169,7 @@ struct dns_adb {
 	isc_mutex_t                     entriescntlock;
 	unsigned int			entriescnt;
 	dns_adbentrylist_t              *entries;
+	adbentryindex_t			*entryindex;
 	dns_adbentrylist_t              *deadentries;
 	isc_mutex_t                     *entrylocks;
 	isc_boolean_t                   *entry_sd; /*%< shutting down */
@@ -150,10 +179,6 @@ struct dns_adb {
 	isc_boolean_t                   cevent_out;
 	isc_boolean_t                   shutting_down;
 	isc_eventlist_t                 whenshutdown;
-	isc_event_t			growentries;
-	isc_boolean_t			growentries_sent;
-	isc_event_t			grownames;
-	isc_boolean_t			grownames_sent;
 
 	isc_uint32_t			quota;
 	isc_uint32_t			atr_freq;
@@ -189,7 +214,9 @@ struct dns_adbname {
 	/* for LRU-based management */
 	isc_stdtime_t                   last_used;
 
+	unsigned int			hashval;
 	ISC_LINK(dns_adbname_t)         plink;
+	ISC_LINK(dns_adbname_t)         hlink;
 };
 
 /*% The adbfetch structure */
@@ -238,8 +265,8 @@ struct dns_adbentry {
 	unsigned int                    refcnt;
 	unsigned int                    nh;
 
-	unsigned int                    flags;
-	unsigned int                    srtt;
+	isc_uint32_t                    flags;
+	isc_uint32_t                    srtt;
 	isc_uint16_t			udpsize;
 	unsigned int			completed;
 	unsigned int			timeouts;
@@ -275,9 +302,70 @@ struct dns_adbentry {
 	 */
 
 	ISC_LIST(dns_adblameinfo_t)     lameinfo;
+	unsigned int			hashval;
 	ISC_LINK(dns_adbentry_t)        plink;
+	ISC_LINK(dns_adbentry_t)        hlink;
 };
 
+/*%
+ * The round trip time, flags, expiry and outstanding query count of an
+ * entry are read and updated for every query sent, so where the platform
+ * allows it they are changed with compare-and-swap rather than under the
+ * entry bucket lock.  This is safe because an entry cannot be freed while
+ * the caller holds a dns_adbaddrinfo_t for it.  Everything else in the
+ * entry is still protected by the bucket lock.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && \
+    defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
+#define ADB_USEATOMIC 1
+#endif
+
+#ifdef ADB_USEATOMIC
+#define ENTRY_LOCK(adb, e)
+#define ENTRY_UNLOCK(adb, e)
+
+static inline isc_uint32_t
+entry_cmpxchg(isc_uint32_t *p, isc_uint32_t cmpval, isc_uint32_t val) {
+	return ((isc_uint32_t)isc_atomic_cmpxchg((isc_int32_t *)p,
+						 (isc_int32_t)cmpval,
+						 (isc_int32_t)val));
+}
+#else
+#define ENTRY_LOCK(adb, e)	LOCK(&(adb)->entrylocks[(e)->lock_bucket])
+#define ENTRY_UNLOCK(adb, e)	UNLOCK(&(adb)->entrylocks[(e)->lock_bucket])
+
+static inline isc_uint32_t
+entry_cmpxchg(isc_uint32_t *p, isc_uint32_t cmpval, isc_uint32_t val) {
+	isc_uint32_t old = *p;
+
+	if (old == cmpval)
+		*p = val;
+	return (old);
+}
+#endif
+
+static inline void
+entry_setbits(dns_adbentry_t *entry, isc_uint32_t bits, isc_uint32_t mask) {
+	isc_uint32_t flags, old;
+
+	old = entry->flags;
+	do {
+		flags = old;
+		old = entry_cmpxchg(&entry->flags, flags,
+				    (flags & ~mask) | (bits & mask));
+	} while (old != flags);
+}
+
+/*
+ * Keep an entry that is in use for at least ADB_ENTRY_WINDOW seconds.
+ */
+static inline void
+entry_setexpires(dns_adbentry_t *entry, isc_stdtime_t now) {
+	if (entry->expires == 0)
+		(void)entry_cmpxchg(&entry->expires, 0,
+				    now + ADB_ENTRY_WINDOW);
+}
+
 /*
  * Internal functions (and prototypes).
  */
@@ -335,6 +423,7 @@ static inline void check_exit(dns_adb_t *);
 static void destroy(dns_adb_t *);
 static isc_boolean_t shutdown_names(dns_adb_t *);
 static isc_boolean_t shutdown_entries(dns_adb_t *);
+static inline void nameindex_remove(dns_adb_t *, dns_adbname_t *);
 static inline void link_name(dns_adb_t *, int, dns_adbname_t *);
 static inline isc_boolean_t unlink_name(dns_adb_t *, dns_adbname_t *);
 static inline void link_entry(dns_adb_t *, int, dns_adbentry_t *);
@@ -534,330 +623,13 @@ ttlclamp(dns_ttl_t ttl) {
 }
 
 /*
- * Hashing is most efficient if the number of buckets is prime.
- * The sequence below is the closest previous primes to 2^n and
- * 1.5 * 2^n, for values of n from 10 to 28.  (The tables will
- * no longer grow beyond 2^28 entries.)
+ * Hashing is most efficient if the number of buckets is prime.  The
+ * number of buckets, and so of bucket locks, is fixed; each bucket's
+ * index grows as it fills.
  */
-static const unsigned nbuckets[] = { 1021, 1531, 2039, 3067, 4093, 6143,
-				     8191, 12281, 16381, 24571, 32749,
-				     49193, 65521, 98299, 131071, 199603,
-				     262139, 393209, 524287, 768431, 1048573,
-				     1572853, 2097143, 3145721, 4194301,
-				     6291449, 8388593, 12582893, 16777213,
-				     25165813, 33554393, 50331599, 67108859,
-				     100663291, 134217689, 201326557,
-				     268535431, 0 };
-
-static void
-grow_entries(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbentry_t *e;
-	dns_adbentrylist_t *newdeadentries = NULL;
-	dns_adbentrylist_t *newentries = NULL;
-	isc_boolean_t *newentry_sd = NULL;
-	isc_mutex_t *newentrylocks = NULL;
-	isc_result_t result;
-	unsigned int *newentry_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nentries >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_entries to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nentries; i++)
-		if (adb->entry_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newentries = isc_mem_get(adb->mctx, sizeof(*newentries) * n);
-	newdeadentries = isc_mem_get(adb->mctx, sizeof(*newdeadentries) * n);
-	newentrylocks = isc_mem_get(adb->mctx, sizeof(*newentrylocks) * n);
-	newentry_sd = isc_mem_get(adb->mctx, sizeof(*newentry_sd) * n);
-	newentry_refcnt = isc_mem_get(adb->mctx, sizeof(*newentry_refcnt) * n);
-	if (newentries == NULL || newdeadentries == NULL ||
-	    newentrylocks == NULL || newentry_sd == NULL ||
-	    newentry_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newentrylocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newentries[i]);
-		ISC_LIST_INIT(newdeadentries[i]);
-		newentry_sd[i] = ISC_FALSE;
-		newentry_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
-
-	/*
-	 * Move entries to new arrays.
-	 */
-	for (i = 0; i < adb->nentries; i++) {
-		e = ISC_LIST_HEAD(adb->entries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->entries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, ISC_TRUE) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->entries[i]);
-		}
-		e = ISC_LIST_HEAD(adb->deadentries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->deadentries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, ISC_TRUE) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->deadentries[i]);
-		}
-		INSIST(adb->entry_refcnt[i] == 0);
-		adb->irefcnt--;
-	}
-
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
-	isc_mem_put(adb->mctx, adb->entries,
-		    sizeof(*adb->entries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->deadentries,
-		    sizeof(*adb->deadentries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entrylocks,
-		    sizeof(*adb->entrylocks) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_sd,
-		    sizeof(*adb->entry_sd) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_refcnt,
-		    sizeof(*adb->entry_refcnt) * adb->nentries);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->entries = newentries;
-	adb->deadentries = newdeadentries;
-	adb->entrylocks = newentrylocks;
-	adb->entry_sd = newentry_sd;
-	adb->entry_refcnt = newentry_refcnt;
-	adb->nentries = n;
-
-	set_adbstat(adb, adb->nentries, dns_adbstats_nentries);
-
-	/*
-	 * Only on success do we set adb->growentries_sent to ISC_FALSE.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->growentries_sent = ISC_FALSE;
-	goto done;
-
- cleanup:
-	if (newentries != NULL)
-		isc_mem_put(adb->mctx, newentries,
-			    sizeof(*newentries) * n);
-	if (newdeadentries != NULL)
-		isc_mem_put(adb->mctx, newdeadentries,
-			    sizeof(*newdeadentries) * n);
-	if (newentrylocks != NULL)
-		isc_mem_put(adb->mctx, newentrylocks,
-			    sizeof(*newentrylocks) * n);
-	if (newentry_sd != NULL)
-		isc_mem_put(adb->mctx, newentry_sd,
-			    sizeof(*newentry_sd) * n);
-	if (newentry_refcnt != NULL)
-		isc_mem_put(adb->mctx, newentry_refcnt,
-			     sizeof(*newentry_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_entries finished");
-}
-
-static void
-grow_names(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbname_t *name;
-	dns_adbnamelist_t *newdeadnames = NULL;
-	dns_adbnamelist_t *newnames = NULL;
-	isc_boolean_t *newname_sd = NULL;
-	isc_mutex_t *newnamelocks = NULL;
-	isc_result_t result;
-	unsigned int *newname_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nnames >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_names to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nnames; i++)
-		if (adb->name_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newnames = isc_mem_get(adb->mctx, sizeof(*newnames) * n);
-	newdeadnames = isc_mem_get(adb->mctx, sizeof(*newdeadnames) * n);
-	newnamelocks = isc_mem_get(adb->mctx, sizeof(*newnamelocks) * n);
-	newname_sd = isc_mem_get(adb->mctx, sizeof(*newname_sd) * n);
-	newname_refcnt = isc_mem_get(adb->mctx, sizeof(*newname_refcnt) * n);
-	if (newnames == NULL || newdeadnames == NULL ||
-	    newnamelocks == NULL || newname_sd == NULL ||
-	    newname_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newnamelocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newnames[i]);
-		ISC_LIST_INIT(newdeadnames[i]);
-		newname_sd[i] = ISC_FALSE;
-		newname_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
-
-	/*
-	 * Move names to new arrays.
-	 */
-	for (i = 0; i < adb->nnames; i++) {
-		name = ISC_LIST_HEAD(adb->names[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->names[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, ISC_TRUE) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->names[i]);
-		}
-		name = ISC_LIST_HEAD(adb->deadnames[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->deadnames[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, ISC_TRUE) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->deadnames[i]);
-		}
-		INSIST(adb->name_refcnt[i] == 0);
-		adb->irefcnt--;
-	}
-
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
-	isc_mem_put(adb->mctx, adb->names,
-		    sizeof(*adb->names) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->deadnames,
-		    sizeof(*adb->deadnames) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->namelocks,
-		    sizeof(*adb->namelocks) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_sd,
-		    sizeof(*adb->name_sd) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_refcnt,
-		    sizeof(*adb->name_refcnt) * adb->nnames);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->names = newnames;
-	adb->deadnames = newdeadnames;
-	adb->namelocks = newnamelocks;
-	adb->name_sd = newname_sd;
-	adb->name_refcnt = newname_refcnt;
-	adb->nnames = n;
-
-	set_adbstat(adb, adb->nnames, dns_adbstats_nnames);
-
-	/*
-	 * Only on success do we set adb->grownames_sent to ISC_FALSE.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->grownames_sent = ISC_FALSE;
-	goto done;
-
- cleanup:
-	if (newnames != NULL)
-		isc_mem_put(adb->mctx, newnames, sizeof(*newnames) * n);
-	if (newdeadnames != NULL)
-		isc_mem_put(adb->mctx, newdeadnames, sizeof(*newdeadnames) * n);
-	if (newnamelocks != NULL)
-		isc_mem_put(adb->mctx, newnamelocks, sizeof(*newnamelocks) * n);
-	if (newname_sd != NULL)
-		isc_mem_put(adb->mctx, newname_sd, sizeof(*newname_sd) * n);
-	if (newname_refcnt != NULL)
-		isc_mem_put(adb->mctx, newname_refcnt,
-			     sizeof(*newname_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_names finished");
-}
+#ifndef DNS_ADB_NBUCKETS
+#define DNS_ADB_NBUCKETS	1021
+#endif
 
 /*
  * Requires the adbname bucket be locked and that no entry buckets be locked.
@@ -1059,6 +831,7 @@ kill_name(dns_adbname_t **n, isc_eventtype_t ev) {
 		if (!NAME_DEAD(name)) {
 			bucket = name->lock_bucket;
 			ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+			nameindex_remove(adb, name);
 			ISC_LIST_APPEND(adb->deadnames[bucket], name, plink);
 			name->flags |= NAME_IS_DEAD;
 		}
@@ -1115,6 +888,69 @@ check_expire_namehooks(dns_adbname_t *name, isc_stdtime_t now) {
 	return (ISC_TF(result4 || result6));
 }
 
+/*
+ * Double the number of chains in a bucket's name index.  If memory is
+ * short the index is left as it is; its chains just get longer.
+ *
+ * Requires the bucket be locked.
+ */
+static void
+nameindex_grow(dns_adb_t *adb, adbnameindex_t *index) {
+	dns_adbnamelist_t *chains;
+	dns_adbname_t *name;
+	unsigned int i, nchains;
+
+	nchains = index->nchains * 2;
+	chains = isc_mem_get(adb->mctx, sizeof(*chains) * nchains);
+	if (chains == NULL)
+		return;
+	for (i = 0; i < nchains; i++)
+		ISC_LIST_INIT(chains[i]);
+
+	for (i = 0; i < index->nchains; i++) {
+		while ((name = ISC_LIST_HEAD(index->chains[i])) != NULL) {
+			ISC_LIST_UNLINK(index->chains[i], name, hlink);
+			ISC_LIST_APPEND(chains[(name->hashval / adb->nnames) &
+					       (nchains - 1)],
+					name, hlink);
+		}
+	}
+
+	isc_mem_put(adb->mctx, index->chains,
+		    sizeof(*chains) * index->nchains);
+	index->chains = chains;
+	index->nchains = nchains;
+}
+
+/*
+ * Requires the name's bucket be locked.
+ */
+static inline void
+nameindex_add(dns_adb_t *adb, dns_adbname_t *name) {
+	adbnameindex_t *index = &adb->nameindex[name->lock_bucket];
+
+	if (index->count >= 2 * index->nchains)
+		nameindex_grow(adb, index);
+	ISC_LIST_PREPEND(index->chains[ADB_CHAIN(index, adb->nnames,
+						 name->hashval)],
+			 name, hlink);
+	index->count++;
+}
+
+/*
+ * Requires the name's bucket be locked.
+ */
+static inline void
+nameindex_remove(dns_adb_t *adb, dns_adbname_t *name) {
+	adbnameindex_t *index = &adb->nameindex[name->lock_bucket];
+
+	ISC_LIST_UNLINK(index->chains[ADB_CHAIN(index, adb->nnames,
+						name->hashval)],
+			name, hlink);
+	INSIST(index->count > 0);
+	index->count--;
+}
+
 /*
  * Requires the name's bucket be locked.
  */
@@ -1124,6 +960,8 @@ link_name(dns_adb_t *adb, int bucket, dns_adbname_t *name) {
 
 	ISC_LIST_PREPEND(adb->names[bucket], name, plink);
 	name->lock_bucket = bucket;
+	name->hashval = dns_name_fullhash(&name->name, ISC_FALSE);
+	nameindex_add(adb, name);
 	adb->name_refcnt[bucket]++;
 }
 
@@ -1140,8 +978,10 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 
 	if (NAME_DEAD(name))
 		ISC_LIST_UNLINK(adb->deadnames[bucket], name, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+		nameindex_remove(adb, name);
+	}
 	name->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->name_refcnt[bucket] > 0);
 	adb->name_refcnt[bucket]--;
@@ -1150,6 +990,70 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 	return (result);
 }
 
+/*
+ * Double the number of chains in a bucket's entry index.  If memory is
+ * short the index is left as it is; its chains just get longer.
+ *
+ * Requires the bucket be locked.
+ */
+static void
+entryindex_grow(dns_adb_t *adb, adbentryindex_t *index) {
+	dns_adbentrylist_t *chains;
+	dns_adbentry_t *entry;
+	unsigned int i, nchains;
+
+	nchains = index->nchains * 2;
+	chains = isc_mem_get(adb->mctx, sizeof(*chains) * nchains);
+	if (chains == NULL)
+		return;
+	for (i = 0; i < nchains; i++)
+		ISC_LIST_INIT(chains[i]);
+
+	for (i = 0; i < index->nchains; i++) {
+		while ((entry = ISC_LIST_HEAD(index->chains[i])) != NULL) {
+			ISC_LIST_UNLINK(index->chains[i], entry, hlink);
+			ISC_LIST_APPEND(chains[(entry->hashval /
+						adb->nentries) &
+					       (nchains - 1)],
+					entry, hlink);
+		}
+	}
+
+	isc_mem_put(adb->mctx, index->chains,
+		    sizeof(*chains) * index->nchains);
+	index->chains = chains;
+	index->nchains = nchains;
+}
+
+/*
+ * Requires the entry's bucket be locked.
+ */
+static inline void
+entryindex_add(dns_adb_t *adb, dns_adbentry_t *entry) {
+	adbentryindex_t *index = &adb->entryindex[entry->lock_bucket];
+
+	if (index->count >= 2 * index->nchains)
+		entryindex_grow(adb, index);
+	ISC_LIST_PREPEND(index->chains[ADB_CHAIN(index, adb->nentries,
+						 entry->hashval)],
+			 entry, hlink);
+	index->count++;
+}
+
+/*
+ * Requires the entry's bucket be locked.
+ */
+static inline void
+entryindex_remove(dns_adb_t *adb, dns_adbentry_t *entry) {
+	adbentryindex_t *index = &adb->entryindex[entry->lock_bucket];
+
+	ISC_LIST_UNLINK(index->chains[ADB_CHAIN(index, adb->nentries,
+						entry->hashval)],
+			entry, hlink);
+	INSIST(index->count > 0);
+	index->count--;
+}
+
 /*
  * Requires the entry's bucket be locked.
  */
@@ -1169,14 +1073,17 @@ link_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
 				continue;
 			}
 			INSIST((e->flags & ENTRY_IS_DEAD) == 0);
-			e->flags |= ENTRY_IS_DEAD;
+			entry_setbits(e, ENTRY_IS_DEAD, ENTRY_IS_DEAD);
 			ISC_LIST_UNLINK(adb->entries[bucket], e, plink);
+			entryindex_remove(adb, e);
 			ISC_LIST_PREPEND(adb->deadentries[bucket], e, plink);
 		}
 	}
 
 	ISC_LIST_PREPEND(adb->entries[bucket], entry, plink);
 	entry->lock_bucket = bucket;
+	entry->hashval = isc_sockaddr_hash(&entry->sockaddr, ISC_TRUE);
+	entryindex_add(adb, entry);
 	adb->entry_refcnt[bucket]++;
 }
 
@@ -1193,8 +1100,10 @@ unlink_entry(dns_adb_t *adb, dns_adbentry_t *entry) {
 
 	if ((entry->flags & ENTRY_IS_DEAD) != 0)
 		ISC_LIST_UNLINK(adb->deadentries[bucket], entry, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
+		entryindex_remove(adb, entry);
+	}
 	entry->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->entry_refcnt[bucket] > 0);
 	adb->entry_refcnt[bucket]--;
@@ -1693,18 +1602,11 @@ new_adbname(dns_adb_t *adb, dns_name_t *dnsname) {
 	name->fetch6_err = FIND_ERR_UNEXPECTED;
 	ISC_LIST_INIT(name->finds);
 	ISC_LINK_INIT(name, plink);
+	ISC_LINK_INIT(name, hlink);
 
 	LOCK(&adb->namescntlock);
 	adb->namescnt++;
 	inc_adbstats(adb, dns_adbstats_namescnt);
-	if (!adb->grownames_sent && adb->excl != NULL &&
-	    adb->namescnt > (adb->nnames * 8))
-	{
-		isc_event_t *event = &adb->grownames;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->grownames_sent = ISC_TRUE;
-	}
 	UNLOCK(&adb->namescntlock);
 
 	return (name);
@@ -1840,17 +1742,10 @@ new_adbentry(dns_adb_t *adb) {
 	e->atr = 0.0;
 	ISC_LIST_INIT(e->lameinfo);
 	ISC_LINK_INIT(e, plink);
+	ISC_LINK_INIT(e, hlink);
 	LOCK(&adb->entriescntlock);
 	adb->entriescnt++;
 	inc_adbstats(adb, dns_adbstats_entriescnt);
-	if (!adb->growentries_sent && adb->excl != NULL &&
-	    adb->entriescnt > (adb->nentries * 8))
-	{
-		isc_event_t *event = &adb->growentries;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->growentries_sent = ISC_TRUE;
-	}
 	UNLOCK(&adb->entriescntlock);
 
 	return (e);
@@ -2038,9 +1933,12 @@ find_name_and_lock(dns_adb_t *adb, dns_name_t *name,
 		   unsigned int options, int *bucketp)
 {
 	dns_adbname_t *adbname;
+	adbnameindex_t *index;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = dns_name_fullhash(name, ISC_FALSE) % adb->nnames;
+	hashval = dns_name_fullhash(name, ISC_FALSE);
+	bucket = hashval % adb->nnames;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->namelocks[bucket]);
@@ -2051,15 +1949,17 @@ find_name_and_lock(dns_adb_t *adb, dns_name_t *name,
 		*bucketp = bucket;
 	}
 
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
+	index = &adb->nameindex[bucket];
+	adbname = ISC_LIST_HEAD(index->chains[ADB_CHAIN(index, adb->nnames,
+							hashval)]);
 	while (adbname != NULL) {
-		if (!NAME_DEAD(adbname)) {
-			if (dns_name_equal(name, &adbname->name)
-			    && GLUEHINT_OK(adbname, options)
-			    && STARTATZONE_MATCHES(adbname, options))
-				return (adbname);
-		}
-		adbname = ISC_LIST_NEXT(adbname, plink);
+		INSIST(!NAME_DEAD(adbname));
+		if (adbname->hashval == hashval &&
+		    dns_name_equal(name, &adbname->name) &&
+		    GLUEHINT_OK(adbname, options) &&
+		    STARTATZONE_MATCHES(adbname, options))
+			return (adbname);
+		adbname = ISC_LIST_NEXT(adbname, hlink);
 	}
 
 	return (NULL);
@@ -2080,9 +1980,12 @@ find_entry_and_lock(dns_adb_t *adb, isc_sockaddr_t *addr, int *bucketp,
 	isc_stdtime_t now)
 {
 	dns_adbentry_t *entry, *entry_next;
-	int bucket;
+	adbentryindex_t *index;
+	unsigned int hashval;
+	int bucket, i;
 
-	bucket = isc_sockaddr_hash(addr, ISC_TRUE) % adb->nentries;
+	hashval = isc_sockaddr_hash(addr, ISC_TRUE);
+	bucket = hashval % adb->nentries;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->entrylocks[bucket]);
@@ -2093,15 +1996,31 @@ find_entry_and_lock(dns_adb_t *adb, isc_sockaddr_t *addr, int *bucketp,
 		*bucketp = bucket;
 	}
 
-	/* Search the list, while cleaning up expired entries. */
-	for (entry = ISC_LIST_HEAD(adb->entries[bucket]);
+	/*
+	 * Clean up expired entries at the least recently used end of
+	 * the bucket.
+	 */
+	for (entry = ISC_LIST_TAIL(adb->entries[bucket]), i = 0;
+	     entry != NULL && i < 2;
+	     entry = entry_next, i++) {
+		entry_next = ISC_LIST_PREV(entry, plink);
+		(void)check_expire_entry(adb, &entry, now);
+	}
+
+	/* Search the index. */
+	index = &adb->entryindex[bucket];
+	for (entry = ISC_LIST_HEAD(index->chains[ADB_CHAIN(index,
+							   adb->nentries,
+							   hashval)]);
 	     entry != NULL;
 	     entry = entry_next) {
-		entry_next = ISC_LIST_NEXT(entry, plink);
+		entry_next = ISC_LIST_NEXT(entry, hlink);
+		if (entry->hashval != hashval ||
+		    !isc_sockaddr_equal(addr, &entry->sockaddr))
+			continue;
 		(void)check_expire_entry(adb, &entry, now);
 		if (entry != NULL &&
-		    (entry->expires == 0 || entry->expires > now) &&
-		    isc_sockaddr_equal(addr, &entry->sockaddr)) {
+		    (entry->expires == 0 || entry->expires > now)) {
 			ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
 			ISC_LIST_PREPEND(adb->entries[bucket], entry, plink);
 			return (entry);
@@ -2460,13 +2379,46 @@ cleanup_entries(dns_adb_t *adb, int bucket, isc_stdtime_t now) {
 	return (result);
 }
 
+/*
+ * Free the name and entry indexes, and whatever chains they have.
+ */
+static void
+free_indexes(dns_adb_t *adb) {
+	unsigned int i;
+
+	if (adb->nameindex != NULL) {
+		for (i = 0; i < adb->nnames; i++) {
+			if (adb->nameindex[i].chains == NULL)
+				continue;
+			INSIST(adb->nameindex[i].count == 0);
+			isc_mem_put(adb->mctx, adb->nameindex[i].chains,
+				    sizeof(*adb->nameindex[i].chains) *
+				    adb->nameindex[i].nchains);
+		}
+		isc_mem_put(adb->mctx, adb->nameindex,
+			    sizeof(*adb->nameindex) * adb->nnames);
+		adb->nameindex = NULL;
+	}
+	if (adb->entryindex != NULL) {
+		for (i = 0; i < adb->nentries; i++) {
+			if (adb->entryindex[i].chains == NULL)
+				continue;
+			INSIST(adb->entryindex[i].count == 0);
+			isc_mem_put(adb->mctx, adb->entryindex[i].chains,
+				    sizeof(*adb->entryindex[i].chains) *
+				    adb->entryindex[i].nchains);
+		}
+		isc_mem_put(adb->mctx, adb->entryindex,
+			    sizeof(*adb->entryindex) * adb->nentries);
+		adb->entryindex = NULL;
+	}
+}
+
 static void
 destroy(dns_adb_t *adb) {
 	adb->magic = 0;
 
 	isc_task_detach(&adb->task);
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 
 	isc_mempool_destroy(&adb->nmp);
 	isc_mempool_destroy(&adb->nhmp);
@@ -2500,6 +2452,8 @@ destroy(dns_adb_t *adb) {
 	isc_mem_put(adb->mctx, adb->name_refcnt,
 		    sizeof(*adb->name_refcnt) * adb->nnames);
 
+	free_indexes(adb);
+
 	DESTROYLOCK(&adb->reflock);
 	DESTROYLOCK(&adb->lock);
 	DESTROYLOCK(&adb->mplock);
@@ -2521,7 +2475,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 {
 	dns_adb_t *adb;
 	isc_result_t result;
-	unsigned int i;
+	unsigned int i, j;
 
 	REQUIRE(mem != NULL);
 	REQUIRE(view != NULL);
@@ -2550,7 +2504,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->aimp = NULL;
 	adb->afmp = NULL;
 	adb->task = NULL;
-	adb->excl = NULL;
 	adb->mctx = NULL;
 	adb->view = view;
 	adb->taskmgr = taskmgr;
@@ -2561,17 +2514,14 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->shutting_down = ISC_FALSE;
 	ISC_LIST_INIT(adb->whenshutdown);
 
-	adb->nentries = nbuckets[0];
+	adb->nentries = DNS_ADB_NBUCKETS;
 	adb->entriescnt = 0;
 	adb->entries = NULL;
+	adb->entryindex = NULL;
 	adb->deadentries = NULL;
 	adb->entry_sd = NULL;
 	adb->entry_refcnt = NULL;
 	adb->entrylocks = NULL;
-	ISC_EVENT_INIT(&adb->growentries, sizeof(adb->growentries), 0, NULL,
-		       DNS_EVENT_ADBGROWENTRIES, grow_entries, adb,
-		       adb, NULL, NULL);
-	adb->growentries_sent = ISC_FALSE;
 
 	adb->quota = 0;
 	adb->atr_freq = 0;
@@ -2579,26 +2529,14 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->atr_high = 0.0;
 	adb->atr_discount = 0.0;
 
-	adb->nnames = nbuckets[0];
+	adb->nnames = DNS_ADB_NBUCKETS;
 	adb->namescnt = 0;
 	adb->names = NULL;
+	adb->nameindex = NULL;
 	adb->deadnames = NULL;
 	adb->name_sd = NULL;
 	adb->name_refcnt = NULL;
 	adb->namelocks = NULL;
-	ISC_EVENT_INIT(&adb->grownames, sizeof(adb->grownames), 0, NULL,
-		       DNS_EVENT_ADBGROWNAMES, grow_names, adb,
-		       adb, NULL, NULL);
-	adb->grownames_sent = ISC_FALSE;
-
-	result = isc_taskmgr_excltask(adb->taskmgr, &adb->excl);
-	if (result != ISC_R_SUCCESS) {
-		DP(DEF_LEVEL, "adb: task-exclusive mode unavailable, "
-			      "intializing table sizes to %u\n",
-			      nbuckets[11]);
-		adb->nentries = nbuckets[11];
-		adb->nnames = nbuckets[11];
-	}
 
 	isc_mem_attach(mem, &adb->mctx);
 
@@ -2640,7 +2578,13 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	ALLOCENTRY(adb, entrylocks);
 	ALLOCENTRY(adb, entry_sd);
 	ALLOCENTRY(adb, entry_refcnt);
+	ALLOCENTRY(adb, entryindex);
 #undef ALLOCENTRY
+	for (i = 0; i < adb->nentries; i++) {
+		adb->entryindex[i].chains = NULL;
+		adb->entryindex[i].nchains = ADB_INDEX_MINCHAINS;
+		adb->entryindex[i].count = 0;
+	}
 
 #define ALLOCNAME(adb, el) \
 	do { \
@@ -2656,7 +2600,41 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	ALLOCNAME(adb, namelocks);
 	ALLOCNAME(adb, name_sd);
 	ALLOCNAME(adb, name_refcnt);
+	ALLOCNAME(adb, nameindex);
 #undef ALLOCNAME
+	for (i = 0; i < adb->nnames; i++) {
+		adb->nameindex[i].chains = NULL;
+		adb->nameindex[i].nchains = ADB_INDEX_MINCHAINS;
+		adb->nameindex[i].count = 0;
+	}
+
+	/*
+	 * Allocate the smallest index for each bucket.
+	 */
+	for (i = 0; i < adb->nnames; i++) {
+		adb->nameindex[i].chains =
+			isc_mem_get(adb->mctx,
+				    sizeof(*adb->nameindex[i].chains) *
+				    ADB_INDEX_MINCHAINS);
+		if (adb->nameindex[i].chains == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto fail1;
+		}
+		for (j = 0; j < ADB_INDEX_MINCHAINS; j++)
+			ISC_LIST_INIT(adb->nameindex[i].chains[j]);
+	}
+	for (i = 0; i < adb->nentries; i++) {
+		adb->entryindex[i].chains =
+			isc_mem_get(adb->mctx,
+				    sizeof(*adb->entryindex[i].chains) *
+				    ADB_INDEX_MINCHAINS);
+		if (adb->entryindex[i].chains == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto fail1;
+		}
+		for (j = 0; j < ADB_INDEX_MINCHAINS; j++)
+			ISC_LIST_INIT(adb->entryindex[i].chains[j]);
+	}
 
 	/*
 	 * Initialize the bucket locks for names and elements.
@@ -2770,6 +2748,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	if (adb->name_refcnt != NULL)
 		isc_mem_put(adb->mctx, adb->name_refcnt,
 			    sizeof(*adb->name_refcnt) * adb->nnames);
+	free_indexes(adb);
 	if (adb->nmp != NULL)
 		isc_mempool_destroy(&adb->nmp);
 	if (adb->nhmp != NULL)
@@ -2797,8 +2776,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
  fail0c:
 	DESTROYLOCK(&adb->lock);
  fail0b:
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 	isc_mem_putanddetach(&adb->mctx, adb, sizeof(dns_adb_t));
 
 	return (result);
@@ -4121,69 +4098,78 @@ void
 dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		   unsigned int rtt, unsigned int factor)
 {
-	int bucket;
 	isc_stdtime_t now = 0;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 	REQUIRE(factor <= 10);
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
 
 	if (addr->entry->expires == 0 || factor == DNS_ADB_RTTADJAGE)
 		isc_stdtime_get(&now);
 	adjustsrtt(addr, rtt, factor, now);
 
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, addr->entry);
 }
 
 void
 dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
-	int bucket;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
 
 	adjustsrtt(addr, 0, DNS_ADB_RTTADJAGE, now);
 
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, addr->entry);
 }
 
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now)
 {
+	dns_adbentry_t *entry = addr->entry;
+	isc_uint32_t srtt, old, lastage;
 	isc_uint64_t new_srtt;
 
 	if (factor == DNS_ADB_RTTADJAGE) {
-		if (addr->entry->lastage != now) {
-			new_srtt = addr->entry->srtt;
+		/*
+		 * Only the caller that moves 'lastage' on ages the entry.
+		 */
+		lastage = entry->lastage;
+		if (lastage == now ||
+		    entry_cmpxchg(&entry->lastage, lastage, now) != lastage)
+		{
+			addr->srtt = entry->srtt;
+			entry_setexpires(entry, now);
+			return;
+		}
+	}
+
+	old = entry->srtt;
+	do {
+		srtt = old;
+		if (factor == DNS_ADB_RTTADJAGE) {
+			new_srtt = srtt;
 			new_srtt <<= 9;
-			new_srtt -= addr->entry->srtt;
+			new_srtt -= srtt;
 			new_srtt >>= 9;
-			addr->entry->lastage = now;
 		} else
-			new_srtt = addr->entry->srtt;
-	} else
-		new_srtt = ((isc_uint64_t)addr->entry->srtt / 10 * factor)
-			+ ((isc_uint64_t)rtt / 10 * (10 - factor));
+			new_srtt = ((isc_uint64_t)srtt / 10 * factor)
+				+ ((isc_uint64_t)rtt / 10 * (10 - factor));
+		old = entry_cmpxchg(&entry->srtt, srtt,
+				    (isc_uint32_t)new_srtt);
+	} while (old != srtt);
 
-	addr->entry->srtt = (unsigned int) new_srtt;
 	addr->srtt = (unsigned int) new_srtt;
-
-	if (addr->entry->expires == 0)
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+	entry_setexpires(entry, now);
 }
 
 void
 dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		    unsigned int bits, unsigned int mask)
 {
-	int bucket;
 	isc_stdtime_t now;
 
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -4192,13 +4178,12 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	REQUIRE((bits & ENTRY_IS_DEAD) == 0);
 	REQUIRE((mask & ENTRY_IS_DEAD) == 0);
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
 
-	addr->entry->flags = (addr->entry->flags & ~mask) | (bits & mask);
+	entry_setbits(addr->entry, bits, mask);
 	if (addr->entry->expires == 0) {
 		isc_stdtime_get(&now);
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+		entry_setexpires(addr->entry, now);
 	}
 
 	/*
@@ -4207,7 +4192,7 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	 */
 	addr->flags = (addr->flags & ~mask) | (bits & mask);
 
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, addr->entry);
 }
 
 /*
@@ -4455,16 +4440,14 @@ dns_adb_setudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
 
 unsigned int
 dns_adb_getudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
 	unsigned int size;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
 	size = addr->entry->udpsize;
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, addr->entry);
 
 	return (size);
 }
@@ -4635,7 +4618,7 @@ dns_adb_freeaddrinfo(dns_adb_t *adb, dns_adbaddrinfo_t **addrp) {
 
 	if (entry->expires == 0) {
 		isc_stdtime_get(&now);
-		entry->expires = now + ADB_ENTRY_WINDOW;
+		entry_setexpires(entry, now);
 	}
 
 	want_check_exit = dec_entry_refcnt(adb, overmem, entry, ISC_FALSE);
@@ -4679,18 +4662,23 @@ void
 dns_adb_flushname(dns_adb_t *adb, dns_name_t *name) {
 	dns_adbname_t *adbname;
 	dns_adbname_t *nextname;
+	adbnameindex_t *index;
+	unsigned int hashval;
 	int bucket;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(name != NULL);
 
 	LOCK(&adb->lock);
-	bucket = dns_name_hash(name, ISC_FALSE) % adb->nnames;
+	hashval = dns_name_fullhash(name, ISC_FALSE);
+	bucket = hashval % adb->nnames;
 	LOCK(&adb->namelocks[bucket]);
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
+	index = &adb->nameindex[bucket];
+	adbname = ISC_LIST_HEAD(index->chains[ADB_CHAIN(index, adb->nnames,
+							hashval)]);
 	while (adbname != NULL) {
-		nextname = ISC_LIST_NEXT(adbname, plink);
-		if (!NAME_DEAD(adbname) &&
+		nextname = ISC_LIST_NEXT(adbname, hlink);
+		if (adbname->hashval == hashval &&
 		    dns_name_equal(name, &adbname->name)) {
 			RUNTIME_CHECK(kill_name(&adbname,
 						DNS_EVENT_ADBCANCELED) ==
@@ -4791,29 +4779,30 @@ dns_adbentry_overquota(dns_adbentry_t *entry) {
 
 void
 dns_adb_beginudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-
-	LOCK(&adb->entrylocks[bucket]);
+#ifdef ADB_USEATOMIC
+	(void)isc_atomic_xadd((isc_int32_t *)&addr->entry->active, 1);
+#else
+	ENTRY_LOCK(adb, addr->entry);
 	addr->entry->active++;
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, addr->entry);
+#endif
 }
 
 void
 dns_adb_endudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
+	isc_uint32_t active, old;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-
-	LOCK(&adb->entrylocks[bucket]);
-	if (addr->entry->active > 0)
-		addr->entry->active--;
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
+	for (active = addr->entry->active; active > 0; active = old) {
+		old = entry_cmpxchg(&addr->entry->active, active, active - 1);
+		if (old == active)
+			break;
+	}
+	ENTRY_UNLOCK(adb, addr->entry);
 }
@@ -54,6 +54,15 @@
  */
 #define DNS_CACHE_CLEANERINCREMENT	1000U	/*%< Number of nodes. */
 
+/*!
+ * Control background expiry in "rbt" caches.
+ * SWEEPINTERVAL is how often, in seconds, a sweep starts.
+ * SWEEPINCREMENT is how many rdatasets are purged from each node lock
+ * bucket in one pass; a sweep runs as many passes as it needs.
+ */
+#define DNS_CACHE_SWEEPINTERVAL		1U	/*%< Seconds. */
+#define DNS_CACHE_SWEEPINCREMENT	100U	/*%< Number of rdatasets. */
+
 /***
  ***	Types
  ***/
@@ -110,6 +119,34 @@ struct cache_cleaner {
 	isc_boolean_t	 replaceiterator;
 };
 
+/*
+ * A cache_sweeper_t encapsulates the state of background expiry in an
+ * "rbt" cache.  Each tick of its timer starts a sweep, which purges
+ * expired data a bounded increment at a time, sending itself an event
+ * between increments so that other work is not held up.
+ */
+
+typedef struct cache_sweeper cache_sweeper_t;
+
+/*%
+ * Accesses to a cache sweeper object are synchronized through
+ * task/event serialization, or locked from the cache object.
+ */
+struct cache_sweeper {
+	dns_cache_t	*cache;
+	isc_task_t	*task;
+	unsigned int	interval;	/*% In seconds; 0 is off. */
+	isc_timer_t	*timer;
+	isc_event_t	*resched_event;	/*% NULL while sweeping. */
+	unsigned int	increment;	/*% Rdatasets per bucket per pass. */
+
+	/* Totals, published as cache statistics. */
+	isc_uint64_t	sweeps;
+	isc_uint64_t	deleted;
+	isc_uint64_t	bytes;
+	isc_uint64_t	usecs;
+};
+
 /*%
  * The actual cache object.
  */
@@ -129,10 +166,12 @@ struct dns_cache {
 	dns_rdataclass_t	rdclass;
 	dns_db_t		*db;
 	cache_cleaner_t		cleaner;
+	cache_sweeper_t		sweeper;
 	char			*db_type;
 	int			db_argc;
 	char			**db_argv;
 	size_t			size;
+	dns_ttl_t		serve_stale_ttl;
 	isc_stats_t		*stats;
 
 	/* Locked by 'filelock'. */
@@ -160,6 +199,19 @@ cleaner_shutdown_action(isc_task_t *task, isc_event_t *event);
 static void
 overmem_cleaning_action(isc_task_t *task, isc_event_t *event);
 
+static isc_result_t
+cache_sweeper_init(dns_cache_t *cache, isc_taskmgr_t *taskmgr,
+		   isc_timermgr_t *timermgr, cache_sweeper_t *sweeper);
+
+static void
+sweep_timer_action(isc_task_t *task, isc_event_t *event);
+
+static void
+incremental_sweep_action(isc_task_t *task, isc_event_t *event);
+
+static void
+sweeper_shutdown_action(isc_task_t *task, isc_event_t *event);
+
 static inline isc_result_t
 cache_create_db(dns_cache_t *cache, dns_db_t **db) {
 	return (dns_db_create(cache->mctx, cache->db_type, dns_rootname,
@@ -233,6 +285,7 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	cache->references = 1;
 	cache->live_tasks = 0;
 	cache->rdclass = rdclass;
+	cache->serve_stale_ttl = 0;
 
 	cache->stats = NULL;
 	result = isc_stats_create(cmctx, &cache->stats,
@@ -303,16 +356,24 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 
 	/*
 	 * RBT-type cache DB has its own mechanism of cache cleaning and doesn't
-	 * need the control of the generic cleaner.
+	 * need the control of the generic cleaner; instead, the sweeper
+	 * purges expired data from it in the background.
 	 */
-	if (strcmp(db_type, "rbt") == 0)
+	if (strcmp(db_type, "rbt") == 0) {
 		result = cache_cleaner_init(cache, NULL, NULL, &cache->cleaner);
-	else {
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_db;
+		result = cache_sweeper_init(cache, taskmgr, timermgr,
+					    &cache->sweeper);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_cleaner;
+	} else {
 		result = cache_cleaner_init(cache, taskmgr, timermgr,
 					    &cache->cleaner);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_db;
+		(void)cache_sweeper_init(cache, NULL, NULL, &cache->sweeper);
 	}
-	if (result != ISC_R_SUCCESS)
-		goto cleanup_db;
 
 	result = dns_db_setcachestats(cache->db, cache->stats);
 	if (result != ISC_R_SUCCESS)
@@ -322,6 +383,10 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	*cachep = cache;
 	return (ISC_R_SUCCESS);
 
+ cleanup_cleaner:
+	if (cache->cleaner.iterator != NULL)
+		dns_dbiterator_destroy(&cache->cleaner.iterator);
+	DESTROYLOCK(&cache->cleaner.lock);
  cleanup_db:
 	dns_db_detach(&cache->db);
  cleanup_dbargv:
@@ -370,6 +435,12 @@ cache_free(dns_cache_t *cache) {
 
 	DESTROYLOCK(&cache->cleaner.lock);
 
+	if (cache->sweeper.task != NULL)
+		isc_task_detach(&cache->sweeper.task);
+
+	if (cache->sweeper.resched_event != NULL)
+		isc_event_free(&cache->sweeper.resched_event);
+
 	if (cache->filename) {
 		isc_mem_free(cache->mctx, cache->filename);
 		cache->filename = NULL;
@@ -456,10 +527,14 @@ dns_cache_detach(dns_cache_t **cachep) {
 				      isc_result_totext(result));
 
 		/*
-		 * If the cleaner task exists, let it free the cache.
+		 * If the cleaner or sweeper task exists, let the last
+		 * of them to shut down free the cache.
 		 */
 		if (cache->live_tasks > 0) {
-			isc_task_shutdown(cache->cleaner.task);
+			if (cache->cleaner.task != NULL)
+				isc_task_shutdown(cache->cleaner.task);
+			if (cache->sweeper.task != NULL)
+				isc_task_shutdown(cache->sweeper.task);
 			free_cache = ISC_FALSE;
 		}
 	}
@@ -512,7 +587,8 @@ dns_cache_load(dns_cache_t *cache) {
 		return (ISC_R_SUCCESS);
 
 	LOCK(&cache->filelock);
-	result = dns_db_load(cache->db, cache->filename);
+	result = dns_db_load2(cache->db, cache->filename,
+			      dns_masterformat_raw);
 	UNLOCK(&cache->filelock);
 
 	return (result);
@@ -528,13 +604,46 @@ dns_cache_dump(dns_cache_t *cache) {
 		return (ISC_R_SUCCESS);
 
 	LOCK(&cache->filelock);
-	result = dns_master_dump(cache->mctx, cache->db, NULL,
-				 &dns_master_style_cache, cache->filename);
+	result = dns_master_dump2(cache->mctx, cache->db, NULL,
+				  &dns_master_style_cache, cache->filename,
+				  dns_masterformat_raw);
 	UNLOCK(&cache->filelock);
 	return (result);
 
 }
 
+isc_result_t
+dns_cache_dumpinc(dns_cache_t *cache, isc_task_t *task,
+		  dns_dumpdonefunc_t done, void *done_arg,
+		  dns_dumpctx_t **dctxp)
+{
+	isc_result_t result;
+	dns_db_t *db = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(task != NULL);
+	REQUIRE(done != NULL);
+	REQUIRE(dctxp != NULL && *dctxp == NULL);
+
+	LOCK(&cache->lock);
+	dns_db_attach(cache->db, &db);
+	UNLOCK(&cache->lock);
+
+	LOCK(&cache->filelock);
+	if (cache->filename == NULL)
+		result = ISC_R_NOTFOUND;
+	else
+		result = dns_master_dumpinc2(cache->mctx, db, NULL,
+					     &dns_master_style_cache,
+					     cache->filename, task, done,
+					     done_arg, dctxp,
+					     dns_masterformat_raw);
+	UNLOCK(&cache->filelock);
+
+	dns_db_detach(&db);
+	return (result);
+}
+
 void
 dns_cache_setcleaninginterval(dns_cache_t *cache, unsigned int t) {
 	isc_interval_t interval;
@@ -585,6 +694,79 @@ dns_cache_getcleaninginterval(dns_cache_t *cache) {
 	return (t);
 }
 
+void
+dns_cache_setsweepinterval(dns_cache_t *cache, unsigned int t) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+
+	/*
+	 * The cache may have no sweeper, or it may have shut down.
+	 */
+	if (cache->sweeper.timer == NULL)
+		goto unlock;
+
+	cache->sweeper.interval = t;
+
+	if (t == 0) {
+		result = isc_timer_reset(cache->sweeper.timer,
+					 isc_timertype_inactive,
+					 NULL, NULL, ISC_TRUE);
+	} else {
+		isc_interval_set(&interval, t, 0);
+		result = isc_timer_reset(cache->sweeper.timer,
+					 isc_timertype_ticker,
+					 NULL, &interval, ISC_FALSE);
+	}
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_WARNING,
+			      "could not set cache sweep interval: %s",
+			      isc_result_totext(result));
+
+ unlock:
+	UNLOCK(&cache->lock);
+}
+
+void
+dns_cache_setservestalettl(dns_cache_t *cache, dns_ttl_t ttl) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->serve_stale_ttl = ttl;
+	(void)dns_db_setservestalettl(cache->db, ttl);
+	UNLOCK(&cache->lock);
+}
+
+dns_ttl_t
+dns_cache_getservestalettl(dns_cache_t *cache) {
+	dns_ttl_t ttl;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	ttl = cache->serve_stale_ttl;
+	UNLOCK(&cache->lock);
+
+	return (ttl);
+}
+
+unsigned int
+dns_cache_getsweepinterval(dns_cache_t *cache) {
+	unsigned int t;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	t = cache->sweeper.interval;
+	UNLOCK(&cache->lock);
+
+	return (t);
+}
+
 const char *
 dns_cache_getname(dns_cache_t *cache) {
 	REQUIRE(VALID_CACHE(cache));
@@ -1087,6 +1269,200 @@ dns_cache_getcachesize(dns_cache_t *cache) {
 	return (size);
 }
 
+/*
+ * Initialize the cache sweeper object at *sweeper.  Without a task
+ * manager and a timer manager, the sweeper never runs.
+ */
+static isc_result_t
+cache_sweeper_init(dns_cache_t *cache, isc_taskmgr_t *taskmgr,
+		   isc_timermgr_t *timermgr, cache_sweeper_t *sweeper)
+{
+	isc_result_t result;
+	isc_interval_t interval;
+
+	sweeper->cache = cache;
+	sweeper->task = NULL;
+	sweeper->interval = 0;
+	sweeper->timer = NULL;
+	sweeper->resched_event = NULL;
+	sweeper->increment = DNS_CACHE_SWEEPINCREMENT;
+	sweeper->sweeps = 0;
+	sweeper->deleted = 0;
+	sweeper->bytes = 0;
+	sweeper->usecs = 0;
+
+	if (taskmgr == NULL || timermgr == NULL)
+		return (ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 1, &sweeper->task);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_task_create() failed: %s",
+				 dns_result_totext(result));
+		return (ISC_R_UNEXPECTED);
+	}
+	isc_task_setname(sweeper->task, "cachesweeper", sweeper);
+
+	sweeper->resched_event =
+		isc_event_allocate(cache->mctx, sweeper,
+				   DNS_EVENT_CACHESWEEP,
+				   incremental_sweep_action,
+				   sweeper, sizeof(isc_event_t));
+	if (sweeper->resched_event == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+
+	sweeper->interval = DNS_CACHE_SWEEPINTERVAL;
+	isc_interval_set(&interval, sweeper->interval, 0);
+	result = isc_timer_create(timermgr, isc_timertype_ticker,
+				  NULL, &interval, sweeper->task,
+				  sweep_timer_action, sweeper,
+				  &sweeper->timer);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_timer_create() failed: %s",
+				 dns_result_totext(result));
+		result = ISC_R_UNEXPECTED;
+		goto cleanup;
+	}
+
+	result = isc_task_onshutdown(sweeper->task, sweeper_shutdown_action,
+				     cache);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "cache sweeper: "
+				 "isc_task_onshutdown() failed: %s",
+				 dns_result_totext(result));
+		goto cleanup;
+	}
+	cache->live_tasks++;
+
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	if (sweeper->timer != NULL)
+		isc_timer_detach(&sweeper->timer);
+	if (sweeper->resched_event != NULL)
+		isc_event_free(&sweeper->resched_event);
+	isc_task_detach(&sweeper->task);
+	sweeper->interval = 0;
+	return (result);
+}
+
+/*
+ * This is called when the sweep timer fires: start a sweep unless
+ * the last one is still going.
+ */
+static void
+sweep_timer_action(isc_task_t *task, isc_event_t *event) {
+	cache_sweeper_t *sweeper = event->ev_arg;
+
+	INSIST(task == sweeper->task);
+	INSIST(event->ev_type == ISC_TIMEREVENT_TICK);
+
+	isc_event_free(&event);
+
+	if (sweeper->resched_event != NULL) {
+		isc_task_send(task, &sweeper->resched_event);
+		INSIST(sweeper->resched_event == NULL);
+	}
+}
+
+/*
+ * Do one increment of a sweep, and send ourselves another one if it
+ * did not reach the end of the expired data.
+ */
+static void
+incremental_sweep_action(isc_task_t *task, isc_event_t *event) {
+	cache_sweeper_t *sweeper = event->ev_arg;
+	dns_cache_t *cache = sweeper->cache;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now;
+	isc_time_t start, end;
+	unsigned int count = 0;
+	size_t size = 0;
+	isc_result_t result;
+
+	INSIST(task == sweeper->task);
+	INSIST(event->ev_type == DNS_EVENT_CACHESWEEP);
+
+	LOCK(&cache->lock);
+	dns_db_attach(cache->db, &db);
+	UNLOCK(&cache->lock);
+
+	isc_stdtime_get(&now);
+	TIME_NOW(&start);
+	result = dns_db_expire(db, now, sweeper->increment, &count, &size);
+	TIME_NOW(&end);
+	dns_db_detach(&db);
+
+	sweeper->sweeps++;
+	sweeper->deleted += count;
+	sweeper->bytes += size;
+	sweeper->usecs += isc_time_microdiff(&end, &start);
+	isc_stats_set(cache->stats, sweeper->sweeps,
+		      dns_cachestatscounter_sweeps);
+	isc_stats_set(cache->stats, sweeper->deleted,
+		      dns_cachestatscounter_sweepdeleted);
+	isc_stats_set(cache->stats, sweeper->bytes,
+		      dns_cachestatscounter_sweepbytes);
+	isc_stats_set(cache->stats, sweeper->usecs,
+		      dns_cachestatscounter_sweeptime);
+
+	if (result == DNS_R_CONTINUE) {
+		isc_task_send(task, &event);
+		return;
+	}
+
+	sweeper->resched_event = event;
+
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_WARNING,
+			      "cache sweeper stopped: %s",
+			      isc_result_totext(result));
+		dns_cache_setsweepinterval(cache, 0);
+	}
+}
+
+/*
+ * The sweeper task is shutting down; do the necessary cleanup.
+ */
+static void
+sweeper_shutdown_action(isc_task_t *task, isc_event_t *event) {
+	dns_cache_t *cache = event->ev_arg;
+	isc_boolean_t should_free = ISC_FALSE;
+
+	INSIST(task == cache->sweeper.task);
+	INSIST(event->ev_type == ISC_TASKEVENT_SHUTDOWN);
+
+	isc_event_free(&event);
+
+	LOCK(&cache->lock);
+
+	cache->live_tasks--;
+
+	if (cache->references == 0 && cache->live_tasks == 0)
+		should_free = ISC_TRUE;
+
+	/*
+	 * By detaching the timer in the context of its task,
+	 * we are guaranteed that there will be no further timer
+	 * events.
+	 */
+	if (cache->sweeper.timer != NULL)
+		isc_timer_detach(&cache->sweeper.timer);
+
+	/* Make sure we don't reschedule anymore. */
+	(void)isc_task_purge(task, NULL, DNS_EVENT_CACHESWEEP, NULL);
+
+	UNLOCK(&cache->lock);
+
+	if (should_free)
+		cache_free(cache);
+}
+
 /*
  * The cleaner task is shutting down; do the necessary cleanup.
  */
@@ -1108,9 +1484,8 @@ cleaner_shutdown_action(isc_task_t *task, isc_event_t *event) {
 	LOCK(&cache->lock);
 
 	cache->live_tasks--;
-	INSIST(cache->live_tasks == 0);
 
-	if (cache->references == 0)
+	if (cache->references == 0 && cache->live_tasks == 0)
 		should_free = ISC_TRUE;
 
 	/*
@@ -1160,6 +1535,7 @@ dns_cache_flush(dns_cache_t *cache) {
 	olddb = cache->db;
 	cache->db = db;
 	dns_db_setcachestats(cache->db, cache->stats);
+	(void)dns_db_setservestalettl(cache->db, cache->serve_stale_ttl);
 	UNLOCK(&cache->cleaner.lock);
 	UNLOCK(&cache->lock);
 
@@ -1405,6 +1781,18 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
 		values[dns_cachestatscounter_deletettl],
 		"cache records deleted due to TTL expiration");
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+		values[dns_cachestatscounter_sweeps],
+		"cache expiry sweeper passes");
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+		values[dns_cachestatscounter_sweepdeleted],
+		"cache records purged by expiry sweeper");
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+		values[dns_cachestatscounter_sweepbytes],
+		"cache bytes purged by expiry sweeper");
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+		values[dns_cachestatscounter_sweeptime],
+		"cache expiry sweeper time (microseconds)");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db),
 		"cache database nodes");
 	fprintf(fp, "%20" ISC_PLATFORM_QUADFORMAT "u %s\n",
@@ -1466,6 +1854,14 @@ dns_cache_renderxml(dns_cache_t *cache, xmlTextWriterPtr writer) {
 		   values[dns_cachestatscounter_deletelru], writer));
 	TRY0(renderstat("DeleteTTL",
 		   values[dns_cachestatscounter_deletettl], writer));
+	TRY0(renderstat("SweepPasses",
+		   values[dns_cachestatscounter_sweeps], writer));
+	TRY0(renderstat("SweepDeleted",
+		   values[dns_cachestatscounter_sweepdeleted], writer));
+	TRY0(renderstat("SweepBytes",
+		   values[dns_cachestatscounter_sweepbytes], writer));
+	TRY0(renderstat("SweepTime",
+		   values[dns_cachestatscounter_sweeptime], writer));
 
 	TRY0(renderstat("CacheNodes", dns_db_nodecount(cache->db), writer));
 	TRY0(renderstat("CacheBuckets", dns_db_hashsize(cache->db), writer));
@@ -1526,6 +1922,22 @@ dns_cache_renderjson(dns_cache_t *cache, json_object *cstats) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "DeleteTTL", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_sweeps]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "SweepPasses", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_sweepdeleted]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "SweepDeleted", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_sweepbytes]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "SweepBytes", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_sweeptime]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "SweepTime", obj);
+
 	obj = json_object_new_int64(dns_db_nodecount(cache->db));
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CacheNodes", obj);
@@ -81,6 +81,7 @@ dns_rdatacallbacks_initcommon(dns_rdatacallbacks_t *callbacks) {
 
 	callbacks->magic = DNS_CALLBACK_MAGIC;
 	callbacks->add = NULL;
+	callbacks->addbatch = NULL;
 	callbacks->rawdata = NULL;
 	callbacks->zone = NULL;
 	callbacks->add_private = NULL;
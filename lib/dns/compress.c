@@ -29,15 +29,16 @@
 
 #define TABLE_READY							\
 	do {								\
-		unsigned int i;						\
-									\
 		if ((cctx->allowed & DNS_COMPRESS_READY) == 0) {	\
 			cctx->allowed |= DNS_COMPRESS_READY;		\
-			for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++)	\
-				cctx->table[i] = NULL;			\
+			memset(cctx->table, 0, cctx->tablesize *	\
+			       sizeof(*cctx->table));			\
 		}							\
 	} while (0)
 
+#define TABLE_MASK(c)		((c)->tablesize - 1)
+#define TABLE_SLOT(c, h)	(((h) ^ ((h) >> 16)) & TABLE_MASK(c))
+
 /***
  ***	Compression
  ***/
@@ -49,32 +50,60 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 	cctx->edns = edns;
 	cctx->mctx = mctx;
+	cctx->table = cctx->initialtable;
+	cctx->tablesize = DNS_COMPRESS_TABLESIZE;
 	cctx->count = 0;
+	cctx->morenodes = NULL;
+	cctx->morecount = 0;
+	cctx->hashlength = 0;
+	cctx->arenaused = 0;
 	cctx->allowed = DNS_COMPRESS_ENABLED;
 	cctx->magic = CCTX_MAGIC;
 	return (ISC_R_SUCCESS);
 }
 
+static inline dns_compressnode_t *
+getnode(dns_compress_t *cctx, unsigned int i) {
+	if (i < DNS_COMPRESS_INITIALNODES)
+		return (&cctx->initialnodes[i]);
+	return (&cctx->morenodes[i - DNS_COMPRESS_INITIALNODES]);
+}
+
+/*
+ * Release the copy of the name data owned by 'node', which is either at
+ * the end of the arena or on the heap.
+ */
+static inline void
+releasecopy(dns_compress_t *cctx, dns_compressnode_t *node) {
+	if (node->r.base >= cctx->arena &&
+	    node->r.base < cctx->arena + DNS_COMPRESS_ARENASIZE)
+		cctx->arenaused = (unsigned int)(node->r.base - cctx->arena);
+	else
+		isc_mem_put(cctx->mctx, node->r.base, node->r.length);
+}
+
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
 	dns_compressnode_t *node;
-	unsigned int i;
 
 	REQUIRE(VALID_CCTX(cctx));
 
-	if ((cctx->allowed & DNS_COMPRESS_READY) != 0) {
-		for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-			while (cctx->table[i] != NULL) {
-				node = cctx->table[i];
-				cctx->table[i] = cctx->table[i]->next;
-				if ((node->offset & 0x8000) != 0)
-					isc_mem_put(cctx->mctx, node->r.base,
-						    node->r.length);
-				if (node->count < DNS_COMPRESS_INITIALNODES)
-					continue;
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			}
-		}
+	while (cctx->count > 0) {
+		node = getnode(cctx, --cctx->count);
+		if ((node->offset & 0x8000) != 0)
+			releasecopy(cctx, node);
+	}
+	if (cctx->morenodes != NULL) {
+		isc_mem_put(cctx->mctx, cctx->morenodes,
+			    cctx->morecount * sizeof(dns_compressnode_t));
+		cctx->morenodes = NULL;
+		cctx->morecount = 0;
+	}
+	if (cctx->table != cctx->initialtable) {
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(*cctx->table));
+		cctx->table = cctx->initialtable;
+		cctx->tablesize = DNS_COMPRESS_TABLESIZE;
 	}
 	cctx->magic = 0;
 	cctx->allowed = 0;
@@ -132,6 +161,52 @@ do { \
 	(name)->attributes = DNS_NAMEATTR_ABSOLUTE; \
 } while (0)
 
+/*
+ * Fill in 'offsets' for 'name' and make cctx->hashes[n] the hash of the
+ * suffix of 'name' starting at label 'n'.  The hashes are built from the
+ * root up, each suffix extending the hash of the next shorter one, so
+ * every byte of the name is hashed once for all of its suffixes.  They
+ * are kept, with a copy of the name they belong to, for the
+ * dns_compress_add() that normally follows a lookup of the same name.
+ * The hash ignores case.
+ */
+static void
+hashsuffixes(dns_compress_t *cctx, const dns_name_t *name,
+	     unsigned char *offsets)
+{
+	const unsigned char *ndata = name->ndata;
+	const unsigned char *p;
+	unsigned int labels = name->labels;
+	unsigned int i, len, c;
+	isc_uint32_t h;
+
+	if (name->offsets != NULL) {
+		memmove(offsets, name->offsets, labels);
+	} else {
+		for (i = 0, p = ndata; i < labels; i++, p += *p + 1)
+			offsets[i] = (unsigned char)(p - ndata);
+	}
+
+	if (cctx->hashlength == name->length &&
+	    memcmp(cctx->hashname, ndata, name->length) == 0)
+		return;
+
+	h = 2166136261U;
+	cctx->hashes[labels - 1] = h;
+	for (i = labels - 1; i-- > 0; ) {
+		p = ndata + offsets[i];
+		for (len = *p + 1; len > 0; len--) {
+			c = *p++;
+			if (c >= 'A' && c <= 'Z')
+				c += 'a' - 'A';
+			h = (h ^ c) * 16777619U;
+		}
+		cctx->hashes[i] = h;
+	}
+	memmove(cctx->hashname, ndata, name->length);
+	cctx->hashlength = name->length;
+}
+
 /*
  * Find the longest match of name in the table.
  * If match is found return ISC_TRUE. prefix, suffix and offset are updated.
@@ -143,7 +218,9 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 {
 	dns_name_t tname, nname;
 	dns_compressnode_t *node = NULL;
-	unsigned int labels, hash, n;
+	dns_offsets_t offsets;
+	unsigned int labels, slot, i, n;
+	isc_uint32_t hash;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name) == ISC_TRUE);
@@ -160,16 +237,24 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	labels = dns_name_countlabels(name);
 	INSIST(labels > 0);
 
+	hashsuffixes(cctx, name, offsets);
+
 	dns_name_init(&tname, NULL);
 	dns_name_init(&nname, NULL);
 
 	for (n = 0; n < labels - 1; n++) {
-		dns_name_getlabelsequence(name, n, labels - n, &tname);
-		hash = dns_name_hash(&tname, ISC_FALSE) %
-		       DNS_COMPRESS_TABLESIZE;
-		for (node = cctx->table[hash]; node != NULL; node = node->next)
+		hash = cctx->hashes[n];
+		for (slot = TABLE_SLOT(cctx, hash);
+		     (i = cctx->table[slot]) != 0;
+		     slot = (slot + 1) & TABLE_MASK(cctx))
 		{
+			node = getnode(cctx, i - 1);
+			if (node->hash != hash ||
+			    node->labels != labels - n ||
+			    node->r.length != name->length - offsets[n])
+				continue;
 			NODENAME(node, &nname);
+			dns_name_getlabelsequence(name, n, labels - n, &tname);
 			if ((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0) {
 				if (dns_name_caseequal(&nname, &tname))
 					break;
@@ -178,14 +263,14 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 					break;
 			}
 		}
-		if (node != NULL)
+		if (i != 0)
 			break;
 	}
 
 	/*
-	 * If node == NULL, we found no match at all.
+	 * If we ran out of suffixes, we found no match at all.
 	 */
-	if (node == NULL)
+	if (n == labels - 1)
 		return (ISC_FALSE);
 
 	if (n == 0)
@@ -197,11 +282,70 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	return (ISC_TRUE);
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
+/*
+ * Double the table and put the nodes back in it, oldest first so that
+ * dns_compress_rollback() can still clear the newest ones' slots.
+ */
+static isc_boolean_t
+growtable(dns_compress_t *cctx) {
+	dns_compressnode_t *node;
+	isc_uint16_t *table;
+	unsigned int i, slot;
+
+	table = isc_mem_get(cctx->mctx,
+			    cctx->tablesize * 2 * sizeof(*table));
+	if (table == NULL)
+		return (ISC_FALSE);
+	memset(table, 0, cctx->tablesize * 2 * sizeof(*table));
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(*cctx->table));
+	cctx->table = table;
+	cctx->tablesize *= 2;
+
+	for (i = 0; i < cctx->count; i++) {
+		node = getnode(cctx, i);
+		for (slot = TABLE_SLOT(cctx, node->hash);
+		     cctx->table[slot] != 0;
+		     slot = (slot + 1) & TABLE_MASK(cctx))
+			;
+		cctx->table[slot] = i + 1;
+		node->slot = (isc_uint16_t)slot;
+	}
+	return (ISC_TRUE);
+}
+
+/*
+ * Get the next free node, growing the nodes beyond the preallocated
+ * ones and the table as needed: the table is kept at most three
+ * quarters full.  Returns NULL if memory runs out.
+ */
+static inline dns_compressnode_t *
+newnode(dns_compress_t *cctx) {
+	dns_compressnode_t *nodes;
+	unsigned int count;
+
+	/* Offsets stay below 0x4000, so this is not expected. */
+	if (cctx->count == 0xffff)
+		return (NULL);
+	if (cctx->count >= DNS_COMPRESS_INITIALNODES + cctx->morecount) {
+		count = cctx->morecount * 2 + DNS_COMPRESS_INITIALNODES;
+		nodes = isc_mem_get(cctx->mctx, count * sizeof(*nodes));
+		if (nodes == NULL)
+			return (NULL);
+		if (cctx->morenodes != NULL) {
+			memmove(nodes, cctx->morenodes,
+				cctx->morecount * sizeof(*nodes));
+			isc_mem_put(cctx->mctx, cctx->morenodes,
+				    cctx->morecount * sizeof(*nodes));
+		}
+		cctx->morenodes = nodes;
+		cctx->morecount = count;
+	}
+	if ((cctx->count + 1U) * 4 > cctx->tablesize * 3 &&
+	    !growtable(cctx))
+		return (NULL);
+	return (getnode(cctx, cctx->count));
 }
 
 void
@@ -209,10 +353,11 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, isc_uint16_t offset)
 {
 	dns_name_t tname, xname;
+	dns_offsets_t offsets;
 	unsigned int start;
 	unsigned int n;
 	unsigned int count;
-	unsigned int hash;
+	unsigned int slot;
 	dns_compressnode_t *node;
 	unsigned int length;
 	unsigned int tlength;
@@ -240,11 +385,17 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 	if (count == 0)
 		return;
 	start = 0;
+	hashsuffixes(cctx, name, offsets);
 	dns_name_toregion(name, &r);
 	length = r.length;
-	tmp = isc_mem_get(cctx->mctx, length);
-	if (tmp == NULL)
-		return;
+	if (cctx->arenaused + length <= DNS_COMPRESS_ARENASIZE) {
+		tmp = cctx->arena + cctx->arenaused;
+		cctx->arenaused += length;
+	} else {
+		tmp = isc_mem_get(cctx->mctx, length);
+		if (tmp == NULL)
+			return;
+	}
 	/*
 	 * Copy name data to 'tmp' and make 'r' use 'tmp'.
 	 */
@@ -253,48 +404,49 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 	dns_name_fromregion(&xname, &r);
 
 	while (count > 0) {
-		dns_name_getlabelsequence(&xname, start, n, &tname);
-		hash = dns_name_hash(&tname, ISC_FALSE) %
-		       DNS_COMPRESS_TABLESIZE;
-		tlength = name_length(&tname);
+		tlength = length - offsets[start];
 		toffset = (isc_uint16_t)(offset + (length - tlength));
 		if (toffset >= 0x4000)
 			break;
 		/*
 		 * Create a new node and add it.
 		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
-				break;
-		}
-		node->count = cctx->count++;
+		node = newnode(cctx);
+		if (node == NULL)
+			break;
+		dns_name_getlabelsequence(&xname, start, n, &tname);
 		/*
 		 * 'node->r.base' becomes 'tmp' when start == 0.
-		 * Record this by setting 0x8000 so it can be freed later.
+		 * Record this by setting 0x8000 so it can be released later.
 		 */
 		if (start == 0)
 			toffset |= 0x8000;
 		node->offset = toffset;
 		dns_name_toregion(&tname, &node->r);
-		node->labels = (isc_uint8_t)dns_name_countlabels(&tname);
-		node->next = cctx->table[hash];
-		cctx->table[hash] = node;
+		node->labels = (isc_uint8_t)n;
+		node->hash = cctx->hashes[start];
+		for (slot = TABLE_SLOT(cctx, node->hash);
+		     cctx->table[slot] != 0;
+		     slot = (slot + 1) & TABLE_MASK(cctx))
+			;
+		cctx->table[slot] = ++cctx->count;
+		node->slot = (isc_uint16_t)slot;
 		start++;
 		n--;
 		count--;
 	}
 
-	if (start == 0)
-		isc_mem_put(cctx->mctx, tmp, length);
+	if (start == 0) {
+		if (tmp >= cctx->arena &&
+		    tmp < cctx->arena + DNS_COMPRESS_ARENASIZE)
+			cctx->arenaused -= length;
+		else
+			isc_mem_put(cctx->mctx, tmp, length);
+	}
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, isc_uint16_t offset) {
-	unsigned int i;
 	dns_compressnode_t *node;
 
 	REQUIRE(VALID_CCTX(cctx));
@@ -305,24 +457,20 @@ dns_compress_rollback(dns_compress_t *cctx, isc_uint16_t offset) {
 	if ((cctx->allowed & DNS_COMPRESS_READY) == 0)
 		return;
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && (node->offset & 0x7fff) >= offset) {
-			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			cctx->count--;
-			node = cctx->table[i];
-		}
+	/*
+	 * This relies on nodes being added in order of increasing
+	 * offset, so that the ones to remove are the most recently
+	 * added.  Removing those from an open-addressing table never
+	 * breaks the probe sequence of an older node.
+	 */
+	while (cctx->count > 0) {
+		node = getnode(cctx, cctx->count - 1);
+		if ((node->offset & 0x7fff) < offset)
+			break;
+		cctx->table[node->slot] = 0;
+		if ((node->offset & 0x8000) != 0)
+			releasecopy(cctx, node);
+		cctx->count--;
 	}
 }
 
@@ -890,6 +890,53 @@ dns_db_hashsize(dns_db_t *db) {
 	return ((db->methods->hashsize)(db));
 }
 
+isc_result_t
+dns_db_presize(dns_db_t *db, unsigned int count) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->presize == NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	return ((db->methods->presize)(db, count));
+}
+
+isc_result_t
+dns_db_expire(dns_db_t *db, isc_stdtime_t now, unsigned int max,
+	      unsigned int *countp, size_t *sizep)
+{
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(dns_db_iscache(db));
+	REQUIRE(max > 0);
+
+	if (db->methods->expire == NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	return ((db->methods->expire)(db, now, max, countp, sizep));
+}
+
+isc_result_t
+dns_db_setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(dns_db_iscache(db));
+
+	if (db->methods->setservestalettl == NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	return ((db->methods->setservestalettl)(db, ttl));
+}
+
+isc_result_t
+dns_db_getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(dns_db_iscache(db));
+	REQUIRE(ttl != NULL);
+
+	if (db->methods->getservestalettl == NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	return ((db->methods->getservestalettl)(db, ttl));
+}
+
 void
 dns_db_settask(dns_db_t *db, isc_task_t *task) {
 	REQUIRE(DNS_DB_VALID(db));
@@ -21,6 +21,7 @@
 #include <isc/string.h>
 #include <isc/util.h>
 
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/diff.h>
 #include <dns/log.h>
@@ -521,6 +522,101 @@ dns_diff_load(dns_diff_t *diff, dns_addrdatasetfunc_t addfunc,
 	return (result);
 }
 
+/*
+ * Number of rdatasets dns_diff_load2() passes to callbacks->addbatch
+ * at once.
+ */
+#define DIFF_ADDSZ	64
+
+static isc_result_t
+diff_addbatch(dns_rdatacallbacks_t *callbacks, dns_name_t **names,
+	      dns_rdataset_t *rdatasets, unsigned int count)
+{
+	isc_result_t results[DIFF_ADDSZ];
+	isc_result_t result;
+	unsigned int i;
+
+	result = (*callbacks->addbatch)(callbacks->add_private, names,
+					rdatasets, results, count);
+	if (result == ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+	for (i = 0; i < count; i++) {
+		if (results[i] == DNS_R_UNCHANGED) {
+			isc_log_write(DIFF_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "dns_diff_load: "
+				      "update with no effect");
+		} else if (results[i] != ISC_R_SUCCESS &&
+			   results[i] != DNS_R_NXRRSET)
+			return (results[i]);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_diff_load2(dns_diff_t *diff, dns_rdatacallbacks_t *callbacks) {
+	dns_difftuple_t *t;
+	dns_rdatalist_t rdls[DIFF_ADDSZ];
+	dns_rdataset_t rdss[DIFF_ADDSZ];
+	dns_name_t *names[DIFF_ADDSZ];
+	unsigned int n = 0;
+	isc_result_t result;
+
+	REQUIRE(DNS_DIFF_VALID(diff));
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+
+	if (callbacks->addbatch == NULL)
+		return (dns_diff_load(diff, callbacks->add,
+				      callbacks->add_private));
+
+	t = ISC_LIST_HEAD(diff->tuples);
+	while (t != NULL) {
+		dns_name_t *name;
+
+		name = &t->name;
+		while (t != NULL && dns_name_equal(&t->name, name)) {
+			dns_rdatatype_t type, covers;
+			dns_diffop_t op;
+			dns_rdatalist_t *rdl;
+
+			op = t->op;
+			type = t->rdata.type;
+			covers = rdata_covers(&t->rdata);
+
+			rdl = &rdls[n];
+			dns_rdatalist_init(rdl);
+			rdl->type = type;
+			rdl->covers = covers;
+			rdl->rdclass = t->rdata.rdclass;
+			rdl->ttl = t->ttl;
+
+			while (t != NULL && dns_name_equal(&t->name, name) &&
+			       t->op == op && t->rdata.type == type &&
+			       rdata_covers(&t->rdata) == covers)
+			{
+				ISC_LIST_APPEND(rdl->rdata, &t->rdata, link);
+				t = ISC_LIST_NEXT(t, link);
+			}
+
+			dns_rdataset_init(&rdss[n]);
+			CHECK(dns_rdatalist_tordataset(rdl, &rdss[n]));
+			rdss[n].trust = dns_trust_ultimate;
+			names[n] = name;
+
+			INSIST(op == DNS_DIFFOP_ADD);
+			if (++n == DIFF_ADDSZ) {
+				CHECK(diff_addbatch(callbacks, names, rdss, n));
+				n = 0;
+			}
+		}
+	}
+	if (n > 0)
+		CHECK(diff_addbatch(callbacks, names, rdss, n));
+	result = ISC_R_SUCCESS;
+ failure:
+	return (result);
+}
+
 /*
  * XXX uses qsort(); a merge sort would be more natural for lists,
  * and perhaps safer wrt thread stack overflow.
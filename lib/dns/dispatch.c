@@ -301,6 +301,7 @@ static isc_result_t get_udpsocket(dns_dispatchmgr_t *mgr,
 				  dns_dispatch_t *disp,
 				  isc_socketmgr_t *sockmgr,
 				  isc_sockaddr_t *localaddr,
+				  unsigned int options,
 				  isc_socket_t **sockp,
 				  isc_socket_t *dup_socket);
 static isc_result_t dispatch_createudp(dns_dispatchmgr_t *mgr,
@@ -2779,9 +2780,12 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	}
 
 	/*
-	 * See if we have a dispatcher that matches.
+	 * See if we have a dispatcher that matches.  SO_REUSEPORT
+	 * dispatchers exist to have a socket of their own.
 	 */
-	if (dup_dispatch == NULL) {
+	if (dup_dispatch == NULL &&
+	    (attributes & DNS_DISPATCHATTR_REUSEPORT) == 0)
+	{
 		result = dispatch_find(mgr, localaddr, attributes, mask, &disp);
 		if (result == ISC_R_SUCCESS) {
 			disp->refcount++;
@@ -2855,7 +2859,8 @@ dns_dispatch_getudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 static isc_result_t
 get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 	      isc_socketmgr_t *sockmgr, isc_sockaddr_t *localaddr,
-	      isc_socket_t **sockp, isc_socket_t *dup_socket)
+	      unsigned int options, isc_socket_t **sockp,
+	      isc_socket_t *dup_socket)
 {
 	unsigned int i, j;
 	isc_socket_t *held[DNS_DISPATCH_HELD];
@@ -2914,7 +2919,7 @@ get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 	} else {
 		/* Allow to reuse address for non-random ports. */
 		result = open_socket(sockmgr, localaddr,
-				     ISC_SOCKET_REUSEADDRESS, &sock,
+				     ISC_SOCKET_REUSEADDRESS | options, &sock,
 				     dup_socket);
 
 		if (result == ISC_R_SUCCESS)
@@ -2983,8 +2988,12 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	disp->socktype = isc_sockettype_udp;
 
 	if ((attributes & DNS_DISPATCHATTR_EXCLUSIVE) == 0) {
-		result = get_udpsocket(mgr, disp, sockmgr, localaddr, &sock,
-				       dup_socket);
+		unsigned int options = 0;
+
+		if ((attributes & DNS_DISPATCHATTR_REUSEPORT) != 0)
+			options |= ISC_SOCKET_REUSEPORT;
+		result = get_udpsocket(mgr, disp, sockmgr, localaddr, options,
+				       &sock, dup_socket);
 		if (result != ISC_R_SUCCESS)
 			goto deallocate_dispatch;
 
@@ -17,6 +17,7 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/serial.h>
+#include <isc/sha2.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -36,6 +37,7 @@
 #include <dns/result.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>		/* for DNS_TSIG_FUDGE */
+#include <dns/verifycache.h>
 
 #include <dst/result.h>
 
@@ -76,6 +78,62 @@ inc_stat(isc_statscounter_t counter) {
 		isc_stats_increment(dns_dnssec_stats, counter);
 }
 
+static void
+sha256_putregion(isc_sha256_t *sha, isc_region_t *r) {
+	isc_uint8_t len[2];
+
+	len[0] = (r->length >> 8) & 0xff;
+	len[1] = r->length & 0xff;
+	isc_sha256_update(sha, len, sizeof(len));
+	isc_sha256_update(sha, r->base, r->length);
+}
+
+/*
+ * Compute the digest that identifies a signature check in a
+ * verification cache.  It covers everything the outcome depends on:
+ * the key, the RSA exponent limit, the whole RRSIG rdata, the record
+ * envelope and the (sorted) rdatas.
+ */
+static isc_result_t
+verify_digest(dst_key_t *key, unsigned int maxbits, dns_rdata_t *sigrdata,
+	      isc_region_t *envelope, dns_rdata_t *rdatas, int nrdatas,
+	      unsigned char *digest)
+{
+	isc_sha256_t sha;
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	isc_uint8_t bits[4];
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+	int i;
+
+	isc_buffer_init(&b, keydata, sizeof(keydata));
+	result = dst_key_todns(key, &b);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	isc_sha256_init(&sha);
+	isc_buffer_usedregion(&b, &r);
+	sha256_putregion(&sha, &r);
+	bits[0] = (maxbits >> 24) & 0xff;
+	bits[1] = (maxbits >> 16) & 0xff;
+	bits[2] = (maxbits >> 8) & 0xff;
+	bits[3] = maxbits & 0xff;
+	isc_sha256_update(&sha, bits, sizeof(bits));
+	dns_rdata_toregion(sigrdata, &r);
+	sha256_putregion(&sha, &r);
+	sha256_putregion(&sha, envelope);
+	for (i = 0; i < nrdatas; i++) {
+		if (i > 0 && dns_rdata_compare(&rdatas[i], &rdatas[i-1]) == 0)
+			continue;
+		dns_rdata_toregion(&rdatas[i], &r);
+		sha256_putregion(&sha, &r);
+	}
+	isc_sha256_final(digest, &sha);
+
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Make qsort happy.
  */
@@ -364,14 +422,24 @@ dns_dnssec_verify2(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		   isc_boolean_t ignoretime, isc_mem_t *mctx,
 		   dns_rdata_t *sigrdata, dns_name_t *wild)
 {
-	return (dns_dnssec_verify3(name, set, key, ignoretime, 0, mctx,
-				   sigrdata, wild));
+	return (dns_dnssec_verify4(name, set, key, ignoretime, 0, mctx,
+				   sigrdata, wild, NULL));
 }
 
 isc_result_t
 dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		   isc_boolean_t ignoretime, unsigned int maxbits,
 		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild)
+{
+	return (dns_dnssec_verify4(name, set, key, ignoretime, maxbits, mctx,
+				   sigrdata, wild, NULL));
+}
+
+isc_result_t
+dns_dnssec_verify4(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+		   isc_boolean_t ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_verifycache_t *cache)
 {
 	dns_rdata_rrsig_t sig;
 	dns_fixedname_t fnewname;
@@ -386,6 +454,7 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	int labels = 0;
 	isc_uint32_t flags;
 	isc_boolean_t downcase = ISC_FALSE;
+	unsigned char digest[DNS_VERIFYCACHE_DIGESTLENGTH];
 
 	REQUIRE(name != NULL);
 	REQUIRE(set != NULL);
@@ -393,6 +462,12 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	REQUIRE(mctx != NULL);
 	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
 
+	/*
+	 * The cache only holds signatures checked against the clock.
+	 */
+	if (ignoretime)
+		cache = NULL;
+
 	ret = dns_rdata_tostruct(sigrdata, &sig, NULL);
 	if (ret != ISC_R_SUCCESS)
 		return (ret);
@@ -508,6 +583,22 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 
 	isc_buffer_usedregion(&envbuf, &r);
 
+	/*
+	 * If this check has succeeded before, skip the public key
+	 * operation.  This is only tried on the first pass; the
+	 * lower-cased retry is rare enough not to be worth caching.
+	 */
+	if (cache != NULL && !downcase) {
+		if (verify_digest(key, maxbits, sigrdata, &r, rdatas, nrdatas,
+				  digest) != ISC_R_SUCCESS)
+			cache = NULL;
+		else if (dns_verifycache_find(cache, digest, now)) {
+			inc_stat(dns_dnssecstats_asis);
+			ret = ISC_R_SUCCESS;
+			goto cleanup_array;
+		}
+	}
+
 	for (i = 0; i < nrdatas; i++) {
 		isc_uint16_t len;
 		isc_buffer_t lenbuf;
@@ -556,8 +647,11 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 			      "successfully validated after lower casing "
 			      "signer '%s'", namebuf);
 		inc_stat(dns_dnssecstats_downcase);
-	} else if (ret == ISC_R_SUCCESS)
+	} else if (ret == ISC_R_SUCCESS) {
 		inc_stat(dns_dnssecstats_asis);
+		if (cache != NULL)
+			dns_verifycache_add(cache, digest, sig.timeexpire);
+	}
 
 cleanup_array:
 	isc_mem_put(mctx, rdatas, nrdatas * sizeof(dns_rdata_t));
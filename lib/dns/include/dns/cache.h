@@ -184,6 +184,12 @@ dns_cache_load(dns_cache_t *cache);
  * Previous cache contents are not discarded.
  * If no file name has been set, do nothing and return success.
  *
+ * The file is in raw master file format, as written by dns_cache_dump().
+ * TTLs are reduced by the time that has passed since the file was
+ * written, and data that has expired in the meantime is not loaded.
+ * The file does not record whether the data was DNSSEC validated, so
+ * the loaded data is trusted no further than an ordinary answer.
+ *
  * MT:
  *\li	Multiple simultaneous attempts to load or dump the cache
  * 	will be serialized with respect to one another, but
@@ -203,7 +209,8 @@ dns_cache_dump(dns_cache_t *cache);
 /*%<
  * If the cache has a file name, write the cache contents to disk,
  * overwriting any preexisting file.  If no file name has been set,
- * do nothing and return success.
+ * do nothing and return success.  The file is written in raw master
+ * file format; negative cache entries are not written.
  *
  * MT:
  *\li	Multiple simultaneous attempts to load or dump the cache
@@ -218,6 +225,32 @@ dns_cache_dump(dns_cache_t *cache);
  *  \li    Various failures depending on the database implementation type
  */
 
+isc_result_t
+dns_cache_dumpinc(dns_cache_t *cache, isc_task_t *task,
+		  dns_dumpdonefunc_t done, void *done_arg,
+		  dns_dumpctx_t **dctxp);
+/*%<
+ * Like dns_cache_dump(), but write the file a few nodes at a time
+ * from events sent to 'task', so that the cache can be used and
+ * updated while it is being dumped.  The data is written to a
+ * temporary file that replaces the cache file when the dump is
+ * complete; 'done' is then called with 'done_arg' and the result.
+ *
+ * The dump continues even if the cache is flushed, writing the data
+ * the cache held when it started.  It may be canceled with
+ * dns_dumpctx_cancel().
+ *
+ * Requires:
+ *\li	'task' and 'done' are not NULL.
+ *\li	dctxp != NULL && *dctxp == NULL.
+ *
+ * Returns:
+ *\li	#DNS_R_CONTINUE		the dump has been started; '*dctxp'
+ *				is attached to its context.
+ *\li	#ISC_R_NOTFOUND		no file name has been set.
+ *\li	Various file-related failures
+ */
+
 isc_result_t
 dns_cache_clean(dns_cache_t *cache, isc_stdtime_t now);
 /*%<
@@ -238,6 +271,35 @@ dns_cache_getcleaninginterval(dns_cache_t *cache);
  * Get the periodic cache cleaning interval to 'interval' seconds.
  */
 
+void
+dns_cache_setsweepinterval(dns_cache_t *cache, unsigned int interval);
+/*%<
+ * Set the interval, in seconds, at which expired data is purged from
+ * an "rbt" cache in the background.  An interval of 0 stops the
+ * sweeper.  The default is one second.
+ */
+
+unsigned int
+dns_cache_getsweepinterval(dns_cache_t *cache);
+/*%<
+ * Get the background expiry interval.
+ */
+
+void
+dns_cache_setservestalettl(dns_cache_t *cache, dns_ttl_t ttl);
+/*%<
+ * Keep data in the cache for 'ttl' seconds after it has expired, so
+ * that it can be served when it cannot be refreshed in time.  0 (the
+ * default) discards expired data.  The setting survives
+ * dns_cache_flush().
+ */
+
+dns_ttl_t
+dns_cache_getservestalettl(dns_cache_t *cache);
+/*%<
+ * Get the length of time expired data is kept.
+ */
+
 const char *
 dns_cache_getname(dns_cache_t *cache);
 /*%<
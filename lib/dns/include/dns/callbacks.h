@@ -39,6 +39,16 @@ struct dns_rdatacallbacks {
 	 */
 	dns_addrdatasetfunc_t add;
 
+	/*%
+	 * If not NULL, this may be called instead of 'add' to add
+	 * several rdatasets at once: 'count' pairs of an owner name and
+	 * rdataset, best grouped by owner.  The result of adding each
+	 * is stored in the results array.  It returns ISC_R_SUCCESS if
+	 * every rdataset was added, and otherwise the first failure.
+	 * It uses 'add_private'.
+	 */
+	dns_addbatchfunc_t addbatch;
+
 	/*%
 	 * This is called when reading in a database image from a 'map'
 	 * format zone file.
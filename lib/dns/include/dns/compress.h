@@ -12,6 +12,7 @@
 #include <isc/lang.h>
 #include <isc/region.h>
 
+#include <dns/name.h>
 #include <dns/types.h>
 
 ISC_LANG_BEGINDECLS
@@ -39,17 +40,26 @@ ISC_LANG_BEGINDECLS
 
 #define DNS_COMPRESS_READY		0x80000000
 
-#define DNS_COMPRESS_TABLESIZE 64
-#define DNS_COMPRESS_INITIALNODES 16
+/*%
+ * The global compression table is an open-addressing hash table whose
+ * slots hold the index (plus one) of a node.  The first
+ * DNS_COMPRESS_TABLESIZE slots, DNS_COMPRESS_INITIALNODES nodes and
+ * DNS_COMPRESS_ARENASIZE bytes of copied names live in the context
+ * itself; larger messages allocate more nodes, and a larger table, as
+ * they need them.
+ */
+#define DNS_COMPRESS_TABLESIZE		1024
+#define DNS_COMPRESS_INITIALNODES	64
+#define DNS_COMPRESS_ARENASIZE		1024
 
 typedef struct dns_compressnode dns_compressnode_t;
 
 struct dns_compressnode {
 	isc_region_t		r;
+	isc_uint32_t		hash;
 	isc_uint16_t		offset;
-	isc_uint16_t		count;
+	isc_uint16_t		slot;
 	isc_uint8_t		labels;
-	dns_compressnode_t	*next;
 };
 
 struct dns_compress {
@@ -57,10 +67,22 @@ struct dns_compress {
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
 	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
+	isc_uint16_t		*table;
+	unsigned int		tablesize;	/*%< A power of two. */
+	isc_uint16_t		initialtable[DNS_COMPRESS_TABLESIZE];
 	/*% Preallocated nodes for the table. */
 	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
+	/*% Further nodes, allocated when needed. */
+	dns_compressnode_t	*morenodes;
+	unsigned int		morecount;	/*%< Size of morenodes. */
 	isc_uint16_t		count;		/*%< Number of nodes. */
+	/*% Suffix hashes of the last name looked up, and that name. */
+	unsigned int		hashlength;
+	unsigned char		hashname[DNS_NAME_MAXWIRE];
+	isc_uint32_t		hashes[sizeof(dns_offsets_t)];
+	/*% Copies of the names in the table. */
+	unsigned char		arena[DNS_COMPRESS_ARENASIZE];
+	unsigned int		arenaused;
 	isc_mem_t		*mctx;		/*%< Memory context. */
 };
 
@@ -190,6 +190,12 @@ typedef struct dns_dbmethods {
 					dns_name_t *name);
 	isc_result_t	(*getsize)(dns_db_t *db, dns_dbversion_t *version,
 				   isc_uint64_t *records, isc_uint64_t *bytes);
+	isc_result_t	(*presize)(dns_db_t *db, unsigned int count);
+	isc_result_t	(*expire)(dns_db_t *db, isc_stdtime_t now,
+				  unsigned int max, unsigned int *countp,
+				  size_t *sizep);
+	isc_result_t	(*setservestalettl)(dns_db_t *db, dns_ttl_t ttl);
+	isc_result_t	(*getservestalettl)(dns_db_t *db, dns_ttl_t *ttl);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -248,6 +254,7 @@ struct dns_dbonupdatelistener {
 #define DNS_DBFIND_FORCENSEC3		0x0080
 #define DNS_DBFIND_ADDITIONALOK		0x0100
 #define DNS_DBFIND_NOZONECUT		0x0200
+#define DNS_DBFIND_STALEOK		0x0400
 /*@}*/
 
 /*@{*/
@@ -815,6 +822,12 @@ dns_db_findext(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
  *	in the NSEC3 tree and not the main tree.  Without this option being
  *	set NSEC3 records will not be found.
  *
+ * \li	If the #DNS_DBFIND_STALEOK option is set, then expired data that
+ *	the cache keeps for serving stale answers (see
+ *	dns_db_setservestalettl()) may be returned; such rdatasets have
+ *	#DNS_RDATASETATTR_STALE set, and their TTL is what is left of the
+ *	window.  This option is only meaningful for cache databases.
+ *
  * \li	To respond to a query for SIG records, the caller should create a
  *	rdataset iterator and extract the signatures from each rdataset.
  *
@@ -1400,6 +1413,85 @@ dns_db_hashsize(dns_db_t *db);
  *      0 if not implemented.
  */
 
+isc_result_t
+dns_db_presize(dns_db_t *db, unsigned int count);
+/*%<
+ * For database implementations using a hash table, grow the table so
+ * that 'count' nodes can be added without it being resized, e.g. before
+ * loading a zone whose size is known in advance.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMEMORY
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
+isc_result_t
+dns_db_expire(dns_db_t *db, isc_stdtime_t now, unsigned int max,
+	      unsigned int *countp, size_t *sizep);
+/*%<
+ * Remove data that expired before 'now' from a cache database, in
+ * order of expiry, purging at most 'max' rdatasets from each group of
+ * nodes that share a lock so that no lock is held for long.  Data in
+ * nodes that are in use is marked stale and freed when the nodes are
+ * released.
+ *
+ * Once this has been called, the database no longer purges expired
+ * data as new data is added; the caller is expected to call it
+ * regularly.
+ *
+ * If 'countp' is not NULL, '*countp' is set to the number of rdatasets
+ * purged.  If 'sizep' is not NULL, '*sizep' is set to the number of
+ * bytes they occupied.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid cache database.
+ *
+ * \li	'max' > 0.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS		all expired data was purged.
+ * \li	#DNS_R_CONTINUE		the limit was reached; more may remain.
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
+isc_result_t
+dns_db_setservestalettl(dns_db_t *db, dns_ttl_t ttl);
+/*%<
+ * Set the length of time, in seconds, that a cache database keeps
+ * data after it has expired, so that it can be returned to callers
+ * that set #DNS_DBFIND_STALEOK.  0 disables keeping stale data.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid cache database.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
+isc_result_t
+dns_db_getservestalettl(dns_db_t *db, dns_ttl_t *ttl);
+/*%<
+ * Get the length of time that a cache database keeps stale data.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid cache database.
+ *
+ * \li	'ttl' is not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
 void
 dns_db_settask(dns_db_t *db, isc_task_t *task);
 /*%<
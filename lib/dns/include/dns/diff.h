@@ -254,6 +254,19 @@ dns_diff_load(dns_diff_t *diff, dns_addrdatasetfunc_t addfunc,
  *      (XXX why is it a void pointer, then?)
  */
 
+isc_result_t
+dns_diff_load2(dns_diff_t *diff, dns_rdatacallbacks_t *callbacks);
+/*%<
+ * Like dns_diff_load, but takes the callbacks filled in by
+ * dns_db_beginload(), and adds the rdatasets in batches when the
+ * database supports 'callbacks->addbatch'.
+ *
+ * Requires:
+ *\li	'diff' is valid and contains only additions.
+ *
+ *\li	'callbacks' was passed to dns_db_beginload().
+ */
+
 isc_result_t
 dns_diff_print(dns_diff_t *diff, FILE *file);
 
@@ -123,6 +123,11 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	The UDP socket is bound with SO_REUSEPORT, so that several
+ *	dispatchers can each have their own socket on the same address and
+ *	port.  An existing dispatcher is never shared when this is set.
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -134,6 +139,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 #define DNS_DISPATCHATTR_FIXEDID	0x00000100U
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 /*
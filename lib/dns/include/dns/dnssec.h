@@ -128,6 +128,12 @@ isc_result_t
 dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		   isc_boolean_t ignoretime, unsigned int maxbits,
 		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild);
+
+isc_result_t
+dns_dnssec_verify4(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+		   isc_boolean_t ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_verifycache_t *cache);
 /*%<
  *	Verifies the RRSIG record covering this rdataset signed by a specific
  *	key.  This does not determine if the key's owner is authorized to sign
@@ -136,6 +142,11 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *
  *	'maxbits' specifies the maximum number of rsa exponent bits accepted.
  *
+ *	If 'cache' is not NULL, a check that has succeeded before with the
+ *	same key, signature and data skips the public key operation, and a
+ *	successful check is remembered.  The cache is not used when
+ *	'ignoretime' is ISC_TRUE.  dns_dnssec_verify4() only.
+ *
  *	Requires:
  *\li		'name' (the owner name of the record) is a valid name
  *\li		'set' is a valid rdataset
@@ -143,6 +154,7 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *\li		'mctx' is not NULL
  *\li		'sigrdata' is a valid rdata containing a SIG record
  *\li		'wild' if non-NULL then is a valid and has a buffer.
+ *\li		'cache' is NULL or a valid verification cache.
  *
  *	Returns:
  *\li		#ISC_R_SUCCESS
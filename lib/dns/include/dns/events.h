@@ -75,6 +75,7 @@
 #define DNS_EVENT_CATZADDZONE			(ISC_EVENTCLASS_DNS + 54)
 #define DNS_EVENT_CATZMODZONE			(ISC_EVENTCLASS_DNS + 55)
 #define DNS_EVENT_CATZDELZONE			(ISC_EVENTCLASS_DNS + 56)
+#define DNS_EVENT_CACHESWEEP			(ISC_EVENTCLASS_DNS + 57)
 
 #define DNS_EVENT_FIRSTEVENT			(ISC_EVENTCLASS_DNS + 0)
 #define DNS_EVENT_LASTEVENT			(ISC_EVENTCLASS_DNS + 65535)
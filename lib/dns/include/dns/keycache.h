@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_KEYCACHE_H
+#define DNS_KEYCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/keycache.h
+ * \brief
+ * Defines dns_keycache_t, a cache of parsed DNSKEY records.
+ *
+ * Notes:
+ *\li	Turning a DNSKEY record into a dst_key_t builds a cryptographic
+ *	key object, which costs far more than the signature check the
+ *	key is then used for.  A validating resolver sees the same zone
+ *	keys over and over, so it keeps the parsed keys in a key cache
+ *	and hands out references to them.
+ *
+ *\li	Keys are found by owner name, class and the exact DNSKEY rdata;
+ *	the algorithm and key tag are part of the rdata.  A key in the
+ *	cache never changes, so there is nothing to invalidate: a zone
+ *	that rolls its keys simply stops asking for the old ones, and
+ *	they age out.
+ *
+ *\li	The cache holds at most a fixed number of keys.  When it is
+ *	full, the least recently used key is dropped.  Keys still in use
+ *	by a caller are not freed until the caller frees them.
+ *
+ * MP:
+ *\li	All functions are thread-safe.  The keys returned are shared
+ *	and must not be modified.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	The memory used is bounded by the number of entries and the size
+ *	of the largest DNSKEY record (64k).
+ *
+ * Security:
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_keycache_create(isc_mem_t *mctx, unsigned int maxentries,
+		    dns_keycache_t **cachep);
+/*%<
+ * Create a key cache holding at most 'maxentries' keys.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'maxentries' > 0.
+ *\li	cachep != NULL && *cachep == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_keycache_attach(dns_keycache_t *source, dns_keycache_t **targetp);
+/*%<
+ * Attach '*targetp' to 'source'.
+ */
+
+void
+dns_keycache_detach(dns_keycache_t **cachep);
+/*%<
+ * Detach '*cachep' from its key cache, destroying it when the last
+ * reference goes away.
+ *
+ * Ensures:
+ *\li	*cachep == NULL.
+ */
+
+isc_result_t
+dns_keycache_get(dns_keycache_t *cache, dns_name_t *owner,
+		 dns_rdata_t *rdata, dst_key_t **keyp);
+/*%<
+ * Find the parsed form of the DNSKEY (or KEY) record 'rdata' owned by
+ * 'owner', parsing and caching it if it is not already cached.  This
+ * is equivalent to dns_dnssec_keyfromrdata(), but the key returned may
+ * be shared; the caller frees it with dst_key_free() as usual.
+ *
+ * Requires:
+ *\li	'owner' is a valid absolute name.
+ *\li	'rdata' is a DNSKEY or KEY record.
+ *\li	keyp != NULL && *keyp == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	Any error dst_key_fromdns() returns; failures are not cached.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_KEYCACHE_H */
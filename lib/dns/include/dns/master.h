@@ -50,6 +50,10 @@
 #define DNS_MASTER_KEY	 	0x00004000	/*%< Loading a key zone master file. */
 #define DNS_MASTER_NOTTL	0x00008000	/*%< Don't require ttl. */
 #define DNS_MASTER_CHECKTTL	0x00010000	/*%< Check max-zone-ttl */
+#define DNS_MASTER_PARALLEL	0x00020000	/*%<
+						 * Load large text files
+						 * using several threads.
+						 */
 
 ISC_LANG_BEGINDECLS
 
@@ -299,6 +303,13 @@ dns_master_loadlexerinc(isc_lex_t *lex,
  * If 'DNS_MASTER_AGETTL' is set and the master file contains one or more
  * $DATE directives, the TTLs of the data will be aged accordingly.
  *
+ * If 'DNS_MASTER_PARALLEL' is set, a large text master file may be
+ * split where records start and the pieces loaded on several threads
+ * at once.  'callbacks->add' is then called from those threads, but
+ * never by two of them at a time.  Files that cannot be split safely,
+ * and included files, are loaded as usual.  All the loads in the
+ * process share at most one worker thread per CPU between them.
+ *
  * 'callbacks->commit' is assumed to call 'callbacks->error' or
  * 'callbacks->warn' to generate any error messages required.
  *
@@ -176,6 +176,12 @@ typedef isc_result_t (*dns_rbtdatawriter_t)(FILE *file,
 					    void *arg,
 					    isc_uint64_t *crc);
 
+typedef isc_result_t (*dns_rbtdatawriter2_t)(FILE *file,
+					     unsigned char *data,
+					     void *arg, void *base,
+					     dns_rbtnode_t *node,
+					     isc_uint64_t *crc);
+
 typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *rbtnode,
 					   void *base, size_t offset,
 					   void *arg, isc_uint64_t *crc);
@@ -683,6 +689,21 @@ dns_rbt_hashsize(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+isc_result_t
+dns_rbt_presize(dns_rbt_t *rbt, unsigned int count);
+/*%<
+ * Grow the 'rbt' hash table, if necessary, so that it can hold 'count'
+ * nodes without being resized again.  Nodes already in the table are
+ * moved to the new one incrementally as the tree is modified.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ *
+ * Returns:
+ * \li  #ISC_R_SUCCESS
+ * \li  #ISC_R_NOMEMORY
+ */
+
 void
 dns_rbt_destroy(dns_rbt_t **rbtp);
 isc_result_t
@@ -724,6 +745,32 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 /*%<
  * Write out the RBT structure and its data to a file.
  *
+ * Equivalent to dns_rbt_serialize_tree2() with a 'base' of NULL.
+ *
+ * Notes:
+ * \li  The file must be an actual file which allows seek() calls, so it cannot
+ *      be a stream.  Returns ISC_R_INVALIDFILE if not.
+ */
+
+isc_result_t
+dns_rbt_serialize_tree2(FILE *file, dns_rbt_t *rbt, void *base,
+			dns_rbtdatawriter2_t datawriter,
+			void *writer_arg, off_t *offset);
+/*%<
+ * Write out the RBT structure and its data to a file, for the file
+ * to be mapped at 'base'.
+ *
+ * Every pointer in the image is written as the address it will have
+ * when the file is mapped at 'base', so that dns_rbt_deserialize_tree()
+ * only has to rewrite pointers if the file ends up somewhere else.
+ * The nodes are written first, followed by all of their data, so that
+ * the data pages are not touched when nothing has to be rewritten.
+ *
+ * 'datawriter' is called with the file positioned where the data for
+ * a node is to be written, and is passed 'base' and the address 'node'
+ * will have in the mapped file.  It may write nothing, in which case
+ * the node will have no data.
+ *
  * Notes:
  * \li  The file must be an actual file which allows seek() calls, so it cannot
  *      be a stream.  Returns ISC_R_INVALIDFILE if not.
@@ -740,6 +787,10 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
  *
  * If 'originp' is not NULL, then it is pointed to the root node of the RBT.
  *
+ * If the file is not mapped at the address it was written for, the
+ * node pointers are rewritten to match 'base_address'; 'datafixer' is
+ * expected to do the same for the data.
+ *
  * Notes:
  * \li  The file must be an actual file which allows seek() calls, so it cannot
  *      be a stream.  This condition is not checked in the code.
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * Defines dns_respcache_t, the "response cache" object.
+ *
+ * Notes:
+ *\li	A response cache holds fully rendered DNS responses, keyed by
+ *	the question and by those properties of the query that change
+ *	the rendered output (flags, EDNS buffer size, transport).  A
+ *	server can answer a repeated query by copying the stored
+ *	response and patching in the query's message ID, instead of
+ *	looking up and rendering the answer again.
+ *
+ *\li	The cache has no notion of the data it was built from.  Its
+ *	owner must call dns_respcache_flush() whenever that data may
+ *	have changed.  Each flush starts a new generation; a response
+ *	built during an older generation is refused by
+ *	dns_respcache_add(), so a lookup racing with an update cannot
+ *	store stale data.
+ *
+ *\li	The cache holds at most a fixed number of responses, split
+ *	evenly over a number of independently locked stripes.  When a
+ *	stripe is full, its least recently used response is replaced.
+ *
+ * MP:
+ *\li	All functions are thread-safe.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	The memory used is bounded by the number of entries and
+ *	the largest response stored (64k).
+ *
+ * Security:
+ *\li	The cache does not decide which queries may share a response.
+ *	The caller must only store responses that do not depend on
+ *	anything outside the key, such as the client's address or
+ *	its TSIG key.
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/lang.h>
+#include <isc/stats.h>
+
+#include <dns/types.h>
+
+/***
+ ***	Types
+ ***/
+
+/*%
+ * The properties of a query that select a cached response.  'flags'
+ * and 'udpsize' are opaque to the cache; they are compared exactly.
+ * 'qname' is compared case-sensitively, because the question section
+ * of the response repeats the name as the client sent it.
+ */
+typedef struct dns_respcachekey {
+	const dns_name_t *	qname;
+	dns_rdatatype_t		qtype;
+	dns_rdataclass_t	qclass;
+	unsigned int		flags;
+	isc_uint16_t		udpsize;
+} dns_respcachekey_t;
+
+/*%
+ * Statistics to be credited when a cached response is used, as they
+ * would have been had the response been built afresh.  The statistics
+ * objects may be NULL.
+ */
+typedef struct dns_respcacheinfo {
+	isc_statscounter_t	counter;
+	isc_stats_t *		zonestats;
+	dns_stats_t *		querystats;
+} dns_respcacheinfo_t;
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int maxentries,
+		     dns_respcache_t **cachep);
+/*%<
+ * Create a response cache holding at most 'maxentries' responses,
+ * rounded up to a whole number per stripe.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'maxentries' > 0.
+ *\li	cachep != NULL && *cachep == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_respcache_attach(dns_respcache_t *source, dns_respcache_t **targetp);
+/*%<
+ * Attach '*targetp' to 'source'.
+ */
+
+void
+dns_respcache_detach(dns_respcache_t **cachep);
+/*%<
+ * Detach '*cachep' from its response cache, destroying it (and all
+ * responses it holds) when the last reference goes away.
+ *
+ * Ensures:
+ *\li	*cachep == NULL.
+ */
+
+unsigned int
+dns_respcache_generation(dns_respcache_t *cache);
+/*%<
+ * Return the current generation of 'cache'.  A caller that may later
+ * store a response should read this before it starts looking up the
+ * data the response is built from, and pass it to dns_respcache_add().
+ */
+
+void
+dns_respcache_flush(dns_respcache_t *cache);
+/*%<
+ * Remove all responses from 'cache' and start a new generation.
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const dns_respcachekey_t *key,
+		   dns_messageid_t id, isc_buffer_t *target,
+		   dns_respcacheinfo_t *info);
+/*%<
+ * Look for a response to the query described by 'key'.  If one is
+ * found it is copied to 'target' with its message ID set to 'id'.
+ *
+ * If 'info' is not NULL, it is filled in with the statistics the
+ * response was stored with; the caller must detach any statistics
+ * objects it is given.
+ *
+ * Requires:
+ *\li	'key->qname' is an absolute name.
+ *\li	'target' is a valid buffer.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ *\li	#ISC_R_NOSPACE		a response was found but does not fit
+ *				in 'target'; nothing was copied.
+ */
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *cache, unsigned int generation,
+		  const dns_respcachekey_t *key, const isc_region_t *response,
+		  const dns_respcacheinfo_t *info);
+/*%<
+ * Store 'response' as the answer to the query described by 'key',
+ * replacing any response already stored for it.  The message ID of
+ * 'response' is not stored.
+ *
+ * 'generation' is the value dns_respcache_generation() returned before
+ * the response was built.
+ *
+ * If 'info' is not NULL, the cache attaches to its statistics objects
+ * and returns them from later dns_respcache_find() calls.
+ *
+ * Requires:
+ *\li	'key->qname' is an absolute name.
+ *\li	'response' is at least a DNS message header long.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_CANCELED		the cache has been flushed since
+ *				'generation'; nothing was stored.
+ *\li	#ISC_R_NOMEMORY
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
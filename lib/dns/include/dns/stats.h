@@ -116,8 +116,12 @@ enum {
 	dns_cachestatscounter_querymisses = 4,
 	dns_cachestatscounter_deletelru = 5,
 	dns_cachestatscounter_deletettl = 6,
+	dns_cachestatscounter_sweeps = 7,
+	dns_cachestatscounter_sweepdeleted = 8,
+	dns_cachestatscounter_sweepbytes = 9,
+	dns_cachestatscounter_sweeptime = 10,
 
-	dns_cachestatscounter_max = 7,
+	dns_cachestatscounter_max = 11,
 
 	/*%
 	 * Query statistics counters (obsolete).
@@ -237,6 +241,14 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+dns_rdatatypestats_create2(isc_mem_t *mctx, dns_stats_t **statsp,
+			   unsigned int options);
+/*%<
+ * Like dns_rdatatypestats_create(), with 'options' passed to
+ * isc_stats_create2().
+ */
+
 isc_result_t
 dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
@@ -256,7 +268,8 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 isc_result_t
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
- * Create a statistics counter structure per opcode.
+ * Create a statistics counter structure per opcode.  The counters are
+ * sharded (see isc_stats_create2()).
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -272,7 +285,8 @@ dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 isc_result_t
 dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
- * Create a statistics counter structure per assigned rcode.
+ * Create a statistics counter structure per assigned rcode.  The counters
+ * are sharded (see isc_stats_create2()).
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
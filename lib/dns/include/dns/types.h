@@ -90,6 +90,7 @@ typedef isc_uint32_t				dns_iterations_t;
 typedef isc_uint16_t				dns_keyflags_t;
 typedef struct dns_keynode			dns_keynode_t;
 typedef ISC_LIST(dns_keynode_t)			dns_keynodelist_t;
+typedef struct dns_keycache			dns_keycache_t;
 typedef struct dns_keytable			dns_keytable_t;
 typedef isc_uint16_t				dns_keytag_t;
 typedef struct dns_loadctx			dns_loadctx_t;
@@ -122,6 +123,7 @@ typedef isc_uint16_t				dns_rdatatype_t;
 typedef struct dns_request			dns_request_t;
 typedef struct dns_requestmgr			dns_requestmgr_t;
 typedef struct dns_resolver			dns_resolver_t;
+typedef struct dns_respcache			dns_respcache_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef isc_uint8_t				dns_secalg_t;
 typedef isc_uint8_t				dns_secproto_t;
@@ -138,6 +140,7 @@ typedef struct dns_tsigkey			dns_tsigkey_t;
 typedef isc_uint32_t				dns_ttl_t;
 typedef struct dns_update_state			dns_update_state_t;
 typedef struct dns_validator			dns_validator_t;
+typedef struct dns_verifycache			dns_verifycache_t;
 typedef struct dns_view				dns_view_t;
 typedef ISC_LIST(dns_view_t)			dns_viewlist_t;
 typedef struct dns_zone				dns_zone_t;
@@ -393,6 +396,10 @@ typedef void
 typedef isc_result_t
 (*dns_addrdatasetfunc_t)(void *, dns_name_t *, dns_rdataset_t *);
 
+typedef isc_result_t
+(*dns_addbatchfunc_t)(void *, dns_name_t **, dns_rdataset_t *,
+		      isc_result_t *, unsigned int);
+
 typedef isc_result_t
 (*dns_additionaldatafunc_t)(void *, dns_name_t *, dns_rdatatype_t);
 
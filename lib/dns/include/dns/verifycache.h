@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_VERIFYCACHE_H
+#define DNS_VERIFYCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/verifycache.h
+ * \brief
+ * Defines dns_verifycache_t, a cache of successful signature checks.
+ *
+ * Notes:
+ *\li	dns_dnssec_verify4() describes everything a signature check
+ *	depends on -- the key, the RRSIG record and the RRset it covers --
+ *	by a single SHA-256 digest.  When the check succeeds the digest
+ *	is stored here, and a later check with the same digest can skip
+ *	the public key operation.  Failed checks are not stored.
+ *
+ *\li	The cache only remembers that the cryptography succeeded.  The
+ *	caller still makes every other check (validity period, signer
+ *	name, key flags) each time.
+ *
+ *\li	An entry is kept no longer than the expiration time of the
+ *	signature it stands for.  The cache holds at most a fixed number
+ *	of entries; when it is full the least recently used entry is
+ *	replaced.
+ *
+ * MP:
+ *\li	All functions are thread-safe.  The cache is split into stripes,
+ *	each with its own lock, so that concurrent checks seldom contend.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	Each entry uses a fixed amount of memory.
+ *
+ * Security:
+ *\li	A hit requires a SHA-256 collision over the key, signature and
+ *	signed data, so the cache does not weaken the check.
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/lang.h>
+#include <isc/sha2.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+/*%
+ * The length of the digest that identifies a signature check.
+ */
+#define DNS_VERIFYCACHE_DIGESTLENGTH	ISC_SHA256_DIGESTLENGTH
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_verifycache_create(isc_mem_t *mctx, unsigned int maxentries,
+		       dns_verifycache_t **cachep);
+/*%<
+ * Create a verification cache holding at most about 'maxentries'
+ * results.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'maxentries' > 0.
+ *\li	cachep != NULL && *cachep == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_verifycache_attach(dns_verifycache_t *source, dns_verifycache_t **targetp);
+/*%<
+ * Attach '*targetp' to 'source'.
+ */
+
+void
+dns_verifycache_detach(dns_verifycache_t **cachep);
+/*%<
+ * Detach '*cachep' from its verification cache, destroying it when the
+ * last reference goes away.
+ *
+ * Ensures:
+ *\li	*cachep == NULL.
+ */
+
+isc_boolean_t
+dns_verifycache_find(dns_verifycache_t *cache, const unsigned char *digest,
+		     isc_stdtime_t now);
+/*%<
+ * Return ISC_TRUE if a check with 'digest' has succeeded before and
+ * the signature had not expired by 'now'.
+ *
+ * Requires:
+ *\li	'digest' points to DNS_VERIFYCACHE_DIGESTLENGTH octets.
+ */
+
+void
+dns_verifycache_add(dns_verifycache_t *cache, const unsigned char *digest,
+		    isc_stdtime_t expire);
+/*%<
+ * Record that the check with 'digest' succeeded, for a signature that
+ * expires at 'expire'.
+ *
+ * Requires:
+ *\li	'digest' points to DNS_VERIFYCACHE_DIGESTLENGTH octets.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_VERIFYCACHE_H */
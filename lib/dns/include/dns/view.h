@@ -84,6 +84,9 @@ struct dns_view {
 	dns_adb_t *			adb;
 	dns_requestmgr_t *		requestmgr;
 	dns_acache_t *			acache;
+	dns_respcache_t *		respcache;
+	dns_keycache_t *		keycache;
+	dns_verifycache_t *		verifycache;
 	dns_cache_t *			cache;
 	dns_db_t *			cachedb;
 	dns_db_t *			hints;
@@ -152,6 +155,8 @@ struct dns_view {
 	char				*nta_file;
 	dns_ttl_t			prefetch_trigger;
 	dns_ttl_t			prefetch_eligible;
+	isc_boolean_t			staleanswersenable;
+	dns_ttl_t			staleanswerttl;
 	in_port_t			dstport;
 	dns_aclenv_t			aclenv;
 	dns_rdatatype_t			preferred_glue;
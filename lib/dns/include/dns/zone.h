@@ -85,6 +85,7 @@ typedef enum {
  */
 #define DNS_ZONEOPT2_CHECKTTL	  0x00000001U	/*%< check max-zone-ttl */
 #define DNS_ZONEOPT2_AUTOEMPTY	  0x00000002U	/*%< automatic empty zone */
+#define DNS_ZONEOPT2_PARALLELLOAD 0x00000004U	/*%< parallel-load */
 
 #ifndef NOMINUM_PUBLIC
 /*
@@ -2037,6 +2038,32 @@ dns_zone_setacache(dns_zone_t *zone, dns_acache_t *acache);
  *	'zone' will have a reference to 'acache'
  */
 
+void
+dns_zone_setrespcache(dns_zone_t *zone, dns_respcache_t *respcache);
+/*%<
+ *	Associate the zone with a response cache, or with none if
+ *	'respcache' is NULL.  The cache is flushed whenever the zone's
+ *	database is replaced or a new version of it is committed.
+ *
+ * Require:
+ *	'zone' to be a valid zone.
+ *
+ * Ensures:
+ *	'zone' will have a reference to 'respcache'
+ */
+
+dns_respcache_t *
+dns_zone_getrespcache(dns_zone_t *zone);
+/*%<
+ *	Return the response cache that changes to the zone's data are
+ *	flushed from, or NULL if there is none.  This is NULL while the
+ *	zone is not loaded, and for zones whose database cannot report
+ *	changes.  No reference is attached.
+ *
+ * Require:
+ *	'zone' to be a valid zone.
+ */
+
 void
 dns_zone_setcheckmx(dns_zone_t *zone, dns_checkmxfunc_t checkmx);
 /*%<
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/list.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/keycache.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+typedef struct dns_kcentry dns_kcentry_t;
+
+struct dns_keycache {
+	unsigned int		magic;
+	isc_mutex_t		lock;
+	isc_mem_t		*mctx;
+	isc_refcount_t		references;
+
+	dns_kcentry_t		**table;
+	unsigned int		size;		/* power of two */
+	unsigned int		count;
+	unsigned int		maxentries;
+	ISC_LIST(dns_kcentry_t)	lru;		/* most recently used first */
+};
+
+#define KEYCACHE_MAGIC			ISC_MAGIC('K', 'e', 'y', 'C')
+#define VALID_KEYCACHE(c)		ISC_MAGIC_VALID(c, KEYCACHE_MAGIC)
+
+/*
+ * An entry is allocated in one piece: the structure is followed by the
+ * DNSKEY rdata the key was parsed from.  The owner name and class are
+ * those of the key itself.
+ */
+struct dns_kcentry {
+	dns_kcentry_t *		next;
+	ISC_LINK(dns_kcentry_t)	link;
+	unsigned int		hashval;
+	unsigned int		length;
+	dst_key_t *		key;
+};
+
+#define ENTRY_DATA(e)		((unsigned char *)((e) + 1))
+#define ENTRY_SIZE(e)		(sizeof(*(e)) + (e)->length)
+
+static unsigned int
+key_hash(dns_name_t *owner, isc_region_t *r) {
+	return (dns_name_fullhash(owner, ISC_FALSE) ^
+		isc_hash_function(r->base, r->length, ISC_TRUE, NULL));
+}
+
+static isc_boolean_t
+key_match(dns_kcentry_t *entry, unsigned int hashval, dns_name_t *owner,
+	  dns_rdataclass_t rdclass, isc_region_t *r)
+{
+	return (ISC_TF(entry->hashval == hashval &&
+		       entry->length == r->length &&
+		       memcmp(ENTRY_DATA(entry), r->base, r->length) == 0 &&
+		       dst_key_class(entry->key) == rdclass &&
+		       dns_name_equal(dst_key_name(entry->key), owner)));
+}
+
+static void
+entry_free(dns_keycache_t *cache, dns_kcentry_t *entry) {
+	dst_key_free(&entry->key);
+	isc_mem_put(cache->mctx, entry, ENTRY_SIZE(entry));
+}
+
+/*
+ * Find an entry matching the key.  Requires the cache lock.
+ */
+static dns_kcentry_t *
+entry_find(dns_keycache_t *cache, unsigned int hashval, dns_name_t *owner,
+	   dns_rdataclass_t rdclass, isc_region_t *r)
+{
+	dns_kcentry_t *entry;
+
+	for (entry = cache->table[hashval & (cache->size - 1)];
+	     entry != NULL;
+	     entry = entry->next)
+	{
+		if (key_match(entry, hashval, owner, rdclass, r))
+			break;
+	}
+	return (entry);
+}
+
+/*
+ * Unlink 'entry' from its bucket and from the LRU list.
+ * Requires the cache lock.
+ */
+static void
+entry_unlink(dns_keycache_t *cache, dns_kcentry_t *entry) {
+	dns_kcentry_t **entryp;
+
+	entryp = &cache->table[entry->hashval & (cache->size - 1)];
+	while (*entryp != entry) {
+		INSIST(*entryp != NULL);
+		entryp = &(*entryp)->next;
+	}
+	*entryp = entry->next;
+	ISC_LIST_UNLINK(cache->lru, entry, link);
+	cache->count--;
+}
+
+isc_result_t
+dns_keycache_create(isc_mem_t *mctx, unsigned int maxentries,
+		    dns_keycache_t **cachep)
+{
+	isc_result_t result;
+	dns_keycache_t *cache;
+	unsigned int size;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxentries > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	/*
+	 * One bucket per entry, rounded up to a power of two.
+	 */
+	for (size = 16; size < maxentries && size < (1U << 24); size <<= 1)
+		;
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(cache, 0, sizeof(*cache));
+
+	result = isc_mutex_init(&cache->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_cache;
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+
+	cache->table = isc_mem_get(mctx, sizeof(*cache->table) * size);
+	if (cache->table == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_refs;
+	}
+	memset(cache->table, 0, sizeof(*cache->table) * size);
+
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->size = size;
+	cache->count = 0;
+	cache->maxentries = maxentries;
+	ISC_LIST_INIT(cache->lru);
+	cache->magic = KEYCACHE_MAGIC;
+
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_refs:
+	isc_refcount_decrement(&cache->references, NULL);
+	isc_refcount_destroy(&cache->references);
+ cleanup_lock:
+	DESTROYLOCK(&cache->lock);
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_keycache_attach(dns_keycache_t *source, dns_keycache_t **targetp) {
+	REQUIRE(VALID_KEYCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_keycache_detach(dns_keycache_t **cachep) {
+	dns_keycache_t *cache;
+	dns_kcentry_t *entry;
+	unsigned int refs;
+
+	REQUIRE(cachep != NULL && VALID_KEYCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	isc_refcount_decrement(&cache->references, &refs);
+	if (refs != 0)
+		return;
+
+	while ((entry = ISC_LIST_HEAD(cache->lru)) != NULL) {
+		ISC_LIST_UNLINK(cache->lru, entry, link);
+		entry_free(cache, entry);
+	}
+
+	cache->magic = 0;
+	isc_refcount_destroy(&cache->references);
+	DESTROYLOCK(&cache->lock);
+	isc_mem_put(cache->mctx, cache->table,
+		    sizeof(*cache->table) * cache->size);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_result_t
+dns_keycache_get(dns_keycache_t *cache, dns_name_t *owner,
+		 dns_rdata_t *rdata, dst_key_t **keyp)
+{
+	dns_kcentry_t *entry, *old, *evicted = NULL;
+	dns_kcentry_t **bucket;
+	dst_key_t *key = NULL;
+	unsigned int hashval;
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+
+	REQUIRE(VALID_KEYCACHE(cache));
+	REQUIRE(owner != NULL && dns_name_isabsolute(owner));
+	REQUIRE(rdata != NULL && (rdata->type == dns_rdatatype_dnskey ||
+				  rdata->type == dns_rdatatype_key));
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	dns_rdata_toregion(rdata, &r);
+	hashval = key_hash(owner, &r);
+
+	LOCK(&cache->lock);
+	entry = entry_find(cache, hashval, owner, rdata->rdclass, &r);
+	if (entry != NULL) {
+		if (entry != ISC_LIST_HEAD(cache->lru)) {
+			ISC_LIST_UNLINK(cache->lru, entry, link);
+			ISC_LIST_PREPEND(cache->lru, entry, link);
+		}
+		dst_key_attach(entry->key, keyp);
+		UNLOCK(&cache->lock);
+		return (ISC_R_SUCCESS);
+	}
+	UNLOCK(&cache->lock);
+
+	/*
+	 * Parse the key without holding the lock; if another caller
+	 * caches the same key meanwhile, theirs is used and this one
+	 * is thrown away.
+	 */
+	isc_buffer_init(&b, r.base, r.length);
+	isc_buffer_add(&b, r.length);
+	result = dst_key_fromdns(owner, rdata->rdclass, &b, cache->mctx, &key);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry) + r.length);
+	if (entry == NULL) {
+		/*
+		 * The key itself is fine; just don't cache it.
+		 */
+		*keyp = key;
+		return (ISC_R_SUCCESS);
+	}
+	entry->next = NULL;
+	ISC_LINK_INIT(entry, link);
+	entry->hashval = hashval;
+	entry->length = r.length;
+	memmove(ENTRY_DATA(entry), r.base, r.length);
+	entry->key = key;
+
+	LOCK(&cache->lock);
+	old = entry_find(cache, hashval, owner, rdata->rdclass, &r);
+	if (old != NULL) {
+		dst_key_attach(old->key, keyp);
+		UNLOCK(&cache->lock);
+		entry_free(cache, entry);
+		return (ISC_R_SUCCESS);
+	}
+	if (cache->count >= cache->maxentries) {
+		evicted = ISC_LIST_TAIL(cache->lru);
+		entry_unlink(cache, evicted);
+	}
+
+	bucket = &cache->table[hashval & (cache->size - 1)];
+	entry->next = *bucket;
+	*bucket = entry;
+	ISC_LIST_PREPEND(cache->lru, entry, link);
+	cache->count++;
+	dst_key_attach(entry->key, keyp);
+	UNLOCK(&cache->lock);
+
+	if (evicted != NULL)
+		entry_free(cache, evicted);
+
+	return (ISC_R_SUCCESS);
+}
@@ -12,16 +12,22 @@
 
 #include <config.h>
 
+#include <ctype.h>
+
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/lex.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/callbacks.h>
@@ -40,6 +46,14 @@
 #include <dns/time.h>
 #include <dns/ttl.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#else
+#define PROT_READ	0x01
+#define MAP_PRIVATE	0x0002
+#define MAP_FAILED	((void *)-1)
+#endif
+
 /*!
  * Grow the number of dns_rdatalist_t (#RDLSZ) and dns_rdata_t (#RDSZ) structures
  * by these sizes when we need to.
@@ -82,11 +96,26 @@
 #define DNS_MASTER_LHS 2048
 #define DNS_MASTER_RHS MINTSIZ
 
+/*%
+ * Parallel loading of text files.  Files smaller than two chunks are
+ * loaded serially.  Each worker collects up to PAR_BATCHSIZ bytes of
+ * rdatasets before adding them to the database.
+ */
+#define PAR_CHUNKSIZ (512*1024)
+#define PAR_BATCHSIZ (256*1024)
+
+/*%
+ * Number of rdatasets passed to callbacks->addbatch at once.
+ */
+#define ADDSZ 64
+
 #define CHECKNAMESFAIL(x) (((x) & DNS_MASTER_CHECKNAMESFAIL) != 0)
 
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
 
 typedef struct dns_incctx dns_incctx_t;
+typedef struct loadpar loadpar_t;
+typedef struct loadbatch loadbatch_t;
 
 /*%
  * Master file load state.
@@ -145,6 +174,10 @@ struct dns_loadctx {
 
 	dns_masterincludecb_t	include_cb;
 	void			*include_arg;
+
+	/* Parallel loading of the text format: */
+	loadpar_t		*par;		/*%< set in the top context */
+	loadbatch_t		*batch;		/*%< set in chunk contexts */
 };
 
 struct dns_incctx {
@@ -186,6 +219,27 @@ openfile_map(dns_loadctx_t *lctx, const char *master_file);
 static isc_result_t
 load_map(dns_loadctx_t *lctx);
 
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx);
+
+static isc_result_t
+par_create(dns_loadctx_t *lctx, const char *master_file);
+
+static void
+par_destroy(dns_loadctx_t *lctx);
+
+static void
+par_wait(dns_loadctx_t *lctx, isc_event_t *event);
+
+static isc_result_t
+batch_add(dns_loadctx_t *lctx, dns_name_t *owner, dns_rdatalist_t *this,
+	  dns_rdataset_t *dataset, const char *source, unsigned int line);
+
+static isc_result_t
+addrdatasets(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
+	     dns_name_t **owners, dns_rdataset_t *datasets,
+	     const char **sources, unsigned int *lines, unsigned int count);
+
 static isc_result_t
 pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx);
 
@@ -462,6 +516,8 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 	REQUIRE(DNS_LCTX_VALID(lctx));
 
 	lctx->magic = 0;
+	if (lctx->par != NULL)
+		par_destroy(lctx);
 	if (lctx->inc != NULL)
 		incctx_destroy(lctx->mctx, lctx->inc);
 
@@ -523,6 +579,27 @@ incctx_create(isc_mem_t *mctx, dns_name_t *origin, dns_incctx_t **ictxp) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Create a lexer set up for master files.
+ */
+static isc_result_t
+lex_create(isc_mem_t *mctx, isc_lex_t **lexp) {
+	isc_result_t result;
+	isc_lexspecials_t specials;
+
+	result = isc_lex_create(mctx, TOKENSIZ, lexp);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	memset(specials, 0, sizeof(specials));
+	specials[0] = 1;
+	specials['('] = 1;
+	specials[')'] = 1;
+	specials['"'] = 1;
+	isc_lex_setspecials(*lexp, specials);
+	isc_lex_setcomments(*lexp, ISC_LEXCOMMENT_DNSMASTERFILE);
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 	       unsigned int options, isc_uint32_t resign, dns_name_t *top,
@@ -535,7 +612,6 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 	dns_loadctx_t *lctx;
 	isc_result_t result;
 	isc_region_t r;
-	isc_lexspecials_t specials;
 
 	REQUIRE(lctxp != NULL && *lctxp == NULL);
 	REQUIRE(callbacks != NULL);
@@ -587,17 +663,10 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 		lctx->keep_lex = ISC_TRUE;
 	} else {
 		lctx->lex = NULL;
-		result = isc_lex_create(mctx, TOKENSIZ, &lctx->lex);
+		result = lex_create(mctx, &lctx->lex);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup_inc;
 		lctx->keep_lex = ISC_FALSE;
-		memset(specials, 0, sizeof(specials));
-		specials[0] = 1;
-		specials['('] = 1;
-		specials[')'] = 1;
-		specials['"'] = 1;
-		isc_lex_setspecials(lctx->lex, specials);
-		isc_lex_setcomments(lctx->lex, ISC_LEXCOMMENT_DNSMASTERFILE);
 	}
 
 	lctx->ttl_known = ISC_TF((options & DNS_MASTER_NOTTL) != 0);
@@ -614,6 +683,8 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 	lctx->result = ISC_R_SUCCESS;
 	lctx->include_cb = include_cb;
 	lctx->include_arg = include_arg;
+	lctx->par = NULL;
+	lctx->batch = NULL;
 	isc_stdtime_get(&lctx->now);
 
 	dns_fixedname_init(&lctx->fixed_top);
@@ -1012,6 +1083,17 @@ check_wildcard(dns_incctx_t *ictx, const char *source, unsigned long line,
 
 static isc_result_t
 openfile_text(dns_loadctx_t *lctx, const char *master_file) {
+	/*
+	 * Only the top level file is split; files it includes are
+	 * read by whichever worker meets the $INCLUDE.
+	 */
+	if ((lctx->options & DNS_MASTER_PARALLEL) != 0) {
+		lctx->options &= ~DNS_MASTER_PARALLEL;
+		if ((lctx->options & DNS_MASTER_AGETTL) == 0 &&
+		    !lctx->keep_lex &&
+		    par_create(lctx, master_file) == ISC_R_SUCCESS)
+			return (ISC_R_SUCCESS);
+	}
 	return (isc_lex_openfile(lctx->lex, master_file));
 }
 
@@ -2103,6 +2185,980 @@ pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx) {
 	return (result);
 }
 
+/*
+ * Parallel loading of text files.
+ *
+ * The top level file is mapped into memory and scanned once for the
+ * places where it can be split: lines that start a record with an
+ * explicit owner name, outside parentheses and quotes.  A split is only
+ * made where the state carried from one record to the next is known,
+ * namely the origin and the $TTL default; so nothing is split before
+ * the first $TTL, or after a $DATE.  Each piece (chunk) is then loaded
+ * by load_text() on a lexer of its own, starting with the origin and
+ * default TTL in effect where it begins.
+ *
+ * Worker threads take chunks in turn.  Their rdatasets are copied into
+ * a per worker batch, which is added to the database under a single
+ * lock when it fills up and at the end of each chunk.
+ */
+
+typedef struct loadchunk {
+	size_t			offset;
+	size_t			length;
+	unsigned long		line;
+	isc_boolean_t		ttl_known;
+	isc_uint32_t		ttl;
+	isc_result_t		result;
+	unsigned int		originlen;
+	unsigned char		origin[DNS_NAME_MAXWIRE];
+} loadchunk_t;
+
+struct loadpar {
+	isc_mutex_t		lock;		/*%< chunks and results */
+	isc_mutex_t		addlock;	/*%< database and include_cb */
+	char			*filename;
+	FILE			*f;
+	unsigned char		*base;
+	size_t			size;
+	loadchunk_t		*chunks;
+	unsigned int		nchunks;
+	unsigned int		maxchunks;
+	/* Locked by lock. */
+	unsigned int		next;		/*%< next chunk to load */
+	unsigned int		running;	/*%< active workers */
+	isc_boolean_t		stop;
+	isc_boolean_t		seen_include;
+	isc_event_t		*event;
+	/* Used only by the thread running load_parallel(). */
+	isc_boolean_t		started;
+	isc_boolean_t		incremental;	/*%< no worker threads */
+	isc_thread_t		*threads;
+	unsigned int		nthreads;
+	unsigned int		maxthreads;
+};
+
+typedef struct batchentry batchentry_t;
+
+struct batchentry {
+	batchentry_t		*next;
+	const char		*source;
+	unsigned int		line;
+	dns_name_t		owner;
+	dns_rdatalist_t		rdatalist;
+	unsigned int		attributes;
+	isc_uint32_t		resign;
+};
+
+struct loadbatch {
+	loadpar_t		*par;
+	unsigned char		*mem;
+	size_t			used;
+	const char		*source;	/*%< last source copied */
+	batchentry_t		*head;
+	batchentry_t		*tail;
+};
+
+#define BATCH_ALIGN(n)	(((n) + 7) & ~((size_t)7))
+
+typedef struct scanstate {
+	dns_fixedname_t		fixed[2];
+	dns_name_t		*origin;
+	isc_boolean_t		ttl_known;
+	isc_uint32_t		ttl;
+	isc_boolean_t		split;
+} scanstate_t;
+
+#define SCAN_NOTOWNER	" \t\r\n;\"()"
+
+/*
+ * Add every batched rdataset to the database, ADDSZ at a time.
+ */
+static isc_result_t
+batch_flush(dns_loadctx_t *lctx) {
+	loadbatch_t *batch = lctx->batch;
+	batchentry_t *entry;
+	dns_rdataset_t datasets[ADDSZ];
+	dns_name_t *owners[ADDSZ];
+	const char *sources[ADDSZ];
+	unsigned int lines[ADDSZ];
+	dns_rdataset_t *dataset;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int n;
+
+	if (batch->head == NULL)
+		return (ISC_R_SUCCESS);
+
+	LOCK(&batch->par->addlock);
+	entry = batch->head;
+	while (entry != NULL && result == ISC_R_SUCCESS) {
+		for (n = 0; entry != NULL && n < ADDSZ; entry = entry->next) {
+			dataset = &datasets[n];
+			dns_rdataset_init(dataset);
+			RUNTIME_CHECK(dns_rdatalist_tordataset(
+					&entry->rdatalist, dataset)
+				      == ISC_R_SUCCESS);
+			dataset->trust = dns_trust_ultimate;
+			dataset->attributes |= entry->attributes;
+			dataset->resign = entry->resign;
+			owners[n] = &entry->owner;
+			sources[n] = entry->source;
+			lines[n] = entry->line;
+			n++;
+		}
+		result = addrdatasets(lctx->callbacks, lctx, owners, datasets,
+				      sources, lines, n);
+	}
+	UNLOCK(&batch->par->addlock);
+
+	batch->used = 0;
+	batch->source = NULL;
+	batch->head = batch->tail = NULL;
+	return (result);
+}
+
+/*
+ * Copy the rdatalist 'this' and the attributes of 'dataset' into the
+ * batch, flushing it first if there is no room.
+ */
+static isc_result_t
+batch_add(dns_loadctx_t *lctx, dns_name_t *owner, dns_rdatalist_t *this,
+	  dns_rdataset_t *dataset, const char *source, unsigned int line)
+{
+	loadbatch_t *batch = lctx->batch;
+	batchentry_t *entry;
+	dns_rdata_t *rdata, *copy;
+	unsigned char *p;
+	isc_region_t r;
+	size_t need, srcneed = 0;
+	isc_result_t result;
+
+	need = BATCH_ALIGN(sizeof(*entry)) + BATCH_ALIGN(owner->length);
+	for (rdata = ISC_LIST_HEAD(this->rdata);
+	     rdata != NULL;
+	     rdata = ISC_LIST_NEXT(rdata, link))
+		need += BATCH_ALIGN(sizeof(*rdata) + rdata->length);
+	if (source != NULL)
+		srcneed = BATCH_ALIGN(strlen(source) + 1);
+
+	if (batch->used + need + srcneed > PAR_BATCHSIZ) {
+		result = batch_flush(lctx);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	if (need + srcneed > PAR_BATCHSIZ) {
+		/*
+		 * Too big to batch; add it directly.
+		 */
+		LOCK(&batch->par->addlock);
+		result = addrdatasets(lctx->callbacks, lctx, &owner, dataset,
+				      &source, &line, 1);
+		UNLOCK(&batch->par->addlock);
+		return (result);
+	}
+
+	if (source != NULL &&
+	    (batch->source == NULL || strcmp(source, batch->source) != 0))
+	{
+		p = batch->mem + batch->used;
+		strcpy((char *)p, source);
+		batch->source = (char *)p;
+		batch->used += srcneed;
+	}
+
+	p = batch->mem + batch->used;
+	entry = (batchentry_t *)p;
+	p += BATCH_ALIGN(sizeof(*entry));
+	entry->next = NULL;
+	entry->source = (source != NULL) ? batch->source : NULL;
+	entry->line = line;
+	entry->attributes = dataset->attributes;
+	entry->resign = dataset->resign;
+
+	memmove(p, owner->ndata, owner->length);
+	r.base = p;
+	r.length = owner->length;
+	dns_name_init(&entry->owner, NULL);
+	dns_name_fromregion(&entry->owner, &r);
+	p += BATCH_ALIGN(owner->length);
+
+	dns_rdatalist_init(&entry->rdatalist);
+	entry->rdatalist.rdclass = this->rdclass;
+	entry->rdatalist.type = this->type;
+	entry->rdatalist.covers = this->covers;
+	entry->rdatalist.ttl = this->ttl;
+	for (rdata = ISC_LIST_HEAD(this->rdata);
+	     rdata != NULL;
+	     rdata = ISC_LIST_NEXT(rdata, link))
+	{
+		copy = (dns_rdata_t *)p;
+		*copy = *rdata;
+		ISC_LINK_INIT(copy, link);
+		copy->data = (unsigned char *)(copy + 1);
+		memmove(copy->data, rdata->data, rdata->length);
+		ISC_LIST_APPEND(entry->rdatalist.rdata, copy, link);
+		p += BATCH_ALIGN(sizeof(*copy) + rdata->length);
+	}
+
+	batch->used += need;
+	if (batch->tail != NULL)
+		batch->tail->next = entry;
+	else
+		batch->head = entry;
+	batch->tail = entry;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Find the end of the record starting at '*pp': the first newline
+ * outside parentheses and quoted strings.  Advance '*pp' past it,
+ * counting lines in '*linep'.  Return ISC_FALSE if the record is
+ * malformed; the serial loader will report it.
+ */
+static isc_boolean_t
+scan_record(unsigned char **pp, unsigned char *end, unsigned long *linep) {
+	unsigned char *p = *pp;
+	unsigned int depth = 0;
+	isc_boolean_t quoted = ISC_FALSE;
+
+	while (p < end) {
+		switch (*p++) {
+		case '\\':
+			if (p < end) {
+				if (*p == '\n')
+					(*linep)++;
+				p++;
+			}
+			break;
+		case '"':
+			quoted = ISC_TF(!quoted);
+			break;
+		case ';':
+			if (!quoted)
+				while (p < end && *p != '\n')
+					p++;
+			break;
+		case '(':
+			if (!quoted)
+				depth++;
+			break;
+		case ')':
+			if (!quoted) {
+				if (depth == 0)
+					return (ISC_FALSE);
+				depth--;
+			}
+			break;
+		case '\n':
+			(*linep)++;
+			if (quoted)
+				return (ISC_FALSE);
+			if (depth == 0) {
+				*pp = p;
+				return (ISC_TRUE);
+			}
+			break;
+		}
+	}
+	*pp = p;
+	return (ISC_TF(depth == 0 && !quoted));
+}
+
+/*
+ * Return ISC_TRUE unless 'filename' certainly contains no $TTL, $DATE
+ * or $INCLUDE directive, which could change the state after it.
+ */
+static isc_boolean_t
+include_changes_ttl(const char *filename) {
+	FILE *f = NULL;
+	char word[sizeof("INCLUDE")];
+	isc_boolean_t bol = ISC_TRUE;
+	isc_boolean_t found = ISC_FALSE;
+	unsigned int n;
+	int c;
+
+	if (isc_stdio_open(filename, "r", &f) != ISC_R_SUCCESS)
+		return (ISC_TRUE);
+	while (!found && (c = getc(f)) != EOF) {
+		if (bol && c == '$') {
+			n = 0;
+			while ((c = getc(f)) != EOF && isalpha(c) &&
+			       n < sizeof(word) - 1)
+				word[n++] = c;
+			word[n] = '\0';
+			if (strcasecmp(word, "TTL") == 0 ||
+			    strcasecmp(word, "DATE") == 0 ||
+			    strcasecmp(word, "INCLUDE") == 0)
+				found = ISC_TRUE;
+		}
+		bol = ISC_TF(c == '\n');
+	}
+	(void)isc_stdio_close(f);
+	return (found);
+}
+
+/*
+ * Track the effect of the directive in 'text' on the scan state.
+ */
+static void
+scan_directive(isc_lex_t *lex, unsigned char *text, size_t length,
+	       scanstate_t *st)
+{
+	isc_buffer_t buffer;
+	isc_token_t token;
+	isc_result_t result;
+	unsigned int options;
+	dns_name_t *origin;
+	isc_uint32_t ttl;
+	char *directive;
+
+	options = ISC_LEXOPT_EOL | ISC_LEXOPT_EOF | ISC_LEXOPT_DNSMULTILINE |
+		  ISC_LEXOPT_ESCAPE;
+	isc_buffer_init(&buffer, text, (unsigned int)length);
+	isc_buffer_add(&buffer, (unsigned int)length);
+	result = isc_lex_openbuffer(lex, &buffer);
+	if (result != ISC_R_SUCCESS) {
+		st->split = ISC_FALSE;
+		return;
+	}
+	result = isc_lex_gettoken(lex, options, &token);
+	if (result != ISC_R_SUCCESS || token.type != isc_tokentype_string)
+		goto nosplit;
+	directive = DNS_AS_STR(token);
+
+	if (strcasecmp(directive, "$TTL") == 0) {
+		result = isc_lex_gettoken(lex, options, &token);
+		if (result != ISC_R_SUCCESS ||
+		    token.type != isc_tokentype_string ||
+		    dns_ttl_fromtext(&token.value.as_textregion,
+				     &ttl) != ISC_R_SUCCESS)
+			goto nosplit;
+		if (ttl > 0x7fffffffUL)
+			ttl = 0;
+		st->ttl = ttl;
+		st->ttl_known = ISC_TRUE;
+	} else if (strcasecmp(directive, "$ORIGIN") == 0) {
+		result = isc_lex_gettoken(lex, options, &token);
+		if (result != ISC_R_SUCCESS ||
+		    token.type != isc_tokentype_string)
+			goto nosplit;
+		origin = dns_fixedname_name(&st->fixed[0]);
+		if (origin == st->origin)
+			origin = dns_fixedname_name(&st->fixed[1]);
+		isc_buffer_init(&buffer, token.value.as_region.base,
+				token.value.as_region.length);
+		isc_buffer_add(&buffer, token.value.as_region.length);
+		result = dns_name_fromtext(origin, &buffer, st->origin,
+					   0, NULL);
+		if (result != ISC_R_SUCCESS)
+			goto nosplit;
+		st->origin = origin;
+	} else if (strcasecmp(directive, "$INCLUDE") == 0) {
+		result = isc_lex_gettoken(lex, options | ISC_LEXOPT_QSTRING,
+					  &token);
+		if (result != ISC_R_SUCCESS ||
+		    (token.type != isc_tokentype_string &&
+		     token.type != isc_tokentype_qstring))
+			goto nosplit;
+		if (include_changes_ttl(DNS_AS_STR(token)))
+			st->ttl_known = ISC_FALSE;
+	} else if (strcasecmp(directive, "$DATE") == 0)
+		goto nosplit;
+
+	(void)isc_lex_close(lex);
+	return;
+
+ nosplit:
+	(void)isc_lex_close(lex);
+	st->split = ISC_FALSE;
+}
+
+/*
+ * Start a new chunk at 'offset'.
+ */
+static isc_result_t
+chunk_add(dns_loadctx_t *lctx, loadpar_t *par, size_t offset,
+	  unsigned long line, scanstate_t *st)
+{
+	loadchunk_t *chunks, *chunk;
+	unsigned int maxchunks;
+	isc_region_t r;
+
+	if (par->nchunks == par->maxchunks) {
+		maxchunks = par->maxchunks * 2 + 16;
+		chunks = isc_mem_get(lctx->mctx, maxchunks * sizeof(*chunks));
+		if (chunks == NULL)
+			return (ISC_R_NOMEMORY);
+		if (par->chunks != NULL) {
+			memmove(chunks, par->chunks,
+				par->nchunks * sizeof(*chunks));
+			isc_mem_put(lctx->mctx, par->chunks,
+				    par->maxchunks * sizeof(*chunks));
+		}
+		par->chunks = chunks;
+		par->maxchunks = maxchunks;
+	}
+	if (par->nchunks > 0) {
+		chunk = &par->chunks[par->nchunks - 1];
+		chunk->length = offset - chunk->offset;
+	}
+
+	chunk = &par->chunks[par->nchunks++];
+	chunk->offset = offset;
+	chunk->length = par->size - offset;
+	chunk->line = line;
+	chunk->ttl_known = st->ttl_known;
+	chunk->ttl = st->ttl;
+	chunk->result = ISC_R_SUCCESS;
+	dns_name_toregion(st->origin, &r);
+	memmove(chunk->origin, r.base, r.length);
+	chunk->originlen = r.length;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Split the mapped file into chunks.
+ */
+static isc_result_t
+par_scan(dns_loadctx_t *lctx, loadpar_t *par) {
+	scanstate_t st;
+	isc_lex_t *lex = NULL;
+	unsigned char *p, *end, *q, *record;
+	unsigned char *owner = NULL;
+	size_t ownerlen = 0, start = 0, offset;
+	unsigned long line = 1, recline;
+	unsigned int i;
+	isc_result_t result;
+
+	result = lex_create(lctx->mctx, &lex);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_fixedname_init(&st.fixed[0]);
+	dns_fixedname_init(&st.fixed[1]);
+	st.origin = dns_fixedname_name(&st.fixed[0]);
+	RUNTIME_CHECK(dns_name_copy(lctx->inc->origin, st.origin, NULL)
+		      == ISC_R_SUCCESS);
+	st.ttl_known = lctx->default_ttl_known;
+	st.ttl = lctx->default_ttl;
+	st.split = ISC_TRUE;
+
+	result = chunk_add(lctx, par, 0, 1, &st);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	p = par->base;
+	end = p + par->size;
+	while (p < end) {
+		record = p;
+		recline = line;
+		if (*p == '$') {
+			if (!scan_record(&p, end, &line))
+				goto malformed;
+			if (st.split)
+				scan_directive(lex, record,
+					       (size_t)(p - record), &st);
+			continue;
+		}
+		if (strchr(SCAN_NOTOWNER, *p) == NULL) {
+			for (q = p;
+			     q < end && strchr(SCAN_NOTOWNER, *q) == NULL;
+			     q++)
+			{
+				if (*q == '\\' && q + 1 < end)
+					q++;
+			}
+			offset = (size_t)(record - par->base);
+			if (st.split && st.ttl_known &&
+			    offset - start >= PAR_CHUNKSIZ &&
+			    ((size_t)(q - record) != ownerlen ||
+			     memcmp(record, owner, ownerlen) != 0))
+			{
+				result = chunk_add(lctx, par, offset,
+						   recline, &st);
+				if (result != ISC_R_SUCCESS)
+					goto cleanup;
+				start = offset;
+			}
+			owner = record;
+			ownerlen = (size_t)(q - record);
+		}
+		if (!scan_record(&p, end, &line))
+			goto malformed;
+	}
+
+	/*
+	 * Each chunk is read through an isc_buffer_t.
+	 */
+	for (i = 0; i < par->nchunks; i++)
+		if (par->chunks[i].length > 0xffffffffU)
+			goto malformed;
+	goto cleanup;
+
+ malformed:
+	result = DNS_R_SYNTAX;
+
+ cleanup:
+	isc_lex_destroy(&lex);
+	return (result);
+}
+
+static void
+par_include(const char *filename, void *arg) {
+	dns_loadctx_t *lctx = arg;
+
+	LOCK(&lctx->par->addlock);
+	(lctx->include_cb)(filename, lctx->include_arg);
+	UNLOCK(&lctx->par->addlock);
+}
+
+/*
+ * Load one chunk with a context of its own, using 'batch'.
+ */
+static isc_result_t
+load_chunk(dns_loadctx_t *lctx, loadchunk_t *chunk, loadbatch_t *batch) {
+	loadpar_t *par = lctx->par;
+	dns_loadctx_t *clctx = NULL;
+	dns_masterincludecb_t include_cb = NULL;
+	isc_buffer_t buffer;
+	dns_name_t origin;
+	isc_region_t r;
+	isc_result_t result, tresult;
+
+	r.base = chunk->origin;
+	r.length = chunk->originlen;
+	dns_name_init(&origin, NULL);
+	dns_name_fromregion(&origin, &r);
+
+	if (lctx->include_cb != NULL)
+		include_cb = par_include;
+	result = loadctx_create(dns_masterformat_text, lctx->mctx,
+				lctx->options, lctx->resign, lctx->top,
+				lctx->zclass, &origin, lctx->callbacks,
+				NULL, NULL, NULL, include_cb, lctx, NULL,
+				&clctx);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	clctx->maxttl = lctx->maxttl;
+	clctx->now = lctx->now;
+	if (chunk->ttl_known) {
+		clctx->ttl = chunk->ttl;
+		clctx->default_ttl = chunk->ttl;
+		clctx->default_ttl_known = ISC_TRUE;
+	}
+	/*
+	 * Warnings given once per file are given once per worker.
+	 */
+	LOCK(&par->lock);
+	clctx->warn_1035 = lctx->warn_1035;
+	clctx->warn_tcr = lctx->warn_tcr;
+	clctx->warn_sigexpired = lctx->warn_sigexpired;
+	UNLOCK(&par->lock);
+
+	isc_buffer_init(&buffer, par->base + chunk->offset,
+			(unsigned int)chunk->length);
+	isc_buffer_add(&buffer, (unsigned int)chunk->length);
+	result = isc_lex_openbuffer(clctx->lex, &buffer);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = isc_lex_setsourcename(clctx->lex, par->filename);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	(void)isc_lex_setsourceline(clctx->lex, chunk->line);
+
+	clctx->batch = batch;
+	result = load_text(clctx);
+	tresult = batch_flush(clctx);
+	if (result == DNS_R_SEENINCLUDE)
+		result = ISC_R_SUCCESS;
+	if (result == ISC_R_SUCCESS)
+		result = tresult;
+	if (result == ISC_R_SUCCESS)
+		result = clctx->result;
+
+	LOCK(&par->lock);
+	if (!clctx->warn_1035)
+		lctx->warn_1035 = ISC_FALSE;
+	if (!clctx->warn_tcr)
+		lctx->warn_tcr = ISC_FALSE;
+	if (!clctx->warn_sigexpired)
+		lctx->warn_sigexpired = ISC_FALSE;
+	if (clctx->seen_include)
+		par->seen_include = ISC_TRUE;
+	UNLOCK(&par->lock);
+
+ cleanup:
+	dns_loadctx_detach(&clctx);
+	return (result);
+}
+
+/*
+ * Load the next chunk, if there is one and the load has not been
+ * stopped.  Return ISC_FALSE if there was nothing to do.
+ */
+static isc_boolean_t
+par_next(dns_loadctx_t *lctx, loadbatch_t *batch) {
+	loadpar_t *par = lctx->par;
+	loadchunk_t *chunk;
+	isc_boolean_t canceled;
+	isc_result_t result;
+
+	LOCK(&lctx->lock);
+	canceled = lctx->canceled;
+	UNLOCK(&lctx->lock);
+
+	LOCK(&par->lock);
+	if (canceled || par->stop || par->next == par->nchunks) {
+		UNLOCK(&par->lock);
+		return (ISC_FALSE);
+	}
+	chunk = &par->chunks[par->next++];
+	UNLOCK(&par->lock);
+
+	result = load_chunk(lctx, chunk, batch);
+
+	LOCK(&par->lock);
+	chunk->result = result;
+	if (result != ISC_R_SUCCESS &&
+	    (lctx->options & DNS_MASTER_MANYERRORS) == 0)
+		par->stop = ISC_TRUE;
+	UNLOCK(&par->lock);
+
+	return (ISC_TRUE);
+}
+
+/*
+ * Load chunks until there are none left.  The last worker to finish
+ * requeues the load event, if there is one.
+ */
+static void
+par_work(dns_loadctx_t *lctx) {
+	loadpar_t *par = lctx->par;
+	loadbatch_t batch;
+	isc_event_t *event = NULL;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.par = par;
+	batch.mem = isc_mem_get(lctx->mctx, PAR_BATCHSIZ);
+
+	if (batch.mem != NULL) {
+		while (par_next(lctx, &batch))
+			;
+		isc_mem_put(lctx->mctx, batch.mem, PAR_BATCHSIZ);
+	}
+
+	LOCK(&par->lock);
+	INSIST(par->running > 0);
+	if (--par->running == 0) {
+		event = par->event;
+		par->event = NULL;
+	}
+	UNLOCK(&par->lock);
+	if (event != NULL)
+		isc_task_send(lctx->task, &event);
+}
+
+/*
+ * Load one chunk on the calling thread, for an incremental load that
+ * has no worker threads.  Return ISC_FALSE if there was none to load.
+ */
+static isc_boolean_t
+par_step(dns_loadctx_t *lctx) {
+	loadbatch_t batch;
+	isc_boolean_t loaded;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.par = lctx->par;
+	batch.mem = isc_mem_get(lctx->mctx, PAR_BATCHSIZ);
+	if (batch.mem == NULL)
+		return (ISC_FALSE);
+
+	loaded = par_next(lctx, &batch);
+	isc_mem_put(lctx->mctx, batch.mem, PAR_BATCHSIZ);
+	return (loaded);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+/*
+ * Worker threads are shared out among all the parallel loads in the
+ * process, so that loading many large zones at once does not start
+ * more threads than there are CPUs.
+ */
+static isc_once_t par_once = ISC_ONCE_INIT;
+static isc_mutex_t par_threadlock;
+static unsigned int par_threadsfree;
+
+static void
+par_initialize(void) {
+	RUNTIME_CHECK(isc_mutex_init(&par_threadlock) == ISC_R_SUCCESS);
+	par_threadsfree = isc_os_ncpus();
+}
+
+/*
+ * Take up to 'n' worker threads; return the number taken.
+ */
+static unsigned int
+par_reserve(unsigned int n) {
+	RUNTIME_CHECK(isc_once_do(&par_once, par_initialize) == ISC_R_SUCCESS);
+
+	LOCK(&par_threadlock);
+	if (n > par_threadsfree)
+		n = par_threadsfree;
+	par_threadsfree -= n;
+	UNLOCK(&par_threadlock);
+
+	return (n);
+}
+
+static void
+par_release(unsigned int n) {
+	if (n == 0)
+		return;
+
+	LOCK(&par_threadlock);
+	par_threadsfree += n;
+	UNLOCK(&par_threadlock);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+par_run(isc_threadarg_t arg) {
+	par_work(arg);
+	return ((isc_threadresult_t)0);
+}
+#endif
+
+static void
+par_join(loadpar_t *par) {
+#ifdef ISC_PLATFORM_USETHREADS
+	while (par->nthreads > 0) {
+		RUNTIME_CHECK(isc_thread_join(par->threads[--par->nthreads],
+					      NULL) == ISC_R_SUCCESS);
+		par_release(1);
+	}
+#else
+	UNUSED(par);
+#endif
+}
+
+/*
+ * Load the chunks on up to one worker thread per CPU, as many as are
+ * free.  An incremental load returns DNS_R_CONTINUE once the workers
+ * are started, and is called again by load_quantum() when they have
+ * all finished.  If no thread is free, it loads one chunk per call
+ * on the task instead.
+ */
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx) {
+	loadpar_t *par = lctx->par;
+	isc_boolean_t canceled;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int i, want;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	if (!par->started) {
+		par->started = ISC_TRUE;
+		want = isc_os_ncpus();
+		if (want > par->nchunks)
+			want = par->nchunks;
+		/*
+		 * A synchronous load works on this thread as well.
+		 */
+		if (lctx->task == NULL)
+			want--;
+
+		/*
+		 * The running count includes this thread until it has
+		 * either worked or handed off to the load event.
+		 */
+		par->running = 1;
+#ifdef ISC_PLATFORM_USETHREADS
+		par->maxthreads = par_reserve(want);
+		if (par->maxthreads > 0) {
+			par->threads = isc_mem_get(lctx->mctx,
+						   par->maxthreads *
+						   sizeof(isc_thread_t));
+			if (par->threads == NULL) {
+				par_release(par->maxthreads);
+				par->maxthreads = 0;
+			}
+		}
+		for (i = 0; i < par->maxthreads; i++) {
+			LOCK(&par->lock);
+			par->running++;
+			UNLOCK(&par->lock);
+			if (isc_thread_create(par_run, lctx,
+					      &par->threads[i])
+			    != ISC_R_SUCCESS)
+			{
+				LOCK(&par->lock);
+				par->running--;
+				UNLOCK(&par->lock);
+				break;
+			}
+			par->nthreads++;
+		}
+		par_release(par->maxthreads - par->nthreads);
+#else
+		UNUSED(want);
+#endif
+		if (lctx->task != NULL) {
+			LOCK(&par->lock);
+			par->running--;
+			UNLOCK(&par->lock);
+			if (par->nthreads > 0)
+				return (DNS_R_CONTINUE);
+			par->incremental = ISC_TRUE;
+		} else
+			par_work(lctx);
+	}
+
+	if (par->incremental && par_step(lctx))
+		return (DNS_R_CONTINUE);
+
+	par_join(par);
+
+	for (i = 0; i < par->nchunks; i++) {
+		if (par->chunks[i].result != ISC_R_SUCCESS) {
+			result = par->chunks[i].result;
+			break;
+		}
+	}
+	if (result == ISC_R_SUCCESS) {
+		LOCK(&lctx->lock);
+		canceled = lctx->canceled;
+		UNLOCK(&lctx->lock);
+		if (canceled)
+			result = ISC_R_CANCELED;
+		else if (par->next != par->nchunks)
+			result = ISC_R_NOMEMORY;
+		else if (par->seen_include) {
+			lctx->seen_include = ISC_TRUE;
+			result = DNS_R_SEENINCLUDE;
+		}
+	}
+	return (result);
+}
+
+/*
+ * Requeue 'event' when the workers have finished.
+ */
+static void
+par_wait(dns_loadctx_t *lctx, isc_event_t *event) {
+	loadpar_t *par = lctx->par;
+
+	LOCK(&par->lock);
+	if (par->running != 0) {
+		par->event = event;
+		event = NULL;
+	}
+	UNLOCK(&par->lock);
+	if (event != NULL)
+		isc_task_send(lctx->task, &event);
+}
+
+/*
+ * Map 'master_file' and split it for a parallel load.  On failure the
+ * file is loaded serially instead.
+ */
+static isc_result_t
+par_create(dns_loadctx_t *lctx, const char *master_file) {
+	loadpar_t *par;
+	off_t size = 0;
+	int flags;
+	isc_result_t result;
+
+	par = isc_mem_get(lctx->mctx, sizeof(*par));
+	if (par == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(par, 0, sizeof(*par));
+	lctx->par = par;
+
+	result = isc_mutex_init(&par->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(lctx->mctx, par, sizeof(*par));
+		lctx->par = NULL;
+		return (result);
+	}
+	result = isc_mutex_init(&par->addlock);
+	if (result != ISC_R_SUCCESS) {
+		DESTROYLOCK(&par->lock);
+		isc_mem_put(lctx->mctx, par, sizeof(*par));
+		lctx->par = NULL;
+		return (result);
+	}
+
+	par->filename = isc_mem_strdup(lctx->mctx, master_file);
+	if (par->filename == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	result = isc_stdio_open(master_file, "r", &par->f);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = isc_file_getsizefd(fileno(par->f), &size);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	if (size < 2 * PAR_CHUNKSIZ || (off_t)(size_t)size != size) {
+		result = ISC_R_RANGE;
+		goto cleanup;
+	}
+	par->size = (size_t)size;
+
+	flags = MAP_PRIVATE;
+#ifdef MAP_FILE
+	flags |= MAP_FILE;
+#endif
+	par->base = isc_file_mmap(NULL, par->size, PROT_READ, flags,
+				  fileno(par->f), 0);
+	if (par->base == NULL || par->base == MAP_FAILED) {
+		par->base = NULL;
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+
+	result = par_scan(lctx, par);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	if (par->nchunks < 2) {
+		result = ISC_R_RANGE;
+		goto cleanup;
+	}
+
+	lctx->load = load_parallel;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	par_destroy(lctx);
+	return (result);
+}
+
+static void
+par_destroy(dns_loadctx_t *lctx) {
+	loadpar_t *par = lctx->par;
+
+	par_join(par);
+	if (par->threads != NULL)
+		isc_mem_put(lctx->mctx, par->threads,
+			    par->maxthreads * sizeof(isc_thread_t));
+	if (par->chunks != NULL)
+		isc_mem_put(lctx->mctx, par->chunks,
+			    par->maxchunks * sizeof(loadchunk_t));
+	if (par->base != NULL)
+		(void)isc_file_munmap(par->base, par->size);
+	if (par->f != NULL)
+		(void)isc_stdio_close(par->f);
+	if (par->filename != NULL)
+		isc_mem_free(lctx->mctx, par->filename);
+	DESTROYLOCK(&par->addlock);
+	DESTROYLOCK(&par->lock);
+	isc_mem_put(lctx->mctx, par, sizeof(*par));
+	lctx->par = NULL;
+}
+
 /*
  * Fill/check exists buffer with 'len' bytes.  Track remaining bytes to be
  * read when incrementally filling the buffer.
@@ -2281,6 +3337,7 @@ load_raw(dns_loadctx_t *lctx) {
 	isc_buffer_t target, buf;
 	unsigned char *target_mem = NULL;
 	dns_decompress_t dctx;
+	isc_uint32_t ttl_offset = 0;
 
 	callbacks = lctx->callbacks;
 	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
@@ -2291,6 +3348,20 @@ load_raw(dns_loadctx_t *lctx) {
 			return (result);
 	}
 
+	/*
+	 * The TTLs in the file are relative to the time it was dumped.
+	 * If they are to be aged, work out how long ago that was.
+	 */
+	if ((lctx->options & DNS_MASTER_AGETTL) != 0 &&
+	    lctx->header.dumptime != 0)
+	{
+		isc_stdtime_t now;
+
+		isc_stdtime_get(&now);
+		if (now > lctx->header.dumptime)
+			ttl_offset = now - lctx->header.dumptime;
+	}
+
 	ISC_LIST_INIT(head);
 	ISC_LIST_INIT(dummy);
 
@@ -2324,6 +3395,7 @@ load_raw(dns_loadctx_t *lctx) {
 		isc_uint32_t totallen;
 		size_t minlen, readlen;
 		isc_boolean_t sequential_read = ISC_FALSE;
+		isc_boolean_t expired = ISC_FALSE;
 
 		/* Read the data length */
 		isc_buffer_clear(&target);
@@ -2395,6 +3467,17 @@ load_raw(dns_loadctx_t *lctx) {
 		rdatalist.covers = isc_buffer_getuint16(&target);
 		rdatalist.ttl =  isc_buffer_getuint32(&target);
 		rdcount = isc_buffer_getuint32(&target);
+
+		/*
+		 * Adjust the TTL for the dump time.  An RRset that has
+		 * already expired is read, but not committed.
+		 */
+		if ((lctx->options & DNS_MASTER_AGETTL) != 0) {
+			if (rdatalist.ttl < ttl_offset)
+				expired = ISC_TRUE;
+			else
+				rdatalist.ttl -= ttl_offset;
+		}
 		if (rdcount == 0 || rdcount > 0xffff) {
 			result = ISC_R_RANGE;
 			goto cleanup;
@@ -2463,8 +3546,13 @@ load_raw(dns_loadctx_t *lctx) {
 
 				/* Partial Commit. */
 				ISC_LIST_APPEND(head, &rdatalist, link);
-				result = commit(callbacks, lctx, &head, name,
-						NULL, 0);
+				if (expired) {
+					ISC_LIST_UNLINK(head, &rdatalist,
+							link);
+					result = ISC_R_SUCCESS;
+				} else
+					result = commit(callbacks, lctx, &head,
+							name, NULL, 0);
 				for (j = 0; j < i; j++) {
 					ISC_LIST_UNLINK(rdatalist.rdata,
 							&rdata[j], link);
@@ -2522,10 +3610,13 @@ load_raw(dns_loadctx_t *lctx) {
 			goto cleanup;
 		}
 
-		ISC_LIST_APPEND(head, &rdatalist, link);
-
 		/* Commit this RRset.  rdatalist will be unlinked. */
-		result = commit(callbacks, lctx, &head, name, NULL, 0);
+		if (expired)
+			result = ISC_R_SUCCESS;
+		else {
+			ISC_LIST_APPEND(head, &rdatalist, link);
+			result = commit(callbacks, lctx, &head, name, NULL, 0);
+		}
 
 		for (i = 0; i < rdcount; i++) {
 			ISC_LIST_UNLINK(rdatalist.rdata, &rdata[i], link);
@@ -3064,6 +4155,102 @@ resign_fromlist(dns_rdatalist_t *this, dns_loadctx_t *lctx) {
 	return (when);
 }
 
+/*
+ * Report a failure to add an rdataset at 'owner'.
+ */
+static isc_result_t
+adderror(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
+	 dns_name_t *owner, isc_result_t result,
+	 const char *source, unsigned int line)
+{
+	char namebuf[DNS_NAME_FORMATSIZE];
+	void    (*error)(struct dns_rdatacallbacks *, const char *, ...);
+
+	error = callbacks->error;
+	if (result == ISC_R_NOMEMORY) {
+		(*error)(callbacks, "dns_master_load: %s",
+			 dns_result_totext(result));
+	} else if (result != ISC_R_SUCCESS) {
+		dns_name_format(owner, namebuf, sizeof(namebuf));
+		if (source != NULL) {
+			(*error)(callbacks, "%s: %s:%lu: %s: %s",
+				 "dns_master_load", source, line,
+				 namebuf, dns_result_totext(result));
+		} else {
+			(*error)(callbacks, "%s: %s: %s",
+				 "dns_master_load", namebuf,
+				 dns_result_totext(result));
+		}
+	}
+	if (MANYERRS(lctx, result)) {
+		SETRESULT(lctx, result);
+		result = ISC_R_SUCCESS;
+	}
+	return (result);
+}
+
+/*
+ * Pass 'count' rdatasets to the database, all at once if it supports
+ * that, reporting any errors.  'count' is at most ADDSZ.
+ */
+static isc_result_t
+addrdatasets(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
+	     dns_name_t **owners, dns_rdataset_t *datasets,
+	     const char **sources, unsigned int *lines, unsigned int count)
+{
+	isc_result_t results[ADDSZ];
+	isc_result_t result;
+	unsigned int i;
+
+	INSIST(count <= ADDSZ);
+
+	if (callbacks->addbatch != NULL) {
+		result = (*callbacks->addbatch)(callbacks->add_private,
+						owners, datasets, results,
+						count);
+		if (result == ISC_R_SUCCESS)
+			return (ISC_R_SUCCESS);
+	} else {
+		for (i = 0; i < count; i++)
+			results[i] = ISC_R_SUCCESS;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (callbacks->addbatch == NULL)
+			results[i] = (*callbacks->add)(callbacks->add_private,
+						       owners[i],
+						       &datasets[i]);
+		if (results[i] == ISC_R_SUCCESS)
+			continue;
+		result = adderror(callbacks, lctx, owners[i], results[i],
+				  sources[i], lines[i]);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Convert 'this' to the rdataset to be committed.
+ */
+static void
+makedataset(dns_loadctx_t *lctx, dns_rdatalist_t *this,
+	    dns_rdataset_t *dataset)
+{
+	dns_rdataset_init(dataset);
+	RUNTIME_CHECK(dns_rdatalist_tordataset(this, dataset)
+		      == ISC_R_SUCCESS);
+	dataset->trust = dns_trust_ultimate;
+	/*
+	 * If this is a secure dynamic zone set the re-signing time.
+	 */
+	if (dataset->type == dns_rdatatype_rrsig &&
+	    (lctx->options & DNS_MASTER_RESIGN) != 0) {
+		dataset->attributes |= DNS_RDATASETATTR_RESIGN;
+		dataset->resign = resign_fromlist(this, lctx);
+	}
+}
+
 /*
  * Convert each element from a rdatalist_t to rdataset then call commit.
  * Unlink each element as we go.
@@ -3075,53 +4262,49 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
        const char *source, unsigned int line)
 {
 	dns_rdatalist_t *this;
-	dns_rdataset_t dataset;
+	dns_rdataset_t datasets[ADDSZ];
+	dns_name_t *owners[ADDSZ];
+	const char *sources[ADDSZ];
+	unsigned int lines[ADDSZ];
 	isc_result_t result;
-	char namebuf[DNS_NAME_FORMATSIZE];
-	void    (*error)(struct dns_rdatacallbacks *, const char *, ...);
-
-	this = ISC_LIST_HEAD(*head);
-	error = callbacks->error;
+	unsigned int i, n;
 
-	if (this == NULL)
-		return (ISC_R_SUCCESS);
-	do {
-		dns_rdataset_init(&dataset);
-		RUNTIME_CHECK(dns_rdatalist_tordataset(this, &dataset)
-			      == ISC_R_SUCCESS);
-		dataset.trust = dns_trust_ultimate;
-		/*
-		 * If this is a secure dynamic zone set the re-signing time.
-		 */
-		if (dataset.type == dns_rdatatype_rrsig &&
-		    (lctx->options & DNS_MASTER_RESIGN) != 0) {
-			dataset.attributes |= DNS_RDATASETATTR_RESIGN;
-			dataset.resign = resign_fromlist(this, lctx);
+	/*
+	 * A worker of a parallel load keeps a copy for later.
+	 */
+	if (lctx->batch != NULL) {
+		while ((this = ISC_LIST_HEAD(*head)) != NULL) {
+			makedataset(lctx, this, &datasets[0]);
+			result = batch_add(lctx, owner, this, &datasets[0],
+					   source, line);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+			ISC_LIST_UNLINK(*head, this, link);
 		}
-		result = ((*callbacks->add)(callbacks->add_private, owner,
-					    &dataset));
-		if (result == ISC_R_NOMEMORY) {
-			(*error)(callbacks, "dns_master_load: %s",
-				 dns_result_totext(result));
-		} else if (result != ISC_R_SUCCESS) {
-			dns_name_format(owner, namebuf, sizeof(namebuf));
-			if (source != NULL) {
-				(*error)(callbacks, "%s: %s:%lu: %s: %s",
-					 "dns_master_load", source, line,
-					 namebuf, dns_result_totext(result));
-			} else {
-				(*error)(callbacks, "%s: %s: %s",
-					 "dns_master_load", namebuf,
-					 dns_result_totext(result));
-			}
+		return (ISC_R_SUCCESS);
+	}
+
+	while (ISC_LIST_HEAD(*head) != NULL) {
+		n = 0;
+		for (this = ISC_LIST_HEAD(*head);
+		     this != NULL && n < ADDSZ;
+		     this = ISC_LIST_NEXT(this, link))
+		{
+			makedataset(lctx, this, &datasets[n]);
+			owners[n] = owner;
+			sources[n] = source;
+			lines[n] = line;
+			n++;
 		}
-		if (MANYERRS(lctx, result))
-			SETRESULT(lctx, result);
-		else if (result != ISC_R_SUCCESS)
+		result = addrdatasets(callbacks, lctx, owners, datasets,
+				      sources, lines, n);
+		if (result != ISC_R_SUCCESS)
 			return (result);
-		ISC_LIST_UNLINK(*head, this, link);
-		this = ISC_LIST_HEAD(*head);
-	} while (this != NULL);
+		for (i = 0; i < n; i++) {
+			this = ISC_LIST_HEAD(*head);
+			ISC_LIST_UNLINK(*head, this, link);
+		}
+	}
 	return (ISC_R_SUCCESS);
 }
 
@@ -3175,7 +4358,10 @@ load_quantum(isc_task_t *task, isc_event_t *event) {
 		result = (lctx->load)(lctx);
 	if (result == DNS_R_CONTINUE) {
 		event->ev_arg = lctx;
-		isc_task_send(task, &event);
+		if (lctx->par != NULL)
+			par_wait(lctx, event);
+		else
+			isc_task_send(task, &event);
 	} else {
 		(lctx->done)(lctx->done_arg, result);
 		isc_event_free(&event);
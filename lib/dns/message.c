@@ -100,6 +100,17 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
 #define RDATALIST_COUNT		  8
 #define RDATASET_COUNT		 RDATALIST_COUNT
 
+/*%
+ * dns_message_reset() keeps enough memory for the next message to be
+ * parsed or rendered without allocating, provided it is no bigger than
+ * the last one.  These limit what is kept after an unusually big one.
+ */
+#define SCRATCHPAD_RETAIN	16384
+#define NAME_RETAIN		 64
+#define OFFSET_RETAIN		 64
+#define RDATA_RETAIN		256
+#define RDATALIST_RETAIN	128
+
 /*%
  * Text representation of the different items, for message_totext
  * functions.
@@ -163,6 +174,10 @@ msgblock_reset(dns_msgblock_t *);
 static inline void
 msgblock_free(isc_mem_t *, dns_msgblock_t *, unsigned int);
 
+static dns_msgblock_t *
+msgblock_recycle(isc_mem_t *, dns_msgblock_t *, unsigned int, unsigned int,
+		 unsigned int, isc_boolean_t);
+
 static void
 logfmtpacket(dns_message_t *message, const char *description,
 	     isc_sockaddr_t *address, isc_logcategory_t *category,
@@ -232,6 +247,46 @@ msgblock_free(isc_mem_t *mctx, dns_msgblock_t *block, unsigned int sizeof_type)
 	isc_mem_put(mctx, block, length);
 }
 
+/*
+ * Free the chain of blocks starting at 'block'.  Unless 'everything'
+ * is set, return a single empty block with room for as many elements
+ * as the chain had handed out (at least 'min' and at most 'max'), so
+ * that the next message of the same size needs no more blocks.
+ */
+static dns_msgblock_t *
+msgblock_recycle(isc_mem_t *mctx, dns_msgblock_t *block,
+		 unsigned int sizeof_type, unsigned int min, unsigned int max,
+		 isc_boolean_t everything)
+{
+	dns_msgblock_t *next;
+	unsigned int used = 0;
+
+	if (block == NULL)
+		return (NULL);
+
+	if (!everything && ISC_LIST_NEXT(block, link) == NULL) {
+		msgblock_reset(block);
+		ISC_LINK_INIT(block, link);
+		return (block);
+	}
+
+	while (block != NULL) {
+		next = ISC_LIST_NEXT(block, link);
+		used += block->count - block->remaining;
+		msgblock_free(mctx, block, sizeof_type);
+		block = next;
+	}
+
+	if (everything)
+		return (NULL);
+
+	if (used < min)
+		used = min;
+	if (used > max)
+		used = max;
+	return (msgblock_allocate(mctx, sizeof_type, used));
+}
+
 /*
  * Allocate a new dynamic buffer, and attach it to this message as the
  * "current" buffer.  (which is always the last on the list, for our
@@ -522,8 +577,9 @@ msgresetsigs(dns_message_t *msg, isc_boolean_t replying) {
  */
 static void
 msgreset(dns_message_t *msg, isc_boolean_t everything) {
-	dns_msgblock_t *msgblock, *next_msgblock;
+	dns_msgblock_t *msgblock;
 	isc_buffer_t *dynbuf, *next_dynbuf;
+	unsigned int scratchlen = 0;
 	dns_rdata_t *rdata;
 	dns_rdatalist_t *rdatalist;
 
@@ -551,58 +607,62 @@ msgreset(dns_message_t *msg, isc_boolean_t everything) {
 		rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
 	}
 
+	/*
+	 * Keep one scratch buffer.  If the last message needed more than
+	 * one, make the one we keep as big as all of them together.
+	 */
 	dynbuf = ISC_LIST_HEAD(msg->scratchpad);
 	INSIST(dynbuf != NULL);
 	if (!everything) {
+		scratchlen = isc_buffer_length(dynbuf);
 		isc_buffer_clear(dynbuf);
 		dynbuf = ISC_LIST_NEXT(dynbuf, link);
 	}
 	while (dynbuf != NULL) {
 		next_dynbuf = ISC_LIST_NEXT(dynbuf, link);
+		scratchlen += isc_buffer_length(dynbuf);
 		ISC_LIST_UNLINK(msg->scratchpad, dynbuf, link);
 		isc_buffer_free(&dynbuf);
 		dynbuf = next_dynbuf;
 	}
-
-	msgblock = ISC_LIST_HEAD(msg->rdatas);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatas, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdata_t));
-		msgblock = next_msgblock;
+	if (!everything) {
+		dynbuf = ISC_LIST_HEAD(msg->scratchpad);
+		if (scratchlen > SCRATCHPAD_RETAIN)
+			scratchlen = SCRATCHPAD_RETAIN;
+		if (scratchlen > isc_buffer_length(dynbuf) &&
+		    isc_buffer_allocate(msg->mctx, &next_dynbuf,
+					scratchlen) == ISC_R_SUCCESS)
+		{
+			ISC_LIST_UNLINK(msg->scratchpad, dynbuf, link);
+			isc_buffer_free(&dynbuf);
+			ISC_LIST_APPEND(msg->scratchpad, next_dynbuf, link);
+		}
 	}
 
 	/*
-	 * rdatalists could be empty.
+	 * The same for the element blocks; rdatalists could be empty.
 	 */
+	msgblock = ISC_LIST_HEAD(msg->rdatas);
+	ISC_LIST_INIT(msg->rdatas);
+	msgblock = msgblock_recycle(msg->mctx, msgblock, sizeof(dns_rdata_t),
+				    RDATA_COUNT, RDATA_RETAIN, everything);
+	if (msgblock != NULL)
+		ISC_LIST_APPEND(msg->rdatas, msgblock, link);
 
 	msgblock = ISC_LIST_HEAD(msg->rdatalists);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatalists, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdatalist_t));
-		msgblock = next_msgblock;
-	}
+	ISC_LIST_INIT(msg->rdatalists);
+	msgblock = msgblock_recycle(msg->mctx, msgblock,
+				    sizeof(dns_rdatalist_t), RDATALIST_COUNT,
+				    RDATALIST_RETAIN, everything);
+	if (msgblock != NULL)
+		ISC_LIST_APPEND(msg->rdatalists, msgblock, link);
 
 	msgblock = ISC_LIST_HEAD(msg->offsets);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->offsets, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_offsets_t));
-		msgblock = next_msgblock;
-	}
+	ISC_LIST_INIT(msg->offsets);
+	msgblock = msgblock_recycle(msg->mctx, msgblock, sizeof(dns_offsets_t),
+				    OFFSET_COUNT, OFFSET_RETAIN, everything);
+	if (msgblock != NULL)
+		ISC_LIST_APPEND(msg->offsets, msgblock, link);
 
 	if (msg->tsigkey != NULL) {
 		dns_tsigkey_detach(&msg->tsigkey);
@@ -738,14 +798,14 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 	result = isc_mempool_create(m->mctx, sizeof(dns_name_t), &m->namepool);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
-	isc_mempool_setfreemax(m->namepool, NAME_COUNT);
+	isc_mempool_setfreemax(m->namepool, NAME_RETAIN);
 	isc_mempool_setname(m->namepool, "msg:names");
 
 	result = isc_mempool_create(m->mctx, sizeof(dns_rdataset_t),
 				    &m->rdspool);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
-	isc_mempool_setfreemax(m->rdspool, NAME_COUNT);
+	isc_mempool_setfreemax(m->rdspool, NAME_RETAIN);
 	isc_mempool_setname(m->rdspool, "msg:rdataset");
 
 	dynbuf = NULL;
@@ -44,7 +44,6 @@ typedef enum {
 
 typedef enum {
 	fw_start = 0,
-	fw_ordinary,
 	fw_newcurrent
 } fw_state;
 
@@ -119,6 +118,35 @@ static unsigned char maptolower[] = {
 		set_offsets(name, var, NULL); \
 	}
 
+/*
+ * Load eight octets from 'p', which need not be aligned.
+ */
+static inline isc_uint64_t
+load8(const unsigned char *p) {
+	isc_uint64_t w;
+
+	memmove(&w, p, sizeof(w));
+	return (w);
+}
+
+/*
+ * Case-fold eight octets at once, as maptolower[] would one at a time:
+ * only 'A' to 'Z' change.  For each octet below 0x80, adding 0x3f sets
+ * the top bit if it is 'A' or above, and adding 0x25 if it is above
+ * 'Z'; no sum carries into the next octet.  Label lengths (below 64)
+ * are never changed, so whole wire-format names can be folded.
+ */
+static inline isc_uint64_t
+fold8(isc_uint64_t w) {
+	isc_uint64_t low7 = w & 0x7f7f7f7f7f7f7f7fULL;
+	isc_uint64_t upper;
+
+	upper = (low7 + 0x3f3f3f3f3f3f3f3fULL) &
+		~(low7 + 0x2525252525252525ULL) &
+		~w & 0x8080808080808080ULL;
+	return (w | (upper >> 2));
+}
+
 /*%
  * Note:  If additional attributes are added that should not be set for
  *	  empty names, MAKE_EMPTY() must be changed so it clears them.
@@ -626,6 +654,18 @@ dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		else
 			count = count2;
 
+		/*
+		 * Skip equal words; the first difference is then found
+		 * an octet at a time.
+		 */
+		while (count >= 8 &&
+		       fold8(load8(label1)) == fold8(load8(label2)))
+		{
+			count -= 8;
+			label1 += 8;
+			label2 += 8;
+		}
+
 		/* Loop unrolled for performance */
 		while (ISC_LIKELY(count > 3)) {
 			chdiff = (int)maptolower[label1[0]] -
@@ -711,8 +751,7 @@ dns_name_compare(const dns_name_t *name1, const dns_name_t *name2) {
 
 isc_boolean_t
 dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l, count;
-	unsigned char c;
+	unsigned int length;
 	unsigned char *label1, *label2;
 
 	/*
@@ -738,43 +777,27 @@ dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
 	if (name1->length != name2->length)
 		return (ISC_FALSE);
 
-	l = name1->labels;
-
-	if (l != name2->labels)
+	if (name1->labels != name2->labels)
 		return (ISC_FALSE);
 
+	/*
+	 * Case folding leaves label lengths alone and never turns another
+	 * octet into one, so the names are equal exactly when their folded
+	 * wire forms are; there is no need to walk the labels.
+	 */
+	length = name1->length;
 	label1 = name1->ndata;
 	label2 = name2->ndata;
-	while (ISC_LIKELY(l-- > 0)) {
-		count = *label1++;
-		if (count != *label2++)
+	while (ISC_LIKELY(length >= 8)) {
+		if (fold8(load8(label1)) != fold8(load8(label2)))
+			return (ISC_FALSE);
+		length -= 8;
+		label1 += 8;
+		label2 += 8;
+	}
+	while (ISC_LIKELY(length-- > 0)) {
+		if (maptolower[*label1++] != maptolower[*label2++])
 			return (ISC_FALSE);
-
-		INSIST(count <= 63); /* no bitstring support */
-
-		/* Loop unrolled for performance */
-		while (ISC_LIKELY(count > 3)) {
-			c = maptolower[label1[0]];
-			if (c != maptolower[label2[0]])
-				return (ISC_FALSE);
-			c = maptolower[label1[1]];
-			if (c != maptolower[label2[1]])
-				return (ISC_FALSE);
-			c = maptolower[label1[2]];
-			if (c != maptolower[label2[2]])
-				return (ISC_FALSE);
-			c = maptolower[label1[3]];
-			if (c != maptolower[label2[3]])
-				return (ISC_FALSE);
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (ISC_LIKELY(count-- > 0)) {
-			c = maptolower[*label1++];
-			if (c != maptolower[*label2++])
-				return (ISC_FALSE);
-		}
 	}
 
 	return (ISC_TRUE);
@@ -844,6 +867,13 @@ dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
 		if (count1 != count2)
 			return ((count1 < count2) ? -1 : 1);
 		count = count1;
+		while (count >= 8 &&
+		       fold8(load8(label1)) == fold8(load8(label2)))
+		{
+			count -= 8;
+			label1 += 8;
+			label2 += 8;
+		}
 		while (count > 0) {
 			count--;
 			c1 = maptolower[*label1++];
@@ -1878,8 +1908,8 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 	biggest_pointer = current;
 
 	/*
-	 * Note:  The following code is not optimized for speed, but
-	 * rather for correctness.  Speed will be addressed in the future.
+	 * Each pass of the loop reads a label length, copying the label
+	 * that follows it, or one octet of a compression pointer.
 	 */
 
 	while (current < source->active && !done) {
@@ -1897,10 +1927,25 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 					goto full;
 				nused += c + 1;
 				*ndata++ = c;
-				if (c == 0)
+				if (c == 0) {
 					done = ISC_TRUE;
-				n = c;
-				state = fw_ordinary;
+					break;
+				}
+				/*
+				 * Copy the whole label at once.
+				 */
+				if (c > source->active - current)
+					return (ISC_R_UNEXPECTEDEND);
+				if (downcase) {
+					for (n = 0; n < c; n++)
+						ndata[n] = maptolower[cdata[n]];
+				} else
+					memmove(ndata, cdata, c);
+				ndata += c;
+				cdata += c;
+				current += c;
+				if (!seen_pointer)
+					cused += c;
 			} else if (c >= 128 && c < 192) {
 				/*
 				 * 14 bit local compression pointer.
@@ -1920,14 +1965,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source,
 			} else
 				return (DNS_R_BADLABELTYPE);
 			break;
-		case fw_ordinary:
-			if (downcase)
-				c = maptolower[c];
-			*ndata++ = c;
-			n--;
-			if (n == 0)
-				state = fw_start;
-			break;
 		case fw_newcurrent:
 			new_current *= 256;
 			new_current += c;
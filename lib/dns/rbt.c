@@ -63,6 +63,14 @@
 
 #define RBT_HASH_SIZE           64
 
+/*%
+ * While the hash table is being grown, this many buckets of the old
+ * table are moved to the new one on each insertion or removal.  Growth
+ * is triggered at three nodes per bucket and roughly doubles the table,
+ * so the old table is always drained long before the next growth.
+ */
+#define RBT_REHASH_STEP         4
+
 #ifdef RBT_MEM_TEST
 #undef RBT_HASH_SIZE
 #define RBT_HASH_SIZE 2 /*%< To give the reallocation code a workout. */
@@ -77,6 +85,13 @@ struct dns_rbt {
 	unsigned int		nodecount;
 	size_t			hashsize;
 	dns_rbtnode_t **	hashtable;
+	/*
+	 * The previous table while a rehash is in progress; buckets
+	 * below 'hashiter' have already been moved to 'hashtable'.
+	 */
+	size_t			oldhashsize;
+	dns_rbtnode_t **	oldhashtable;
+	size_t			hashiter;
 	void *			mmap_location;
 };
 
@@ -109,6 +124,7 @@ struct file_header {
 	unsigned int rdataset_fixed:1;	/* compiled with --enable-rrset-fixed */
 	unsigned int nodecount;		/* shadow from rbt structure */
 	isc_uint64_t crc;
+	isc_uint64_t base;		/* address the file was written for */
 	char version2[32];  		/* repeated; must match version1 */
 };
 
@@ -117,10 +133,11 @@ struct file_header {
  *
  * step one: write out a zeroed header of 1024 bytes
  * step two: walk the tree in a depth-first, left-right-down order, writing
- * out the nodes, reserving space as we go, correcting addresses to point
- * at the proper offset in the file, and setting a flag for each pointer to
- * indicate that it is a reference to a location in the file, rather than in
- * memory.
+ * out the nodes, reserving space as we go, and correcting addresses to
+ * point at where the node will be when the file is mapped at the address
+ * it is written for.  The data for the nodes is written after all of the
+ * nodes, so the data pages need not be touched if the file is mapped at
+ * that address.
  * step three: write out the header, adding the information that will be
  * needed to re-create the tree object itself.
  *
@@ -136,7 +153,7 @@ dns_rbt_zero_header(FILE *file);
 
 static isc_result_t
 write_header(FILE *file, dns_rbt_t *rbt, isc_uint64_t first_node_offset,
-	     isc_uint64_t crc);
+	     isc_uint64_t base, isc_uint64_t crc);
 
 static isc_result_t
 serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
@@ -145,52 +162,9 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 
 static isc_result_t
 serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
-		dns_rbtdatawriter_t datawriter, void *writer_arg,
+		dns_rbtdatawriter2_t datawriter, void *writer_arg,
+		uintptr_t base, off_t *nodepos, off_t *datapos,
 		uintptr_t *where, isc_uint64_t *crc);
-/*
- * The following functions allow you to get the actual address of a pointer
- * without having to use an if statement to check to see if that address is
- * relative or not
- */
-static inline dns_rbtnode_t *
-getparent(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->parent);
-	adjusted_address += node->parent_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getleft(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->left);
-	adjusted_address += node->left_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getright(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->right);
-	adjusted_address += node->right_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getdown(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->down);
-	adjusted_address += node->down_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
-
-static inline dns_rbtnode_t *
-getdata(dns_rbtnode_t *node, file_header_t *header) {
-	char *adjusted_address = (char *)(node->data);
-	adjusted_address += node->data_is_relative * (uintptr_t)header;
-
-	return ((dns_rbtnode_t *)adjusted_address);
-}
 
 /*%
  * Elements of the rbtnode structure.
@@ -425,12 +399,15 @@ static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name);
 static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node);
-static void
+static isc_result_t
 rehash(dns_rbt_t *rbt, unsigned int newcount);
+static inline dns_rbtnode_t *
+hash_find(dns_rbtnode_t *hnode, unsigned int hash, dns_rbtnode_t *up,
+	  dns_name_t *name);
 #else
 #define hash_node(rbt, node, name)
 #define unhash_node(rbt, node)
-#define rehash(rbt, newcount)
+#define rehash(rbt, newcount) ISC_R_SUCCESS
 #endif
 
 static inline void
@@ -446,7 +423,7 @@ static void
 deletefromlevel(dns_rbtnode_t *delete, dns_rbtnode_t **rootp);
 
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t size,
+treefix(dns_rbt_t *rbt, void *base, size_t size, uintptr_t written,
 	dns_rbtnode_t *n, dns_name_t *name,
 	dns_rbtdatafixer_t datafixer, void *fixer_arg,
 	isc_uint64_t *crc);
@@ -492,7 +469,7 @@ dns_rbt_zero_header(FILE *file) {
  */
 static isc_result_t
 write_header(FILE *file, dns_rbt_t *rbt, isc_uint64_t first_node_offset,
-	     isc_uint64_t crc)
+	     isc_uint64_t base, isc_uint64_t crc)
 {
 	file_header_t header;
 	isc_result_t result;
@@ -520,6 +497,7 @@ write_header(FILE *file, dns_rbt_t *rbt, isc_uint64_t first_node_offset,
 	header.nodecount = rbt->nodecount;
 
 	header.crc = crc;
+	header.base = base;
 
 	CHECK(isc_stdio_tell(file, &location));
 	location = dns_rbt_serialize_align(location);
@@ -561,33 +539,18 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 	temp_node.parent_is_relative = 0;
 	temp_node.data_is_relative = 0;
 	temp_node.is_mmapped = 1;
+	ISC_LINK_INIT(&temp_node, deadlink);
 
 	/*
-	 * If the next node is not NULL, calculate the next node's location
-	 * in the file.  Note that this will have to change when the data
-	 * structure changes, and it also assumes that we always write the
-	 * nodes out in list order (which we currently do.)
-	*/
-	if (temp_node.parent != NULL) {
-		temp_node.parent = (dns_rbtnode_t *)(parent);
-		temp_node.parent_is_relative = 1;
-	}
-	if (temp_node.left != NULL) {
-		temp_node.left = (dns_rbtnode_t *)(left);
-		temp_node.left_is_relative = 1;
-	}
-	if (temp_node.right != NULL) {
-		temp_node.right = (dns_rbtnode_t *)(right);
-		temp_node.right_is_relative = 1;
-	}
-	if (temp_node.down != NULL) {
-		temp_node.down = (dns_rbtnode_t *)(down);
-		temp_node.down_is_relative = 1;
-	}
-	if (temp_node.data != NULL) {
-		temp_node.data = (dns_rbtnode_t *)(data);
-		temp_node.data_is_relative = 1;
-	}
+	 * The locations of the other nodes and of the data have already
+	 * been worked out by serialize_nodes(), as the addresses they will
+	 * have once the file is mapped.
+	 */
+	temp_node.parent = (dns_rbtnode_t *)(parent);
+	temp_node.left = (dns_rbtnode_t *)(left);
+	temp_node.right = (dns_rbtnode_t *)(right);
+	temp_node.down = (dns_rbtnode_t *)(down);
+	temp_node.data = (void *)(data);
 
 	node_data = (unsigned char *) node + sizeof(dns_rbtnode_t);
 	datasize = NODE_SIZE(node) - sizeof(dns_rbtnode_t);
@@ -615,28 +578,44 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 	return (result);
 }
 
+/*
+ * Return the space needed for the nodes, but not the data, of the
+ * tree below and including 'node'.
+ */
+static off_t
+serialize_size(dns_rbtnode_t *node) {
+	if (node == NULL)
+		return (0);
+
+	return (dns_rbt_serialize_align(NODE_SIZE(node)) +
+		serialize_size(LEFT(node)) +
+		serialize_size(RIGHT(node)) +
+		serialize_size(DOWN(node)));
+}
+
 static isc_result_t
 serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
-		dns_rbtdatawriter_t datawriter, void *writer_arg,
+		dns_rbtdatawriter2_t datawriter, void *writer_arg,
+		uintptr_t base, off_t *nodepos, off_t *datapos,
 		uintptr_t *where, isc_uint64_t *crc)
 {
-	uintptr_t left = 0, right = 0, down = 0, data = 0;
-	off_t location = 0, offset_adjust;
+	uintptr_t left = 0, right = 0, down = 0, data = 0, self;
+	off_t location, end;
 	isc_result_t result;
 
 	if (node == NULL) {
-		if (where != NULL)
-			*where = 0;
+		*where = 0;
 		return (ISC_R_SUCCESS);
 	}
 
-	/* Reserve space for current node. */
-	CHECK(isc_stdio_tell(file, &location));
-	location = dns_rbt_serialize_align(location);
-	CHECK(isc_stdio_seek(file, location, SEEK_SET));
-
-	offset_adjust = dns_rbt_serialize_align(location + NODE_SIZE(node));
-	CHECK(isc_stdio_seek(file, offset_adjust, SEEK_SET));
+	/*
+	 * Reserve space for current node.  Nodes are laid out from
+	 * '*nodepos', and their data from '*datapos', which is past the
+	 * last node.
+	 */
+	location = *nodepos;
+	*nodepos = dns_rbt_serialize_align(location + NODE_SIZE(node));
+	self = base + (uintptr_t) location;
 
 	/*
 	 * Serialize the rest of the tree.
@@ -644,22 +623,27 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 	 * WARNING: A change in the order (from left, right, down)
 	 * will break the way the crc hash is computed.
 	 */
-	CHECK(serialize_nodes(file, getleft(node, NULL), location,
-			      datawriter, writer_arg, &left, crc));
-	CHECK(serialize_nodes(file, getright(node, NULL), location,
-			      datawriter, writer_arg, &right, crc));
-	CHECK(serialize_nodes(file, getdown(node, NULL), location,
-			      datawriter, writer_arg, &down, crc));
+	CHECK(serialize_nodes(file, LEFT(node), self, datawriter, writer_arg,
+			      base, nodepos, datapos, &left, crc));
+	CHECK(serialize_nodes(file, RIGHT(node), self, datawriter, writer_arg,
+			      base, nodepos, datapos, &right, crc));
+	CHECK(serialize_nodes(file, DOWN(node), self, datawriter, writer_arg,
+			      base, nodepos, datapos, &down, crc));
 
 	if (node->data != NULL) {
-		off_t ret;
+		CHECK(isc_stdio_seek(file, *datapos, SEEK_SET));
+		CHECK(datawriter(file, node->data, writer_arg, (void *) base,
+				 (dns_rbtnode_t *) self, crc));
+		CHECK(isc_stdio_tell(file, &end));
 
-		CHECK(isc_stdio_tell(file, &ret));
-		ret = dns_rbt_serialize_align(ret);
-		CHECK(isc_stdio_seek(file, ret, SEEK_SET));
-		data = ret;
-
-		datawriter(file, node->data, writer_arg, crc);
+		/*
+		 * The writer leaves out anything not in the version being
+		 * written, which may be everything.
+		 */
+		if (end != *datapos) {
+			data = base + (uintptr_t) *datapos;
+			*datapos = dns_rbt_serialize_align(end);
+		}
 	}
 
 	/* Seek back to reserved space. */
@@ -668,11 +652,7 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 	/* Serialize the current node. */
 	CHECK(serialize_node(file, node, left, right, down, parent, data, crc));
 
-	/* Ensure we are always at the end of the file. */
-	CHECK(isc_stdio_seek(file, 0, SEEK_END));
-
-	if (where != NULL)
-		*where = (uintptr_t) location;
+	*where = self;
 
  cleanup:
 	return (result);
@@ -688,13 +668,48 @@ dns_rbt_serialize_align(off_t target) {
 		return (target + 8 - offset);
 }
 
+/*
+ * Adapts a dns_rbtdatawriter_t for dns_rbt_serialize_tree2().
+ */
+typedef struct {
+	dns_rbtdatawriter_t	datawriter;
+	void *			writer_arg;
+} serialize_writer_t;
+
+static isc_result_t
+serialize_writer(FILE *file, unsigned char *data, void *arg, void *base,
+		 dns_rbtnode_t *node, isc_uint64_t *crc)
+{
+	serialize_writer_t *writer = arg;
+
+	UNUSED(base);
+	UNUSED(node);
+
+	return ((writer->datawriter)(file, data, writer->writer_arg, crc));
+}
+
 isc_result_t
 dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 		       dns_rbtdatawriter_t datawriter,
 		       void *writer_arg, off_t *offset)
+{
+	serialize_writer_t writer;
+
+	writer.datawriter = datawriter;
+	writer.writer_arg = writer_arg;
+
+	return (dns_rbt_serialize_tree2(file, rbt, NULL, serialize_writer,
+					&writer, offset));
+}
+
+isc_result_t
+dns_rbt_serialize_tree2(FILE *file, dns_rbt_t *rbt, void *base,
+			dns_rbtdatawriter2_t datawriter,
+			void *writer_arg, off_t *offset)
 {
 	isc_result_t result;
-	off_t header_position, node_position, end_position;
+	off_t header_position, node_position, data_position;
+	uintptr_t root;
 	isc_uint64_t crc;
 
 	REQUIRE(file != NULL);
@@ -708,13 +723,15 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 	/* Write dummy header */
 	CHECK(dns_rbt_zero_header(file));
 
-	/* Serialize nodes */
+	/* Serialize nodes, followed by their data */
 	CHECK(isc_stdio_tell(file, &node_position));
-	CHECK(serialize_nodes(file, rbt->root, 0, datawriter,
-			      writer_arg, NULL, &crc));
+	node_position = dns_rbt_serialize_align(node_position);
+	data_position = node_position + serialize_size(rbt->root);
+	CHECK(serialize_nodes(file, rbt->root, 0, datawriter, writer_arg,
+			      (uintptr_t) base, &node_position,
+			      &data_position, &root, &crc));
 
-	CHECK(isc_stdio_tell(file, &end_position));
-	if (node_position == end_position) {
+	if (root == 0) {
 		CHECK(isc_stdio_seek(file, header_position, SEEK_SET));
 		*offset = 0;
 		return (ISC_R_SUCCESS);
@@ -727,7 +744,8 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 
 	/* Serialize header */
 	CHECK(isc_stdio_seek(file, header_position, SEEK_SET));
-	CHECK(write_header(file, rbt, HEADER_LENGTH, crc));
+	CHECK(write_header(file, rbt, HEADER_LENGTH,
+			   (isc_uint64_t) (uintptr_t) base, crc));
 
 	/* Ensure we are always at the end of the file. */
 	CHECK(isc_stdio_seek(file, 0, SEEK_END));
@@ -744,9 +762,24 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 	} \
 } while(0);
 
+/*
+ * Return the address in the file mapped at 'base' of 'ptr', which was
+ * written for the file being mapped at 'written', or NULL if it would
+ * not be within the first 'limit' bytes of the file.
+ */
+static inline void *
+relocate(void *ptr, uintptr_t written, void *base, size_t limit) {
+	uintptr_t offset = (uintptr_t) ptr - written;
+
+	if (offset > limit)
+		return (NULL);
+
+	return ((char *) base + offset);
+}
+
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
-	dns_name_t *name, dns_rbtdatafixer_t datafixer,
+treefix(dns_rbt_t *rbt, void *base, size_t filesize, uintptr_t written,
+	dns_rbtnode_t *n, dns_name_t *name, dns_rbtdatafixer_t datafixer,
 	void *fixer_arg, isc_uint64_t *crc)
 {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -778,60 +811,54 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 	/* memorize header contents prior to fixup */
 	memmove(&header, n, sizeof(header));
 
-	if (n->left_is_relative) {
-		CONFIRM(n->left <= (dns_rbtnode_t *) nodemax);
-		n->left = getleft(n, rbt->mmap_location);
-		n->left_is_relative = 0;
+	/*
+	 * If the file is mapped where it was written for, relocate()
+	 * returns each pointer unchanged.
+	 */
+	if (n->left != NULL) {
+		n->left = relocate(n->left, written, base, nodemax);
+		CONFIRM(n->left != NULL);
 		CONFIRM(DNS_RBTNODE_VALID(n->left));
-	} else
-		CONFIRM(n->left == NULL);
+	}
 
-	if (n->right_is_relative) {
-		CONFIRM(n->right <= (dns_rbtnode_t *) nodemax);
-		n->right = getright(n, rbt->mmap_location);
-		n->right_is_relative = 0;
+	if (n->right != NULL) {
+		n->right = relocate(n->right, written, base, nodemax);
+		CONFIRM(n->right != NULL);
 		CONFIRM(DNS_RBTNODE_VALID(n->right));
-	} else
-		CONFIRM(n->right == NULL);
+	}
 
-	if (n->down_is_relative) {
-		CONFIRM(n->down <= (dns_rbtnode_t *) nodemax);
-		n->down = getdown(n, rbt->mmap_location);
-		n->down_is_relative = 0;
+	if (n->down != NULL) {
+		n->down = relocate(n->down, written, base, nodemax);
+		CONFIRM(n->down != NULL);
 		CONFIRM(n->down > (dns_rbtnode_t *) n);
 		CONFIRM(DNS_RBTNODE_VALID(n->down));
-	} else
-		CONFIRM(n->down == NULL);
+	}
 
-	if (n->parent_is_relative) {
-		CONFIRM(n->parent <= (dns_rbtnode_t *) nodemax);
-		n->parent = getparent(n, rbt->mmap_location);
-		n->parent_is_relative = 0;
+	if (n->parent != NULL) {
+		n->parent = relocate(n->parent, written, base, nodemax);
+		CONFIRM(n->parent != NULL);
 		CONFIRM(n->parent < (dns_rbtnode_t *) n);
 		CONFIRM(DNS_RBTNODE_VALID(n->parent));
-	} else
-		CONFIRM(n->parent == NULL);
+	}
 
-	if (n->data_is_relative) {
-		CONFIRM(n->data <= (void *) filesize);
-		n->data = getdata(n, rbt->mmap_location);
-		n->data_is_relative = 0;
+	if (n->data != NULL) {
+		n->data = relocate(n->data, written, base, filesize);
+		CONFIRM(n->data != NULL);
 		CONFIRM(n->data > (void *) n);
-	} else
-		CONFIRM(n->data == NULL);
+	}
 
 	hash_node(rbt, n, fullname);
 
 	/* a change in the order (from left, right, down) will break hashing*/
 	if (n->left != NULL)
-		CHECK(treefix(rbt, base, filesize, n->left, name,
+		CHECK(treefix(rbt, base, filesize, written, n->left, name,
 			      datafixer, fixer_arg, crc));
 	if (n->right != NULL)
-		CHECK(treefix(rbt, base, filesize, n->right, name,
+		CHECK(treefix(rbt, base, filesize, written, n->right, name,
 			      datafixer, fixer_arg, crc));
 	if (n->down != NULL)
-		CHECK(treefix(rbt, base, filesize, n->down, fullname,
-			      datafixer, fixer_arg, crc));
+		CHECK(treefix(rbt, base, filesize, written, n->down,
+			      fullname, datafixer, fixer_arg, crc));
 
 	if (datafixer != NULL && n->data != NULL)
 		CHECK(datafixer(n, base, filesize, fixer_arg, crc));
@@ -901,6 +928,10 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		result = ISC_R_INVALIDFILE;
 		goto cleanup;
 	}
+	if (header->base != (uintptr_t) header->base) {
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
 
 	/* Copy other data items from the header into our rbt. */
 	rbt->root = (dns_rbtnode_t *)((char *)base_address +
@@ -910,10 +941,10 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		result = ISC_R_INVALIDFILE;
 		goto cleanup;
 	}
-	rehash(rbt, header->nodecount);
+	CHECK(rehash(rbt, header->nodecount));
 
-	CHECK(treefix(rbt, base_address, filesize, rbt->root,
-		      dns_rootname, datafixer, fixer_arg, &crc));
+	CHECK(treefix(rbt, base_address, filesize, (uintptr_t) header->base,
+		      rbt->root, dns_rootname, datafixer, fixer_arg, &crc));
 
 	isc_crc64_final(&crc);
 #ifdef DEBUG
@@ -977,6 +1008,9 @@ dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter,
 	rbt->nodecount = 0;
 	rbt->hashtable = NULL;
 	rbt->hashsize = 0;
+	rbt->oldhashtable = NULL;
+	rbt->oldhashsize = 0;
+	rbt->hashiter = 0;
 	rbt->mmap_location = NULL;
 
 #ifdef DNS_RBT_USEHASH
@@ -1021,6 +1055,9 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum) {
 	if (rbt->hashtable != NULL)
 		isc_mem_put(rbt->mctx, rbt->hashtable,
 			    rbt->hashsize * sizeof(dns_rbtnode_t *));
+	if (rbt->oldhashtable != NULL)
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
 
 	rbt->magic = 0;
 
@@ -1045,6 +1082,21 @@ dns_rbt_hashsize(dns_rbt_t *rbt) {
 	return (rbt->hashsize);
 }
 
+isc_result_t
+dns_rbt_presize(dns_rbt_t *rbt, unsigned int count) {
+
+	REQUIRE(VALID_RBT(rbt));
+
+#ifdef DNS_RBT_USEHASH
+	if (count < rbt->hashsize * 3)
+		return (ISC_R_SUCCESS);
+	return (rehash(rbt, count));
+#else
+	UNUSED(count);
+	return (ISC_R_SUCCESS);
+#endif
+}
+
 static inline isc_result_t
 chain_name(dns_rbtnodechain_t *chain, dns_name_t *name,
 	   isc_boolean_t include_chain_end)
@@ -1585,30 +1637,18 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 
 			/*
 			 * Walk all the nodes in the hash bucket pointed
-			 * by the computed hash value.
+			 * by the computed hash value, and if a rehash is
+			 * in progress and the bucket has not been moved
+			 * yet, in its old bucket too.
 			 */
-			for (hnode = rbt->hashtable[hash % rbt->hashsize];
-			     hnode != NULL;
-			     hnode = hnode->hashnext)
+			hnode = hash_find(rbt->hashtable[hash % rbt->hashsize],
+					  hash, up_current, &hash_name);
+			if (hnode == NULL && rbt->oldhashtable != NULL &&
+			    hash % rbt->oldhashsize >= rbt->hashiter)
 			{
-				dns_name_t hnode_name;
-
-				if (ISC_LIKELY(hash != HASHVAL(hnode)))
-					continue;
-				/*
-				 * This checks that the hashed label
-				 * sequence being looked up is at the
-				 * same tree level, so that we don't
-				 * match a labelsequence from some other
-				 * subdomain.
-				 */
-				if (ISC_LIKELY(get_upper_node(hnode) != up_current))
-					continue;
-
-				dns_name_init(&hnode_name, NULL);
-				NODENAME(hnode, &hnode_name);
-				if (ISC_LIKELY(dns_name_equal(&hnode_name, &hash_name)))
-					break;
+				hnode = hash_find(rbt->oldhashtable[hash %
+							rbt->oldhashsize],
+						  hash, up_current, &hash_name);
 			}
 
 			if (hnode != NULL) {
@@ -2284,6 +2324,20 @@ hash_add_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name) {
 
 	HASHVAL(node) = dns_name_fullhash(name, ISC_FALSE);
 
+	/*
+	 * While a rehash is in progress, a node whose old bucket has not
+	 * been moved yet goes into that bucket, so that unhash_node() can
+	 * tell from the hash value alone which table the node is in.
+	 */
+	if (rbt->oldhashtable != NULL &&
+	    HASHVAL(node) % rbt->oldhashsize >= rbt->hashiter)
+	{
+		hash = HASHVAL(node) % rbt->oldhashsize;
+		HASHNEXT(node) = rbt->oldhashtable[hash];
+		rbt->oldhashtable[hash] = node;
+		return;
+	}
+
 	hash = HASHVAL(node) % rbt->hashsize;
 	HASHNEXT(node) = rbt->hashtable[hash];
 
@@ -2306,34 +2360,20 @@ inithash(dns_rbt_t *rbt) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Move up to 'count' buckets of the old hash table into the current one,
+ * freeing the old table once it is empty.
+ */
 static void
-rehash(dns_rbt_t *rbt, unsigned int newcount) {
-	unsigned int oldsize;
-	dns_rbtnode_t **oldtable;
+rehash_step(dns_rbt_t *rbt, size_t count) {
 	dns_rbtnode_t *node;
 	dns_rbtnode_t *nextnode;
 	unsigned int hash;
-	unsigned int i;
 
-	oldsize = (unsigned int)rbt->hashsize;
-	oldtable = rbt->hashtable;
-	do {
-		INSIST((rbt->hashsize * 2 + 1) > rbt->hashsize);
-		rbt->hashsize = rbt->hashsize * 2 + 1;
-	} while (newcount >= (rbt->hashsize * 3));
-	rbt->hashtable = isc_mem_get(rbt->mctx,
-				     rbt->hashsize * sizeof(dns_rbtnode_t *));
-	if (rbt->hashtable == NULL) {
-		rbt->hashtable = oldtable;
-		rbt->hashsize = oldsize;
-		return;
-	}
-
-	for (i = 0; i < rbt->hashsize; i++)
-		rbt->hashtable[i] = NULL;
-
-	for (i = 0; i < oldsize; i++) {
-		for (node = oldtable[i]; node != NULL; node = nextnode) {
+	while (count-- > 0 && rbt->hashiter < rbt->oldhashsize) {
+		node = rbt->oldhashtable[rbt->hashiter];
+		rbt->oldhashtable[rbt->hashiter++] = NULL;
+		for (; node != NULL; node = nextnode) {
 			hash = HASHVAL(node) % rbt->hashsize;
 			nextnode = HASHNEXT(node);
 			HASHNEXT(node) = rbt->hashtable[hash];
@@ -2341,15 +2381,63 @@ rehash(dns_rbt_t *rbt, unsigned int newcount) {
 		}
 	}
 
-	isc_mem_put(rbt->mctx, oldtable, oldsize * sizeof(dns_rbtnode_t *));
+	if (rbt->hashiter == rbt->oldhashsize) {
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
+		rbt->oldhashtable = NULL;
+		rbt->oldhashsize = 0;
+		rbt->hashiter = 0;
+	}
+}
+
+/*
+ * Grow the hash table so that it holds 'newcount' nodes at less than
+ * three per bucket.  The nodes are moved over incrementally by
+ * rehash_step(); when the tree is empty there is nothing to move, so
+ * the old table is released at once.
+ */
+static isc_result_t
+rehash(dns_rbt_t *rbt, unsigned int newcount) {
+	size_t newsize;
+	dns_rbtnode_t **newtable;
+
+	/*
+	 * Finish any rehash still in progress, so that there are never
+	 * more than two tables.
+	 */
+	if (rbt->oldhashtable != NULL)
+		rehash_step(rbt, rbt->oldhashsize);
+
+	newsize = rbt->hashsize;
+	do {
+		INSIST((newsize * 2 + 1) > newsize);
+		newsize = newsize * 2 + 1;
+	} while (newcount >= (newsize * 3));
+	newtable = isc_mem_get(rbt->mctx, newsize * sizeof(dns_rbtnode_t *));
+	if (newtable == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(newtable, 0, newsize * sizeof(dns_rbtnode_t *));
+
+	rbt->oldhashtable = rbt->hashtable;
+	rbt->oldhashsize = rbt->hashsize;
+	rbt->hashiter = 0;
+	rbt->hashtable = newtable;
+	rbt->hashsize = newsize;
+
+	rehash_step(rbt, (rbt->nodecount == 0) ? rbt->oldhashsize
+					       : RBT_REHASH_STEP);
+
+	return (ISC_R_SUCCESS);
 }
 
 static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name) {
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
+	if (rbt->oldhashtable != NULL)
+		rehash_step(rbt, RBT_REHASH_STEP);
 	if (rbt->nodecount >= (rbt->hashsize * 3))
-		rehash(rbt, rbt->nodecount);
+		(void)rehash(rbt, rbt->nodecount);
 
 	hash_add_node(rbt, node, name);
 }
@@ -2357,15 +2445,27 @@ hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, dns_name_t *name) {
 static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 	unsigned int bucket;
+	dns_rbtnode_t **table;
 	dns_rbtnode_t *bucket_node;
 
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
-	bucket = HASHVAL(node) % rbt->hashsize;
-	bucket_node = rbt->hashtable[bucket];
+	if (rbt->oldhashtable != NULL)
+		rehash_step(rbt, RBT_REHASH_STEP);
+
+	if (rbt->oldhashtable != NULL &&
+	    HASHVAL(node) % rbt->oldhashsize >= rbt->hashiter)
+	{
+		table = rbt->oldhashtable;
+		bucket = HASHVAL(node) % rbt->oldhashsize;
+	} else {
+		table = rbt->hashtable;
+		bucket = HASHVAL(node) % rbt->hashsize;
+	}
+	bucket_node = table[bucket];
 
 	if (bucket_node == node) {
-		rbt->hashtable[bucket] = HASHNEXT(node);
+		table[bucket] = HASHNEXT(node);
 	} else {
 		while (HASHNEXT(bucket_node) != node) {
 			INSIST(HASHNEXT(bucket_node) != NULL);
@@ -2374,6 +2474,36 @@ unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 		HASHNEXT(bucket_node) = HASHNEXT(node);
 	}
 }
+
+/*
+ * Search the hash chain starting at 'hnode' for the node at the tree
+ * level below 'up' whose label sequence is 'name'.
+ */
+static inline dns_rbtnode_t *
+hash_find(dns_rbtnode_t *hnode, unsigned int hash, dns_rbtnode_t *up,
+	  dns_name_t *name)
+{
+	for (; hnode != NULL; hnode = hnode->hashnext) {
+		dns_name_t hnode_name;
+
+		if (ISC_LIKELY(hash != HASHVAL(hnode)))
+			continue;
+		/*
+		 * This checks that the hashed label sequence being
+		 * looked up is at the same tree level, so that we don't
+		 * match a labelsequence from some other subdomain.
+		 */
+		if (ISC_LIKELY(get_upper_node(hnode) != up))
+			continue;
+
+		dns_name_init(&hnode_name, NULL);
+		NODENAME(hnode, &hnode_name);
+		if (ISC_LIKELY(dns_name_equal(&hnode_name, name)))
+			break;
+	}
+
+	return (hnode);
+}
 #endif /* DNS_RBT_USEHASH */
 
 static inline void
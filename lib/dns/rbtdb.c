@@ -28,6 +28,7 @@
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/parseint.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/random.h>
@@ -38,6 +39,7 @@
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -111,6 +113,7 @@ struct rbtdb_file_header {
 	isc_uint64_t tree;
 	isc_uint64_t nsec;
 	isc_uint64_t nsec3;
+	isc_uint64_t base;		/* address the file was written for */
 
 	char version2[32];  		/* repeated; must match version1 */
 };
@@ -187,6 +190,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define detachnode detachnode64
 #define dump dump64
 #define endload endload64
+#define expire expire64
 #define expire_header expire_header64
 #define expirenode expirenode64
 #define find_closest_nsec find_closest_nsec64
@@ -202,6 +206,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define free_rbtdb_callback free_rbtdb_callback64
 #define free_rdataset free_rdataset64
 #define getnsec3parameters getnsec3parameters64
+#define getservestalettl getservestalettl64
 #define getsize getsize64
 #define getoriginnode getoriginnode64
 #define getrrsetstats getrrsetstats64
@@ -221,6 +226,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define nodecount nodecount64
 #define nodefullname nodefullname64
 #define overmem overmem64
+#define presize presize64
 #define previous_closest_nsec previous_closest_nsec64
 #define printnode printnode64
 #define prune_tree prune_tree64
@@ -247,6 +253,8 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define rdatasetiter_first rdatasetiter_first64
 #define rdatasetiter_next rdatasetiter_next64
 #define reactivate_node reactivate_node64
+#define reclaim_dead_nodes reclaim_dead_nodes64
+#define release_node_lock release_node_lock64
 #define resign_delete resign_delete64
 #define resign_insert resign_insert64
 #define resign_sooner resign_sooner64
@@ -257,6 +265,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define set_index set_index64
 #define set_ttl set_ttl64
 #define setcachestats setcachestats64
+#define setservestalettl setservestalettl64
 #define setownercase setownercase64
 #define setsigningtime setsigningtime64
 #define settask settask64
@@ -372,13 +381,65 @@ typedef isc_mutex_t nodelock_t;
 #define NODE_WEAKDOWNGRADE(l)   ((void)0)
 #endif
 
+/*%
+ * The tree lock is taken for reading by every lookup, and even a read lock
+ * writes to the lock word, so with one lock all readers contend for one
+ * cache line.  Where there is an efficient rwlock we therefore split it
+ * into TREE_LOCK_SHARDS locks, each padded to its own cache lines.  A
+ * reader locks only the shard assigned to its thread and remembers which
+ * one it took, since it may unlock from another thread (e.g. a paused
+ * iterator); a writer locks every shard in order.
+ *
+ * A read lock on one shard cannot be upgraded to exclusive access, so
+ * tree_tryupgrade() fails when there is more than one shard, and nodes
+ * that would have been freed go to the dead node list instead.  The first
+ * node put on an empty list sends reclaim_dead_nodes() to the database
+ * task, which takes the tree write lock and frees them.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_RWLOCK_USEATOMIC)
+#define TREE_LOCK_SHARDS	16
+#else
+#define TREE_LOCK_SHARDS	1
+#endif
+#define TREE_LOCK_LINESIZE	64
+
+typedef struct {
+	isc_rwlock_t		lock;
+	char			pad[(TREE_LOCK_LINESIZE -
+				     sizeof(isc_rwlock_t) %
+				     TREE_LOCK_LINESIZE) %
+				    TREE_LOCK_LINESIZE];
+} treelock_t;
+
+/*
+ * The shards are allocated with room to start them on a cache line
+ * boundary; isc_mem_get() does not align that far.
+ */
+#define TREE_LOCK_ALLOCSIZE	(TREE_LOCK_SHARDS * sizeof(treelock_t) + \
+				 TREE_LOCK_LINESIZE)
+
+#if TREE_LOCK_SHARDS > 1
+static isc_once_t		treelock_once = ISC_ONCE_INIT;
+static isc_thread_key_t		treelock_key;
+static isc_mutex_t		treelock_mutex;
+static unsigned int		treelock_next;	/* locked by treelock_mutex */
+
+static void
+treelock_initialize(void) {
+	RUNTIME_CHECK(isc_mutex_init(&treelock_mutex) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_thread_key_create(&treelock_key, NULL) == 0);
+}
+#endif
+
 /*%
  * Whether to rate-limit updating the LRU to avoid possible thread contention.
- * Our performance measurement has shown the cost is marginal, so it's defined
- * to be 0 by default either with or without threads.
+ * Every update needs the node write lock, which readers of a popular name
+ * then queue behind, so this is on by default.  Entries that are used for
+ * the first time since they were added are always promoted; see
+ * need_headerupdate().
  */
 #ifndef DNS_RBTDB_LIMITLRUUPDATE
-#define DNS_RBTDB_LIMITLRUUPDATE 0
+#define DNS_RBTDB_LIMITLRUUPDATE 1
 #endif
 
 /*
@@ -460,6 +521,22 @@ typedef struct rdatasetheader {
 } rdatasetheader_t;
 
 typedef ISC_LIST(rdatasetheader_t)      rdatasetheaderlist_t;
+
+/*%
+ * The LRU lists of a cache bucket, a segmented LRU: entries start on the
+ * probationary 'cold' list and move to the protected 'hot' list when they
+ * are used again.  Entries are purged from the cold list first, so a
+ * burst of names that are used only once cannot push out the names
+ * that are used all the time.  The hot list may hold at most three
+ * quarters of the bucket; the least recently used hot entries move back
+ * to the cold list to make room.
+ */
+typedef struct {
+	rdatasetheaderlist_t		cold;
+	rdatasetheaderlist_t		hot;
+	unsigned int			ncold;
+	unsigned int			nhot;
+} rbtdb_lru_t;
 typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 
 #define RDATASET_ATTR_NONEXISTENT       0x0001
@@ -474,6 +551,7 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 #define RDATASET_ATTR_PREFETCH          0x0200
 #define RDATASET_ATTR_CASESET           0x0400
 #define RDATASET_ATTR_ZEROTTL           0x0800
+#define RDATASET_ATTR_HOT               0x1000
 
 typedef struct acache_cbarg {
 	dns_rdatasetadditional_t        type;
@@ -520,6 +598,8 @@ struct acachectl {
 	(((header)->attributes & RDATASET_ATTR_PREFETCH) != 0)
 #define CASESET(header) \
 	(((header)->attributes & RDATASET_ATTR_CASESET) != 0)
+#define HOT(header) \
+	(((header)->attributes & RDATASET_ATTR_HOT) != 0)
 #define ZEROTTL(header) \
 	(((header)->attributes & RDATASET_ATTR_ZEROTTL) != 0)
 
@@ -527,6 +607,18 @@ struct acachectl {
 	(((header)->rdh_ttl > (now)) || \
 	 ((header)->rdh_ttl == (now) && ZEROTTL(header)))
 
+/*%
+ * A cache keeps expired data for serve_stale_ttl seconds, so that it
+ * can be used when a fresh answer cannot be had.  Data is not purged
+ * until that window and RBTDB_VIRTUAL have both passed.
+ */
+#define KEEPSTALE(rbtdb) \
+	((rbtdb)->serve_stale_ttl > 0)
+#define STALEOK(rbtdb, header, now) \
+	((header)->rdh_ttl + (rbtdb)->serve_stale_ttl > (now))
+#define EXPIRED(rbtdb, header, now) \
+	((header)->rdh_ttl + (rbtdb)->serve_stale_ttl < (now) - RBTDB_VIRTUAL)
+
 #define DEFAULT_NODE_LOCK_COUNT         7       /*%< Should be prime. */
 
 /*%
@@ -536,7 +628,8 @@ struct acachectl {
  * LRU purge algorithm won't work well (entries tend to be purged prematurely).
  * The default value should work well for most environments, but this can
  * also be configurable at compilation time via the
- * DNS_RBTDB_CACHE_NODE_LOCK_COUNT variable.  This value must be larger than
+ * DNS_RBTDB_CACHE_NODE_LOCK_COUNT variable, or for each database by passing
+ * the count as argv[1] to dns_db_create().  This value must be larger than
  * 1 due to the assumption of overmem_purge().
  */
 #ifdef DNS_RBTDB_CACHE_NODE_LOCK_COUNT
@@ -555,6 +648,27 @@ typedef struct {
 	isc_refcount_t                  references;
 	/* Locked by lock. */
 	isc_boolean_t                   exiting;
+	isc_boolean_t                   reclaiming;
+} rbtdb_nodelock_data_t;
+
+/*%
+ * The same, padded to a multiple of the cache line size so that threads
+ * working in different buckets do not share cache lines.  Like the tree
+ * lock shards, the array is allocated with room to start it on a line.
+ */
+#define NODE_LOCK_LINESIZE	TREE_LOCK_LINESIZE
+#define NODE_LOCK_ALLOCSIZE(n)	((n) * sizeof(rbtdb_nodelock_t) + \
+				 NODE_LOCK_LINESIZE)
+
+typedef struct {
+	nodelock_t                      lock;
+	isc_refcount_t                  references;
+	isc_boolean_t                   exiting;
+	isc_boolean_t                   reclaiming;
+	char				pad[(NODE_LOCK_LINESIZE -
+					     sizeof(rbtdb_nodelock_data_t) %
+					     NODE_LOCK_LINESIZE) %
+					    NODE_LOCK_LINESIZE];
 } rbtdb_nodelock_t;
 
 typedef struct rbtdb_changed {
@@ -624,11 +738,16 @@ struct dns_rbtdb {
 #else
 	isc_mutex_t                     lock;
 #endif
-	/* Locks the tree structure (prevents nodes appearing/disappearing) */
-	isc_rwlock_t                    tree_lock;
+	/*
+	 * Locks the tree structure (prevents nodes appearing/disappearing).
+	 * Use the tree_*lock() functions.
+	 */
+	treelock_t *			tree_lock;
+	void *				tree_lockbase;
 	/* Locks for individual tree nodes */
 	unsigned int                    node_lock_count;
 	rbtdb_nodelock_t *              node_locks;
+	void *				node_lockbase;
 	dns_rbtnode_t *                 origin_node;
 	dns_stats_t *			rrsetstats; /* cache DB only */
 	isc_stats_t *			cachestats; /* cache DB only */
@@ -647,11 +766,11 @@ struct dns_rbtdb {
 	dns_dbnode_t                    *nsnode;
 
 	/*
-	 * This is a linked list used to implement the LRU cache.  There will
-	 * be node_lock_count linked lists here.  Nodes in bucket 1 will be
-	 * placed on the linked list rdatasets[1].
+	 * These are the linked lists used to implement the LRU cache.  There
+	 * will be node_lock_count pairs of lists here.  Nodes in bucket 1
+	 * will be placed on the lists in lru[1].
 	 */
-	rdatasetheaderlist_t            *rdatasets;
+	rbtdb_lru_t                     *lru;
 
 	/*%
 	 * Temporary storage for stale cache nodes and dynamically deleted
@@ -684,6 +803,8 @@ struct dns_rbtdb {
 
 	/* Unlocked */
 	unsigned int                    quantum;
+	isc_boolean_t			sweeping;	/* set once */
+	dns_ttl_t			serve_stale_ttl;
 };
 
 #define RBTDB_ATTR_LOADED               0x01
@@ -714,6 +835,7 @@ typedef struct {
 typedef struct {
 	dns_rbtdb_t *           rbtdb;
 	isc_stdtime_t           now;
+	uintptr_t               written;	/* map file base address */
 } rbtdb_load_t;
 
 static void delete_callback(void *data, void *arg);
@@ -755,6 +877,8 @@ static isc_result_t rdataset_putadditional(dns_acache_t *acache,
 					   dns_rdataset_t *rdataset,
 					   dns_rdatasetadditional_t type,
 					   dns_rdatatype_t qtype);
+static inline void lru_insert(dns_rbtdb_t *rbtdb, rdatasetheader_t *header);
+static inline void lru_unlink(dns_rbtdb_t *rbtdb, rdatasetheader_t *header);
 static inline isc_boolean_t need_headerupdate(rdatasetheader_t *header,
 					      isc_stdtime_t now);
 static void update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
@@ -768,6 +892,7 @@ static isc_result_t resign_insert(dns_rbtdb_t *rbtdb, int idx,
 static void resign_delete(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
 			  rdatasetheader_t *header);
 static void prune_tree(isc_task_t *task, isc_event_t *event);
+static void reclaim_dead_nodes(isc_task_t *task, isc_event_t *event);
 static void rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust);
 static void rdataset_expire(dns_rdataset_t *rdataset);
 static void rdataset_clearprefetch(dns_rdataset_t *rdataset);
@@ -872,6 +997,7 @@ typedef struct rbtdb_dbiterator {
 	isc_boolean_t                   paused;
 	isc_boolean_t                   new_origin;
 	isc_rwlocktype_t                tree_locked;
+	unsigned int			tree_shard;
 	isc_result_t                    result;
 	dns_fixedname_t                 name;
 	dns_fixedname_t                 origin;
@@ -961,6 +1087,141 @@ hexdump(const char *desc, unsigned char *data, size_t size) {
 }
 #endif
 
+/*
+ * Tree lock routines
+ */
+
+static isc_result_t
+tree_initlock(isc_mem_t *mctx, dns_rbtdb_t *rbtdb) {
+	isc_result_t result;
+	size_t misalign;
+	unsigned int i;
+
+#if TREE_LOCK_SHARDS > 1
+	RUNTIME_CHECK(isc_once_do(&treelock_once, treelock_initialize)
+		      == ISC_R_SUCCESS);
+#endif
+
+	rbtdb->tree_lockbase = isc_mem_get(mctx, TREE_LOCK_ALLOCSIZE);
+	if (rbtdb->tree_lockbase == NULL)
+		return (ISC_R_NOMEMORY);
+	misalign = (unsigned long)rbtdb->tree_lockbase &
+		   (TREE_LOCK_LINESIZE - 1);
+	rbtdb->tree_lock = (treelock_t *)
+		((char *)rbtdb->tree_lockbase +
+		 (TREE_LOCK_LINESIZE - misalign) % TREE_LOCK_LINESIZE);
+
+	for (i = 0; i < TREE_LOCK_SHARDS; i++) {
+		result = isc_rwlock_init(&rbtdb->tree_lock[i].lock, 0, 0);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				isc_rwlock_destroy(&rbtdb->tree_lock[i].lock);
+			isc_mem_put(mctx, rbtdb->tree_lockbase,
+				    TREE_LOCK_ALLOCSIZE);
+			rbtdb->tree_lockbase = NULL;
+			rbtdb->tree_lock = NULL;
+			return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+tree_destroylock(isc_mem_t *mctx, dns_rbtdb_t *rbtdb) {
+	unsigned int i;
+
+	for (i = 0; i < TREE_LOCK_SHARDS; i++)
+		isc_rwlock_destroy(&rbtdb->tree_lock[i].lock);
+	isc_mem_put(mctx, rbtdb->tree_lockbase, TREE_LOCK_ALLOCSIZE);
+	rbtdb->tree_lockbase = NULL;
+	rbtdb->tree_lock = NULL;
+}
+
+/*%
+ * Lock the tree for reading, returning the shard to pass to
+ * tree_rdunlock().
+ */
+static inline unsigned int
+tree_rdlock(dns_rbtdb_t *rbtdb) {
+	unsigned int shard = 0;
+#if TREE_LOCK_SHARDS > 1
+	void *value;
+
+	value = isc_thread_key_getspecific(treelock_key);
+	if (value == NULL) {
+		LOCK(&treelock_mutex);
+		shard = treelock_next++ % TREE_LOCK_SHARDS;
+		UNLOCK(&treelock_mutex);
+		(void)isc_thread_key_setspecific(treelock_key,
+					 (void *)(unsigned long)(shard + 1));
+	} else
+		shard = (unsigned int)((unsigned long)value - 1);
+#endif
+
+	RWLOCK(&rbtdb->tree_lock[shard].lock, isc_rwlocktype_read);
+	return (shard);
+}
+
+static inline void
+tree_rdunlock(dns_rbtdb_t *rbtdb, unsigned int shard) {
+	RWUNLOCK(&rbtdb->tree_lock[shard].lock, isc_rwlocktype_read);
+}
+
+static void
+tree_wrlock(dns_rbtdb_t *rbtdb) {
+	unsigned int i;
+
+	for (i = 0; i < TREE_LOCK_SHARDS; i++)
+		RWLOCK(&rbtdb->tree_lock[i].lock, isc_rwlocktype_write);
+}
+
+static void
+tree_wrunlock(dns_rbtdb_t *rbtdb) {
+	unsigned int i;
+
+	for (i = TREE_LOCK_SHARDS; i-- > 0; )
+		RWUNLOCK(&rbtdb->tree_lock[i].lock, isc_rwlocktype_write);
+}
+
+static isc_result_t
+tree_trywrlock(dns_rbtdb_t *rbtdb) {
+	isc_result_t result;
+	unsigned int i;
+
+	for (i = 0; i < TREE_LOCK_SHARDS; i++) {
+		result = isc_rwlock_trylock(&rbtdb->tree_lock[i].lock,
+					    isc_rwlocktype_write);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				RWUNLOCK(&rbtdb->tree_lock[i].lock,
+					 isc_rwlocktype_write);
+			return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Try to turn the caller's read lock into a write lock.  This is only
+ * possible when the tree lock is not sharded.
+ */
+static inline isc_result_t
+tree_tryupgrade(dns_rbtdb_t *rbtdb) {
+#if TREE_LOCK_SHARDS > 1
+	UNUSED(rbtdb);
+	return (ISC_R_LOCKBUSY);
+#else
+	return (isc_rwlock_tryupgrade(&rbtdb->tree_lock[0].lock));
+#endif
+}
+
+static inline void
+tree_downgrade(dns_rbtdb_t *rbtdb) {
+	INSIST(TREE_LOCK_SHARDS == 1);
+	isc_rwlock_downgrade(&rbtdb->tree_lock[0].lock);
+}
 
 /*
  * DB Routines
@@ -1265,12 +1526,13 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 	/*
 	 * Clean up LRU / re-signing order lists.
 	 */
-	if (rbtdb->rdatasets != NULL) {
-		for (i = 0; i < rbtdb->node_lock_count; i++)
-			INSIST(ISC_LIST_EMPTY(rbtdb->rdatasets[i]));
-		isc_mem_put(rbtdb->common.mctx, rbtdb->rdatasets,
-			    rbtdb->node_lock_count *
-			    sizeof(rdatasetheaderlist_t));
+	if (rbtdb->lru != NULL) {
+		for (i = 0; i < rbtdb->node_lock_count; i++) {
+			INSIST(ISC_LIST_EMPTY(rbtdb->lru[i].cold));
+			INSIST(ISC_LIST_EMPTY(rbtdb->lru[i].hot));
+		}
+		isc_mem_put(rbtdb->common.mctx, rbtdb->lru,
+			    rbtdb->node_lock_count * sizeof(rbtdb_lru_t));
 	}
 	/*
 	 * Clean up dead node buckets.
@@ -1309,9 +1571,9 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 		dns_rpz_detach_rpzs(&rbtdb->rpzs);
 	}
 
-	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
-		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	isc_mem_put(rbtdb->common.mctx, rbtdb->node_lockbase,
+		    NODE_LOCK_ALLOCSIZE(rbtdb->node_lock_count));
+	tree_destroylock(rbtdb->common.mctx, rbtdb);
 	isc_refcount_destroy(&rbtdb->references);
 	if (rbtdb->task != NULL)
 		isc_task_detach(&rbtdb->task);
@@ -1388,6 +1650,33 @@ maybe_free_rbtdb(dns_rbtdb_t *rbtdb) {
 	}
 }
 
+/*
+ * The last reference to a bucket of an exiting database has gone; free
+ * the database if it was the last active bucket.
+ */
+static void
+release_node_lock(dns_rbtdb_t *rbtdb) {
+	isc_boolean_t want_free = ISC_FALSE;
+
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
+	rbtdb->active--;
+	if (rbtdb->active == 0)
+		want_free = ISC_TRUE;
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+	if (want_free) {
+		char buf[DNS_NAME_FORMATSIZE];
+		if (dns_name_dynamic(&rbtdb->common.origin))
+			dns_name_format(&rbtdb->common.origin, buf,
+					sizeof(buf));
+		else
+			strcpy(buf, "<UNKNOWN>");
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_DEBUG(1),
+			      "calling free_rbtdb(%s)", buf);
+		free_rbtdb(rbtdb, ISC_TRUE, NULL);
+	}
+}
+
 static void
 detach(dns_db_t **dbp) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)(*dbp);
@@ -1670,7 +1959,7 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 	idx = rdataset->node->locknum;
 	if (ISC_LINK_LINKED(rdataset, link)) {
 		INSIST(IS_CACHE(rbtdb));
-		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], rdataset, link);
+		lru_unlink(rbtdb, rdataset);
 	}
 
 	if (rdataset->heap_index != 0)
@@ -2220,10 +2509,9 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		 * we only do a trylock.
 		 */
 		if (tlock == isc_rwlocktype_read)
-			result = isc_rwlock_tryupgrade(&rbtdb->tree_lock);
+			result = tree_tryupgrade(rbtdb);
 		else
-			result = isc_rwlock_trylock(&rbtdb->tree_lock,
-						    isc_rwlocktype_write);
+			result = tree_trywrlock(rbtdb);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS ||
 			      result == ISC_R_LOCKBUSY);
 
@@ -2305,6 +2593,30 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		INSIST(node->data == NULL);
 		INSIST(!ISC_LINK_LINKED(node, deadlink));
 		ISC_LIST_APPEND(rbtdb->deadnodes[bucket], node, deadlink);
+
+		/*
+		 * Nothing else is certain to take the tree write lock
+		 * soon, so have the task reclaim the node.  The event
+		 * holds a reference to the bucket rather than to the
+		 * database, which may already be on its way to being
+		 * freed.
+		 */
+		if (!nodelock->reclaiming && !nodelock->exiting &&
+		    rbtdb->task != NULL)
+		{
+			isc_event_t *ev;
+
+			ev = isc_event_allocate(rbtdb->common.mctx, rbtdb,
+						DNS_EVENT_RBTDEADNODES,
+						reclaim_dead_nodes, nodelock,
+						sizeof(isc_event_t));
+			if (ev != NULL) {
+				isc_refcount_increment0(&nodelock->references,
+							NULL);
+				nodelock->reclaiming = ISC_TRUE;
+				isc_task_send(rbtdb->task, &ev);
+			}
+		}
 	}
 
  restore_locks:
@@ -2317,11 +2629,11 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	 */
 	if (tlock == isc_rwlocktype_none)
 		if (write_locked)
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			tree_wrunlock(rbtdb);
 
 	if (tlock == isc_rwlocktype_read)
 		if (write_locked)
-			isc_rwlock_downgrade(&rbtdb->tree_lock);
+			tree_downgrade(rbtdb);
 
 	return (no_reference);
 }
@@ -2344,7 +2656,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 
 	isc_event_free(&event);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrlock(rbtdb);
 	locknum = node->locknum;
 	NODE_LOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
 	do {
@@ -2384,7 +2696,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 		node = parent;
 	} while (node != NULL);
 	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrunlock(rbtdb);
 
 	detach((dns_db_t **)&rbtdb);
 }
@@ -2501,8 +2813,9 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
 	unsigned char *raw;             /* RDATASLAB */
 	unsigned int count, length;
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	unsigned int treeshard;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 	version->havensec3 = ISC_FALSE;
 	node = rbtdb->origin_node;
 	NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
@@ -2579,7 +2892,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
  unlock:
 	NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
 		    isc_rwlocktype_read);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 }
 
 static void
@@ -2589,7 +2902,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	unsigned int locknum;
 	unsigned int refs;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrlock(rbtdb);
 	for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
@@ -2599,7 +2912,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 			    isc_rwlocktype_write);
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrunlock(rbtdb);
 	if (again)
 		isc_task_send(task, &event);
 	else {
@@ -2610,6 +2923,49 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	}
 }
 
+/*
+ * Free the dead nodes of one bucket, on behalf of decrement_reference().
+ * The event holds a reference to the bucket, which is dropped once the
+ * list is empty.
+ */
+static void
+reclaim_dead_nodes(isc_task_t *task, isc_event_t *event) {
+	dns_rbtdb_t *rbtdb = event->ev_sender;
+	rbtdb_nodelock_t *nodelock = event->ev_arg;
+	unsigned int locknum = (unsigned int)(nodelock - rbtdb->node_locks);
+	isc_boolean_t again = ISC_FALSE;
+	isc_boolean_t inactive = ISC_FALSE;
+	unsigned int refs;
+
+	tree_wrlock(rbtdb);
+	NODE_LOCK(&nodelock->lock, isc_rwlocktype_write);
+	/*
+	 * Once the database is exiting, free_rbtdb() will dispose of the
+	 * dead nodes; pruning them now could attach to it again.
+	 */
+	if (!nodelock->exiting) {
+		cleanup_dead_nodes(rbtdb, locknum);
+		again = ISC_TF(!ISC_LIST_EMPTY(rbtdb->deadnodes[locknum]));
+	}
+	if (!again) {
+		nodelock->reclaiming = ISC_FALSE;
+		isc_refcount_decrement(&nodelock->references, &refs);
+		if (refs == 0 && nodelock->exiting)
+			inactive = ISC_TRUE;
+	}
+	NODE_UNLOCK(&nodelock->lock, isc_rwlocktype_write);
+	tree_wrunlock(rbtdb);
+
+	if (again) {
+		isc_task_send(task, &event);
+		return;
+	}
+
+	isc_event_free(&event);
+	if (inactive)
+		release_node_lock(rbtdb);
+}
+
 static void
 closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
@@ -2839,7 +3195,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 			 * expensive, but this event should be rare enough
 			 * to justify the cost.
 			 */
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			tree_wrlock(rbtdb);
 			tlock = isc_rwlocktype_write;
 		}
 
@@ -2875,7 +3231,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 			isc_refcount_increment(&rbtdb->references, NULL);
 			isc_task_send(rbtdb->task, &event);
 		} else
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			tree_wrunlock(rbtdb);
 	}
 
  end:
@@ -2956,15 +3312,16 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 	dns_name_t nodename;
 	isc_result_t result;
 	isc_rwlocktype_t locktype = isc_rwlocktype_read;
+	unsigned int treeshard;
 
 	INSIST(tree == rbtdb->tree || tree == rbtdb->nsec3);
 
 	dns_name_init(&nodename, NULL);
-	RWLOCK(&rbtdb->tree_lock, locktype);
+	treeshard = tree_rdlock(rbtdb);
 	result = dns_rbt_findnode(tree, name, NULL, &node, NULL,
 				  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
 	if (result != ISC_R_SUCCESS) {
-		RWUNLOCK(&rbtdb->tree_lock, locktype);
+		tree_rdunlock(rbtdb, treeshard);
 		if (!create) {
 			if (result == DNS_R_PARTIALMATCH)
 				result = ISC_R_NOTFOUND;
@@ -2975,7 +3332,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 		 * unlocking then relocking.
 		 */
 		locktype = isc_rwlocktype_write;
-		RWLOCK(&rbtdb->tree_lock, locktype);
+		tree_wrlock(rbtdb);
 		node = NULL;
 		result = dns_rbt_addnode(tree, name, &node);
 		if (result == ISC_R_SUCCESS) {
@@ -2992,7 +3349,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 				if (dns_name_iswildcard(name)) {
 					result = add_wildcard_magic(rbtdb, name);
 					if (result != ISC_R_SUCCESS) {
-						RWUNLOCK(&rbtdb->tree_lock, locktype);
+						tree_wrunlock(rbtdb);
 						return (result);
 					}
 				}
@@ -3000,7 +3357,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 			if (tree == rbtdb->nsec3)
 				node->nsec = DNS_RBT_NSEC_NSEC3;
 		} else if (result != ISC_R_EXISTS) {
-			RWUNLOCK(&rbtdb->tree_lock, locktype);
+			tree_wrunlock(rbtdb);
 			return (result);
 		}
 	}
@@ -3038,7 +3395,10 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 		}
 	}
 
-	RWUNLOCK(&rbtdb->tree_lock, locktype);
+	if (locktype == isc_rwlocktype_write)
+		tree_wrunlock(rbtdb);
+	else
+		tree_rdunlock(rbtdb, treeshard);
 
 	*nodep = (dns_dbnode_t *)node;
 
@@ -3237,7 +3597,15 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	rdataset->rdclass = rbtdb->common.rdclass;
 	rdataset->type = RBTDB_RDATATYPE_BASE(header->type);
 	rdataset->covers = RBTDB_RDATATYPE_EXT(header->type);
-	rdataset->ttl = header->rdh_ttl - now;
+	if (IS_CACHE(rbtdb) && !ACTIVE(header, now)) {
+		/*
+		 * Only found with DNS_DBFIND_STALEOK; the TTL is what
+		 * is left of the stale window.
+		 */
+		rdataset->attributes |= DNS_RDATASETATTR_STALE;
+		rdataset->ttl = header->rdh_ttl + rbtdb->serve_stale_ttl - now;
+	} else
+		rdataset->ttl = header->rdh_ttl - now;
 	rdataset->trust = header->trust;
 	if (NEGATIVE(header))
 		rdataset->attributes |= DNS_RDATASETATTR_NEGATIVE;
@@ -4092,6 +4460,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	dns_rbtnodechain_t chain;
 	nodelock_t *lock;
 	dns_rbt_t *tree;
+	unsigned int treeshard;
 
 	search.rbtdb = (dns_rbtdb_t *)db;
 
@@ -4129,7 +4498,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	 */
 	wild = ISC_FALSE;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(search.rbtdb);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -4553,7 +4922,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	NODE_UNLOCK(lock, isc_rwlocktype_read);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(search.rbtdb, treeshard);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -4611,13 +4980,25 @@ check_stale_header(dns_rbtnode_t *node, rdatasetheader_t *header,
 #endif
 
 	if (!ACTIVE(header, search->now)) {
+		/*
+		 * Data within the stale window is kept.  It is only
+		 * looked at if the caller asked for stale data.
+		 */
+		if (KEEPSTALE(search->rbtdb) && !STALE(header) &&
+		    STALEOK(search->rbtdb, header, search->now))
+		{
+			*header_prev = header;
+			return (ISC_TF((search->options &
+					DNS_DBFIND_STALEOK) == 0));
+		}
+
 		/*
 		 * This rdataset is stale.  If no one else is using the
 		 * node, we can clean it up right now, otherwise we mark
 		 * it as stale, and the node as dirty, so it will get
 		 * cleaned up later.
 		 */
-		if ((header->rdh_ttl < search->now - RBTDB_VIRTUAL) &&
+		if (EXPIRED(search->rbtdb, header, search->now) &&
 		    (*locktype == isc_rwlocktype_write ||
 		     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS))
 		{
@@ -4952,11 +5333,11 @@ rpz_attach(dns_db_t *db, dns_rpz_zones_t *rpzs, dns_rpz_num_t rpz_num) {
 	rbtdb = (dns_rbtdb_t *)db;
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrlock(rbtdb);
 	REQUIRE(rbtdb->rpzs == NULL && rbtdb->rpz_num == DNS_RPZ_INVALID_NUM);
 	dns_rpz_attach_rpzs(rpzs, &rbtdb->rpzs);
 	rbtdb->rpz_num = rpz_num;
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrunlock(rbtdb);
 }
 
 /*
@@ -4970,7 +5351,7 @@ rpz_ready(dns_db_t *db) {
 	rbtdb = (dns_rbtdb_t *)db;
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrlock(rbtdb);
 	if (rbtdb->rpzs == NULL) {
 		INSIST(rbtdb->rpz_num == DNS_RPZ_INVALID_NUM);
 		result = ISC_R_SUCCESS;
@@ -4978,7 +5359,7 @@ rpz_ready(dns_db_t *db) {
 		result = dns_rpz_ready(rbtdb->rpzs, &rbtdb->load_rpzs,
 				       rbtdb->rpz_num);
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrunlock(rbtdb);
 	return (result);
 }
 
@@ -5000,6 +5381,7 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	rdatasetheader_t *foundsig, *nssig, *cnamesig;
 	rdatasetheader_t *update, *updatesig;
 	rbtdb_rdatatype_t sigtype, negtype;
+	unsigned int treeshard;
 
 	UNUSED(version);
 
@@ -5024,7 +5406,7 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	update = NULL;
 	updatesig = NULL;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(search.rbtdb);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -5272,7 +5654,7 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(search.rbtdb, treeshard);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -5310,6 +5692,7 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 	rdatasetheader_t *found, *foundsig;
 	unsigned int rbtoptions = DNS_RBTFIND_EMPTYDATA;
 	isc_rwlocktype_t locktype;
+	unsigned int treeshard;
 
 	search.rbtdb = (dns_rbtdb_t *)db;
 
@@ -5332,7 +5715,7 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 	if ((options & DNS_DBFIND_NOEXACT) != 0)
 		rbtoptions |= DNS_RBTFIND_NOEXACT;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(search.rbtdb);
 
 	/*
 	 * Search down from the root of the tree.
@@ -5427,7 +5810,7 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(search.rbtdb, treeshard);
 
 	INSIST(!search.need_cleanup);
 
@@ -5460,7 +5843,6 @@ static void
 detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 	dns_rbtnode_t *node;
-	isc_boolean_t want_free = ISC_FALSE;
 	isc_boolean_t inactive = ISC_FALSE;
 	rbtdb_nodelock_t *nodelock;
 
@@ -5484,25 +5866,8 @@ detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
 
 	*targetp = NULL;
 
-	if (inactive) {
-		RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
-		rbtdb->active--;
-		if (rbtdb->active == 0)
-			want_free = ISC_TRUE;
-		RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
-		if (want_free) {
-			char buf[DNS_NAME_FORMATSIZE];
-			if (dns_name_dynamic(&rbtdb->common.origin))
-				dns_name_format(&rbtdb->common.origin, buf,
-						sizeof(buf));
-			else
-				strcpy(buf, "<UNKNOWN>");
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
-				      DNS_LOGMODULE_CACHE, ISC_LOG_DEBUG(1),
-				      "calling free_rbtdb(%s)", buf);
-			free_rbtdb(rbtdb, ISC_TRUE, NULL);
-		}
-	}
+	if (inactive)
+		release_node_lock(rbtdb);
 }
 
 static isc_result_t
@@ -5561,7 +5926,7 @@ expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
 		  isc_rwlocktype_write);
 
 	for (header = rbtnode->data; header != NULL; header = header->next)
-		if (header->rdh_ttl <= now - RBTDB_VIRTUAL) {
+		if (EXPIRED(rbtdb, header, now)) {
 			/*
 			 * We don't check if refcurrent(rbtnode) == 0 and try
 			 * to free like we do in cache_find(), because
@@ -5817,7 +6182,7 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	for (header = rbtnode->data; header != NULL; header = header_next) {
 		header_next = header->next;
 		if (!ACTIVE(header, now)) {
-			if ((header->rdh_ttl < now - RBTDB_VIRTUAL) &&
+			if (EXPIRED(rbtdb, header, now) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -6399,8 +6764,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-						 newheader, link);
+				lru_insert(rbtdb, newheader);
 				INSIST(rbtdb->heaps != NULL);
 				(void)isc_heap_insert(rbtdb->heaps[idx],
 						      newheader);
@@ -6425,8 +6789,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 			}
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-						 newheader, link);
+				lru_insert(rbtdb, newheader);
 				/*
 				 * XXXMLG We don't check the return value
 				 * here.  If it fails, we will not do TTL
@@ -6500,8 +6863,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 		}
 		idx = newheader->node->locknum;
 		if (IS_CACHE(rbtdb)) {
-			ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
-					 newheader, link);
+			lru_insert(rbtdb, newheader);
 			isc_heap_insert(rbtdb->heaps[idx], newheader);
 		} else if (RESIGN(newheader)) {
 			resign_delete(rbtdb, rbtversion, header);
@@ -6662,6 +7024,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	isc_boolean_t cache_is_overmem = ISC_FALSE;
 	dns_fixedname_t fixed;
 	dns_name_t *name;
+	unsigned int treeshard;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	INSIST(rbtversion == NULL || rbtversion->rbtdb == rbtdb);
@@ -6687,9 +7050,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 
 	dns_fixedname_init(&fixed);
 	name = dns_fixedname_name(&fixed);
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 	dns_rbt_fullnamefromnode(node, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 	dns_rdataset_getownercase(rdataset, name);
 
 	newheader = (rdatasetheader_t *)region.base;
@@ -6781,7 +7144,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		cache_is_overmem = ISC_TRUE;
 	if (delegating || newnsec || cache_is_overmem) {
 		tree_locked = ISC_TRUE;
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		tree_wrlock(rbtdb);
 	}
 
 	if (cache_is_overmem)
@@ -6799,10 +7162,17 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		if (tree_locked)
 			cleanup_dead_nodes(rbtdb, rbtnode->locknum);
 
-		header = isc_heap_element(rbtdb->heaps[rbtnode->locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL)
-			expire_header(rbtdb, header, tree_locked,
-				      expire_ttl);
+		/*
+		 * Unless expire() is doing it in the background,
+		 * purge one expired rdataset from this bucket.
+		 */
+		if (!rbtdb->sweeping) {
+			header = isc_heap_element(
+					rbtdb->heaps[rbtnode->locknum], 1);
+			if (header && EXPIRED(rbtdb, header, now))
+				expire_header(rbtdb, header, tree_locked,
+					      expire_ttl);
+		}
 
 		/*
 		 * If we've been holding a write lock on the tree just for
@@ -6810,7 +7180,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		 * node lock.
 		 */
 		if (tree_locked && !delegating && !newnsec) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+			tree_wrunlock(rbtdb);
 			tree_locked = ISC_FALSE;
 		}
 	}
@@ -6841,7 +7211,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		    isc_rwlocktype_write);
 
 	if (tree_locked)
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		tree_wrunlock(rbtdb);
 
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
@@ -7233,23 +7603,19 @@ loadnode(dns_rbtdb_t *rbtdb, dns_name_t *name, dns_rbtnode_t **nodep,
 	return (noderesult);
 }
 
-static isc_result_t
-loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
-	rbtdb_load_t *loadctx = arg;
-	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
-	dns_rbtnode_t *node;
-	isc_result_t result;
-	isc_region_t region;
-	rdatasetheader_t *newheader;
+#define IS_NSEC3(r) \
+	((r)->type == dns_rdatatype_nsec3 || \
+	 (r)->covers == dns_rdatatype_nsec3)
 
+/*
+ * Check that 'rdataset' may be loaded at 'name'.
+ */
+static isc_result_t
+loading_check(dns_rbtdb_t *rbtdb, dns_name_t *name,
+	      dns_rdataset_t *rdataset)
+{
 	REQUIRE(rdataset->rdclass == rbtdb->common.rdclass);
 
-	/*
-	 * This routine does no node locking.  See comments in
-	 * 'load' below for more information on loading and
-	 * locking.
-	 */
-
 	/*
 	 * SOA records are only allowed at top of zone.
 	 */
@@ -7257,10 +7623,6 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 	    !IS_CACHE(rbtdb) && !dns_name_equal(name, &rbtdb->common.origin))
 		return (DNS_R_NOTZONETOP);
 
-	if (rdataset->type != dns_rdatatype_nsec3 &&
-	    rdataset->covers != dns_rdatatype_nsec3)
-		add_empty_wildcards(rbtdb, name);
-
 	if (dns_name_iswildcard(name)) {
 		/*
 		 * NS record owners cannot legally be wild cards.
@@ -7272,14 +7634,32 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 		 */
 		if (rdataset->type == dns_rdatatype_nsec3)
 			return (DNS_R_INVALIDNSEC3);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Find or create the node for 'name' in the tree 'rdataset' belongs to.
+ */
+static isc_result_t
+loading_findnode(dns_rbtdb_t *rbtdb, dns_name_t *name,
+		 dns_rdataset_t *rdataset, dns_rbtnode_t **nodep)
+{
+	dns_rbtnode_t *node;
+	isc_result_t result;
+
+	if (!IS_NSEC3(rdataset))
+		add_empty_wildcards(rbtdb, name);
+
+	if (dns_name_iswildcard(name)) {
 		result = add_wildcard_magic(rbtdb, name);
 		if (result != ISC_R_SUCCESS)
 			return (result);
 	}
 
 	node = NULL;
-	if (rdataset->type == dns_rdatatype_nsec3 ||
-	    rdataset->covers == dns_rdatatype_nsec3) {
+	if (IS_NSEC3(rdataset)) {
 		result = dns_rbt_addnode(rbtdb->nsec3, name, &node);
 		if (result == ISC_R_SUCCESS)
 			node->nsec = DNS_RBT_NSEC_NSEC3;
@@ -7302,6 +7682,22 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 #endif
 	}
 
+	*nodep = node;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Add 'rdataset' to 'node'.
+ */
+static isc_result_t
+loading_addheader(rbtdb_load_t *loadctx, dns_rbtnode_t *node,
+		  dns_name_t *name, dns_rdataset_t *rdataset)
+{
+	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
+	isc_result_t result;
+	isc_region_t region;
+	rdatasetheader_t *newheader;
+
 	result = dns_rdataslab_fromrdataset(rdataset, rbtdb->common.mctx,
 					    &region,
 					    sizeof(rdatasetheader_t));
@@ -7315,6 +7711,11 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 						rdataset->covers);
 	newheader->attributes = 0;
 	newheader->trust = rdataset->trust;
+	/*
+	 * A cache file does not record whether its data was validated.
+	 */
+	if (IS_CACHE(rbtdb) && newheader->trust > dns_trust_answer)
+		newheader->trust = dns_trust_answer;
 	newheader->serial = 1;
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
@@ -7346,13 +7747,88 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 	return (result);
 }
 
+static isc_result_t
+loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
+	rbtdb_load_t *loadctx = arg;
+	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
+	dns_rbtnode_t *node;
+	isc_result_t result;
+
+	/*
+	 * This routine does no node locking.  See comments in
+	 * 'load' below for more information on loading and
+	 * locking.
+	 */
+
+	result = loading_check(rbtdb, name, rdataset);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = loading_findnode(rbtdb, name, rdataset, &node);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	return (loading_addheader(loadctx, node, name, rdataset));
+}
+
+/*
+ * Add 'count' rdatasets.  The node found for one owner name is reused
+ * for the rdatasets that follow it with the same owner, so the tree is
+ * searched once per name rather than once per rdataset.
+ */
+static isc_result_t
+loading_addbatch(void *arg, dns_name_t **names, dns_rdataset_t *rdatasets,
+		 isc_result_t *results, unsigned int count)
+{
+	rbtdb_load_t *loadctx = arg;
+	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
+	dns_rbtnode_t *node = NULL;
+	dns_name_t *last = NULL;
+	dns_rdataset_t *rdataset;
+	isc_boolean_t nsec3 = ISC_FALSE;
+	isc_result_t result, tresult = ISC_R_SUCCESS;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		rdataset = &rdatasets[i];
+		result = loading_check(rbtdb, names[i], rdataset);
+		if (result != ISC_R_SUCCESS)
+			goto next;
+
+		/*
+		 * A node that is getting its first NSEC also needs an
+		 * entry in the auxiliary NSEC tree.
+		 */
+		if (node == NULL || nsec3 != IS_NSEC3(rdataset) ||
+		    (rdataset->type == dns_rdatatype_nsec &&
+		     node->nsec != DNS_RBT_NSEC_HAS_NSEC) ||
+		    !dns_name_equal(names[i], last))
+		{
+			node = NULL;
+			result = loading_findnode(rbtdb, names[i], rdataset,
+						  &node);
+			if (result != ISC_R_SUCCESS)
+				goto next;
+			last = names[i];
+			nsec3 = IS_NSEC3(rdataset);
+		}
+
+		result = loading_addheader(loadctx, node, names[i], rdataset);
+ next:
+		results[i] = result;
+		if (result != ISC_R_SUCCESS && tresult == ISC_R_SUCCESS)
+			tresult = result;
+	}
+
+	return (tresult);
+}
+
 static isc_result_t
 rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 	      void *arg, isc_uint64_t *crc)
 {
 	isc_result_t result;
-	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *) arg;
-	rdatasetheader_t *header;
+	rbtdb_load_t *loadctx = arg;
+	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
+	rdatasetheader_t *header, *next;
 	unsigned char *limit = ((unsigned char *) base) + filesize;
 	unsigned char *p;
 	size_t size;
@@ -7373,12 +7849,25 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 		hexdump("hashing slab", p + sizeof(rdatasetheader_t),
 			size - sizeof(rdatasetheader_t));
 #endif
-		header->serial = 1;
-		header->is_mmapped = 1;
-		header->node = rbtnode;
-		header->node_is_relative = 0;
+		/*
+		 * rbt_datawriter() has already set these up for the file
+		 * being mapped where it was written for.  Only store them
+		 * if they differ, so that the page stays clean, and shared
+		 * with the page cache, in that case.
+		 */
+		if (header->serial != 1)
+			header->serial = 1;
+		if (header->is_mmapped != 1 || header->node_is_relative != 0 ||
+		    header->next_is_relative != 0)
+		{
+			header->is_mmapped = 1;
+			header->node_is_relative = 0;
+			header->next_is_relative = 0;
+		}
+		if (header->node != rbtnode)
+			header->node = rbtnode;
 
-		if (rbtdb != NULL && RESIGN(header) && header->resign != 0) {
+		if (RESIGN(header) && header->resign != 0) {
 			int idx = header->node->locknum;
 			result = isc_heap_insert(rbtdb->heaps[idx], header);
 			if (result != ISC_R_SUCCESS)
@@ -7387,14 +7876,14 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 
 		if (header->next != NULL) {
 			size_t cooked = dns_rbt_serialize_align(size);
-			if ((uintptr_t)header->next !=
-				    (p - (unsigned char *)base) + cooked)
+			next = (rdatasetheader_t *)(p + cooked);
+			if ((uintptr_t)header->next - loadctx->written !=
+			    (uintptr_t)(p - (unsigned char *)base) + cooked)
 				return (ISC_R_INVALIDFILE);
-			header->next = (rdatasetheader_t *)(p + cooked);
-			header->next_is_relative = 0;
-			if ((header->next < (rdatasetheader_t *) base) ||
-			    (header->next > (rdatasetheader_t *) limit))
+			if ((unsigned char *)next + sizeof(*next) > limit)
 				return (ISC_R_INVALIDFILE);
+			if (header->next != next)
+				header->next = next;
 		}
 	}
 
@@ -7409,16 +7898,32 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	isc_result_t result;
 	rbtdb_load_t *loadctx = arg;
 	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
-	rbtdb_file_header_t *header;
+	rbtdb_file_header_t *header, fileheader;
 	int fd;
 	off_t filesize = 0;
 	char *base;
+	void *hint = NULL;
 	dns_rbt_t *tree = NULL, *nsec = NULL, *nsec3 = NULL;
 	int protect, flags;
 	dns_rbtnode_t *origin_node = NULL;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
+	/*
+	 * Find out where the file was written to be mapped.  If it can be
+	 * mapped there, nothing in the rdataset slabs needs rewriting.
+	 */
+	result = isc_stdio_seek(f, offset, SEEK_SET);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = isc_stdio_read(&fileheader, 1, sizeof(fileheader), f, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	if (fileheader.base != (uintptr_t) fileheader.base)
+		return (ISC_R_INVALIDFILE);
+	loadctx->written = (uintptr_t) fileheader.base;
+	hint = (void *) loadctx->written;
+
 	/*
 	 * TODO CKB: since this is read-write (had to be to add nodes later)
 	 * we will need to lock the file or the nodes in it before modifying
@@ -7434,7 +7939,7 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 	flags |= MAP_FILE;
 #endif
 
-	base = isc_file_mmap(NULL, filesize, protect, flags, fd, 0);
+	base = isc_file_mmap(hint, filesize, protect, flags, fd, 0);
 	if (base == NULL || base == MAP_FAILED)
 		return (ISC_R_FAILURE);
 
@@ -7445,7 +7950,7 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 						  (off_t) header->tree,
 						  rbtdb->common.mctx,
 						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
+						  rbt_datafixer, loadctx,
 						  NULL, &tree);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
@@ -7462,7 +7967,7 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 						  (off_t) header->nsec,
 						  rbtdb->common.mctx,
 						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
+						  rbt_datafixer, loadctx,
 						  NULL, &nsec);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
@@ -7473,7 +7978,7 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 						  (off_t) header->nsec3,
 						  rbtdb->common.mctx,
 						  delete_callback, rbtdb,
-						  rbt_datafixer, rbtdb,
+						  rbt_datafixer, loadctx,
 						  NULL, &nsec3);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
@@ -7534,6 +8039,7 @@ beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 		isc_stdtime_get(&loadctx->now);
 	else
 		loadctx->now = 0;
+	loadctx->written = 0;
 
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
 
@@ -7556,6 +8062,7 @@ beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
 
 	callbacks->add = loading_addrdataset;
+	callbacks->addbatch = loading_addbatch;
 	callbacks->add_private = loadctx;
 	callbacks->deserialize = deserialize32;
 	callbacks->deserialize_private = loadctx;
@@ -7592,6 +8099,7 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 		iszonesecure(db, rbtdb->current_version, rbtdb->origin_node);
 
 	callbacks->add = NULL;
+	callbacks->addbatch = NULL;
 	callbacks->add_private = NULL;
 	callbacks->deserialize = NULL;
 	callbacks->deserialize_private = NULL;
@@ -7601,18 +8109,37 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Return the version of 'header' that is in the version 'serial', or
+ * NULL if there isn't one.
+ */
+static rdatasetheader_t *
+serialize_version(rdatasetheader_t *header, rbtdb_serial_t serial) {
+	do {
+		if (header->serial <= serial && !IGNORE(header)) {
+			if (NONEXISTENT(header))
+				header = NULL;
+			break;
+		} else
+			header = header->down;
+	} while (header != NULL);
+
+	return (header);
+}
+
 /*
  * helper function to handle writing out the rdataset data pointed to
  * by the void *data pointer in the dns_rbtnode
  */
 static isc_result_t
-rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg,
-	       isc_uint64_t *crc)
+rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg, void *base,
+	       dns_rbtnode_t *node, isc_uint64_t *crc)
 {
 	rbtdb_version_t *version = (rbtdb_version_t *) arg;
 	rbtdb_serial_t serial;
 	rdatasetheader_t newheader;
-	rdatasetheader_t *header = (rdatasetheader_t *) data, *next;
+	rdatasetheader_t *top = (rdatasetheader_t *) data;
+	rdatasetheader_t *header = NULL, *next;
 	off_t where;
 	size_t cooked, size;
 	unsigned char *p;
@@ -7626,19 +8153,17 @@ rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg,
 
 	serial = version->serial;
 
-	for (; header != NULL; header = next) {
-		next = header->next;
-		do {
-			if (header->serial <= serial && !IGNORE(header)) {
-				if (NONEXISTENT(header))
-					header = NULL;
-				break;
-			} else
-				header = header->down;
-		} while (header != NULL);
+	for (; top != NULL && header == NULL; top = top->next)
+		header = serialize_version(top, serial);
 
-		if (header == NULL)
-			continue;
+	for (; header != NULL; header = next) {
+		/*
+		 * Find the next header to be written, so that this one
+		 * can point to it.
+		 */
+		next = NULL;
+		for (; top != NULL && next == NULL; top = top->next)
+			next = serialize_version(top, serial);
 
 		CHECK(isc_stdio_tell(rbtfile, &where));
 		size = dns_rdataslab_size((unsigned char *) header,
@@ -7651,8 +8176,11 @@ rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg,
 		off = where;
 		if ((off_t)off != where)
 			return (ISC_R_RANGE);
-		newheader.node = (dns_rbtnode_t *) off;
-		newheader.node_is_relative = 1;
+		off += (uintptr_t) base;
+		newheader.node = node;
+		newheader.node_is_relative = 0;
+		newheader.next_is_relative = 0;
+		newheader.is_mmapped = 1;
 		newheader.serial = 1;
 
 		/*
@@ -7660,10 +8188,8 @@ rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg,
 		 * will be properly aligned when read back in.
 		 */
 		cooked = dns_rbt_serialize_align(size);
-		if (next != NULL) {
+		if (next != NULL)
 			newheader.next = (rdatasetheader_t *) (off + cooked);
-			newheader.next_is_relative = 1;
-		}
 
 #ifdef DEBUG
 		hexdump("writing header", (unsigned char *) &newheader,
@@ -7732,7 +8258,7 @@ init_file_version(void) {
  */
 static isc_result_t
 rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
-		   off_t nsec3_location)
+		   off_t nsec3_location, void *base)
 {
 	rbtdb_file_header_t header;
 	isc_result_t result;
@@ -7747,6 +8273,7 @@ rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
 	header.tree = (isc_uint64_t) tree_location;
 	header.nsec = (isc_uint64_t) nsec_location;
 	header.nsec3 = (isc_uint64_t) nsec3_location;
+	header.base = (isc_uint64_t) (uintptr_t) base;
 	result = isc_stdio_write(&header, 1, sizeof(rbtdb_file_header_t),
 			      rbtfile, NULL);
 	fflush(rbtfile);
@@ -7754,18 +8281,48 @@ rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
 	return (result);
 }
 
+/*
+ * Map files are written for a particular address, and if they can be
+ * mapped there when loaded, the rdataset slabs are used without being
+ * modified and stay shared with the page cache.  Zones are spread over
+ * a range of addresses that is normally unused, by a hash of the origin
+ * name, so that each zone will usually find its address free.  There is
+ * no room for this in a 32 bit address space, where files are written
+ * for address 0 and always have to be relocated.
+ */
+#define MAPBASE_START		0x100000000000ULL
+#define MAPBASE_SLOTS		(1U << 18)
+#define MAPBASE_SLOTSIZE	(1ULL << 28)
+
+static void *
+map_base(dns_rbtdb_t *rbtdb) {
+	isc_uint64_t base;
+
+	if (sizeof(void *) < sizeof(isc_uint64_t))
+		return (NULL);
+
+	base = MAPBASE_START + MAPBASE_SLOTSIZE *
+	       (dns_name_fullhash(&rbtdb->common.origin, ISC_FALSE) %
+		MAPBASE_SLOTS);
+
+	return ((void *) (uintptr_t) base);
+}
+
 static isc_result_t
 serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	rbtdb_version_t *version = (rbtdb_version_t *) ver;
 	dns_rbtdb_t *rbtdb;
 	isc_result_t result;
 	off_t tree_location, nsec_location, nsec3_location, header_location;
+	void *base;
 
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	REQUIRE(rbtfile != NULL);
 
+	base = map_base(rbtdb);
+
 	/* Ensure we're writing to a plain file */
 	CHECK(isc_file_isplainfilefd(fileno(rbtfile)));
 
@@ -7783,16 +8340,19 @@ serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	 */
 	CHECK(isc_stdio_tell(rbtfile, &header_location));
 	CHECK(rbtdb_zero_header(rbtfile));
-	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->tree, rbt_datawriter,
-				     version, &tree_location));
-	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->nsec, rbt_datawriter,
-				     version, &nsec_location));
-	CHECK(dns_rbt_serialize_tree(rbtfile, rbtdb->nsec3, rbt_datawriter,
-				     version, &nsec3_location));
+	CHECK(dns_rbt_serialize_tree2(rbtfile, rbtdb->tree, base,
+				      rbt_datawriter, version,
+				      &tree_location));
+	CHECK(dns_rbt_serialize_tree2(rbtfile, rbtdb->nsec, base,
+				      rbt_datawriter, version,
+				      &nsec_location));
+	CHECK(dns_rbt_serialize_tree2(rbtfile, rbtdb->nsec3, base,
+				      rbt_datawriter, version,
+				      &nsec3_location));
 
 	CHECK(isc_stdio_seek(rbtfile, header_location, SEEK_SET));
 	CHECK(rbtdb_write_header(rbtfile, tree_location, nsec_location,
-				 nsec3_location));
+				 nsec3_location, base));
  failure:
 	return (result);
 }
@@ -7835,14 +8395,15 @@ static isc_boolean_t
 issecure(dns_db_t *db) {
 	dns_rbtdb_t *rbtdb;
 	isc_boolean_t secure;
+	unsigned int treeshard;
 
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 	secure = ISC_TF(rbtdb->current_version->secure == dns_db_secure);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 
 	return (secure);
 }
@@ -7851,14 +8412,15 @@ static isc_boolean_t
 isdnssec(dns_db_t *db) {
 	dns_rbtdb_t *rbtdb;
 	isc_boolean_t dnssec;
+	unsigned int treeshard;
 
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 	dnssec = ISC_TF(rbtdb->current_version->secure != dns_db_insecure);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 
 	return (dnssec);
 }
@@ -7867,14 +8429,15 @@ static unsigned int
 nodecount(dns_db_t *db) {
 	dns_rbtdb_t *rbtdb;
 	unsigned int count;
+	unsigned int treeshard;
 
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 	count = dns_rbt_nodecount(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 
 	return (count);
 }
@@ -7883,18 +8446,126 @@ static size_t
 hashsize(dns_db_t *db) {
 	dns_rbtdb_t *rbtdb;
 	size_t size;
+	unsigned int treeshard;
 
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 	size = dns_rbt_hashsize(rbtdb->tree);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 
 	return (size);
 }
 
+static isc_result_t
+presize(dns_db_t *db, unsigned int count) {
+	dns_rbtdb_t *rbtdb;
+	isc_result_t result;
+
+	rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	tree_wrlock(rbtdb);
+	result = dns_rbt_presize(rbtdb->tree, count);
+	tree_wrunlock(rbtdb);
+
+	return (result);
+}
+
+static isc_result_t
+expire(dns_db_t *db, isc_stdtime_t now, unsigned int max,
+       unsigned int *countp, size_t *sizep)
+{
+	dns_rbtdb_t *rbtdb;
+	rdatasetheader_t *header;
+	unsigned int locknum, n, count = 0;
+	size_t size = 0;
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_boolean_t reclaim = ISC_FALSE;
+
+	rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+	REQUIRE(max > 0);
+
+	/*
+	 * From now on addrdataset() leaves expired data to us.
+	 */
+	rbtdb->sweeping = ISC_TRUE;
+
+	for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
+		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
+			  isc_rwlocktype_write);
+
+		for (n = 0; n < max; n++) {
+			header = isc_heap_element(rbtdb->heaps[locknum], 1);
+			if (header == NULL || !EXPIRED(rbtdb, header, now))
+				break;
+
+			if (NONEXISTENT(header))
+				size += sizeof(*header);
+			else
+				size += dns_rdataslab_size(
+						(unsigned char *)header,
+						sizeof(*header));
+
+			/*
+			 * Take the header off the heap first: if its node
+			 * is in use, expire_header() only marks it, and we
+			 * must not find it again.  It is freed when the
+			 * node is released.
+			 */
+			isc_heap_delete(rbtdb->heaps[locknum],
+					header->heap_index);
+			header->heap_index = 0;
+			expire_header(rbtdb, header, ISC_FALSE, expire_ttl);
+			count++;
+		}
+		if (n == max)
+			result = DNS_R_CONTINUE;
+		if (!ISC_LIST_EMPTY(rbtdb->deadnodes[locknum]))
+			reclaim = ISC_TRUE;
+
+		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
+			    isc_rwlocktype_write);
+	}
+
+	/*
+	 * Nodes emptied above, or released under a read lock on the tree,
+	 * wait on the dead node lists until someone holds the tree lock
+	 * for writing.  Rather than leave them to reclaim_dead_nodes(),
+	 * take it once here and reclaim them: as many per bucket as this
+	 * pass may have emptied, and a few more.  cleanup_dead_nodes()
+	 * does ten at a time.
+	 */
+	if (reclaim) {
+		tree_wrlock(rbtdb);
+		for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
+			NODE_LOCK(&rbtdb->node_locks[locknum].lock,
+				  isc_rwlocktype_write);
+			for (n = 0;
+			     n <= max &&
+			     !ISC_LIST_EMPTY(rbtdb->deadnodes[locknum]);
+			     n += 10)
+				cleanup_dead_nodes(rbtdb, locknum);
+			NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
+				    isc_rwlocktype_write);
+		}
+		tree_wrunlock(rbtdb);
+	}
+
+	if (countp != NULL)
+		*countp = count;
+	if (sizep != NULL)
+		*sizep = size;
+
+	return (result);
+}
+
 static void
 settask(dns_db_t *db, isc_task_t *task) {
 	dns_rbtdb_t *rbtdb;
@@ -7950,13 +8621,14 @@ getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
 	dns_rbtdb_t *rbtdb;
 	isc_result_t result = ISC_R_NOTFOUND;
 	rbtdb_version_t *rbtversion = version;
+	unsigned int treeshard;
 
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	INSIST(rbtversion == NULL || rbtversion->rbtdb == rbtdb);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 
 	if (rbtversion == NULL)
 		rbtversion = rbtdb->current_version;
@@ -7977,7 +8649,7 @@ getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
 			*flags = rbtversion->flags;
 		result = ISC_R_SUCCESS;
 	}
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 
 	return (result);
 }
@@ -8059,10 +8731,11 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 	unsigned int i;
 	isc_result_t result = ISC_R_NOTFOUND;
 	unsigned int locknum;
+	unsigned int treeshard;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 
 	for (i = 0; i < rbtdb->node_lock_count; i++) {
 		NODE_LOCK(&rbtdb->node_locks[i].lock, isc_rwlocktype_read);
@@ -8098,7 +8771,7 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 	result = ISC_R_SUCCESS;
 
  unlock:
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 
 	return (result);
 }
@@ -8128,7 +8801,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	if (header->heap_index == 0)
 		return;
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrlock(rbtdb);
 	NODE_LOCK(&rbtdb->node_locks[node->locknum].lock,
 		  isc_rwlocktype_write);
 	/*
@@ -8138,7 +8811,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	resign_delete(rbtdb, rbtversion, header);
 	NODE_UNLOCK(&rbtdb->node_locks[node->locknum].lock,
 		    isc_rwlocktype_write);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	tree_wrunlock(rbtdb);
 }
 
 static isc_result_t
@@ -8163,19 +8836,43 @@ getrrsetstats(dns_db_t *db) {
 	return (rbtdb->rrsetstats);
 }
 
+static isc_result_t
+setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	/* 0 disables keeping stale data. */
+	rbtdb->serve_stale_ttl = ttl;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	*ttl = rbtdb->serve_stale_ttl;
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 	dns_rbtnode_t *rbtnode = (dns_rbtnode_t *)node;
 	isc_result_t result;
+	unsigned int treeshard;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	REQUIRE(node != NULL);
 	REQUIRE(name != NULL);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	treeshard = tree_rdlock(rbtdb);
 	result = dns_rbt_fullnamefromnode(rbtnode, name);
-	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	tree_rdunlock(rbtdb, treeshard);
 
 	return (result);
 }
@@ -8225,7 +8922,11 @@ static dns_dbmethods_t zone_methods = {
 	NULL,
 	hashsize,
 	nodefullname,
-	getsize
+	getsize,
+	presize,
+	NULL,
+	NULL,
+	NULL
 };
 
 static dns_dbmethods_t cache_methods = {
@@ -8273,7 +8974,11 @@ static dns_dbmethods_t cache_methods = {
 	setcachestats,
 	hashsize,
 	nodefullname,
-	NULL
+	NULL,
+	presize,
+	expire,
+	setservestalettl,
+	getservestalettl
 };
 
 isc_result_t
@@ -8291,6 +8996,7 @@ dns_rbtdb_create
 	int i;
 	dns_name_t name;
 	isc_boolean_t (*sooner)(void *, void *);
+	size_t misalign;
 	isc_mem_t *hmctx = mctx;
 
 	/* Keep the compiler happy. */
@@ -8307,6 +9013,19 @@ dns_rbtdb_create
 		hmctx = (isc_mem_t *) argv[0];
 
 	memset(rbtdb, '\0', sizeof(*rbtdb));
+
+	/*
+	 * If argv[1] exists, it is the number of node locks (and so of LRU
+	 * lists and TTL heaps) for a cache database, in decimal.
+	 */
+	if (argc > 1 && type == dns_dbtype_cache) {
+		isc_uint32_t count;
+
+		result = isc_parse_uint32(&count, argv[1], 10);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_rbtdb;
+		rbtdb->node_lock_count = count;
+	}
 	dns_name_init(&rbtdb->common.origin, NULL);
 	rbtdb->common.attributes = 0;
 	if (type == dns_dbtype_cache) {
@@ -8326,7 +9045,7 @@ dns_rbtdb_create
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbtdb;
 
-	result = isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
+	result = tree_initlock(mctx, rbtdb);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_lock;
 
@@ -8341,17 +9060,22 @@ dns_rbtdb_create
 			rbtdb->node_lock_count = DEFAULT_CACHE_NODE_LOCK_COUNT;
 		else
 			rbtdb->node_lock_count = DEFAULT_NODE_LOCK_COUNT;
-	} else if (rbtdb->node_lock_count < 2 && IS_CACHE(rbtdb)) {
+	} else if ((rbtdb->node_lock_count < 2 && IS_CACHE(rbtdb)) ||
+		   rbtdb->node_lock_count >= (1 << DNS_RBT_LOCKLENGTH)) {
 		result = ISC_R_RANGE;
 		goto cleanup_tree_lock;
 	}
-	INSIST(rbtdb->node_lock_count < (1 << DNS_RBT_LOCKLENGTH));
-	rbtdb->node_locks = isc_mem_get(mctx, rbtdb->node_lock_count *
-					sizeof(rbtdb_nodelock_t));
-	if (rbtdb->node_locks == NULL) {
+	rbtdb->node_lockbase =
+		isc_mem_get(mctx, NODE_LOCK_ALLOCSIZE(rbtdb->node_lock_count));
+	if (rbtdb->node_lockbase == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto cleanup_tree_lock;
 	}
+	misalign = (unsigned long)rbtdb->node_lockbase &
+		   (NODE_LOCK_LINESIZE - 1);
+	rbtdb->node_locks = (rbtdb_nodelock_t *)
+		((char *)rbtdb->node_lockbase +
+		 (NODE_LOCK_LINESIZE - misalign) % NODE_LOCK_LINESIZE);
 
 	rbtdb->cachestats = NULL;
 	rbtdb->rrsetstats = NULL;
@@ -8359,16 +9083,20 @@ dns_rbtdb_create
 		result = dns_rdatasetstats_create(mctx, &rbtdb->rrsetstats);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup_node_locks;
-		rbtdb->rdatasets = isc_mem_get(mctx, rbtdb->node_lock_count *
-					       sizeof(rdatasetheaderlist_t));
-		if (rbtdb->rdatasets == NULL) {
+		rbtdb->lru = isc_mem_get(mctx, rbtdb->node_lock_count *
+					 sizeof(rbtdb_lru_t));
+		if (rbtdb->lru == NULL) {
 			result = ISC_R_NOMEMORY;
 			goto cleanup_rrsetstats;
 		}
-		for (i = 0; i < (int)rbtdb->node_lock_count; i++)
-			ISC_LIST_INIT(rbtdb->rdatasets[i]);
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
+			ISC_LIST_INIT(rbtdb->lru[i].cold);
+			ISC_LIST_INIT(rbtdb->lru[i].hot);
+			rbtdb->lru[i].ncold = 0;
+			rbtdb->lru[i].nhot = 0;
+		}
 	} else
-		rbtdb->rdatasets = NULL;
+		rbtdb->lru = NULL;
 
 	/*
 	 * Create the heaps.
@@ -8377,7 +9105,7 @@ dns_rbtdb_create
 				   sizeof(isc_heap_t *));
 	if (rbtdb->heaps == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_rdatasets;
+		goto cleanup_lru;
 	}
 	for (i = 0; i < (int)rbtdb->node_lock_count; i++)
 		rbtdb->heaps[i] = NULL;
@@ -8419,6 +9147,7 @@ dns_rbtdb_create
 			goto cleanup_deadnodes;
 		}
 		rbtdb->node_locks[i].exiting = ISC_FALSE;
+		rbtdb->node_locks[i].reclaiming = ISC_FALSE;
 	}
 
 	/*
@@ -8609,20 +9338,20 @@ dns_rbtdb_create
 			    rbtdb->node_lock_count * sizeof(isc_heap_t *));
 	}
 
- cleanup_rdatasets:
-	if (rbtdb->rdatasets != NULL)
-		isc_mem_put(mctx, rbtdb->rdatasets, rbtdb->node_lock_count *
-			    sizeof(rdatasetheaderlist_t));
+ cleanup_lru:
+	if (rbtdb->lru != NULL)
+		isc_mem_put(mctx, rbtdb->lru, rbtdb->node_lock_count *
+			    sizeof(rbtdb_lru_t));
  cleanup_rrsetstats:
 	if (rbtdb->rrsetstats != NULL)
 		dns_stats_detach(&rbtdb->rrsetstats);
 
  cleanup_node_locks:
-	isc_mem_put(mctx, rbtdb->node_locks,
-		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
+	isc_mem_put(mctx, rbtdb->node_lockbase,
+		    NODE_LOCK_ALLOCSIZE(rbtdb->node_lock_count));
 
  cleanup_tree_lock:
-	isc_rwlock_destroy(&rbtdb->tree_lock);
+	tree_destroylock(mctx, rbtdb);
 
  cleanup_lock:
 	RBTDB_DESTROYLOCK(&rbtdb->lock);
@@ -9144,10 +9873,10 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 			      dns_rbt_nodecount(rbtdb->tree));
 
 		if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			tree_rdunlock(rbtdb, rbtdbiter->tree_shard);
 			was_read_locked = ISC_TRUE;
 		}
-		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		tree_wrlock(rbtdb);
 		rbtdbiter->tree_locked = isc_rwlocktype_write;
 
 		for (i = 0; i < rbtdbiter->delete; i++) {
@@ -9163,9 +9892,9 @@ flush_deletions(rbtdb_dbiterator_t *rbtdbiter) {
 
 		rbtdbiter->delete = 0;
 
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		tree_wrunlock(rbtdb);
 		if (was_read_locked) {
-			RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+			rbtdbiter->tree_shard = tree_rdlock(rbtdb);
 			rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 		} else {
@@ -9181,7 +9910,7 @@ resume_iteration(rbtdb_dbiterator_t *rbtdbiter) {
 	REQUIRE(rbtdbiter->paused);
 	REQUIRE(rbtdbiter->tree_locked == isc_rwlocktype_none);
 
-	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	rbtdbiter->tree_shard = tree_rdlock(rbtdb);
 	rbtdbiter->tree_locked = isc_rwlocktype_read;
 
 	rbtdbiter->paused = ISC_FALSE;
@@ -9194,7 +9923,7 @@ dbiterator_destroy(dns_dbiterator_t **iteratorp) {
 	dns_db_t *db = NULL;
 
 	if (rbtdbiter->tree_locked == isc_rwlocktype_read) {
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		tree_rdunlock(rbtdb, rbtdbiter->tree_shard);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	} else
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_none);
@@ -9567,7 +10296,7 @@ dbiterator_pause(dns_dbiterator_t *iterator) {
 
 	if (rbtdbiter->tree_locked != isc_rwlocktype_none) {
 		INSIST(rbtdbiter->tree_locked == isc_rwlocktype_read);
-		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		tree_rdunlock(rbtdb, rbtdbiter->tree_shard);
 		rbtdbiter->tree_locked = isc_rwlocktype_none;
 	}
 
@@ -9991,15 +10720,55 @@ rdataset_getownercase(const dns_rdataset_t *rdataset, dns_name_t *name) {
  * Routines for LRU-based cache management.
  */
 
+/*%
+ * Put a new cache entry at the head of its bucket's cold list.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static inline void
+lru_insert(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	rbtdb_lru_t *lru = &rbtdb->lru[header->node->locknum];
+
+	INSIST(!HOT(header));
+	ISC_LIST_PREPEND(lru->cold, header, link);
+	lru->ncold++;
+}
+
+/*%
+ * Remove a cache entry from whichever LRU list it is on.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static inline void
+lru_unlink(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	rbtdb_lru_t *lru = &rbtdb->lru[header->node->locknum];
+
+	if (HOT(header)) {
+		ISC_LIST_UNLINK(lru->hot, header, link);
+		lru->nhot--;
+		header->attributes &= ~RDATASET_ATTR_HOT;
+	} else {
+		ISC_LIST_UNLINK(lru->cold, header, link);
+		lru->ncold--;
+	}
+}
+
 /*%
  * See if a given cache entry that is being reused needs to be updated
  * in the LRU-list.  From the LRU management point of view, this function is
  * expected to return true for almost all cases.  When used with threads,
  * however, this may cause a non-negligible performance penalty because a
  * writer lock will have to be acquired before updating the list.
+ *
+ * An entry on the cold list is promoted the first time it is used in a
+ * later second than the one it was added or last promoted in; that is
+ * what tells it apart from a name that is looked up once.  This happens
+ * at most once per entry.
+ *
  * If DNS_RBTDB_LIMITLRUUPDATE is defined to be non 0 at compilation time, this
- * function returns true if the entry has not been updated for some period of
- * time.  We differentiate the NS or glue address case and the others since
+ * function returns true for a hot entry only if the entry has not been
+ * updated for some period of time.  We differentiate the NS or glue
+ * address case and the others since
  * experiments have shown that the former tends to be accessed relatively
  * infrequently and the cost of cache miss is higher (e.g., a missing NS records
  * may cause external queries at a higher level zone, involving more
@@ -10013,6 +10782,9 @@ need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
 	     (RDATASET_ATTR_NONEXISTENT|RDATASET_ATTR_STALE)) != 0)
 		return (ISC_FALSE);
 
+	if (!HOT(header))
+		return (ISC_TF(header->last_used != now));
+
 #if DNS_RBTDB_LIMITLRUUPDATE
 	if (header->type == dns_rdatatype_ns ||
 	    (header->trust == dns_trust_glue &&
@@ -10036,7 +10808,9 @@ need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
 
 /*%
  * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
+ * of its bucket's hot list, promoting it if it was on the cold list.
+ * If that makes the hot list too long, the least recently used hot
+ * entries are moved to the head of the cold list.
  *
  * Caller must hold the node (write) lock.
  *
@@ -10046,14 +10820,59 @@ static void
 update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
 	      isc_stdtime_t now)
 {
+	rbtdb_lru_t *lru;
+	rdatasetheader_t *demoted;
+
 	INSIST(IS_CACHE(rbtdb));
 
 	/* To be checked: can we really assume this? XXXMLG */
 	INSIST(ISC_LINK_LINKED(header, link));
 
-	ISC_LIST_UNLINK(rbtdb->rdatasets[header->node->locknum], header, link);
+	lru = &rbtdb->lru[header->node->locknum];
+	lru_unlink(rbtdb, header);
 	header->last_used = now;
-	ISC_LIST_PREPEND(rbtdb->rdatasets[header->node->locknum], header, link);
+	header->attributes |= RDATASET_ATTR_HOT;
+	ISC_LIST_PREPEND(lru->hot, header, link);
+	lru->nhot++;
+
+	while (lru->nhot > 1 && lru->nhot > 3 * lru->ncold) {
+		demoted = ISC_LIST_TAIL(lru->hot);
+		INSIST(demoted != header);
+		lru_unlink(rbtdb, demoted);
+		ISC_LIST_PREPEND(lru->cold, demoted, link);
+		lru->ncold++;
+	}
+}
+
+/*%
+ * Purge up to 'purgecount' entries from the tail of 'list', one of the
+ * LRU lists of a bucket, and return how many more are to be purged.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static int
+lru_purge(dns_rbtdb_t *rbtdb, rdatasetheaderlist_t *list, int purgecount,
+	  isc_boolean_t tree_locked)
+{
+	rdatasetheader_t *header, *header_prev;
+
+	for (header = ISC_LIST_TAIL(*list);
+	     header != NULL && purgecount > 0;
+	     header = header_prev) {
+		header_prev = ISC_LIST_PREV(header, link);
+		/*
+		 * Unlink the entry at this point to avoid checking it
+		 * again even if it's currently used someone else and
+		 * cannot be purged at this moment.  This entry won't be
+		 * referenced any more (so unlinking is safe) since the
+		 * TTL was reset to 0.
+		 */
+		lru_unlink(rbtdb, header);
+		expire_header(rbtdb, header, tree_locked, expire_lru);
+		purgecount--;
+	}
+
+	return (purgecount);
 }
 
 /*%
@@ -10065,48 +10884,43 @@ update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
  * entries of the same name of different RR types while adding RRsets from a
  * single response (consider the case where we're adding A and AAAA glue records
  * of the same NS name).
+ *
+ * Entries are purged from the cold lists; only if every other bucket's cold
+ * list is empty are they purged from the hot lists.
  */
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 	      isc_stdtime_t now, isc_boolean_t tree_locked)
 {
-	rdatasetheader_t *header, *header_prev;
+	rdatasetheader_t *header;
+	rbtdb_lru_t *lru;
 	unsigned int locknum;
 	int purgecount = 2;
+	int pass;
+
+	for (pass = 0; pass < 2 && purgecount > 0; pass++) {
+		for (locknum = (locknum_start + 1) % rbtdb->node_lock_count;
+		     locknum != locknum_start && purgecount > 0;
+		     locknum = (locknum + 1) % rbtdb->node_lock_count) {
+			lru = &rbtdb->lru[locknum];
+			NODE_LOCK(&rbtdb->node_locks[locknum].lock,
+				  isc_rwlocktype_write);
+
+			header = isc_heap_element(rbtdb->heaps[locknum], 1);
+			if (header && EXPIRED(rbtdb, header, now)) {
+				expire_header(rbtdb, header, tree_locked,
+					      expire_ttl);
+				purgecount--;
+			}
 
-	for (locknum = (locknum_start + 1) % rbtdb->node_lock_count;
-	     locknum != locknum_start && purgecount > 0;
-	     locknum = (locknum + 1) % rbtdb->node_lock_count) {
-		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
-			  isc_rwlocktype_write);
-
-		header = isc_heap_element(rbtdb->heaps[locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL) {
-			expire_header(rbtdb, header, tree_locked,
-				      expire_ttl);
-			purgecount--;
-		}
-
-		for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
-		     header != NULL && purgecount > 0;
-		     header = header_prev) {
-			header_prev = ISC_LIST_PREV(header, link);
-			/*
-			 * Unlink the entry at this point to avoid checking it
-			 * again even if it's currently used someone else and
-			 * cannot be purged at this moment.  This entry won't be
-			 * referenced any more (so unlinking is safe) since the
-			 * TTL was reset to 0.
-			 */
-			ISC_LIST_UNLINK(rbtdb->rdatasets[locknum], header,
-					link);
-			expire_header(rbtdb, header, tree_locked,
-				      expire_lru);
-			purgecount--;
-		}
+			purgecount = lru_purge(rbtdb,
+					       (pass == 0) ? &lru->cold
+							   : &lru->hot,
+					       purgecount, tree_locked);
 
-		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
+			NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 				    isc_rwlocktype_write);
+		}
 	}
 }
 
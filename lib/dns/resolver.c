@@ -177,6 +177,28 @@
 #endif
 #define RES_NOBUCKET		0xffffffff
 
+/*%
+ * Fetch contexts are spread over this many buckets per resolver task,
+ * so that concurrent fetches rarely contend for a bucket lock.
+ */
+#ifndef RES_FCTX_BUCKETS_PER_TASK
+#define RES_FCTX_BUCKETS_PER_TASK	8
+#endif
+
+/*%
+ * Initial number of hash chains in each bucket's fetch context index.
+ * The index doubles when a bucket holds more than two fetch contexts
+ * per chain.  Must be a power of two.
+ */
+#define RES_FCTX_HASHSIZE	16
+
+/*%
+ * The bucket is chosen by the low bits of the hash value modulo the
+ * number of buckets, so the chain within it uses the high bits.
+ */
+#define FCTX_HASH_BITS(h)	(((h) >> 16) | ((h) << 16))
+#define FCTX_CHAIN(b, h)	(FCTX_HASH_BITS(h) & ((b)->hashsize - 1))
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -257,6 +279,7 @@ struct fetchctx {
 	dns_name_t			name;
 	dns_rdatatype_t			type;
 	unsigned int			options;
+	unsigned int			hashval;
 	unsigned int			bucketnum;
 	unsigned int			dbucketnum;
 	char *				info;
@@ -270,6 +293,7 @@ struct fetchctx {
 	unsigned int			references;
 	isc_event_t			control_event;
 	ISC_LINK(struct fetchctx)       link;
+	ISC_LINK(struct fetchctx)       hlink;
 	ISC_LIST(dns_fetchevent_t)      events;
 	/*% Locked by task event serialization. */
 	dns_name_t			domain;
@@ -412,10 +436,21 @@ struct dns_fetch {
 #define DNS_FETCH_MAGIC			ISC_MAGIC('F', 't', 'c', 'h')
 #define DNS_FETCH_VALID(fetch)		ISC_MAGIC_VALID(fetch, DNS_FETCH_MAGIC)
 
+typedef ISC_LIST(fetchctx_t)		fctxlist_t;
+
+/*%
+ * A bucket's fetch contexts are on 'fctxs', and also on one of the
+ * 'hashsize' chains in 'table', chosen by their hash value, so that
+ * a fetch can be joined to a running one without a list scan.
+ * Several buckets may share a task and a memory context.
+ */
 typedef struct fctxbucket {
 	isc_task_t *			task;
 	isc_mutex_t			lock;
-	ISC_LIST(fetchctx_t)		fctxs;
+	fctxlist_t			fctxs;
+	fctxlist_t *			table;
+	unsigned int			hashsize;
+	unsigned int			count;
 	isc_boolean_t			exiting;
 	isc_mem_t *			mctx;
 } fctxbucket_t;
@@ -3779,6 +3814,67 @@ fctx_try(fetchctx_t *fctx, isc_boolean_t retrying, isc_boolean_t badcache) {
 		inc_stats(res, dns_resstatscounter_retry);
 }
 
+/*
+ * Double the number of hash chains in 'bucket'.  If memory is short the
+ * chains are left as they are; they just get longer.
+ *
+ * Caller must be holding the bucket lock.
+ */
+static void
+bucket_grow(fctxbucket_t *bucket) {
+	fctxlist_t *table;
+	fetchctx_t *fctx;
+	unsigned int i, hashsize;
+
+	hashsize = bucket->hashsize * 2;
+	table = isc_mem_get(bucket->mctx, hashsize * sizeof(*table));
+	if (table == NULL)
+		return;
+	for (i = 0; i < hashsize; i++)
+		ISC_LIST_INIT(table[i]);
+
+	for (fctx = ISC_LIST_HEAD(bucket->fctxs);
+	     fctx != NULL;
+	     fctx = ISC_LIST_NEXT(fctx, link)) {
+		ISC_LIST_UNLINK(bucket->table[FCTX_CHAIN(bucket, fctx->hashval)],
+				fctx, hlink);
+		ISC_LIST_APPEND(table[FCTX_HASH_BITS(fctx->hashval) &
+				      (hashsize - 1)],
+				fctx, hlink);
+	}
+
+	isc_mem_put(bucket->mctx, bucket->table,
+		    bucket->hashsize * sizeof(*table));
+	bucket->table = table;
+	bucket->hashsize = hashsize;
+}
+
+/*
+ * Caller must be holding the bucket lock.
+ */
+static void
+bucket_link(fctxbucket_t *bucket, fetchctx_t *fctx) {
+	if (bucket->count >= 2 * bucket->hashsize)
+		bucket_grow(bucket);
+
+	ISC_LIST_APPEND(bucket->fctxs, fctx, link);
+	ISC_LIST_APPEND(bucket->table[FCTX_CHAIN(bucket, fctx->hashval)],
+			fctx, hlink);
+	bucket->count++;
+}
+
+/*
+ * Caller must be holding the bucket lock.
+ */
+static void
+bucket_unlink(fctxbucket_t *bucket, fetchctx_t *fctx) {
+	ISC_LIST_UNLINK(bucket->fctxs, fctx, link);
+	ISC_LIST_UNLINK(bucket->table[FCTX_CHAIN(bucket, fctx->hashval)],
+			fctx, hlink);
+	INSIST(bucket->count > 0);
+	bucket->count--;
+}
+
 static isc_boolean_t
 fctx_unlink(fetchctx_t *fctx) {
 	dns_resolver_t *res;
@@ -3804,7 +3900,7 @@ fctx_unlink(fetchctx_t *fctx) {
 	res = fctx->res;
 	bucketnum = fctx->bucketnum;
 
-	ISC_LIST_UNLINK(res->buckets[bucketnum].fctxs, fctx, link);
+	bucket_unlink(&res->buckets[bucketnum], fctx);
 
 	LOCK(&res->nlock);
 	res->nfctx--;
@@ -4204,8 +4300,8 @@ log_ns_ttl(fetchctx_t *fctx, const char *where) {
 static isc_result_t
 fctx_create(dns_resolver_t *res, dns_name_t *name, dns_rdatatype_t type,
 	    dns_name_t *domain, dns_rdataset_t *nameservers,
-	    unsigned int options, unsigned int bucketnum, unsigned int depth,
-	    isc_counter_t *qc, fetchctx_t **fctxp)
+	    unsigned int options, unsigned int hashval, unsigned int bucketnum,
+	    unsigned int depth, isc_counter_t *qc, fetchctx_t **fctxp)
 {
 	fetchctx_t *fctx;
 	isc_result_t result;
@@ -4268,6 +4364,7 @@ fctx_create(dns_resolver_t *res, dns_name_t *name, dns_rdatatype_t type,
 	 */
 	fctx->res = res;
 	fctx->references = 0;
+	fctx->hashval = hashval;
 	fctx->bucketnum = bucketnum;
 	fctx->dbucketnum = RES_NOBUCKET;
 	fctx->state = fetchstate_init;
@@ -4465,9 +4562,10 @@ fctx_create(dns_resolver_t *res, dns_name_t *name, dns_rdatatype_t type,
 
 	ISC_LIST_INIT(fctx->events);
 	ISC_LINK_INIT(fctx, link);
+	ISC_LINK_INIT(fctx, hlink);
 	fctx->magic = FCTX_MAGIC;
 
-	ISC_LIST_APPEND(res->buckets[bucketnum].fctxs, fctx, link);
+	bucket_link(&res->buckets[bucketnum], fctx);
 
 	LOCK(&res->nlock);
 	res->nfctx++;
@@ -8727,6 +8825,10 @@ destroy(dns_resolver_t *res) {
 	DESTROYLOCK(&res->lock);
 	for (i = 0; i < res->nbuckets; i++) {
 		INSIST(ISC_LIST_EMPTY(res->buckets[i].fctxs));
+		INSIST(res->buckets[i].count == 0);
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].table,
+			    res->buckets[i].hashsize *
+			    sizeof(*res->buckets[i].table));
 		isc_task_shutdown(res->buckets[i].task);
 		isc_task_detach(&res->buckets[i].task);
 		DESTROYLOCK(&res->buckets[i].lock);
@@ -8847,7 +8949,7 @@ dns_resolver_create(dns_view_t *view,
 {
 	dns_resolver_t *res;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int i, buckets_created = 0, dbuckets_created = 0;
+	unsigned int i, j, buckets_created = 0, dbuckets_created = 0;
 	isc_task_t *task = NULL;
 	char name[16];
 	unsigned dispattr;
@@ -8894,47 +8996,76 @@ dns_resolver_create(dns_view_t *view,
 	res->maxqueries = DEFAULT_MAX_QUERIES;
 	res->quotaresp[dns_quotatype_zone] = DNS_R_DROP;
 	res->quotaresp[dns_quotatype_server] = DNS_R_SERVFAIL;
-	res->nbuckets = ntasks;
+	res->nbuckets = ntasks * RES_FCTX_BUCKETS_PER_TASK;
 	if (view->resstats != NULL)
-		isc_stats_set(view->resstats, ntasks,
+		isc_stats_set(view->resstats, res->nbuckets,
 			      dns_resstatscounter_buckets);
-	res->activebuckets = ntasks;
+	res->activebuckets = res->nbuckets;
 	res->buckets = isc_mem_get(view->mctx,
-				   ntasks * sizeof(fctxbucket_t));
+				   res->nbuckets * sizeof(fctxbucket_t));
 	if (res->buckets == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto cleanup_res;
 	}
-	for (i = 0; i < ntasks; i++) {
+	for (i = 0; i < res->nbuckets; i++) {
 		result = isc_mutex_init(&res->buckets[i].lock);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup_buckets;
 		res->buckets[i].task = NULL;
-		result = isc_task_create(taskmgr, 0, &res->buckets[i].task);
-		if (result != ISC_R_SUCCESS) {
-			DESTROYLOCK(&res->buckets[i].lock);
-			goto cleanup_buckets;
-		}
 		res->buckets[i].mctx = NULL;
-		snprintf(name, sizeof(name), "res%u", i);
+		if (i >= ntasks) {
+			/*
+			 * Share the task and memory context of an
+			 * earlier bucket.
+			 */
+			isc_task_attach(res->buckets[i % ntasks].task,
+					&res->buckets[i].task);
+			isc_mem_attach(res->buckets[i % ntasks].mctx,
+				       &res->buckets[i].mctx);
+		} else {
+			result = isc_task_create(taskmgr, 0,
+						 &res->buckets[i].task);
+			if (result != ISC_R_SUCCESS) {
+				DESTROYLOCK(&res->buckets[i].lock);
+				goto cleanup_buckets;
+			}
+			snprintf(name, sizeof(name), "res%u", i);
 #ifdef ISC_PLATFORM_USETHREADS
-		/*
-		 * Use a separate memory context for each bucket to reduce
-		 * contention among multiple threads.  Do this only when
-		 * enabling threads because it will be require more memory.
-		 */
-		result = isc_mem_create(0, 0, &res->buckets[i].mctx);
-		if (result != ISC_R_SUCCESS) {
+			/*
+			 * Use a separate memory context for each task to
+			 * reduce contention among multiple threads.  Do
+			 * this only when enabling threads because it will
+			 * be require more memory.
+			 */
+			result = isc_mem_create(0, 0, &res->buckets[i].mctx);
+			if (result != ISC_R_SUCCESS) {
+				isc_task_detach(&res->buckets[i].task);
+				DESTROYLOCK(&res->buckets[i].lock);
+				goto cleanup_buckets;
+			}
+			isc_mem_setname(res->buckets[i].mctx, name, NULL);
+#else
+			isc_mem_attach(view->mctx, &res->buckets[i].mctx);
+#endif
+			isc_task_setname(res->buckets[i].task, name, res);
+		}
+		ISC_LIST_INIT(res->buckets[i].fctxs);
+		res->buckets[i].hashsize = RES_FCTX_HASHSIZE;
+		res->buckets[i].count = 0;
+		res->buckets[i].table =
+			isc_mem_get(res->buckets[i].mctx,
+				    RES_FCTX_HASHSIZE *
+				    sizeof(*res->buckets[i].table));
+		if (res->buckets[i].table == NULL) {
+			isc_mem_detach(&res->buckets[i].mctx);
+			isc_task_shutdown(res->buckets[i].task);
 			isc_task_detach(&res->buckets[i].task);
 			DESTROYLOCK(&res->buckets[i].lock);
+			result = ISC_R_NOMEMORY;
 			goto cleanup_buckets;
 		}
-		isc_mem_setname(res->buckets[i].mctx, name, NULL);
-#else
-		isc_mem_attach(view->mctx, &res->buckets[i].mctx);
-#endif
-		isc_task_setname(res->buckets[i].task, name, res);
-		ISC_LIST_INIT(res->buckets[i].fctxs);
+		for (j = 0; j < RES_FCTX_HASHSIZE; j++)
+			ISC_LIST_INIT(res->buckets[i].table[j]);
 		res->buckets[i].exiting = ISC_FALSE;
 		buckets_created++;
 	}
@@ -9063,6 +9194,9 @@ dns_resolver_create(dns_view_t *view,
 
  cleanup_buckets:
 	for (i = 0; i < buckets_created; i++) {
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].table,
+			    res->buckets[i].hashsize *
+			    sizeof(*res->buckets[i].table));
 		isc_mem_detach(&res->buckets[i].mctx);
 		DESTROYLOCK(&res->buckets[i].lock);
 		isc_task_shutdown(res->buckets[i].task);
@@ -9335,6 +9469,33 @@ fctx_match(fetchctx_t *fctx, dns_name_t *name, dns_rdatatype_t type,
 	return (dns_name_equal(&fctx->name, name));
 }
 
+static inline unsigned int
+fctx_hash(dns_name_t *name, dns_rdatatype_t type) {
+	return (dns_name_fullhash(name, ISC_FALSE) ^ (type * 0x9e3779b1U));
+}
+
+/*
+ * Find a running fetch context for 'name', 'type' and 'options' that
+ * a new fetch can join.
+ *
+ * Caller must be holding the bucket lock.
+ */
+static fetchctx_t *
+bucket_find(fctxbucket_t *bucket, unsigned int hashval, dns_name_t *name,
+	    dns_rdatatype_t type, unsigned int options)
+{
+	fetchctx_t *fctx;
+
+	for (fctx = ISC_LIST_HEAD(bucket->table[FCTX_CHAIN(bucket, hashval)]);
+	     fctx != NULL;
+	     fctx = ISC_LIST_NEXT(fctx, hlink)) {
+		if (fctx->hashval == hashval &&
+		    fctx_match(fctx, name, type, options))
+			break;
+	}
+	return (fctx);
+}
+
 static inline void
 log_fetch(dns_name_t *name, dns_rdatatype_t type) {
 	char namebuf[DNS_NAME_FORMATSIZE];
@@ -9407,7 +9568,7 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 	dns_fetch_t *fetch;
 	fetchctx_t *fctx = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int bucketnum;
+	unsigned int hashval, bucketnum;
 	isc_boolean_t new_fctx = ISC_FALSE;
 	isc_event_t *event;
 	unsigned int count = 0;
@@ -9442,7 +9603,8 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 	fetch->mctx = NULL;
 	isc_mem_attach(res->mctx, &fetch->mctx);
 
-	bucketnum = dns_name_fullhash(name, ISC_FALSE) % res->nbuckets;
+	hashval = fctx_hash(name, type);
+	bucketnum = hashval % res->nbuckets;
 
 	LOCK(&res->lock);
 	spillat = res->spillat;
@@ -9455,14 +9617,9 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 		goto unlock;
 	}
 
-	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
-		for (fctx = ISC_LIST_HEAD(res->buckets[bucketnum].fctxs);
-		     fctx != NULL;
-		     fctx = ISC_LIST_NEXT(fctx, link)) {
-			if (fctx_match(fctx, name, type, options))
-				break;
-		}
-	}
+	if ((options & DNS_FETCHOPT_UNSHARED) == 0)
+		fctx = bucket_find(&res->buckets[bucketnum], hashval,
+				   name, type, options);
 
 	/*
 	 * Is this a duplicate?
@@ -9492,7 +9649,8 @@ dns_resolver_createfetch3(dns_resolver_t *res, dns_name_t *name,
 
 	if (fctx == NULL) {
 		result = fctx_create(res, name, type, domain, nameservers,
-				     options, bucketnum, depth, qc, &fctx);
+				     options, hashval, bucketnum, depth, qc,
+				     &fctx);
 		if (result != ISC_R_SUCCESS)
 			goto unlock;
 		new_fctx = ISC_TRUE;
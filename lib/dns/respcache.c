@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/list.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/stats.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+#include <dns/stats.h>
+#include <dns/types.h>
+
+/*
+ * The number of independently locked stripes; a power of two.
+ */
+#define RESPCACHE_STRIPES	16
+
+typedef struct dns_rcentry dns_rcentry_t;
+
+typedef struct rcstripe {
+	isc_mutex_t		lock;
+	dns_rcentry_t		**table;
+	unsigned int		count;
+	ISC_LIST(dns_rcentry_t)	lru;		/* most recently used first */
+} rcstripe_t;
+
+struct dns_respcache {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	isc_refcount_t		references;
+
+	unsigned int		size;		/* per stripe; power of two */
+	unsigned int		maxentries;	/* per stripe */
+	/*% Changed with every stripe locked; read with any one locked. */
+	unsigned int		generation;
+	rcstripe_t		stripes[RESPCACHE_STRIPES];
+};
+
+#define RESPCACHE_MAGIC			ISC_MAGIC('R', 's', 'p', 'C')
+#define VALID_RESPCACHE(c)		ISC_MAGIC_VALID(c, RESPCACHE_MAGIC)
+
+#define STRIPE(c, h)	(&(c)->stripes[(h) & (RESPCACHE_STRIPES - 1)])
+#define BUCKET(c, s, h)	(&(s)->table[((h) / RESPCACHE_STRIPES) & \
+				     ((c)->size - 1)])
+
+/*
+ * An entry is allocated in one piece: the structure is followed by
+ * the query name in wire format and then by the response, less its
+ * two-octet message ID.
+ */
+struct dns_rcentry {
+	dns_rcentry_t *		next;
+	ISC_LINK(dns_rcentry_t)	link;
+	unsigned int		hashval;
+	dns_rdatatype_t		qtype;
+	dns_rdataclass_t	qclass;
+	unsigned int		flags;
+	isc_uint16_t		udpsize;
+	unsigned int		namelen;
+	unsigned int		length;
+	dns_respcacheinfo_t	info;
+};
+
+#define ENTRY_NAME(e)		((unsigned char *)((e) + 1))
+#define ENTRY_DATA(e)		(ENTRY_NAME(e) + (e)->namelen)
+#define ENTRY_SIZE(e)		(sizeof(*(e)) + (e)->namelen + (e)->length)
+
+static unsigned int
+key_hash(const dns_respcachekey_t *key) {
+	isc_uint32_t hashval;
+
+	hashval = isc_hash_function(key->qname->ndata, key->qname->length,
+				    ISC_TRUE, NULL);
+	return (hashval ^ (key->qtype << 16) ^ key->flags ^ key->udpsize);
+}
+
+static isc_boolean_t
+key_match(dns_rcentry_t *entry, unsigned int hashval,
+	  const dns_respcachekey_t *key)
+{
+	return (ISC_TF(entry->hashval == hashval &&
+		       entry->qtype == key->qtype &&
+		       entry->qclass == key->qclass &&
+		       entry->flags == key->flags &&
+		       entry->udpsize == key->udpsize &&
+		       entry->namelen == key->qname->length &&
+		       memcmp(ENTRY_NAME(entry), key->qname->ndata,
+			      entry->namelen) == 0));
+}
+
+static void
+entry_free(dns_respcache_t *cache, dns_rcentry_t *entry) {
+	if (entry->info.zonestats != NULL)
+		isc_stats_detach(&entry->info.zonestats);
+	if (entry->info.querystats != NULL)
+		dns_stats_detach(&entry->info.querystats);
+	isc_mem_put(cache->mctx, entry, ENTRY_SIZE(entry));
+}
+
+/*
+ * Unlink 'entry' from its bucket and from the LRU list.
+ * Requires the stripe lock.
+ */
+static void
+entry_unlink(dns_respcache_t *cache, rcstripe_t *stripe,
+	     dns_rcentry_t *entry)
+{
+	dns_rcentry_t **entryp;
+
+	entryp = BUCKET(cache, stripe, entry->hashval);
+	while (*entryp != entry) {
+		INSIST(*entryp != NULL);
+		entryp = &(*entryp)->next;
+	}
+	*entryp = entry->next;
+	ISC_LIST_UNLINK(stripe->lru, entry, link);
+	stripe->count--;
+}
+
+/*
+ * Free every entry of 'stripe'.  Requires the stripe lock, or that
+ * no one else can use the cache.
+ */
+static void
+stripe_flush(dns_respcache_t *cache, rcstripe_t *stripe) {
+	dns_rcentry_t *entry;
+
+	while ((entry = ISC_LIST_HEAD(stripe->lru)) != NULL) {
+		ISC_LIST_UNLINK(stripe->lru, entry, link);
+		entry_free(cache, entry);
+	}
+	memset(stripe->table, 0, sizeof(*stripe->table) * cache->size);
+	stripe->count = 0;
+}
+
+static void
+stripes_destroy(dns_respcache_t *cache, unsigned int n) {
+	rcstripe_t *stripe;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		stripe = &cache->stripes[i];
+		stripe_flush(cache, stripe);
+		isc_mem_put(cache->mctx, stripe->table,
+			    sizeof(*stripe->table) * cache->size);
+		DESTROYLOCK(&stripe->lock);
+	}
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int maxentries,
+		     dns_respcache_t **cachep)
+{
+	isc_result_t result;
+	dns_respcache_t *cache;
+	rcstripe_t *stripe;
+	unsigned int i, size;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxentries > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(cache, 0, sizeof(*cache));
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_cache;
+
+	/*
+	 * Split the entries evenly over the stripes, with one bucket
+	 * per entry rounded up to a power of two.
+	 */
+	maxentries = (maxentries + RESPCACHE_STRIPES - 1) / RESPCACHE_STRIPES;
+	for (size = 16; size < maxentries && size < (1U << 20); size <<= 1)
+		;
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->size = size;
+	cache->maxentries = maxentries;
+	cache->generation = 0;
+
+	for (i = 0; i < RESPCACHE_STRIPES; i++) {
+		stripe = &cache->stripes[i];
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_stripes;
+		stripe->table = isc_mem_get(mctx,
+					    sizeof(*stripe->table) * size);
+		if (stripe->table == NULL) {
+			DESTROYLOCK(&stripe->lock);
+			result = ISC_R_NOMEMORY;
+			goto cleanup_stripes;
+		}
+		memset(stripe->table, 0, sizeof(*stripe->table) * size);
+		stripe->count = 0;
+		ISC_LIST_INIT(stripe->lru);
+	}
+
+	cache->magic = RESPCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_stripes:
+	stripes_destroy(cache, i);
+	isc_mem_detach(&cache->mctx);
+	isc_refcount_decrement(&cache->references, NULL);
+	isc_refcount_destroy(&cache->references);
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_respcache_attach(dns_respcache_t *source, dns_respcache_t **targetp) {
+	REQUIRE(VALID_RESPCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_respcache_detach(dns_respcache_t **cachep) {
+	dns_respcache_t *cache;
+	unsigned int refs;
+
+	REQUIRE(cachep != NULL && VALID_RESPCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	isc_refcount_decrement(&cache->references, &refs);
+	if (refs != 0)
+		return;
+
+	cache->magic = 0;
+	stripes_destroy(cache, RESPCACHE_STRIPES);
+	isc_refcount_destroy(&cache->references);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+unsigned int
+dns_respcache_generation(dns_respcache_t *cache) {
+	rcstripe_t *stripe;
+	unsigned int generation;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+
+	stripe = &cache->stripes[0];
+	LOCK(&stripe->lock);
+	generation = cache->generation;
+	UNLOCK(&stripe->lock);
+
+	return (generation);
+}
+
+void
+dns_respcache_flush(dns_respcache_t *cache) {
+	unsigned int i;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+
+	/*
+	 * Hold every stripe while the generation changes, so that an
+	 * add checking it under its own stripe's lock cannot slip a
+	 * stale response in after that stripe has been emptied.
+	 */
+	for (i = 0; i < RESPCACHE_STRIPES; i++)
+		LOCK(&cache->stripes[i].lock);
+	cache->generation++;
+	for (i = 0; i < RESPCACHE_STRIPES; i++)
+		stripe_flush(cache, &cache->stripes[i]);
+	for (i = RESPCACHE_STRIPES; i-- > 0; )
+		UNLOCK(&cache->stripes[i].lock);
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const dns_respcachekey_t *key,
+		   dns_messageid_t id, isc_buffer_t *target,
+		   dns_respcacheinfo_t *info)
+{
+	rcstripe_t *stripe;
+	dns_rcentry_t *entry;
+	unsigned int hashval;
+	isc_result_t result;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(key != NULL && dns_name_isabsolute(key->qname));
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	hashval = key_hash(key);
+	stripe = STRIPE(cache, hashval);
+
+	LOCK(&stripe->lock);
+	for (entry = *BUCKET(cache, stripe, hashval);
+	     entry != NULL;
+	     entry = entry->next)
+	{
+		if (key_match(entry, hashval, key))
+			break;
+	}
+	if (entry == NULL) {
+		result = ISC_R_NOTFOUND;
+		goto unlock;
+	}
+
+	if (isc_buffer_availablelength(target) < entry->length + 2) {
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+
+	isc_buffer_putuint16(target, id);
+	isc_buffer_putmem(target, ENTRY_DATA(entry), entry->length);
+
+	if (info != NULL) {
+		info->counter = entry->info.counter;
+		info->zonestats = NULL;
+		if (entry->info.zonestats != NULL)
+			isc_stats_attach(entry->info.zonestats,
+					 &info->zonestats);
+		info->querystats = NULL;
+		if (entry->info.querystats != NULL)
+			dns_stats_attach(entry->info.querystats,
+					 &info->querystats);
+	}
+
+	if (entry != ISC_LIST_HEAD(stripe->lru)) {
+		ISC_LIST_UNLINK(stripe->lru, entry, link);
+		ISC_LIST_PREPEND(stripe->lru, entry, link);
+	}
+	result = ISC_R_SUCCESS;
+
+ unlock:
+	UNLOCK(&stripe->lock);
+	return (result);
+}
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *cache, unsigned int generation,
+		  const dns_respcachekey_t *key, const isc_region_t *response,
+		  const dns_respcacheinfo_t *info)
+{
+	rcstripe_t *stripe;
+	dns_rcentry_t *entry, *old, *evicted = NULL;
+	dns_rcentry_t **bucket;
+	unsigned int hashval, namelen, length;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(key != NULL && dns_name_isabsolute(key->qname));
+	REQUIRE(response != NULL && response->length >= DNS_MESSAGE_HEADERLEN);
+
+	/*
+	 * Build the entry before taking the lock; a stale generation
+	 * is rare enough that the wasted work does not matter.
+	 */
+	namelen = key->qname->length;
+	length = response->length - 2;
+	entry = isc_mem_get(cache->mctx, sizeof(*entry) + namelen + length);
+	if (entry == NULL)
+		return (ISC_R_NOMEMORY);
+
+	hashval = key_hash(key);
+	entry->next = NULL;
+	ISC_LINK_INIT(entry, link);
+	entry->hashval = hashval;
+	entry->qtype = key->qtype;
+	entry->qclass = key->qclass;
+	entry->flags = key->flags;
+	entry->udpsize = key->udpsize;
+	entry->namelen = namelen;
+	entry->length = length;
+	memmove(ENTRY_NAME(entry), key->qname->ndata, namelen);
+	memmove(ENTRY_DATA(entry), response->base + 2, length);
+
+	entry->info.counter = 0;
+	entry->info.zonestats = NULL;
+	entry->info.querystats = NULL;
+	if (info != NULL) {
+		entry->info.counter = info->counter;
+		if (info->zonestats != NULL)
+			isc_stats_attach(info->zonestats,
+					 &entry->info.zonestats);
+		if (info->querystats != NULL)
+			dns_stats_attach(info->querystats,
+					 &entry->info.querystats);
+	}
+
+	stripe = STRIPE(cache, hashval);
+	LOCK(&stripe->lock);
+	if (generation != cache->generation) {
+		UNLOCK(&stripe->lock);
+		entry_free(cache, entry);
+		return (ISC_R_CANCELED);
+	}
+
+	bucket = BUCKET(cache, stripe, hashval);
+	for (old = *bucket; old != NULL; old = old->next) {
+		if (key_match(old, hashval, key))
+			break;
+	}
+	if (old != NULL) {
+		entry_unlink(cache, stripe, old);
+	} else if (stripe->count >= cache->maxentries) {
+		old = ISC_LIST_TAIL(stripe->lru);
+		entry_unlink(cache, stripe, old);
+	}
+	evicted = old;
+
+	entry->next = *bucket;
+	*bucket = entry;
+	ISC_LIST_PREPEND(stripe->lru, entry, link);
+	stripe->count++;
+	UNLOCK(&stripe->lock);
+
+	if (evicted != NULL)
+		entry_free(cache, evicted);
+
+	return (ISC_R_SUCCESS);
+}
@@ -1325,7 +1325,11 @@ static dns_dbmethods_t sdlzdb_methods = {
 	NULL,			/* setcachestats */
 	NULL,			/* hashsize */
 	NULL,			/* nodefullname */
-	NULL			/* getsize */
+	NULL,			/* getsize */
+	NULL,			/* presize */
+	NULL,			/* expire */
+	NULL,			/* setservestalettl */
+	NULL			/* getservestalettl */
 };
 
 /*
@@ -122,7 +122,7 @@ dns_stats_detach(dns_stats_t **statsp) {
  */
 static isc_result_t
 create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
-	     dns_stats_t **statsp)
+	     unsigned int options, dns_stats_t **statsp)
 {
 	dns_stats_t *stats;
 	isc_result_t result;
@@ -138,7 +138,7 @@ create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	result = isc_stats_create(mctx, &stats->counters, ncounters);
+	result = isc_stats_create2(mctx, &stats->counters, ncounters, options);
 	if (result != ISC_R_SUCCESS)
 		goto clean_mutex;
 
@@ -162,7 +162,8 @@ isc_result_t
 dns_generalstats_create(isc_mem_t *mctx, dns_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_general, ncounters, statsp));
+	return (create_stats(mctx, dns_statstype_general, ncounters, 0,
+			     statsp));
 }
 
 isc_result_t
@@ -170,7 +171,17 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rdtype, rdtypecounter_max,
-			     statsp));
+			     0, statsp));
+}
+
+isc_result_t
+dns_rdatatypestats_create2(isc_mem_t *mctx, dns_stats_t **statsp,
+			   unsigned int options)
+{
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, dns_statstype_rdtype, rdtypecounter_max,
+			     options, statsp));
 }
 
 isc_result_t
@@ -178,14 +189,15 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rdataset,
-			     rdatasettypecounter_max, statsp));
+			     rdatasettypecounter_max, 0, statsp));
 }
 
 isc_result_t
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_opcode, 16, statsp));
+	return (create_stats(mctx, dns_statstype_opcode, 16,
+			     ISC_STATS_SHARDED, statsp));
 }
 
 isc_result_t
@@ -193,7 +205,8 @@ dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rcode,
-			     dns_rcode_badcookie + 1, statsp));
+			     dns_rcode_badcookie + 1, ISC_STATS_SHARDED,
+			     statsp));
 }
 
 /*%
@@ -17,10 +17,25 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+#include <isc/hash.h>
+#include <isc/print.h>
+#include <isc/stdio.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/task.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/journal.h>
+#include <dns/masterdump.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
 
 #include "dnstest.h"
 
@@ -32,10 +47,222 @@
 #define	BIGBUFLEN	(64 * 1024)
 #define TEST_ORIGIN	"test"
 
+#define NTHREADS	8
+#define NNAMES		2000
+
+#ifdef ISC_PLATFORM_USETHREADS
+/*
+ * Look up and create nodes, starting at a different name in each thread,
+ * so that readers and writers of the tree run concurrently.
+ */
+static dns_db_t *db_shared;
+static dns_dbnode_t *nodes[NTHREADS][NNAMES];
+
+static void *
+findnodes(void *arg) {
+	dns_db_t *db = db_shared;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t **node;
+	isc_buffer_t b;
+	isc_result_t result;
+	char namebuf[64];
+	int i, id, start;
+
+	id = *(int *)arg;
+	start = id * (NNAMES / NTHREADS);
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	for (i = 0; i < NNAMES; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.test.",
+			 (start + i) % NNAMES);
+		isc_buffer_constinit(&b, namebuf, strlen(namebuf));
+		isc_buffer_add(&b, strlen(namebuf));
+		result = dns_name_fromtext(name, &b, dns_rootname, 0, NULL);
+		if (result != ISC_R_SUCCESS)
+			return ((void *)1);
+		node = &nodes[id][(start + i) % NNAMES];
+		result = dns_db_findnode(db, name, ISC_FALSE, node);
+		if (result == ISC_R_NOTFOUND)
+			result = dns_db_findnode(db, name, ISC_TRUE, node);
+		if (result != ISC_R_SUCCESS)
+			return ((void *)1);
+	}
+
+	return (NULL);
+}
+#endif
+
+/*
+ * Add an A rdataset with the given TTL at 'name' to a cache, as if at
+ * time 'now'.
+ */
+static void
+addaddress(dns_db_t *db, const char *name, isc_stdtime_t now, dns_ttl_t ttl) {
+	static unsigned char address[4] = { 10, 53, 0, 1 };
+	dns_fixedname_t fixed;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_region_t r;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), name, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	r.base = address;
+	r.length = sizeof(address);
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a, &r);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), ISC_TRUE,
+				 &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
 /*
  * Individual unit tests
  */
 
+ATF_TC(addbatch);
+ATF_TC_HEAD(addbatch, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "add several rdatasets at once while loading");
+}
+ATF_TC_BODY(addbatch, tc) {
+	static const char *names[] = {
+		"a.test.", "a.test.", "b.test.", "*.w.test.", "*.test.",
+		"a.test."
+	};
+	static const dns_rdatatype_t types[] = {
+		dns_rdatatype_a, dns_rdatatype_txt, dns_rdatatype_soa,
+		dns_rdatatype_a, dns_rdatatype_ns, dns_rdatatype_a
+	};
+	static unsigned char data[][4] = {
+		{ 10, 53, 0, 1 }, { 3, 'a', 'b', 'c' }, { 0, 0, 0, 0 },
+		{ 10, 53, 0, 3 }, { 0, 0, 0, 0 }, { 10, 53, 0, 2 }
+	};
+	const isc_result_t expect[] = {
+		ISC_R_SUCCESS, ISC_R_SUCCESS, DNS_R_NOTZONETOP,
+		ISC_R_SUCCESS, DNS_R_INVALIDNS, ISC_R_SUCCESS
+	};
+#define NBATCH (sizeof(names) / sizeof(names[0]))
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	isc_mem_t *mymctx = NULL;
+	dns_fixedname_t fixed[NBATCH], origin;
+	dns_name_t *owners[NBATCH];
+	dns_rdata_t rdata[NBATCH];
+	dns_rdatalist_t rdatalist[NBATCH];
+	dns_rdataset_t rdatasets[NBATCH], rdataset;
+	dns_rdatacallbacks_t callbacks;
+	isc_result_t results[NBATCH];
+	isc_result_t result;
+	isc_region_t r;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&origin);
+	result = dns_name_fromstring(dns_fixedname_name(&origin), "test.",
+				     0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_create(mymctx, "rbt", dns_fixedname_name(&origin),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NBATCH; i++) {
+		dns_fixedname_init(&fixed[i]);
+		owners[i] = dns_fixedname_name(&fixed[i]);
+		result = dns_name_fromstring(owners[i], names[i], 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		r.base = data[i];
+		r.length = sizeof(data[i]);
+		dns_rdata_init(&rdata[i]);
+		dns_rdata_fromregion(&rdata[i], dns_rdataclass_in, types[i],
+				     &r);
+		dns_rdatalist_init(&rdatalist[i]);
+		rdatalist[i].rdclass = dns_rdataclass_in;
+		rdatalist[i].type = types[i];
+		rdatalist[i].ttl = 300;
+		ISC_LIST_APPEND(rdatalist[i].rdata, &rdata[i], link);
+		dns_rdataset_init(&rdatasets[i]);
+		result = dns_rdatalist_tordataset(&rdatalist[i],
+						  &rdatasets[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(callbacks.addbatch != NULL);
+
+	/* Each rdataset gets its own result; the first failure is returned. */
+	result = (*callbacks.addbatch)(callbacks.add_private, owners,
+				       rdatasets, results, NBATCH);
+	ATF_CHECK_EQ(result, DNS_R_NOTZONETOP);
+	for (i = 0; i < NBATCH; i++)
+		ATF_CHECK_EQ_MSG(results[i], expect[i], "%u: %s", i,
+				 isc_result_totext(results[i]));
+
+	result = dns_db_endload(db, &callbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Both A records at the same name were merged. */
+	result = dns_db_findnode(db, owners[0], ISC_FALSE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_a, 0, 0,
+				     &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		ATF_CHECK_EQ(dns_rdataset_count(&rdataset), 2);
+		dns_rdataset_disassociate(&rdataset);
+	}
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_txt, 0, 0,
+				     &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	result = dns_db_findnode(db, owners[3], ISC_FALSE, &node);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+	result = dns_db_findnode(db, owners[2], ISC_FALSE, &node);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+#undef NBATCH
+}
+
 ATF_TC(getoriginnode);
 ATF_TC_HEAD(getoriginnode, tc) {
 	atf_tc_set_md_var(tc, "descr",
@@ -69,10 +296,680 @@ ATF_TC_BODY(getoriginnode, tc) {
 	isc_mem_detach(&mymctx);
 }
 
+ATF_TC(nodelocks);
+ATF_TC_HEAD(nodelocks, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "set the number of cache node locks at creation");
+}
+ATF_TC_BODY(nodelocks, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	char *argv[2];
+	char count[16];
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	argv[0] = (char *)mymctx;
+	argv[1] = count;
+
+	strlcpy(count, "256", sizeof(count));
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 2, argv, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+
+	strlcpy(count, "1", sizeof(count));
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 2, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	strlcpy(count, "1024", sizeof(count));
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 2, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	strlcpy(count, "many", sizeof(count));
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 2, argv, &db);
+	ATF_CHECK_EQ(result, ISC_R_BADNUMBER);
+
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
+ATF_TC(concurrent);
+ATF_TC_HEAD(concurrent, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "find and create cache nodes from several threads");
+}
+ATF_TC_BODY(concurrent, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t threads[NTHREADS];
+	int ids[NTHREADS];
+	void *ret;
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	db_shared = db;
+
+	for (i = 0; i < NTHREADS; i++) {
+		ids[i] = i;
+		result = isc_thread_create(findnodes, &ids[i], &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		ret = NULL;
+		isc_thread_join(threads[i], &ret);
+		ATF_CHECK_EQ(ret, NULL);
+	}
+
+	/* The names and their common parent "test.". */
+	ATF_CHECK_EQ(dns_db_nodecount(db), NNAMES + 1);
+
+	for (i = 0; i < NTHREADS; i++) {
+		int j;
+
+		for (j = 0; j < NNAMES; j++)
+			if (nodes[i][j] != NULL)
+				dns_db_detachnode(db, &nodes[i][j]);
+	}
+
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+#else
+	UNUSED(tc);
+	atf_tc_skip("threads not enabled");
+#endif
+}
+
+ATF_TC(expire);
+ATF_TC_HEAD(expire, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "purge expired cache data in bounded increments");
+}
+ATF_TC_BODY(expire, tc) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_rdataset_t rdataset;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_stdtime_t now;
+	unsigned int count, total = 0, passes = 0;
+	size_t size, bytes = 0;
+	char name[64];
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * More expired names than there are node locks, so that at
+	 * least one lock holds two of them.
+	 */
+	isc_stdtime_get(&now);
+	addaddress(db, "live.test.", now, 3600);
+	for (i = 0; i < 40; i++) {
+		snprintf(name, sizeof(name), "n%d.test.", i);
+		addaddress(db, name, now - 1000, 10);
+	}
+
+	do {
+		count = 0;
+		size = 0;
+		result = dns_db_expire(db, now, 1, &count, &size);
+		ATF_REQUIRE(result == ISC_R_SUCCESS ||
+			    result == DNS_R_CONTINUE);
+		total += count;
+		bytes += size;
+		passes++;
+	} while (result == DNS_R_CONTINUE);
+
+	ATF_CHECK_EQ(total, 40);
+	ATF_CHECK(bytes > 0);
+	ATF_CHECK(passes > 1);
+
+	/* Nothing is left to purge. */
+	result = dns_db_expire(db, now, 100, &count, &size);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count, 0);
+	ATF_CHECK_EQ(size, 0);
+
+	/* Live data is untouched. */
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), "live.test.",
+				     0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), ISC_FALSE,
+				 &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_a, 0, now,
+				     &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_stdtime_t expire_now;
+static unsigned int expire_count;
+
+static void *
+expireall(void *arg) {
+	dns_db_t *db = arg;
+	isc_result_t result;
+
+	result = dns_db_expire(db, expire_now, 100, &expire_count, NULL);
+	return ((result == ISC_R_SUCCESS) ? NULL : (void *)1);
+}
+#endif
+
+ATF_TC(expire_reclaim);
+ATF_TC_HEAD(expire_reclaim, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "free the nodes a sweep empties while the tree "
+			  "is locked for reading");
+}
+ATF_TC_BODY(expire_reclaim, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *iter = NULL;
+	isc_thread_t thread;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	unsigned int before;
+	char name[64];
+	void *ret;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Many more names than a single cleanup_dead_nodes() call
+	 * frees from each node lock.
+	 */
+	isc_stdtime_get(&expire_now);
+	addaddress(db, "live.test.", expire_now, 3600);
+	before = dns_db_nodecount(db);
+	for (i = 0; i < 400; i++) {
+		snprintf(name, sizeof(name), "n%d.test.", i);
+		addaddress(db, name, expire_now - 1000, 10);
+	}
+
+	/*
+	 * An iterator holds the tree lock for reading, so the sweep
+	 * cannot free the nodes it empties as it goes; it waits for
+	 * the iterator to let go and frees them at the end.
+	 */
+	result = dns_db_createiterator(db, 0, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_first(iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_thread_create(expireall, db, &thread);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	usleep(200000);
+	dns_dbiterator_destroy(&iter);
+	ret = NULL;
+	isc_thread_join(thread, &ret);
+	ATF_CHECK_EQ(ret, NULL);
+
+	ATF_CHECK_EQ(expire_count, 400);
+	/* Only "test.", which the names split off, is left over. */
+	ATF_CHECK_EQ(dns_db_nodecount(db), before + 1);
+
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+#else
+	UNUSED(tc);
+	atf_tc_skip("threads not enabled");
+#endif
+}
+
+/*
+ * Create 'count' empty nodes and release them while an iterator holds
+ * the tree lock for reading, so that they cannot be freed at once.  They
+ * must still go away afterwards, though nothing else touches 'db'.
+ */
+static void
+releasenodes(dns_db_t *db, int count) {
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node[100];
+	dns_fixedname_t fixed;
+	isc_result_t result;
+	unsigned int before;
+	char name[64];
+	int i;
+
+	REQUIRE(count <= 100);
+
+	before = dns_db_nodecount(db);
+	dns_fixedname_init(&fixed);
+	for (i = 0; i < count; i++) {
+		snprintf(name, sizeof(name), "n%d.test.", i);
+		result = dns_name_fromstring(dns_fixedname_name(&fixed), name,
+					     0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		node[i] = NULL;
+		result = dns_db_findnode(db, dns_fixedname_name(&fixed),
+					 ISC_TRUE, &node[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	result = dns_db_createiterator(db, 0, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_first(iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < count; i++)
+		dns_db_detachnode(db, &node[i]);
+	dns_dbiterator_destroy(&iter);
+
+	for (i = 0; i < 50 && dns_db_nodecount(db) != before; i++)
+		usleep(100000);
+	ATF_CHECK_EQ(dns_db_nodecount(db), before);
+}
+
+ATF_TC(deadnodes);
+ATF_TC_HEAD(deadnodes, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "free the nodes released while the tree is locked "
+			  "for reading");
+}
+ATF_TC_BODY(deadnodes, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_taskmgr_t *taskmgr = NULL;
+	isc_task_t *task = NULL;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_taskmgr_create(mymctx, 1, 0, &taskmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_settask(db, task);
+
+	/*
+	 * Split off "test." first, so that the iterator does not rest on
+	 * a node being released and freeing them leaves the tree as it was.
+	 */
+	isc_stdtime_get(&now);
+	addaddress(db, "a.test.", now, 3600);
+	addaddress(db, "b.test.", now, 3600);
+
+	/*
+	 * A single node, whose bucket has no other references left, and
+	 * more than are reclaimed from a bucket in one go.
+	 */
+	releasenodes(db, 1);
+	releasenodes(db, 100);
+
+	dns_db_detach(&db);
+	isc_task_detach(&task);
+	isc_taskmgr_destroy(&taskmgr);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
+ATF_TC(servestale);
+ATF_TC_HEAD(servestale, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "expired cache data is kept and found on request "
+			  "for the stale window");
+}
+ATF_TC_BODY(servestale, tc) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed, found;
+	dns_rdataset_t rdataset;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_stdtime_t now;
+	dns_ttl_t ttl;
+	unsigned int count;
+	size_t size;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_getservestalettl(db, &ttl);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(ttl, 0);
+	result = dns_db_setservestalettl(db, 3600);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_getservestalettl(db, &ttl);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(ttl, 3600);
+
+	/* Expired 990 seconds ago: inside the stale window. */
+	isc_stdtime_get(&now);
+	addaddress(db, "stale.test.", now - 1000, 10);
+
+	dns_fixedname_init(&fixed);
+	dns_fixedname_init(&found);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed),
+				     "stale.test.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* An ordinary lookup does not see it... */
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, 0, now, NULL,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+
+	/* ...nor does the sweeper or the cache cleaner purge it... */
+	result = dns_db_expire(db, now, 100, &count, &size);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count, 0);
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), ISC_FALSE,
+				 &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_expirenode(db, node, now);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+
+	/* ...but a lookup that accepts stale data finds it. */
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, DNS_DBFIND_STALEOK, now, NULL,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		ATF_CHECK((rdataset.attributes &
+			   DNS_RDATASETATTR_STALE) != 0);
+		ATF_CHECK(rdataset.ttl <= 3600 - 990);
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	/* Once the stale window has passed it is purged. */
+	result = dns_db_expire(db, now + 3600, 100, &count, &size);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count, 1);
+
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, DNS_DBFIND_STALEOK, now, NULL,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
+ATF_TC(agettl);
+ATF_TC_HEAD(agettl, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a raw cache dump is loaded with its TTLs aged");
+}
+ATF_TC_BODY(agettl, tc) {
+	dns_db_t *db = NULL;
+	dns_fixedname_t fixed, found;
+	dns_rdataset_t rdataset;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_stdtime_t now;
+	unsigned char dumptime[4];
+	FILE *f = NULL;
+	const char *file = "agettl.raw";
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	addaddress(db, "long.test.", now, 3600);
+	addaddress(db, "short.test.", now, 50);
+
+	result = dns_master_dump2(mymctx, db, NULL, &dns_master_style_cache,
+				  file, dns_masterformat_raw);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+
+	/*
+	 * Pretend the file was written 100 seconds ago: the dump time
+	 * follows the format and version words of the header.
+	 */
+	now -= 100;
+	dumptime[0] = (now >> 24) & 0xff;
+	dumptime[1] = (now >> 16) & 0xff;
+	dumptime[2] = (now >> 8) & 0xff;
+	dumptime[3] = now & 0xff;
+	result = isc_stdio_open(file, "r+b", &f);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_seek(f, 8, SEEK_SET);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_write(dumptime, 1, sizeof(dumptime), f, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_close(f);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_load2(db, file, dns_masterformat_raw);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	dns_fixedname_init(&fixed);
+	dns_fixedname_init(&found);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_name_fromstring(dns_fixedname_name(&fixed),
+				     "long.test.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, 0, now, NULL,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		ATF_CHECK(rdataset.ttl <= 3500);
+		ATF_CHECK(rdataset.ttl > 3400);
+		ATF_CHECK(rdataset.trust <= dns_trust_answer);
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	/* Data that expired after the dump is not loaded. */
+	result = dns_name_fromstring(dns_fixedname_name(&fixed),
+				     "short.test.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, 0, now, NULL,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+
+	dns_db_detach(&db);
+	unlink(file);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
+static void
+water(void *arg, int mark) {
+	UNUSED(arg);
+	UNUSED(mark);
+}
+
+static isc_boolean_t
+findaddress(dns_db_t *db, const char *name, isc_stdtime_t now) {
+	dns_fixedname_t fixed, found;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	dns_fixedname_init(&found);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), name, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL,
+			     dns_rdatatype_a, 0, now, NULL,
+			     dns_fixedname_name(&found), &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	return (ISC_TF(result == ISC_R_SUCCESS));
+}
+
+ATF_TC(lru);
+ATF_TC_HEAD(lru, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "names used again survive a burst of names used once");
+}
+ATF_TC_BODY(lru, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	isc_stdtime_t now;
+	size_t inuse;
+	char name[64];
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_hash_create(mymctx, NULL, 256);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Added a while ago and used again now: this promotes it.
+	 */
+	isc_stdtime_get(&now);
+	addaddress(db, "hot.test.", now - 10, 3600);
+	ATF_REQUIRE(findaddress(db, "hot.test.", now));
+
+	/*
+	 * Names that are never used again; all of them were used more
+	 * recently than hot.test.
+	 */
+	for (i = 0; i < 200; i++) {
+		snprintf(name, sizeof(name), "n%d.test.", i);
+		addaddress(db, name, now, 3600);
+	}
+
+	/*
+	 * Go over the memory limit; each further addition purges.  The
+	 * low water mark is far enough down that purging does not end
+	 * the overmem condition.
+	 */
+	inuse = isc_mem_inuse(mymctx);
+	isc_mem_setwater(mymctx, water, NULL, inuse + 1, inuse / 2);
+	for (i = 200; i < 250; i++) {
+		snprintf(name, sizeof(name), "n%d.test.", i);
+		addaddress(db, name, now, 3600);
+	}
+	ATF_CHECK(isc_mem_isovermem(mymctx));
+
+	ATF_CHECK(!findaddress(db, "n0.test.", now));
+	ATF_CHECK(findaddress(db, "hot.test.", now));
+
+	isc_mem_setwater(mymctx, NULL, NULL, 0, 0);
+	dns_db_detach(&db);
+	isc_hash_destroy();
+	isc_mem_detach(&mymctx);
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, getoriginnode);
+	ATF_TP_ADD_TC(tp, nodelocks);
+	ATF_TP_ADD_TC(tp, concurrent);
+	ATF_TP_ADD_TC(tp, expire);
+	ATF_TP_ADD_TC(tp, expire_reclaim);
+	ATF_TP_ADD_TC(tp, deadnodes);
+	ATF_TP_ADD_TC(tp, servestale);
+	ATF_TP_ADD_TC(tp, agettl);
+	ATF_TP_ADD_TC(tp, lru);
+	ATF_TP_ADD_TC(tp, addbatch);
 	return (atf_no_error());
 }
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/base64.h>
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/keycache.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatastruct.h>
+#include <dns/rdatatype.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+/*
+ * The cache does not care what kind of key it holds, so use HMAC keys,
+ * which can be built whatever crypto library is available.
+ */
+static const char *keystr1 = "Y2FjaGVkIGtleSBudW1iZXIgb25l";
+static const char *keystr2 = "Y2FjaGVkIGtleSBudW1iZXIgdHdv";
+
+/*
+ * Helper functions
+ */
+
+static dns_name_t *
+str2name(const char *namestr, dns_fixedname_t *fname) {
+	isc_result_t result;
+
+	dns_fixedname_init(fname);
+	result = dns_name_fromstring(dns_fixedname_name(fname), namestr, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (dns_fixedname_name(fname));
+}
+
+/*
+ * Build a DNSKEY rdata with 'flags' and key material 'keystr' in 'buf'.
+ */
+static void
+make_rdata(isc_uint16_t flags, const char *keystr, unsigned char *buf,
+	   size_t size, dns_rdata_t *rdata)
+{
+	dns_rdata_dnskey_t keystruct;
+	unsigned char keydata[4096];
+	isc_buffer_t keydatabuf, rrdatabuf;
+	isc_region_t r;
+
+	keystruct.common.rdclass = dns_rdataclass_in;
+	keystruct.common.rdtype = dns_rdatatype_dnskey;
+	keystruct.mctx = NULL;
+	ISC_LINK_INIT(&keystruct.common, link);
+	keystruct.flags = flags;
+	keystruct.protocol = 3;
+	keystruct.algorithm = DST_ALG_HMACSHA256;
+
+	isc_buffer_init(&keydatabuf, keydata, sizeof(keydata));
+	ATF_REQUIRE_EQ(isc_base64_decodestring(keystr, &keydatabuf),
+		       ISC_R_SUCCESS);
+	isc_buffer_usedregion(&keydatabuf, &r);
+	keystruct.datalen = r.length;
+	keystruct.data = r.base;
+
+	isc_buffer_init(&rrdatabuf, buf, (unsigned int)size);
+	dns_rdata_init(rdata);
+	ATF_REQUIRE_EQ(dns_rdata_fromstruct(rdata, dns_rdataclass_in,
+					    dns_rdatatype_dnskey,
+					    &keystruct, &rrdatabuf),
+		       ISC_R_SUCCESS);
+}
+
+static dst_key_t *
+get(dns_keycache_t *cache, const char *owner, dns_rdata_t *rdata) {
+	dns_fixedname_t fname;
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	result = dns_keycache_get(cache, str2name(owner, &fname), rdata,
+				  &key);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(key != NULL);
+	return (key);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(get);
+ATF_TC_HEAD(get, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a key is parsed once and then shared");
+}
+ATF_TC_BODY(get, tc) {
+	dns_keycache_t *cache = NULL;
+	unsigned char buf1[1024], buf2[1024], buf3[1024];
+	dns_rdata_t rdata1, rdata2, rdata3;
+	dst_key_t *key1, *key2, *key3;
+	dns_fixedname_t fname;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_keycache_create(mctx, 10, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	make_rdata(257, keystr1, buf1, sizeof(buf1), &rdata1);
+	make_rdata(257, keystr2, buf2, sizeof(buf2), &rdata2);
+	make_rdata(256, keystr1, buf3, sizeof(buf3), &rdata3);
+
+	key1 = get(cache, "example.com", &rdata1);
+	ATF_CHECK(dns_name_equal(dst_key_name(key1),
+				 str2name("example.com", &fname)));
+	ATF_CHECK_EQ(dst_key_alg(key1), DST_ALG_HMACSHA256);
+
+	/* The same record gives the same key, whatever the case. */
+	key2 = get(cache, "EXAMPLE.com", &rdata1);
+	ATF_CHECK_EQ(key1, key2);
+	dst_key_free(&key2);
+
+	/* A different owner, key or flags gives a different key. */
+	key2 = get(cache, "example.org", &rdata1);
+	ATF_CHECK(key1 != key2);
+	ATF_CHECK(dns_name_equal(dst_key_name(key2),
+				 str2name("example.org", &fname)));
+	dst_key_free(&key2);
+	key2 = get(cache, "example.com", &rdata2);
+	ATF_CHECK(key1 != key2);
+	dst_key_free(&key2);
+	key3 = get(cache, "example.com", &rdata3);
+	ATF_CHECK(key1 != key3);
+	ATF_CHECK_EQ(dst_key_flags(key3), 256);
+	dst_key_free(&key3);
+
+	/* A key outlives the cache while it is in use. */
+	dns_keycache_detach(&cache);
+	ATF_CHECK_EQ(cache, NULL);
+	ATF_CHECK_EQ(dst_key_flags(key1), 257);
+	dst_key_free(&key1);
+
+	dns_test_end();
+}
+
+ATF_TC(lru);
+ATF_TC_HEAD(lru, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "the least recently used key is dropped");
+}
+ATF_TC_BODY(lru, tc) {
+	dns_keycache_t *cache = NULL;
+	unsigned char buf[1024];
+	dns_rdata_t rdata;
+	dst_key_t *keys[4], *key;
+	char name[32];
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_keycache_create(mctx, 3, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	make_rdata(257, keystr1, buf, sizeof(buf), &rdata);
+	for (i = 0; i < 3; i++) {
+		snprintf(name, sizeof(name), "n%u.example", i);
+		keys[i] = get(cache, name, &rdata);
+	}
+
+	/* Use n0, so that n1 is now the oldest. */
+	key = get(cache, "n0.example", &rdata);
+	ATF_CHECK_EQ(key, keys[0]);
+	dst_key_free(&key);
+
+	keys[3] = get(cache, "n3.example", &rdata);
+
+	key = get(cache, "n1.example", &rdata);
+	ATF_CHECK(key != keys[1]);
+	dst_key_free(&key);
+	key = get(cache, "n3.example", &rdata);
+	ATF_CHECK_EQ(key, keys[3]);
+	dst_key_free(&key);
+
+	for (i = 0; i < 4; i++)
+		dst_key_free(&keys[i]);
+	dns_keycache_detach(&cache);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, get);
+	ATF_TP_ADD_TC(tp, lru);
+
+	return (atf_no_error());
+}
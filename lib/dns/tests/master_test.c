@@ -17,6 +17,9 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <isc/app.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/xml.h>
 
@@ -653,6 +656,314 @@ ATF_TC_BODY(neworigin, tc) {
 	dns_test_end();
 }
 
+/*
+ * Parallel load tests
+ */
+
+#define BIGZONE		"parallel.data"
+#define BIGZONE_NAMES	16000
+
+static unsigned int load_count;
+static isc_uint32_t load_sum;
+static const char *error_expect_value;
+static isc_boolean_t error_expect_result;
+
+/*
+ * Count the records loaded, and sum a hash of each rdataset so that
+ * two loads can be compared whatever order the rdatasets arrive in.
+ * If 'arg' is not NULL it is a lock shared by loads running at once.
+ */
+static isc_result_t
+sum_callback(void *arg, dns_name_t *owner, dns_rdataset_t *dataset) {
+	char buf[BIGBUFLEN];
+	isc_buffer_t target;
+	isc_result_t result;
+	isc_uint32_t h = 2166136261U;
+	unsigned int i;
+
+	isc_buffer_init(&target, buf, BIGBUFLEN);
+	result = dns_rdataset_totext(dataset, owner, ISC_FALSE, ISC_FALSE,
+				     &target);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	for (i = 0; i < isc_buffer_usedlength(&target); i++)
+		h = (h ^ (unsigned char)buf[i]) * 16777619U;
+	if (arg != NULL)
+		LOCK((isc_mutex_t *)arg);
+	load_sum += h;
+	load_count += dns_rdataset_count(dataset);
+	if (arg != NULL)
+		UNLOCK((isc_mutex_t *)arg);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+error_expect(struct dns_rdatacallbacks *mycallbacks, const char *fmt, ...) {
+	char buf[4096];
+	va_list ap;
+
+	UNUSED(mycallbacks);
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (error_expect_value != NULL &&
+	    strstr(buf, error_expect_value) != NULL)
+		error_expect_result = ISC_TRUE;
+}
+
+static void
+emit(FILE *f, unsigned long *linep, const char *fmt, ...) {
+	char buf[1024];
+	va_list ap;
+	char *p;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	fputs(buf, f);
+	for (p = buf; *p != '\0'; p++)
+		if (*p == '\n')
+			(*linep)++;
+}
+
+/*
+ * Write a zone big enough to be split, using the syntax that affects
+ * where it can be split.  If 'bad' is non-zero an invalid record is
+ * written before name number 'bad'; return the line it is on.
+ */
+static unsigned long
+write_bigzone(unsigned int bad) {
+	FILE *f;
+	unsigned long line = 1, badline = 0;
+	unsigned int i;
+
+	f = fopen(BIGZONE, "w");
+	ATF_REQUIRE(f != NULL);
+
+	emit(f, &line, "$TTL 300\n");
+	emit(f, &line, "@ SOA ns hostmaster. ( 1 3600 ; serial, refresh\n"
+		       "\t600 86400 300 )\n");
+	emit(f, &line, "@ NS ns\nns A 192.0.2.1\n");
+	for (i = 0; i < BIGZONE_NAMES; i++) {
+		if (i % 2000 == 0) {
+			emit(f, &line, "$ORIGIN s%u.test.\n", i / 2000);
+			emit(f, &line, "$TTL %u\n", 300 + i / 2000);
+		}
+		if (i == BIGZONE_NAMES / 2)
+			emit(f, &line, "$INCLUDE "
+				       "testdata/master/master7.data\n");
+		if (i % 1000 == 500)
+			emit(f, &line, "$GENERATE 1-3 g%u-$ A 10.0.0.$\n", i);
+		if (bad != 0 && i == bad) {
+			badline = line;
+			emit(f, &line, "bad%u A 300.0.0.1\n", i);
+		}
+		emit(f, &line, "h%u A 10.%u.%u.%u\n", i,
+		     (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+		emit(f, &line, "\t%u AAAA 2001:db8::%x\n", 60 + i % 7, i);
+		emit(f, &line, "h%u TXT \"semi ; paren ( %u\" \"q\\\"\" "
+			       "; a \"comment\n", i, i);
+		emit(f, &line, "h%u MX ( 10 ; (\n\t\tmx%u )\n", i, i);
+	}
+	fclose(f);
+	return (badline);
+}
+
+static isc_result_t
+load_bigzone(unsigned int options) {
+	isc_result_t result;
+
+	result = setup_master(NULL, error_expect);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	callbacks.add = sum_callback;
+	load_count = 0;
+	load_sum = 0;
+
+	return (dns_master_loadfile5(BIGZONE, &dns_origin, &dns_origin,
+				     dns_rdataclass_in, options, 0,
+				     &callbacks, NULL, NULL, mctx,
+				     dns_masterformat_text, 0));
+}
+
+static isc_boolean_t load_done_flag;
+static isc_result_t load_done_result;
+static unsigned int loads_running;
+
+/*
+ * Keep the first result other than DNS_R_SEENINCLUDE, and stop when
+ * every load has finished.
+ */
+static void
+load_done(void *arg, isc_result_t result) {
+	UNUSED(arg);
+
+	if (load_done_result == DNS_R_SEENINCLUDE)
+		load_done_result = result;
+	if (--loads_running == 0) {
+		load_done_flag = ISC_TRUE;
+		isc_app_shutdown();
+	}
+}
+
+/*
+ * Start 'loads_running' incremental loads of BIGZONE at once.
+ */
+static void
+start_load(isc_task_t *task, isc_event_t *event) {
+	dns_loadctx_t *lctx;
+	isc_result_t result;
+	unsigned int i, n = loads_running;
+
+	UNUSED(task);
+
+	load_done_result = DNS_R_SEENINCLUDE;
+	for (i = 0; i < n; i++) {
+		lctx = NULL;
+		result = dns_master_loadfileinc5(BIGZONE, &dns_origin,
+						 &dns_origin,
+						 dns_rdataclass_in,
+						 DNS_MASTER_PARALLEL, 0,
+						 &callbacks, maintask,
+						 load_done, NULL, &lctx,
+						 NULL, NULL, mctx,
+						 dns_masterformat_text, 0);
+		if (result == DNS_R_CONTINUE)
+			dns_loadctx_detach(&lctx);
+		else
+			load_done(NULL, result);
+	}
+	isc_event_free(&event);
+}
+
+ATF_TC(parallel);
+ATF_TC_HEAD(parallel, tc) {
+	atf_tc_set_md_var(tc, "descr", "DNS_MASTER_PARALLEL loads the "
+				       "same data");
+}
+ATF_TC_BODY(parallel, tc) {
+	isc_result_t result;
+	unsigned int count;
+	isc_uint32_t sum;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	(void)write_bigzone(0);
+
+	result = load_bigzone(0);
+	ATF_REQUIRE_EQ(result, DNS_R_SEENINCLUDE);
+	count = load_count;
+	sum = load_sum;
+	ATF_CHECK(count > BIGZONE_NAMES * 4);
+
+	result = load_bigzone(DNS_MASTER_PARALLEL);
+	ATF_CHECK_EQ(result, DNS_R_SEENINCLUDE);
+	ATF_CHECK_EQ(load_count, count);
+	ATF_CHECK_EQ(load_sum, sum);
+
+	/* Incremental load. */
+	result = load_bigzone(0);
+	ATF_REQUIRE_EQ(result, DNS_R_SEENINCLUDE);
+	load_count = 0;
+	load_sum = 0;
+	load_done_flag = ISC_FALSE;
+	loads_running = 1;
+	isc_app_onrun(mctx, maintask, start_load, NULL);
+	isc_app_run();
+	ATF_CHECK(load_done_flag);
+	ATF_CHECK_EQ(load_done_result, DNS_R_SEENINCLUDE);
+	ATF_CHECK_EQ(load_count, count);
+	ATF_CHECK_EQ(load_sum, sum);
+
+	unlink(BIGZONE);
+	dns_test_end();
+}
+
+ATF_TC(parallelshared);
+ATF_TC_HEAD(parallelshared, tc) {
+	atf_tc_set_md_var(tc, "descr", "incremental DNS_MASTER_PARALLEL "
+				       "loads running at once share the "
+				       "worker threads");
+}
+ATF_TC_BODY(parallelshared, tc) {
+	isc_result_t result;
+	isc_mutex_t lock;
+	unsigned int count;
+	isc_uint32_t sum;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	(void)write_bigzone(0);
+
+	result = load_bigzone(0);
+	ATF_REQUIRE_EQ(result, DNS_R_SEENINCLUDE);
+	count = load_count;
+	sum = load_sum;
+
+	/*
+	 * Start more loads than there are CPUs, so that at least one
+	 * has no worker thread and is loaded a chunk at a time by the
+	 * task.
+	 */
+	RUNTIME_CHECK(isc_mutex_init(&lock) == ISC_R_SUCCESS);
+	callbacks.add_private = &lock;
+	load_count = 0;
+	load_sum = 0;
+	load_done_flag = ISC_FALSE;
+	loads_running = isc_os_ncpus() + 1;
+	isc_app_onrun(mctx, maintask, start_load, NULL);
+	isc_app_run();
+	ATF_CHECK(load_done_flag);
+	ATF_CHECK_EQ(load_done_result, DNS_R_SEENINCLUDE);
+	ATF_CHECK_EQ(load_count, count * (isc_os_ncpus() + 1));
+	ATF_CHECK_EQ(load_sum, sum * (isc_os_ncpus() + 1));
+	DESTROYLOCK(&lock);
+
+	unlink(BIGZONE);
+	dns_test_end();
+}
+
+ATF_TC(parallelerror);
+ATF_TC_HEAD(parallelerror, tc) {
+	atf_tc_set_md_var(tc, "descr", "DNS_MASTER_PARALLEL reports errors "
+				       "at the right line");
+}
+ATF_TC_BODY(parallelerror, tc) {
+	isc_result_t result, serial;
+	unsigned long line;
+	char buf[100];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	line = write_bigzone(BIGZONE_NAMES - 100);
+	snprintf(buf, sizeof(buf), "%s:%lu: ", BIGZONE, line);
+	error_expect_value = buf;
+
+	error_expect_result = ISC_FALSE;
+	serial = load_bigzone(0);
+	ATF_CHECK(serial != ISC_R_SUCCESS);
+	ATF_CHECK_MSG(error_expect_result, "'%s' error not emitted", buf);
+
+	error_expect_result = ISC_FALSE;
+	result = load_bigzone(DNS_MASTER_PARALLEL);
+	ATF_CHECK_EQ(result, serial);
+	ATF_CHECK_MSG(error_expect_result, "'%s' error not emitted", buf);
+
+	error_expect_value = NULL;
+	unlink(BIGZONE);
+	dns_test_end();
+}
+
 /*
  * Main
  */
@@ -675,6 +986,9 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, toobig);
 	ATF_TP_ADD_TC(tp, maxrdata);
 	ATF_TP_ADD_TC(tp, neworigin);
+	ATF_TP_ADD_TC(tp, parallel);
+	ATF_TP_ADD_TC(tp, parallelshared);
+	ATF_TP_ADD_TC(tp, parallelerror);
 
 	return (atf_no_error());
 }
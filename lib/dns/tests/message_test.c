@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+#define NANSWERS	40
+#define TXTLEN		100
+
+static void
+putname(isc_buffer_t *b, const char *label) {
+	size_t len = strlen(label);
+
+	isc_buffer_putuint8(b, (isc_uint8_t)len);
+	isc_buffer_putmem(b, (const unsigned char *)label, (unsigned int)len);
+	isc_buffer_putuint8(b, 7);
+	isc_buffer_putmem(b, (const unsigned char *)"example", 7);
+	isc_buffer_putuint8(b, 0);
+}
+
+/*
+ * Build a response with NANSWERS TXT records, each at its own name;
+ * more names, rdatas and scratch space than a message starts with.
+ */
+static void
+buildresponse(isc_buffer_t *b) {
+	char label[16];
+	unsigned int i;
+
+	isc_buffer_putuint16(b, 1);			/* id */
+	isc_buffer_putuint16(b, 0x8400);		/* qr aa */
+	isc_buffer_putuint16(b, 1);			/* qdcount */
+	isc_buffer_putuint16(b, NANSWERS);		/* ancount */
+	isc_buffer_putuint16(b, 0);			/* nscount */
+	isc_buffer_putuint16(b, 0);			/* arcount */
+
+	putname(b, "q");
+	isc_buffer_putuint16(b, dns_rdatatype_txt);
+	isc_buffer_putuint16(b, dns_rdataclass_in);
+
+	for (i = 0; i < NANSWERS; i++) {
+		snprintf(label, sizeof(label), "r%u", i);
+		putname(b, label);
+		isc_buffer_putuint16(b, dns_rdatatype_txt);
+		isc_buffer_putuint16(b, dns_rdataclass_in);
+		isc_buffer_putuint32(b, 300);
+		isc_buffer_putuint16(b, TXTLEN + 1);
+		isc_buffer_putuint8(b, TXTLEN);
+		memset(isc_buffer_used(b), 'a' + i % 26, TXTLEN);
+		isc_buffer_add(b, TXTLEN);
+	}
+}
+
+static void
+parse(dns_message_t *msg, isc_buffer_t *wire) {
+	isc_result_t result;
+
+	isc_buffer_first(wire);
+	result = dns_message_parse(msg, wire, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(msg->counts[DNS_SECTION_ANSWER], NANSWERS);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(reuse);
+ATF_TC_HEAD(reuse, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a reset message parses a message of the same "
+			  "size again without allocating memory");
+}
+ATF_TC_BODY(reuse, tc) {
+	dns_message_t *msg = NULL;
+	unsigned char data[8192];
+	isc_buffer_t wire;
+	isc_result_t result;
+	size_t inuse;
+	int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&wire, data, sizeof(data));
+	buildresponse(&wire);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	parse(msg, &wire);
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+
+	inuse = isc_mem_inuse(mctx);
+	for (i = 0; i < 3; i++) {
+		parse(msg, &wire);
+		ATF_CHECK_EQ(isc_mem_inuse(mctx), inuse);
+		dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+		ATF_CHECK_EQ(isc_mem_inuse(mctx), inuse);
+	}
+
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, reuse);
+
+	return (atf_no_error());
+}
@@ -12,6 +12,7 @@
 
 #include <config.h>
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -78,6 +79,18 @@ ATF_TC_BODY(fullcompare, tc) {
 		{ "foo.", "bar.foo.", dns_namereln_contains, -1, 2 },
 		{ "baz.bar.foo.", "bar.foo.", dns_namereln_subdomain, 1, 3 },
 		{ "bar.foo.", "baz.bar.foo.", dns_namereln_contains, -1, 3 },
+
+		/* long labels, compared a word at a time */
+		{ "ABCDEFGHIJKLMNOPQRSTUVWXYZ.", "abcdefghijklmnopqrstuvwxyz.",
+		  dns_namereln_equal, 0, 2 },
+		{ "abcdefghijKLMNOP.example.", "ABCDEFGHIJklmnox.example.",
+		  dns_namereln_commonancestor, -8, 2 },
+		{ "abcdefgh[.", "ABCDEFGH{.", dns_namereln_commonancestor,
+		  -32, 1 },
+		{ "abcdefgh@.", "ABCDEFGH`.", dns_namereln_commonancestor,
+		  -32, 1 },
+		{ "abcdefgh\\193.", "ABCDEFGH\\225.",
+		  dns_namereln_commonancestor, -32, 1 },
 		{ NULL, NULL, dns_namereln_none, 0, 0 }
 	};
 
@@ -121,6 +134,112 @@ ATF_TC_BODY(fullcompare, tc) {
 	}
 }
 
+ATF_TC(equal);
+ATF_TC_HEAD(equal, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_name_equal test");
+}
+ATF_TC_BODY(equal, tc) {
+	dns_fixedname_t fixed1, fixed2;
+	dns_name_t *name1, *name2;
+	isc_result_t result;
+	int i;
+	struct {
+		const char *name1;
+		const char *name2;
+		isc_boolean_t equal;
+	} data[] = {
+		{ "example.", "example.", ISC_TRUE },
+		{ "www.Example.COM.", "WWW.example.com.", ISC_TRUE },
+		{ "a-rather-long-label.example.", "A-RATHER-LONG-LABEL.EXAMPLE.",
+		  ISC_TRUE },
+		{ "a-rather-long-label.example.", "a-rather-long-labex.example.",
+		  ISC_FALSE },
+		{ "ab.c.", "a.bc.", ISC_FALSE },
+		{ "abcdefgh@.", "abcdefgh`.", ISC_FALSE },
+		{ "abcdefgh[.", "abcdefgh{.", ISC_FALSE },
+		{ "abcdefgh\\193.", "abcdefgh\\225.", ISC_FALSE },
+		{ "abcdefgh\\193.", "ABCDEFGH\\193.", ISC_TRUE },
+		{ NULL, NULL, ISC_FALSE }
+	};
+
+	UNUSED(tc);
+
+	dns_fixedname_init(&fixed1);
+	name1 = dns_fixedname_name(&fixed1);
+	dns_fixedname_init(&fixed2);
+	name2 = dns_fixedname_name(&fixed2);
+	for (i = 0; data[i].name1 != NULL; i++) {
+		result = dns_name_fromstring2(name1, data[i].name1,
+					      NULL, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_name_fromstring2(name2, data[i].name2,
+					      NULL, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		ATF_CHECK_EQ_MSG(dns_name_equal(name1, name2), data[i].equal,
+				 "%s %s", data[i].name1, data[i].name2);
+		ATF_CHECK_EQ(dns_name_equal(name2, name1), data[i].equal);
+		ATF_CHECK_EQ(dns_name_rdatacompare(name1, name2) == 0,
+			     data[i].equal);
+	}
+}
+
+ATF_TC(fromwire);
+ATF_TC_HEAD(fromwire, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_name_fromwire test");
+}
+ATF_TC_BODY(fromwire, tc) {
+	unsigned char data[] = {
+		12, 'A', '-', 'L', 'o', 'n', 'g', 'e', 'r', 'N', 'a', 'm', 'e',
+		7, 'E', 'x', 'a', 'm', 'p', 'l', 'e',
+		0,
+		3, 'W', 'w', 'W', 0xc0, 13
+	};
+	const char *expected[] = {
+		"a-longername.example", "www.example"
+	};
+	unsigned char out[DNS_NAME_MAXWIRE];
+	char text[DNS_NAME_FORMATSIZE];
+	isc_buffer_t source, target;
+	dns_decompress_t dctx;
+	dns_name_t name;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+
+	isc_buffer_init(&source, data, sizeof(data));
+	isc_buffer_add(&source, sizeof(data));
+	isc_buffer_setactive(&source, sizeof(data));
+	for (i = 0; i < 2; i++) {
+		isc_buffer_init(&target, out, sizeof(out));
+		dns_name_init(&name, NULL);
+		result = dns_name_fromwire(&name, &source, &dctx,
+					   DNS_NAME_DOWNCASE, &target);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_name_format(&name, text, sizeof(text));
+		ATF_CHECK_STREQ(text, expected[i]);
+	}
+	ATF_CHECK_EQ(isc_buffer_remaininglength(&source), 0);
+
+	/*
+	 * Cut the first name short in the middle of its second label.
+	 */
+	isc_buffer_init(&source, data, 17);
+	isc_buffer_add(&source, 17);
+	isc_buffer_setactive(&source, 17);
+	isc_buffer_init(&target, out, sizeof(out));
+	dns_name_init(&name, NULL);
+	result = dns_name_fromwire(&name, &source, &dctx, 0, &target);
+	ATF_CHECK_EQ(result, ISC_R_UNEXPECTEDEND);
+	ATF_CHECK_EQ(isc_buffer_consumedlength(&source), 0);
+
+	dns_decompress_invalidate(&dctx);
+}
+
 static void
 compress_test(dns_name_t *name1, dns_name_t *name2, dns_name_t *name3,
 	      unsigned char *expected, unsigned int length,
@@ -277,6 +396,195 @@ ATF_TC_BODY(compression, tc) {
 	dns_test_end();
 }
 
+/*
+ * Render 'count' names starting with n<first>, recording the offset of
+ * each in 'offsets'.
+ */
+static void
+render_names(dns_compress_t *cctx, isc_buffer_t *target, int first,
+	     int count, unsigned int *offsets)
+{
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result;
+	char namebuf[64];
+	int i;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	for (i = first; i < first + count; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.Z%d.example.",
+			 i, i % 16);
+		result = dns_name_fromstring2(name, namebuf, NULL, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		offsets[i] = target->used;
+		result = dns_name_towire(name, cctx, target);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+}
+
+/*
+ * Check that the 'count' names starting with n<first> decompress to
+ * what was rendered.
+ */
+static void
+check_names(isc_buffer_t *source, int first, int count,
+	    unsigned int *offsets)
+{
+	dns_decompress_t dctx;
+	dns_fixedname_t fixed, fixedexpect;
+	dns_name_t *name, *expect;
+	isc_buffer_t b;
+	isc_result_t result;
+	char namebuf[64];
+	int i;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_fixedname_init(&fixedexpect);
+	expect = dns_fixedname_name(&fixedexpect);
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+	for (i = first; i < first + count; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.Z%d.example.",
+			 i, i % 16);
+		result = dns_name_fromstring2(expect, namebuf, NULL, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		b = *source;
+		isc_buffer_setactive(&b, b.used);
+		b.current = offsets[i];
+		result = dns_name_fromwire(name, &b, &dctx, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(name, expect));
+	}
+	dns_decompress_invalidate(&dctx);
+}
+
+ATF_TC(compression_many);
+ATF_TC_HEAD(compression_many, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "compress more names than fit in the preallocated "
+			  "table, with rollback");
+}
+ATF_TC_BODY(compression_many, tc) {
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	static unsigned char buf[65535];
+	unsigned int offsets[1000];
+	unsigned int used;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, ISC_FALSE), ISC_R_SUCCESS);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&target, buf, sizeof(buf));
+
+	render_names(&cctx, &target, 0, 600, offsets);
+	/* Every name but the first shares at least "Zn.example." */
+	ATF_CHECK(target.used < 600 * 8 + 20);
+	check_names(&target, 0, 600, offsets);
+
+	/*
+	 * Throw away the second half and render different names in its
+	 * place; none of them may point into the discarded part.
+	 */
+	used = offsets[300];
+	dns_compress_rollback(&cctx, (isc_uint16_t)used);
+	target.used = used;
+	memset(buf + used, 0xff, sizeof(buf) - used);
+	render_names(&cctx, &target, 600, 400, offsets);
+	check_names(&target, 0, 300, offsets);
+	check_names(&target, 600, 400, offsets);
+
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
+ATF_TC(compression_large);
+ATF_TC_HEAD(compression_large, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "compress a message with more names than the "
+			  "initial table holds");
+}
+ATF_TC_BODY(compression_large, tc) {
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	static unsigned char buf[65535];
+	static unsigned int offsets[1500], again[1500];
+	unsigned int used;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, ISC_FALSE), ISC_R_SUCCESS);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&target, buf, sizeof(buf));
+
+	render_names(&cctx, &target, 0, 1500, offsets);
+	check_names(&target, 0, 1500, offsets);
+
+	/* The second time round, every name is a single pointer. */
+	used = target.used;
+	render_names(&cctx, &target, 0, 1500, again);
+	ATF_CHECK_EQ(target.used - used, 1500 * 2);
+	check_names(&target, 0, 1500, again);
+
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
+ATF_TC(compression_reuse);
+ATF_TC_HEAD(compression_reuse, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "add a name whose storage held another name");
+}
+ATF_TC_BODY(compression_reuse, tc) {
+	dns_compress_t cctx;
+	dns_fixedname_t fixed;
+	dns_name_t *name, prefix;
+	isc_uint16_t offset;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, ISC_FALSE), ISC_R_SUCCESS);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_name_init(&prefix, NULL);
+
+	result = dns_name_fromstring2(name, "a.example.", NULL, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_add(&cctx, name, name, 0);
+
+	/*
+	 * Look up one name, then add another of the same length in the
+	 * same storage without looking it up first.
+	 */
+	result = dns_name_fromstring2(name, "b.example.", NULL, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_compress_findglobal(&cctx, name, &prefix, &offset));
+	result = dns_name_fromstring2(name, "c.example.", NULL, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_add(&cctx, name, name, 20);
+
+	/* The whole of the added name must be found. */
+	ATF_CHECK(dns_compress_findglobal(&cctx, name, &prefix, &offset));
+	ATF_CHECK_EQ(dns_name_countlabels(&prefix), 0);
+	ATF_CHECK_EQ(offset, 20);
+
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 
@@ -375,17 +683,126 @@ ATF_TC_BODY(benchmark, tc) {
 #endif /* DNS_BENCHMARK_TESTS */
 #endif /* ISC_PLATFORM_USETHREADS */
 
+#ifdef DNS_BENCHMARK_TESTS
+
+/*
+ * Benchmark the case-insensitive comparison functions on names shaped
+ * like those a server sees: a few labels of mixed lengths under common
+ * suffixes, compared against a copy with different case (as when a
+ * query name is looked up) and against a sibling name.
+ */
+
+#define NBENCHNAMES	1024
+#define NBENCHROUNDS	4000
+
+ATF_TC(compare_benchmark);
+ATF_TC_HEAD(compare_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark dns_name_equal() and "
+			  "dns_name_fullcompare()");
+}
+ATF_TC_BODY(compare_benchmark, tc) {
+	static const char *prefixes[] = {
+		"www", "mail", "ns1", "smtp-relay", "_ldap._tcp",
+		"static-content", "api.v2", "cdn-edge-cache-01"
+	};
+	static const char *suffixes[] = {
+		"example.com", "example.co.uk", "department.example.org",
+		"a-long-second-level-label.example"
+	};
+	static dns_fixedname_t fixed[3][NBENCHNAMES];
+	dns_name_t *names[3][NBENCHNAMES];
+	char text[DNS_NAME_FORMATSIZE];
+	unsigned int i, j, k, equal;
+	isc_time_t ts1, ts2;
+	isc_result_t result;
+	int order;
+	double t;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * names[0] and names[1] differ only in case; names[2] has a
+	 * different first label.
+	 */
+	for (i = 0; i < NBENCHNAMES; i++) {
+		for (j = 0; j < 3; j++) {
+			snprintf(text, sizeof(text), "%s%u.%s.",
+				 prefixes[i % 8], (j == 2) ? i + 1 : i,
+				 suffixes[(i / 8) % 4]);
+			if (j == 1) {
+				for (k = 0; text[k] != 0; k += 2)
+					text[k] = toupper((unsigned char)text[k]);
+			}
+			dns_fixedname_init(&fixed[j][i]);
+			names[j][i] = dns_fixedname_name(&fixed[j][i]);
+			result = dns_name_fromstring2(names[j][i], text,
+						      NULL, 0, NULL);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			(void)dns_name_countlabels(names[j][i]);
+		}
+	}
+
+	equal = 0;
+	result = isc_time_now(&ts1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (k = 0; k < NBENCHROUNDS; k++)
+		for (i = 0; i < NBENCHNAMES; i++)
+			equal += dns_name_equal(names[0][i], names[1][i]);
+	result = isc_time_now(&ts2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(equal, NBENCHROUNDS * NBENCHNAMES);
+	t = isc_time_microdiff(&ts2, &ts1);
+	printf("%u dns_name_equal() calls, %f seconds, %f calls/second\n",
+	       NBENCHROUNDS * NBENCHNAMES, t / 1000000.0,
+	       (NBENCHROUNDS * NBENCHNAMES) / (t / 1000000.0));
+
+	equal = 0;
+	result = isc_time_now(&ts1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (k = 0; k < NBENCHROUNDS; k++) {
+		for (i = 0; i < NBENCHNAMES; i++) {
+			(void)dns_name_fullcompare(names[1][i], names[2][i],
+						   &order, &j);
+			equal += (order == 0);
+		}
+	}
+	result = isc_time_now(&ts2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(equal, 0);
+	t = isc_time_microdiff(&ts2, &ts1);
+	printf("%u dns_name_fullcompare() calls, %f seconds, "
+	       "%f calls/second\n",
+	       NBENCHROUNDS * NBENCHNAMES, t / 1000000.0,
+	       (NBENCHROUNDS * NBENCHNAMES) / (t / 1000000.0));
+
+	dns_test_end();
+}
+
+#endif /* DNS_BENCHMARK_TESTS */
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, fullcompare);
+	ATF_TP_ADD_TC(tp, equal);
+	ATF_TP_ADD_TC(tp, fromwire);
 	ATF_TP_ADD_TC(tp, compression);
+	ATF_TP_ADD_TC(tp, compression_many);
+	ATF_TP_ADD_TC(tp, compression_large);
+	ATF_TP_ADD_TC(tp, compression_reuse);
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 	ATF_TP_ADD_TC(tp, benchmark);
 #endif /* DNS_BENCHMARK_TESTS */
 #endif /* ISC_PLATFORM_USETHREADS */
+#ifdef DNS_BENCHMARK_TESTS
+	ATF_TP_ADD_TC(tp, compare_benchmark);
+#endif /* DNS_BENCHMARK_TESTS */
 
 	return (atf_no_error());
 }
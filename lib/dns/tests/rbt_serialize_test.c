@@ -138,6 +138,42 @@ write_data(FILE *file, unsigned char *datap, void *arg, isc_uint64_t *crc) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * As write_data(), but for a file that is to be mapped at 'base'.
+ */
+static isc_result_t
+write_data2(FILE *file, unsigned char *datap, void *arg, void *base,
+	    dns_rbtnode_t *node, isc_uint64_t *crc)
+{
+	data_holder_t *data = (data_holder_t *)datap;
+	data_holder_t temp;
+	off_t where;
+	isc_result_t result;
+
+	UNUSED(arg);
+	UNUSED(node);
+
+	result = isc_stdio_tell(file, &where);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	temp = *data;
+	temp.data = (data->len == 0
+		     ? NULL
+		     : (char *)base + where + sizeof(data_holder_t));
+
+	isc_crc64_update(crc, (void *)&temp, sizeof(temp));
+	if (fwrite(&temp, sizeof(data_holder_t), 1, file) != 1)
+		return (ISC_R_FAILURE);
+	if (data->len > 0) {
+		isc_crc64_update(crc, (const void *)data->data, data->len);
+		if (fwrite(data->data, data->len, 1, file) != 1)
+			return (ISC_R_FAILURE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg,
 	 isc_uint64_t *crc)
@@ -182,6 +218,37 @@ fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * As fix_data(), but for a file written by write_data2() for the
+ * address 'arg'.
+ */
+static isc_result_t
+fix_data2(dns_rbtnode_t *p, void *base, size_t max, void *arg,
+	  isc_uint64_t *crc)
+{
+	data_holder_t *data = p->data;
+	uintptr_t offset;
+
+	REQUIRE(crc != NULL);
+
+	if (data == NULL || data->len <= 0 || data->data == NULL)
+		return (ISC_R_INVALIDFILE);
+
+	offset = (uintptr_t)data->data - (uintptr_t)arg;
+	if (offset != (uintptr_t)((char *)data - (char *)base) +
+		      sizeof(data_holder_t) ||
+	    offset + data->len > max)
+		return (ISC_R_INVALIDFILE);
+
+	isc_crc64_update(crc, (void *)data, sizeof(*data));
+
+	data->data = (char *)base + offset;
+
+	isc_crc64_update(crc, (const void *)data->data, data->len);
+
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Load test data into the RBT.
  */
@@ -262,6 +329,33 @@ check_test_data(dns_rbt_t *rbt) {
 	}
 }
 
+/*
+ * Check that every test name is present with the right data.
+ */
+static void
+check_test_values(dns_rbt_t *rbt) {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	data_holder_t *data;
+	isc_result_t result;
+	rbt_testdata_t *testdatap;
+
+	for (testdatap = testdata; testdatap->name != NULL; testdatap++) {
+		dns_fixedname_init(&fname);
+		name = dns_fixedname_name(&fname);
+		result = dns_name_fromstring(name, testdatap->name, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		data = NULL;
+		result = dns_rbt_findname(rbt, name, 0, NULL, (void *) &data);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE(data != NULL);
+		ATF_CHECK_EQ(data->len, testdatap->data.len);
+		ATF_CHECK(memcmp(data->data, testdatap->data.data,
+				 data->len) == 0);
+	}
+}
+
 static void
 data_printer(FILE *out, void *datap)
 {
@@ -423,6 +517,86 @@ ATF_TC_BODY(deserialize_corrupt, tc) {
 }
 
 
+ATF_TC(serialize_base);
+ATF_TC_HEAD(serialize_base, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Test reading a map file at, and away from, the "
+			  "address it was written for");
+}
+ATF_TC_BODY(serialize_base, tc) {
+	dns_rbt_t *rbt = NULL;
+	dns_rbt_t *rbt_at = NULL, *rbt_away = NULL;
+	isc_result_t result;
+	FILE *rbtfile = NULL;
+	off_t offset;
+	int fd;
+	off_t filesize = 0;
+	char *base, *at, *away;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Find some free address space to write the file for.
+	 */
+	base = mmap(NULL, 1024 * 1024, PROT_READ, MAP_ANON|MAP_PRIVATE,
+		    -1, 0);
+	ATF_REQUIRE(base != MAP_FAILED);
+	munmap(base, 1024 * 1024);
+
+	result = dns_rbt_create(mctx, delete_data, NULL, &rbt);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	add_test_data(mctx, rbt);
+
+	rbtfile = fopen("./zone.bin", "w+b");
+	ATF_REQUIRE(rbtfile != NULL);
+	result = dns_rbt_serialize_tree2(rbtfile, rbt, base, write_data2,
+					 NULL, &offset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	fclose(rbtfile);
+	dns_rbt_destroy(&rbt);
+
+	fd = open("zone.bin", O_RDWR);
+	ATF_REQUIRE(fd >= 0);
+	isc_file_getsizefd(fd, &filesize);
+	ATF_REQUIRE(filesize <= 1024 * 1024);
+
+	/*
+	 * While the file is mapped where it was written for, a second
+	 * mapping has to go somewhere else.
+	 */
+	at = mmap(base, filesize, PROT_READ|PROT_WRITE,
+		  MAP_FILE|MAP_PRIVATE, fd, 0);
+	ATF_REQUIRE(at != MAP_FAILED);
+	away = mmap(NULL, filesize, PROT_READ|PROT_WRITE,
+		    MAP_FILE|MAP_PRIVATE, fd, 0);
+	ATF_REQUIRE(away != MAP_FAILED);
+	ATF_REQUIRE(away != base);
+	close(fd);
+
+	result = dns_rbt_deserialize_tree(at, filesize, 0, mctx,
+					  delete_data, NULL, fix_data2, base,
+					  NULL, &rbt_at);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rbt_deserialize_tree(away, filesize, 0, mctx,
+					  delete_data, NULL, fix_data2, base,
+					  NULL, &rbt_away);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	check_test_values(rbt_at);
+	check_test_values(rbt_away);
+	ATF_CHECK_EQ(dns_rbt_nodecount(rbt_at), dns_rbt_nodecount(rbt_away));
+
+	dns_rbt_destroy(&rbt_at);
+	dns_rbt_destroy(&rbt_away);
+	munmap(at, filesize);
+	munmap(away, filesize);
+	unlink("zone.bin");
+	dns_test_end();
+}
+
 ATF_TC(serialize_align);
 ATF_TC_HEAD(serialize_align, tc) {
 	atf_tc_set_md_var(tc, "descr",
@@ -451,6 +625,7 @@ ATF_TC_BODY(serialize_align, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, serialize);
 	ATF_TP_ADD_TC(tp, deserialize_corrupt);
+	ATF_TP_ADD_TC(tp, serialize_base);
 	ATF_TP_ADD_TC(tp, serialize_align);
 
 	return (atf_no_error());
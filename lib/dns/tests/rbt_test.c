@@ -1070,6 +1070,172 @@ ATF_TC_BODY(rbt_insert_and_remove, tc) {
 	dns_test_end();
 }
 
+/*
+ * Check that the 'count' names n<i>.example. for i in [first, count)
+ * are (or, after removal, are not) found in 'mytree'.
+ */
+static void
+check_names(dns_rbt_t *mytree, int first, int count, isc_boolean_t exist) {
+	dns_fixedname_t fname;
+	dns_rbtnode_t *node;
+	isc_result_t result;
+	char namebuf[64];
+	int i;
+
+	for (i = first; i < count; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.example.", i);
+		build_name_from_str(namebuf, &fname);
+		node = NULL;
+		result = dns_rbt_findnode(mytree, dns_fixedname_name(&fname),
+					  NULL, &node, NULL,
+					  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
+		if (exist)
+			ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		else
+			ATF_CHECK(result != ISC_R_SUCCESS);
+	}
+}
+
+ATF_TC(rbt_rehash);
+ATF_TC_HEAD(rbt_rehash, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Test lookups and removals while the hash table "
+			  "grows");
+}
+ATF_TC_BODY(rbt_rehash, tc) {
+	isc_result_t result;
+	dns_rbt_t *mytree = NULL;
+	dns_fixedname_t fname;
+	dns_rbtnode_t *node;
+	char namebuf[64];
+	size_t hashsize;
+	int i;
+
+	UNUSED(tc);
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, NULL, NULL, &mytree);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	hashsize = dns_rbt_hashsize(mytree);
+
+	/*
+	 * Look up every name inserted so far each time the table grows,
+	 * while part of the nodes are still in the old table.
+	 */
+	for (i = 0; i < 10000; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.example.", i);
+		node = NULL;
+		result = insert_helper(mytree, namebuf, &node);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		if (dns_rbt_hashsize(mytree) != hashsize) {
+			hashsize = dns_rbt_hashsize(mytree);
+			check_names(mytree, 0, i + 1, ISC_TRUE);
+			/*
+			 * Remove and re-add the node added as the table
+			 * grew, while most of it is still in the old table.
+			 */
+			result = dns_rbt_deletenode(mytree, node, ISC_FALSE);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			check_names(mytree, i, i + 1, ISC_FALSE);
+			node = NULL;
+			result = insert_helper(mytree, namebuf, &node);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			check_names(mytree, 0, i + 1, ISC_TRUE);
+		}
+	}
+	ATF_CHECK(hashsize > 10000 / 3);
+
+	/* Remove every other name and check the rest are still found. */
+	for (i = 0; i < 10000; i += 2) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.example.", i);
+		build_name_from_str(namebuf, &fname);
+		node = NULL;
+		result = dns_rbt_findnode(mytree, dns_fixedname_name(&fname),
+					  NULL, &node, NULL,
+					  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_rbt_deletenode(mytree, node, ISC_FALSE);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+	check_names(mytree, 0, 1, ISC_FALSE);
+	for (i = 1; i < 10000; i += 2) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.example.", i);
+		build_name_from_str(namebuf, &fname);
+		node = NULL;
+		result = dns_rbt_findnode(mytree, dns_fixedname_name(&fname),
+					  NULL, &node, NULL,
+					  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	ATF_CHECK_EQ(dns__rbt_checkproperties(mytree), ISC_TRUE);
+
+	dns_rbt_destroy(&mytree);
+
+	dns_test_end();
+}
+
+ATF_TC(rbt_presize);
+ATF_TC_HEAD(rbt_presize, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Test that a pre-sized hash table is not grown");
+}
+ATF_TC_BODY(rbt_presize, tc) {
+	isc_result_t result;
+	dns_rbt_t *mytree = NULL;
+	dns_rbtnode_t *node;
+	char namebuf[64];
+	size_t hashsize;
+	int i;
+
+	UNUSED(tc);
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, NULL, NULL, &mytree);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Some names first, so that there are nodes to move. */
+	for (i = 0; i < 100; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.example.", i);
+		node = NULL;
+		result = insert_helper(mytree, namebuf, &node);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	result = dns_rbt_presize(mytree, 5000);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	hashsize = dns_rbt_hashsize(mytree);
+	ATF_CHECK(hashsize * 3 > 5000);
+	check_names(mytree, 0, 100, ISC_TRUE);
+
+	for (i = 100; i < 5000 - 2; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%d.example.", i);
+		node = NULL;
+		result = insert_helper(mytree, namebuf, &node);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_CHECK_EQ(dns_rbt_hashsize(mytree), hashsize);
+	check_names(mytree, 0, 5000 - 2, ISC_TRUE);
+	check_names(mytree, 5000 - 2, 5000, ISC_FALSE);
+
+	/* Asking for less than there is room for changes nothing. */
+	result = dns_rbt_presize(mytree, 10);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_rbt_hashsize(mytree), hashsize);
+
+	dns_rbt_destroy(&mytree);
+
+	dns_test_end();
+}
+
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 
@@ -1212,6 +1378,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, rbt_insert);
 	ATF_TP_ADD_TC(tp, rbt_remove);
 	ATF_TP_ADD_TC(tp, rbt_insert_and_remove);
+	ATF_TP_ADD_TC(tp, rbt_rehash);
+	ATF_TP_ADD_TC(tp, rbt_presize);
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 	ATF_TP_ADD_TC(tp, benchmark);
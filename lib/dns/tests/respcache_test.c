@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+static dns_fixedname_t fixed;
+
+static void
+setkey(dns_respcachekey_t *key, const char *name, dns_rdatatype_t type) {
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), name, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	key->qname = dns_fixedname_name(&fixed);
+	key->qtype = type;
+	key->qclass = dns_rdataclass_in;
+	key->flags = 0;
+	key->udpsize = 512;
+}
+
+/*
+ * Store a fake response: a header with message ID 0xffff, followed by
+ * 'fill' repeated 'len' times.
+ */
+static isc_result_t
+add(dns_respcache_t *cache, unsigned int generation,
+    const dns_respcachekey_t *key, unsigned char fill, unsigned int len)
+{
+	unsigned char data[512];
+	isc_region_t r;
+
+	REQUIRE(len + 12 <= sizeof(data));
+
+	memset(data, 0, 12);
+	data[0] = data[1] = 0xff;
+	memset(data + 12, fill, len);
+	r.base = data;
+	r.length = len + 12;
+
+	return (dns_respcache_add(cache, generation, key, &r, NULL));
+}
+
+/*
+ * Look 'key' up; return the fill byte of the response found, or -1.
+ */
+static int
+find(dns_respcache_t *cache, const dns_respcachekey_t *key) {
+	unsigned char data[512];
+	isc_buffer_t buffer;
+	isc_result_t result;
+	unsigned char *base;
+
+	isc_buffer_init(&buffer, data, sizeof(data));
+	result = dns_respcache_find(cache, key, 0x1234, &buffer, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (-1);
+
+	base = isc_buffer_base(&buffer);
+	ATF_CHECK_EQ(base[0], 0x12);
+	ATF_CHECK_EQ(base[1], 0x34);
+	ATF_REQUIRE(isc_buffer_usedlength(&buffer) > 12);
+	return (base[12]);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(addfind);
+ATF_TC_HEAD(addfind, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "stored responses are found by exact key");
+}
+ATF_TC_BODY(addfind, tc) {
+	dns_respcache_t *cache = NULL;
+	dns_respcachekey_t key;
+	unsigned char small[13];
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_create(mctx, 10, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setkey(&key, "www.example.", dns_rdatatype_a);
+	ATF_CHECK_EQ(find(cache, &key), -1);
+	result = add(cache, dns_respcache_generation(cache), &key, 'a', 100);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(find(cache, &key), 'a');
+
+	/* Replace it. */
+	result = add(cache, dns_respcache_generation(cache), &key, 'b', 100);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(find(cache, &key), 'b');
+
+	/* A response that does not fit is not copied. */
+	isc_buffer_init(&buffer, small, sizeof(small));
+	result = dns_respcache_find(cache, &key, 1, &buffer, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&buffer), 0);
+
+	/* Every part of the key counts. */
+	key.qtype = dns_rdatatype_aaaa;
+	ATF_CHECK_EQ(find(cache, &key), -1);
+	key.qtype = dns_rdatatype_a;
+	key.flags = 1;
+	ATF_CHECK_EQ(find(cache, &key), -1);
+	key.flags = 0;
+	key.udpsize = 4096;
+	ATF_CHECK_EQ(find(cache, &key), -1);
+	key.udpsize = 512;
+	key.qclass = dns_rdataclass_ch;
+	ATF_CHECK_EQ(find(cache, &key), -1);
+	key.qclass = dns_rdataclass_in;
+	ATF_CHECK_EQ(find(cache, &key), 'b');
+
+	/* The name is compared case-sensitively. */
+	setkey(&key, "WWW.example.", dns_rdatatype_a);
+	ATF_CHECK_EQ(find(cache, &key), -1);
+
+	dns_respcache_detach(&cache);
+	ATF_CHECK_EQ(cache, NULL);
+
+	dns_test_end();
+}
+
+ATF_TC(bounded);
+ATF_TC_HEAD(bounded, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "the cache holds a bounded number of responses");
+}
+ATF_TC_BODY(bounded, tc) {
+	dns_respcache_t *cache = NULL;
+	dns_respcachekey_t key;
+	isc_result_t result;
+	char name[32];
+	unsigned int i, found;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_create(mctx, 16, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "n%u.example.", i);
+		setkey(&key, name, dns_rdatatype_a);
+		result = add(cache, dns_respcache_generation(cache), &key,
+			     'a', 10);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/* The most recent response is always kept. */
+	ATF_CHECK_EQ(find(cache, &key), 'a');
+
+	found = 0;
+	for (i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "n%u.example.", i);
+		setkey(&key, name, dns_rdatatype_a);
+		if (find(cache, &key) != -1)
+			found++;
+	}
+	ATF_CHECK(found > 0);
+	ATF_CHECK(found <= 16);
+
+	dns_respcache_detach(&cache);
+
+	dns_test_end();
+}
+
+ATF_TC(flush);
+ATF_TC_HEAD(flush, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "flushing empties the cache and refuses responses "
+			  "built before it");
+}
+ATF_TC_BODY(flush, tc) {
+	dns_respcache_t *cache = NULL;
+	dns_respcachekey_t key;
+	isc_result_t result;
+	unsigned int generation;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_create(mctx, 10, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setkey(&key, "www.example.", dns_rdatatype_a);
+	generation = dns_respcache_generation(cache);
+	result = add(cache, generation, &key, 'a', 10);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_respcache_flush(cache);
+	ATF_CHECK_EQ(find(cache, &key), -1);
+	ATF_CHECK(dns_respcache_generation(cache) != generation);
+
+	/* A lookup that started before the flush may not store. */
+	result = add(cache, generation, &key, 'b', 10);
+	ATF_CHECK_EQ(result, ISC_R_CANCELED);
+	ATF_CHECK_EQ(find(cache, &key), -1);
+
+	result = add(cache, dns_respcache_generation(cache), &key, 'c', 10);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(find(cache, &key), 'c');
+
+	dns_respcache_detach(&cache);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, addfind);
+	ATF_TP_ADD_TC(tp, bounded);
+	ATF_TP_ADD_TC(tp, flush);
+
+	return (atf_no_error());
+}
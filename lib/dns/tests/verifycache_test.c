@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/dnssec.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
+#include <dns/rdatatype.h>
+#include <dns/result.h>
+#include <dns/verifycache.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+static void
+makedigest(unsigned char *digest, unsigned int n) {
+	memset(digest, 0, DNS_VERIFYCACHE_DIGESTLENGTH);
+	digest[0] = (n >> 24) & 0xff;
+	digest[1] = (n >> 16) & 0xff;
+	digest[2] = (n >> 8) & 0xff;
+	digest[3] = n & 0xff;
+	digest[DNS_VERIFYCACHE_DIGESTLENGTH - 1] = 0x5a;
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(addfind);
+ATF_TC_HEAD(addfind, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "a stored check is found until the signature "
+			  "expires");
+}
+ATF_TC_BODY(addfind, tc) {
+	dns_verifycache_t *cache = NULL;
+	unsigned char d1[DNS_VERIFYCACHE_DIGESTLENGTH];
+	unsigned char d2[DNS_VERIFYCACHE_DIGESTLENGTH];
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_verifycache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	makedigest(d1, 1);
+	makedigest(d2, 2);
+
+	ATF_CHECK(!dns_verifycache_find(cache, d1, now));
+	dns_verifycache_add(cache, d1, now + 100);
+	ATF_CHECK(dns_verifycache_find(cache, d1, now));
+	ATF_CHECK(dns_verifycache_find(cache, d1, now + 100));
+	ATF_CHECK(!dns_verifycache_find(cache, d2, now));
+
+	/* Once the signature has expired the entry is gone for good. */
+	ATF_CHECK(!dns_verifycache_find(cache, d1, now + 101));
+	ATF_CHECK(!dns_verifycache_find(cache, d1, now));
+
+	dns_verifycache_detach(&cache);
+	ATF_CHECK_EQ(cache, NULL);
+
+	dns_test_end();
+}
+
+ATF_TC(bounded);
+ATF_TC_HEAD(bounded, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "the cache holds a bounded number of checks");
+}
+ATF_TC_BODY(bounded, tc) {
+	dns_verifycache_t *cache = NULL;
+	unsigned char digest[DNS_VERIFYCACHE_DIGESTLENGTH];
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int i, found;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_verifycache_create(mctx, 16, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	for (i = 0; i < 1000; i++) {
+		makedigest(digest, i * 2654435761U);
+		dns_verifycache_add(cache, digest, now + 100);
+	}
+
+	/* The most recent check is always kept. */
+	ATF_CHECK(dns_verifycache_find(cache, digest, now));
+
+	found = 0;
+	for (i = 0; i < 1000; i++) {
+		makedigest(digest, i * 2654435761U);
+		if (dns_verifycache_find(cache, digest, now))
+			found++;
+	}
+	ATF_CHECK(found <= 16);
+
+	dns_verifycache_detach(&cache);
+
+	dns_test_end();
+}
+
+ATF_TC(verify);
+ATF_TC_HEAD(verify, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "dns_dnssec_verify4() gives the same answers with "
+			  "a cache");
+}
+ATF_TC_BODY(verify, tc) {
+	dns_verifycache_t *cache = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dst_key_t *key = NULL;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT, sigrdata = DNS_RDATA_INIT;
+	dns_rdata_t bad = DNS_RDATA_INIT;
+	unsigned char addr[4] = { 192, 0, 2, 1 };
+	unsigned char keydata[64], sigdata[512];
+	isc_buffer_t b, sigbuf;
+	isc_stdtime_t now, inception, expire;
+	isc_result_t result;
+	int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_verifycache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fname);
+	name = dns_fixedname_name(&fname);
+	result = dns_name_fromstring(name, "example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * A zone key that can be built without a public key library:
+	 * flags 257, protocol 3, HMAC-SHA256.
+	 */
+	isc_buffer_init(&b, keydata, sizeof(keydata));
+	isc_buffer_putuint16(&b, 257);
+	isc_buffer_putuint8(&b, 3);
+	isc_buffer_putuint8(&b, DST_ALG_HMACSHA256);
+	isc_buffer_putmem(&b, (const unsigned char *)"a secret", 8);
+	result = dst_key_fromdns(name, dns_rdataclass_in, &b, mctx, &key);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	rdata.data = addr;
+	rdata.length = sizeof(addr);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	inception = now - 3600;
+	expire = now + 3600;
+	isc_buffer_init(&sigbuf, sigdata, sizeof(sigdata));
+	result = dns_dnssec_sign(name, &rdataset, key, &inception, &expire,
+				 mctx, &sigbuf, &sigrdata);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 2; i++) {
+		result = dns_dnssec_verify4(name, &rdataset, key, ISC_FALSE,
+					    0, mctx, &sigrdata, NULL, cache);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/* Changing the data still makes the check fail. */
+	addr[3] = 2;
+	result = dns_dnssec_verify4(name, &rdataset, key, ISC_FALSE,
+				    0, mctx, &sigrdata, NULL, cache);
+	ATF_CHECK_EQ(result, DNS_R_SIGINVALID);
+	addr[3] = 1;
+
+	/* So does changing the signature. */
+	memmove(sigdata + sizeof(sigdata) / 2, sigrdata.data,
+		sigrdata.length);
+	dns_rdata_init(&bad);
+	bad.data = sigdata + sizeof(sigdata) / 2;
+	bad.length = sigrdata.length;
+	bad.rdclass = sigrdata.rdclass;
+	bad.type = sigrdata.type;
+	bad.data[bad.length - 1] ^= 0x01;
+	result = dns_dnssec_verify4(name, &rdataset, key, ISC_FALSE,
+				    0, mctx, &bad, NULL, cache);
+	ATF_CHECK_EQ(result, DNS_R_SIGINVALID);
+
+	result = dns_dnssec_verify4(name, &rdataset, key, ISC_FALSE,
+				    0, mctx, &sigrdata, NULL, cache);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdataset_disassociate(&rdataset);
+	dst_key_free(&key);
+	dns_verifycache_detach(&cache);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, addfind);
+	ATF_TP_ADD_TC(tp, bounded);
+	ATF_TP_ADD_TC(tp, verify);
+
+	return (atf_no_error());
+}
@@ -20,6 +20,7 @@
 #include <dns/dnssec.h>
 #include <dns/ds.h>
 #include <dns/events.h>
+#include <dns/keycache.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
@@ -127,6 +128,9 @@ static isc_result_t
 get_dst_key(dns_validator_t *val, dns_rdata_rrsig_t *siginfo,
 	    dns_rdataset_t *rdataset);
 
+static dns_keytag_t
+compute_keytag(dns_rdata_t *rdata, dns_rdata_dnskey_t *key);
+
 static isc_result_t
 validate(dns_validator_t *val, isc_boolean_t resume);
 
@@ -1189,6 +1193,20 @@ create_validator(dns_validator_t *val, dns_name_t *name, dns_rdatatype_t type,
 	return (result);
 }
 
+/*%
+ * Build a dst_key_t for the DNSKEY 'rdata' owned by 'name'.  If the
+ * view has a key cache the key comes from there, and is shared.
+ */
+static isc_result_t
+keyfromrdata(dns_validator_t *val, dns_name_t *name, dns_rdata_t *rdata,
+	     dst_key_t **keyp)
+{
+	if (val->view->keycache != NULL)
+		return (dns_keycache_get(val->view->keycache, name, rdata,
+					 keyp));
+	return (dns_dnssec_keyfromrdata(name, rdata, val->view->mctx, keyp));
+}
+
 /*%
  * Try to find a key that could have signed 'siginfo' among those
  * in 'rdataset'.  If found, build a dst_key_t for it and point
@@ -1201,8 +1219,8 @@ get_dst_key(dns_validator_t *val, dns_rdata_rrsig_t *siginfo,
 	    dns_rdataset_t *rdataset)
 {
 	isc_result_t result;
-	isc_buffer_t b;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_dnskey_t key;
 	dst_key_t *oldkey = val->key;
 	isc_boolean_t foundold;
 
@@ -1218,32 +1236,36 @@ get_dst_key(dns_validator_t *val, dns_rdata_rrsig_t *siginfo,
 		goto failure;
 	do {
 		dns_rdataset_current(rdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &key, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
-		isc_buffer_init(&b, rdata.data, rdata.length);
-		isc_buffer_add(&b, rdata.length);
-		INSIST(val->key == NULL);
-		result = dst_key_fromdns(&siginfo->signer, rdata.rdclass, &b,
-					 val->view->mctx, &val->key);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		if (siginfo->algorithm ==
-		    (dns_secalg_t)dst_key_alg(val->key) &&
-		    siginfo->keyid ==
-		    (dns_keytag_t)dst_key_id(val->key) &&
-		    dst_key_iszonekey(val->key))
+		/*
+		 * The algorithm and key tag can be read off the rdata, so
+		 * only build the keys that could have made the signature.
+		 */
+		if (siginfo->algorithm == key.algorithm &&
+		    siginfo->keyid == compute_keytag(&rdata, &key))
 		{
-			if (foundold)
-				/*
-				 * This is the key we're looking for.
-				 */
-				return (ISC_R_SUCCESS);
-			else if (dst_key_compare(oldkey, val->key) == ISC_TRUE)
-			{
-				foundold = ISC_TRUE;
-				dst_key_free(&oldkey);
+			INSIST(val->key == NULL);
+			result = keyfromrdata(val, &siginfo->signer, &rdata,
+					      &val->key);
+			if (result != ISC_R_SUCCESS)
+				goto failure;
+			if (dst_key_iszonekey(val->key)) {
+				if (foundold)
+					/*
+					 * This is the key we're looking for.
+					 */
+					return (ISC_R_SUCCESS);
+				else if (dst_key_compare(oldkey,
+							 val->key) == ISC_TRUE)
+				{
+					foundold = ISC_TRUE;
+					dst_key_free(&oldkey);
+				}
 			}
+			dst_key_free(&val->key);
 		}
-		dst_key_free(&val->key);
 		dns_rdata_reset(&rdata);
 		result = dns_rdataset_next(rdataset);
 	} while (result == ISC_R_SUCCESS);
@@ -1461,8 +1483,7 @@ isselfsigned(dns_validator_t *val) {
 				continue;
 
 			dstkey = NULL;
-			result = dns_dnssec_keyfromrdata(name, &rdata, mctx,
-							 &dstkey);
+			result = keyfromrdata(val, name, &rdata, &dstkey);
 			if (result != ISC_R_SUCCESS)
 				continue;
 
@@ -1505,9 +1526,10 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	dns_fixedname_init(&fixed);
 	wild = dns_fixedname_name(&fixed);
  again:
-	result = dns_dnssec_verify3(val->event->name, val->event->rdataset,
+	result = dns_dnssec_verify4(val->event->name, val->event->rdataset,
 				    key, ignore, val->view->maxbits,
-				    val->view->mctx, rdata, wild);
+				    val->view->mctx, rdata, wild,
+				    val->view->verifycache);
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
 	    val->view->acceptexpired)
 	{
@@ -1728,10 +1750,8 @@ checkkey(dns_validator_t *val, dns_rdata_t *keyrdata, isc_uint16_t keyid,
 		if (keyid != sig.keyid || algorithm != sig.algorithm)
 			continue;
 		if (dstkey == NULL) {
-			result = dns_dnssec_keyfromrdata(val->event->name,
-							 keyrdata,
-							 val->view->mctx,
-							 &dstkey);
+			result = keyfromrdata(val, val->event->name,
+					      keyrdata, &dstkey);
 			if (result != ISC_R_SUCCESS)
 				/*
 				 * This really shouldn't happen, but...
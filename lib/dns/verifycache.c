@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/serial.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/types.h>
+#include <dns/verifycache.h>
+
+/*
+ * The number of independently locked stripes; a power of two.
+ */
+#define VERIFYCACHE_STRIPES	16
+
+typedef struct dns_vcentry dns_vcentry_t;
+
+struct dns_vcentry {
+	dns_vcentry_t *		next;
+	ISC_LINK(dns_vcentry_t)	link;
+	isc_stdtime_t		expire;
+	unsigned char		digest[DNS_VERIFYCACHE_DIGESTLENGTH];
+};
+
+typedef struct vcstripe {
+	isc_mutex_t		lock;
+	dns_vcentry_t		**table;
+	unsigned int		count;
+	ISC_LIST(dns_vcentry_t)	lru;		/* most recently used first */
+} vcstripe_t;
+
+struct dns_verifycache {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	isc_refcount_t		references;
+
+	unsigned int		size;		/* per stripe; power of two */
+	unsigned int		maxentries;	/* per stripe */
+	vcstripe_t		stripes[VERIFYCACHE_STRIPES];
+};
+
+#define VERIFYCACHE_MAGIC		ISC_MAGIC('V', 'f', 'y', 'C')
+#define VALID_VERIFYCACHE(c)		ISC_MAGIC_VALID(c, VERIFYCACHE_MAGIC)
+
+/*
+ * The digest is already uniformly distributed, so its first octets
+ * choose the stripe and the bucket within it.
+ */
+static inline unsigned int
+digest_hash(const unsigned char *digest) {
+	return ((digest[0] << 24) | (digest[1] << 16) |
+		(digest[2] << 8) | digest[3]);
+}
+
+#define STRIPE(c, h)	(&(c)->stripes[(h) & (VERIFYCACHE_STRIPES - 1)])
+#define BUCKET(c, s, h)	(&(s)->table[((h) / VERIFYCACHE_STRIPES) & \
+				     ((c)->size - 1)])
+
+/*
+ * Unlink 'entry' from its bucket and from the LRU list, and free it.
+ * Requires the stripe lock.
+ */
+static void
+entry_delete(dns_verifycache_t *cache, vcstripe_t *stripe,
+	     dns_vcentry_t *entry)
+{
+	dns_vcentry_t **entryp;
+	unsigned int hashval = digest_hash(entry->digest);
+
+	entryp = BUCKET(cache, stripe, hashval);
+	while (*entryp != entry) {
+		INSIST(*entryp != NULL);
+		entryp = &(*entryp)->next;
+	}
+	*entryp = entry->next;
+	ISC_LIST_UNLINK(stripe->lru, entry, link);
+	stripe->count--;
+	isc_mem_put(cache->mctx, entry, sizeof(*entry));
+}
+
+static void
+stripes_destroy(dns_verifycache_t *cache, unsigned int n) {
+	vcstripe_t *stripe;
+	dns_vcentry_t *entry;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		stripe = &cache->stripes[i];
+		while ((entry = ISC_LIST_HEAD(stripe->lru)) != NULL) {
+			ISC_LIST_UNLINK(stripe->lru, entry, link);
+			isc_mem_put(cache->mctx, entry, sizeof(*entry));
+		}
+		isc_mem_put(cache->mctx, stripe->table,
+			    sizeof(*stripe->table) * cache->size);
+		DESTROYLOCK(&stripe->lock);
+	}
+}
+
+isc_result_t
+dns_verifycache_create(isc_mem_t *mctx, unsigned int maxentries,
+		       dns_verifycache_t **cachep)
+{
+	isc_result_t result;
+	dns_verifycache_t *cache;
+	vcstripe_t *stripe;
+	unsigned int i, size;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxentries > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(cache, 0, sizeof(*cache));
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_cache;
+
+	/*
+	 * Split the entries evenly over the stripes, with one bucket
+	 * per entry rounded up to a power of two.
+	 */
+	maxentries = (maxentries + VERIFYCACHE_STRIPES - 1) /
+		     VERIFYCACHE_STRIPES;
+	for (size = 16; size < maxentries && size < (1U << 20); size <<= 1)
+		;
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->size = size;
+	cache->maxentries = maxentries;
+
+	for (i = 0; i < VERIFYCACHE_STRIPES; i++) {
+		stripe = &cache->stripes[i];
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_stripes;
+		stripe->table = isc_mem_get(mctx,
+					    sizeof(*stripe->table) * size);
+		if (stripe->table == NULL) {
+			DESTROYLOCK(&stripe->lock);
+			result = ISC_R_NOMEMORY;
+			goto cleanup_stripes;
+		}
+		memset(stripe->table, 0, sizeof(*stripe->table) * size);
+		stripe->count = 0;
+		ISC_LIST_INIT(stripe->lru);
+	}
+
+	cache->magic = VERIFYCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_stripes:
+	stripes_destroy(cache, i);
+	isc_mem_detach(&cache->mctx);
+	isc_refcount_decrement(&cache->references, NULL);
+	isc_refcount_destroy(&cache->references);
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_verifycache_attach(dns_verifycache_t *source, dns_verifycache_t **targetp)
+{
+	REQUIRE(VALID_VERIFYCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_verifycache_detach(dns_verifycache_t **cachep) {
+	dns_verifycache_t *cache;
+	unsigned int refs;
+
+	REQUIRE(cachep != NULL && VALID_VERIFYCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	isc_refcount_decrement(&cache->references, &refs);
+	if (refs != 0)
+		return;
+
+	cache->magic = 0;
+	stripes_destroy(cache, VERIFYCACHE_STRIPES);
+	isc_refcount_destroy(&cache->references);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_boolean_t
+dns_verifycache_find(dns_verifycache_t *cache, const unsigned char *digest,
+		     isc_stdtime_t now)
+{
+	vcstripe_t *stripe;
+	dns_vcentry_t *entry;
+	unsigned int hashval;
+	isc_boolean_t found = ISC_FALSE;
+
+	REQUIRE(VALID_VERIFYCACHE(cache));
+	REQUIRE(digest != NULL);
+
+	hashval = digest_hash(digest);
+	stripe = STRIPE(cache, hashval);
+
+	LOCK(&stripe->lock);
+	for (entry = *BUCKET(cache, stripe, hashval);
+	     entry != NULL;
+	     entry = entry->next)
+	{
+		if (memcmp(entry->digest, digest, sizeof(entry->digest)) == 0)
+			break;
+	}
+	if (entry != NULL) {
+		if (isc_serial_lt(entry->expire, now)) {
+			entry_delete(cache, stripe, entry);
+		} else {
+			if (entry != ISC_LIST_HEAD(stripe->lru)) {
+				ISC_LIST_UNLINK(stripe->lru, entry, link);
+				ISC_LIST_PREPEND(stripe->lru, entry, link);
+			}
+			found = ISC_TRUE;
+		}
+	}
+	UNLOCK(&stripe->lock);
+
+	return (found);
+}
+
+void
+dns_verifycache_add(dns_verifycache_t *cache, const unsigned char *digest,
+		    isc_stdtime_t expire)
+{
+	vcstripe_t *stripe;
+	dns_vcentry_t *entry, **bucket;
+	unsigned int hashval;
+
+	REQUIRE(VALID_VERIFYCACHE(cache));
+	REQUIRE(digest != NULL);
+
+	hashval = digest_hash(digest);
+	stripe = STRIPE(cache, hashval);
+
+	LOCK(&stripe->lock);
+	bucket = BUCKET(cache, stripe, hashval);
+	for (entry = *bucket; entry != NULL; entry = entry->next) {
+		if (memcmp(entry->digest, digest, sizeof(entry->digest)) == 0)
+			break;
+	}
+	if (entry != NULL) {
+		entry->expire = expire;
+		goto unlock;
+	}
+
+	if (stripe->count >= cache->maxentries) {
+		entry = ISC_LIST_TAIL(stripe->lru);
+		entry_delete(cache, stripe, entry);
+	}
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry));
+	if (entry == NULL)
+		goto unlock;
+	ISC_LINK_INIT(entry, link);
+	entry->expire = expire;
+	memmove(entry->digest, digest, sizeof(entry->digest));
+	entry->next = *bucket;
+	*bucket = entry;
+	ISC_LIST_PREPEND(stripe->lru, entry, link);
+	stripe->count++;
+
+ unlock:
+	UNLOCK(&stripe->lock);
+}
@@ -36,6 +36,7 @@
 #include <dns/dnssec.h>
 #include <dns/events.h>
 #include <dns/forward.h>
+#include <dns/keycache.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/master.h>
@@ -47,12 +48,14 @@
 #include <dns/rdataset.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/tsig.h>
+#include <dns/verifycache.h>
 #include <dns/zone.h>
 #include <dns/zt.h>
 
@@ -138,6 +141,9 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	}
 
 	view->acache = NULL;
+	view->respcache = NULL;
+	view->keycache = NULL;
+	view->verifycache = NULL;
 	view->cache = NULL;
 	view->cachedb = NULL;
 	ISC_LIST_INIT(view->dlz_searched);
@@ -213,6 +219,8 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->nta_recheck = 0;
 	view->prefetch_eligible = 0;
 	view->prefetch_trigger = 0;
+	view->staleanswersenable = ISC_FALSE;
+	view->staleanswerttl = 1;
 	view->dstport = 53;
 	view->preferred_glue = 0;
 	view->flush = ISC_FALSE;
@@ -383,6 +391,12 @@ destroy(dns_view_t *view) {
 			dns_acache_putdb(view->acache, view->cachedb);
 		dns_acache_detach(&view->acache);
 	}
+	if (view->respcache != NULL)
+		dns_respcache_detach(&view->respcache);
+	if (view->keycache != NULL)
+		dns_keycache_detach(&view->keycache);
+	if (view->verifycache != NULL)
+		dns_verifycache_detach(&view->verifycache);
 	dns_rrl_view_destroy(view);
 	if (view->rpzs != NULL)
 		dns_rpz_detach_rpzs(&view->rpzs);
@@ -959,6 +973,8 @@ dns_view_addzone(dns_view_t *view, dns_zone_t *zone) {
 	REQUIRE(view->zonetable != NULL);
 
 	result = dns_zt_mount(view->zonetable, zone);
+	if (result == ISC_R_SUCCESS && view->respcache != NULL)
+		dns_respcache_flush(view->respcache);
 
 	return (result);
 }
@@ -311,7 +311,7 @@ axfr_apply(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
 	isc_uint64_t records;
 
-	CHECK(dns_diff_load(&xfr->diff, xfr->axfr.add, xfr->axfr.add_private));
+	CHECK(dns_diff_load2(&xfr->diff, &xfr->axfr));
 	xfr->difflen = 0;
 	dns_diff_clear(&xfr->diff);
 	if (xfr->maxrecords != 0U) {
@@ -63,6 +63,7 @@
 #include <dns/rdatatype.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rriterator.h>
 #include <dns/soa.h>
@@ -303,6 +304,8 @@ struct dns_zone {
 	isc_uint32_t		sigresigninginterval;
 	dns_view_t		*view;
 	dns_acache_t		*acache;
+	dns_respcache_t		*respcache;
+	isc_boolean_t		respcache_hooked;
 	dns_checkmxfunc_t	checkmx;
 	dns_checksrvfunc_t	checksrv;
 	dns_checknsfunc_t	checkns;
@@ -1017,6 +1020,8 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->sigresigninginterval = 7 * 24 * 3600;
 	zone->view = NULL;
 	zone->acache = NULL;
+	zone->respcache = NULL;
+	zone->respcache_hooked = ISC_FALSE;
 	zone->checkmx = NULL;
 	zone->checksrv = NULL;
 	zone->checkns = NULL;
@@ -1172,6 +1177,8 @@ zone_free(dns_zone_t *zone) {
 		zone_detachdb(zone);
 	if (zone->acache != NULL)
 		dns_acache_detach(&zone->acache);
+	if (zone->respcache != NULL)
+		dns_respcache_detach(&zone->respcache);
 	if (zone->rpzs != NULL) {
 		REQUIRE(zone->rpz_num < zone->rpzs->p.num_zones);
 		dns_rpz_detach_rpzs(&zone->rpzs);
@@ -1548,6 +1555,87 @@ dns_zone_setacache(dns_zone_t *zone, dns_acache_t *acache) {
 	UNLOCK_ZONE(zone);
 }
 
+static isc_result_t
+zone_respcache_update(dns_db_t *db, void *fn_arg) {
+	dns_respcache_t *respcache = fn_arg;
+
+	UNUSED(db);
+
+	dns_respcache_flush(respcache);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Have every change to the zone's database flush the response cache.
+ * Only RBTDB databases report their changes, so responses built from
+ * any other kind of database cannot be cached.
+ *
+ * The caller must hold the dblock as a writer.
+ */
+static void
+zone_respcache_hook(dns_zone_t *zone) {
+	isc_result_t result;
+
+	INSIST(!zone->respcache_hooked);
+
+	if (zone->respcache == NULL || zone->db == NULL)
+		return;
+	if (strcmp(zone->db_argv[0], "rbt") != 0 &&
+	    strcmp(zone->db_argv[0], "rbt64") != 0)
+		return;
+
+	result = dns_db_updatenotify_register(zone->db,
+					      zone_respcache_update,
+					      zone->respcache);
+	if (result == ISC_R_SUCCESS)
+		zone->respcache_hooked = ISC_TRUE;
+	dns_respcache_flush(zone->respcache);
+}
+
+/* The caller must hold the dblock as a writer. */
+static void
+zone_respcache_unhook(dns_zone_t *zone) {
+	if (!zone->respcache_hooked)
+		return;
+
+	(void)dns_db_updatenotify_unregister(zone->db,
+					     zone_respcache_update,
+					     zone->respcache);
+	zone->respcache_hooked = ISC_FALSE;
+	dns_respcache_flush(zone->respcache);
+}
+
+void
+dns_zone_setrespcache(dns_zone_t *zone, dns_respcache_t *respcache) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_write);
+	zone_respcache_unhook(zone);
+	if (zone->respcache != NULL)
+		dns_respcache_detach(&zone->respcache);
+	if (respcache != NULL) {
+		dns_respcache_attach(respcache, &zone->respcache);
+		zone_respcache_hook(zone);
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
+	UNLOCK_ZONE(zone);
+}
+
+dns_respcache_t *
+dns_zone_getrespcache(dns_zone_t *zone) {
+	dns_respcache_t *respcache = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->respcache_hooked)
+		respcache = zone->respcache;
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
+	return (respcache);
+}
+
 static isc_result_t
 dns_zone_setstring(dns_zone_t *zone, char **field, const char *value) {
 	char *copy;
@@ -2030,6 +2118,16 @@ zone_load(dns_zone_t *zone, unsigned int flags, isc_boolean_t locked) {
 	}
 	dns_db_settask(db, zone->task);
 
+	/*
+	 * A reloaded zone is likely to be about the size of the version
+	 * being replaced, so size the new database's hash table for it
+	 * up front rather than growing it repeatedly during the load.
+	 */
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL)
+		(void)dns_db_presize(db, dns_db_nodecount(zone->db));
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
 	if (! dns_db_ispersistent(db)) {
 		if (zone->masterfile != NULL) {
 			result = zone_startload(db, zone, loadtime);
@@ -2224,6 +2322,8 @@ get_master_options(dns_zone_t *zone) {
 		options |= DNS_MASTER_CHECKWILDCARD;
 	if (DNS_ZONE_OPTION2(zone, DNS_ZONEOPT2_CHECKTTL))
 		options |= DNS_MASTER_CHECKTTL;
+	if (DNS_ZONE_OPTION2(zone, DNS_ZONEOPT2_PARALLELLOAD))
+		options |= DNS_MASTER_PARALLEL;
 	return (options);
 }
 
@@ -14627,6 +14727,7 @@ zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(zone->db == NULL && db != NULL);
 
 	dns_db_attach(db, &zone->db);
+	zone_respcache_hook(zone);
 	if (zone->acache != NULL) {
 		isc_result_t result;
 		result = dns_acache_setdb(zone->acache, db);
@@ -14643,6 +14744,7 @@ static inline void
 zone_detachdb(dns_zone_t *zone) {
 	REQUIRE(zone->db != NULL);
 
+	zone_respcache_unhook(zone);
 	if (zone->acache != NULL)
 		(void)dns_acache_putdb(zone->acache, zone->db);
 	dns_db_detach(&zone->db);
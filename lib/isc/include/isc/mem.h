@@ -399,7 +399,8 @@ isc_mem_inuse(isc_mem_t *mctx);
 /*%<
  * Get an estimate of the amount of memory in use in 'mctx', in bytes.
  * This includes quantization overhead, but does not include memory
- * allocated from the system but not yet used.
+ * allocated from the system but not yet used.  Small blocks held free
+ * in per-thread caches are not counted as in use.
  */
 
 size_t
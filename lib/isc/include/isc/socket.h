@@ -68,6 +68,7 @@
 #define isc_socket_detach isc__socket_detach
 #define isc_socketmgr_create isc__socketmgr_create
 #define isc_socketmgr_create2 isc__socketmgr_create2
+#define isc_socketmgr_create3 isc__socketmgr_create3
 #define isc_socketmgr_destroy isc__socketmgr_destroy
 #define isc_socket_open isc__socket_open
 #define isc_socket_close isc__socket_close
@@ -125,6 +126,15 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_REUSEADDRESS		0x01U
 
+/*%
+ * In isc_socket_bind() set socket option SO_REUSEPORT prior to calling
+ * bind(), so that several sockets can be bound to the same address and
+ * port and the kernel distributes incoming packets between them.
+ * isc_socket_bind() fails with ISC_R_NOTIMPLEMENTED if the system does
+ * not support it.
+ */
+#define ISC_SOCKET_REUSEPORT		0x02U
+
 /*%
  * Statistics counters.  Used as isc_statscounter_t values.
  */
@@ -254,6 +264,7 @@ struct isc_socket_connev {
  * _USEMINMTU:	Set the per packet IPV6_USE_MIN_MTU flag.
  */
 #define ISC_SOCKEVENTATTR_ATTACHED		0x80000000U /* internal */
+#define ISC_SOCKEVENTATTR_NORETRY		0x40000000U /* internal */
 #define ISC_SOCKEVENTATTR_TRUNC			0x00800000U /* public */
 #define ISC_SOCKEVENTATTR_CTRUNC		0x00400000U /* public */
 #define ISC_SOCKEVENTATTR_TIMESTAMP		0x00200000U /* public */
@@ -309,6 +320,7 @@ typedef enum {
  */
 #define ISC_SOCKFLAG_IMMEDIATE	0x00000001	/*%< send event only if needed */
 #define ISC_SOCKFLAG_NORETRY	0x00000002	/*%< drop failed UDP sends */
+#define ISC_SOCKFLAG_BATCH	0x00000004	/*%< UDP send may be batched */
 /*@}*/
 
 /*@{*/
@@ -963,8 +975,8 @@ isc_socket_sendto2(isc_socket_t *sock, isc_region_t *region,
  *	expected to be initialized.
  *
  *\li	For isc_socket_sendto2():
- *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE
- *	and ISC_SOCKFLAG_NORETRY.
+ *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE,
+ *	ISC_SOCKFLAG_NORETRY and ISC_SOCKFLAG_BATCH.
  *
  *\li	If ISC_SOCKFLAG_IMMEDIATE is set and the operation completes, the
  *	return value will be ISC_R_SUCCESS and the event will be filled
@@ -978,6 +990,16 @@ isc_socket_sendto2(isc_socket_t *sock, isc_region_t *region,
  *	Using this option along with ISC_SOCKFLAG_IMMEDIATE allows the caller
  *	to specify a region that is allocated on the stack.
  *
+ *\li	ISC_SOCKFLAG_BATCH can only be set for UDP sockets.  If set, the
+ *	datagram is queued rather than sent at once.  The queue is flushed
+ *	from an event posted to 'task', so it is sent after 'task' has
+ *	finished its current event, in a single system call with any other
+ *	datagrams queued on the socket by then; a full batch is sent
+ *	without waiting.  The send therefore never completes immediately:
+ *	with ISC_SOCKFLAG_IMMEDIATE the return value is ISC_R_INPROGRESS,
+ *	and 'region' must remain valid until the completion event is
+ *	received.  On systems without sendmmsg() the flag is ignored.
+ *
  * Requires:
  *
  *\li	'socket' is a valid, bound socket.
@@ -1022,14 +1044,25 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		      unsigned int maxsocks);
+
+isc_result_t
+isc_socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		      unsigned int maxsocks, int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
- * "maxsocks" being zero.
+ * "maxsocks" being zero, and isc_socketmgr_create2() is equivalent of
+ * isc_socketmgr_create3() with "nthreads" being one.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
+ * "nthreads" is the number of watcher threads polling for socket events.
+ * Each watcher has its own event set and handles a fixed share of the
+ * sockets, selected by descriptor number.  It is ignored (one watcher
+ * is used) when the select() backend is in use or when the library was
+ * built without threads.
+ *
  * Notes:
  *
  *\li	All memory will be allocated in memory context 'mctx'.
@@ -1042,6 +1075,8 @@ isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
  *
  *\li	'actx' is a valid application context (for createinctx()).
  *
+ *\li	'nthreads' > 0 (for create3()).
+ *
  * Ensures:
  *
  *\li	'*managerp' is a valid isc_socketmgr_t.
@@ -22,6 +22,11 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_STATSDUMP_VERBOSE	0x00000001 /*%< dump 0-value counters */
 
+/*%<
+ * Flag(s) for isc_stats_create2().
+ */
+#define ISC_STATS_SHARDED	0x00000001 /*%< per-thread counter copies */
+
 /*%<
  * Dump callback type.
  */
@@ -44,6 +49,20 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options);
+/*%<
+ * Like isc_stats_create(), but with 'options'.
+ *
+ * If ISC_STATS_SHARDED is set and threads are enabled, several copies of
+ * the counters are kept, each on its own cache lines, and each thread
+ * updates one of them.  This keeps busy counters that are updated from
+ * many threads from bouncing a cache line between CPUs, at the cost of
+ * more memory and of isc_stats_dump() having to add up the copies; the
+ * values it reports may miss updates that are still in progress.
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -670,6 +670,10 @@ isc_taskmgr_create(isc_mem_t *mctx, unsigned int workers,
  *	create 'workers' threads, but if at least one thread creation
  *	succeeds, isc_taskmgr_create() may return ISC_R_SUCCESS.
  *
+ *\li	Each worker thread has its own ready queue.  A task is run by the
+ *	worker that last ran it unless that worker is busy, in which case
+ *	an idle worker may take it over.
+ *
  *\li	If 'default_quantum' is non-zero, then it will be used as the default
  *	quantum value when tasks are created.  If zero, then an implementation
  *	defined default quantum will be used.
@@ -95,6 +95,9 @@ typedef struct isc_timerevent {
 #define ISC_TIMEREVENT_LIFE		(ISC_EVENTCLASS_TIMER + 3)
 #define ISC_TIMEREVENT_LASTEVENT	(ISC_EVENTCLASS_TIMER + 65535)
 
+/*% Timer manager options */
+#define ISC_TIMERMGR_WHEEL		0x00000001	/*%< Use a timing wheel */
+
 /*% Timer and timer manager methods */
 typedef struct {
 	void		(*destroy)(isc_timermgr_t **managerp);
@@ -369,6 +372,28 @@ isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
  *\li	Unexpected error
  */
 
+isc_result_t
+isc_timermgr_create2(isc_mem_t *mctx, unsigned int options,
+		     isc_timermgr_t **managerp);
+/*%<
+ * Like isc_timermgr_create(), but with 'options'.
+ *
+ * Notes:
+ *
+ *\li	If ISC_TIMERMGR_WHEEL is set, scheduled timers are kept on a
+ *	hierarchical timing wheel rather than a heap.  Scheduling and
+ *	cancelling a timer then take constant time and timers falling due
+ *	in the same millisecond are expired together, which suits large
+ *	numbers of timers that are mostly reset or stopped before they
+ *	fire.  Due times are rounded up to the next millisecond, so a timer
+ *	may fire up to a millisecond later than it would otherwise.
+ *
+ *\li	Options are ignored by timer manager implementations other than
+ *	the built-in one.
+ *
+ * Requires and returns as for isc_timermgr_create().
+ */
+
 void
 isc_timermgr_destroy(isc_timermgr_t **managerp);
 /*%<
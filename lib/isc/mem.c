@@ -35,6 +35,28 @@
 #ifndef ISC_MEM_DEBUGGING
 #define ISC_MEM_DEBUGGING 0
 #endif
+
+/*%
+ * Define ISC_MEM_THREADCACHE=1 to keep, per thread, a few free blocks
+ * of each small size in front of every internal-malloc context the
+ * thread uses, so that most isc_mem_get()/isc_mem_put() calls do not
+ * take the context lock.  Requires thread-specific data with
+ * destructors, and atomic add to keep the cached blocks out of the
+ * context's in-use count.
+ */
+#ifndef ISC_MEM_THREADCACHE
+#if defined(ISC_PLATFORM_USETHREADS) && !defined(WIN32) && \
+    defined(ISC_PLATFORM_HAVEXADD)
+#define ISC_MEM_THREADCACHE 1
+#else
+#define ISC_MEM_THREADCACHE 0
+#endif
+#endif
+
+#if ISC_MEM_THREADCACHE
+#include <isc/atomic.h>
+#include <isc/thread.h>
+#endif
 LIBISC_EXTERNAL_DATA unsigned int isc_mem_debugging = ISC_MEM_DEBUGGING;
 LIBISC_EXTERNAL_DATA unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 
@@ -48,6 +70,11 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define NUM_BASIC_BLOCKS	64		/*%< must be > 1 */
 #define TABLE_INCREMENT		1024
 #define DEBUGLIST_COUNT		1024
+#define TCACHE_MAXSIZE		256U		/*%< largest size cached */
+#define TCACHE_CLASSES		(TCACHE_MAXSIZE / ALIGNMENT_SIZE)
+#define TCACHE_FILL		8		/*%< blocks per refill */
+#define TCACHE_MAXFREE		32		/*%< per size, before flush */
+#define TCACHE_THREADS		64		/*%< threads with caches */
 
 /*
  * Types.
@@ -103,6 +130,36 @@ struct stats {
 typedef ISC_LIST(debuglink_t)	debuglist_t;
 #endif
 
+#if ISC_MEM_THREADCACHE
+typedef struct tcache tcache_t;
+
+/*%
+ * Free blocks of one context held by one thread.  The context has
+ * handed them out, but they are counted in its 'tcached' totals and
+ * not reported as in use; only the owning thread touches the free
+ * lists.  If the context is destroyed first, 'ctx' is cleared (under
+ * contextslock) and the owning thread frees the structure later.
+ */
+struct tcache {
+	isc__mem_t *		ctx;
+	ISC_LINK(tcache_t)	link;
+	element *		freelists[TCACHE_CLASSES];
+	unsigned int		freecount[TCACHE_CLASSES];
+};
+
+/*%
+ * Per-thread state: a slot number indexing each context's table of
+ * caches, and the list of caches this thread owns.
+ */
+typedef struct {
+	unsigned int		id;
+	ISC_LIST(tcache_t)	caches;
+} memthread_t;
+
+#define TCACHE_NOID		TCACHE_THREADS
+#define TCACHE_CLASS(s)		(quantize(s) / ALIGNMENT_SIZE - 1)
+#endif
+
 /* List of all active memory contexts. */
 
 static ISC_LIST(isc__mem_t)	contexts;
@@ -111,6 +168,14 @@ static isc_once_t		once = ISC_ONCE_INIT;
 static isc_mutex_t		contextslock;
 static isc_mutex_t 		createlock;
 
+#if ISC_MEM_THREADCACHE
+static isc_thread_key_t		tcache_key;
+/*% Slot numbers in use, locked by contextslock. */
+static isc_boolean_t		tcache_ids[TCACHE_THREADS];
+/*% Marks threads that found no free slot. */
+static memthread_t		tcache_noid = { TCACHE_NOID, { NULL, NULL } };
+#endif
+
 /*%
  * Total size of lost memory due to a bug of external library.
  * Locked by the global lock.
@@ -153,6 +218,11 @@ struct isc__mem {
 	unsigned int		basic_table_size;
 	unsigned char *		lowest;
 	unsigned char *		highest;
+#if ISC_MEM_THREADCACHE
+	tcache_t **		tcaches;	/*%< indexed by thread slot */
+	/*% Blocks of each class parked in thread caches; atomic. */
+	isc_int32_t		tcached[TCACHE_CLASSES];
+#endif
 
 #if ISC_MEM_TRACKLINES
 	debuglist_t *	 	debuglist;
@@ -681,6 +751,15 @@ mem_getunlocked(isc__mem_t *ctx, size_t size) {
 	ret = ctx->freelists[new_size];
 	ctx->freelists[new_size] = ctx->freelists[new_size]->next;
 
+#if ISC_MEM_THREADCACHE
+	/*
+	 * A block parked in a thread cache can be handed out again for
+	 * any size that rounds to the same class, so such sizes are
+	 * counted by class.
+	 */
+	if (ctx->tcaches != NULL && new_size <= TCACHE_MAXSIZE)
+		size = new_size;
+#endif
 
 	/*
 	 * The stats[] uses the _actual_ "size" requested by the
@@ -751,6 +830,11 @@ mem_putunlocked(isc__mem_t *ctx, void *mem, size_t size) {
 	((element *)mem)->next = ctx->freelists[new_size];
 	ctx->freelists[new_size] = (element *)mem;
 
+#if ISC_MEM_THREADCACHE
+	if (ctx->tcaches != NULL && new_size <= TCACHE_MAXSIZE)
+		size = new_size;
+#endif
+
 	/*
 	 * The stats[] uses the _actual_ "size" requested by the
 	 * caller, with the caveat (in the code above) that "size" >= the
@@ -844,6 +928,297 @@ mem_putstats(isc__mem_t *ctx, void *ptr, size_t size) {
 	}
 }
 
+/*!
+ * Memory in use by callers: blocks parked in thread caches are left
+ * out.  The caller must hold the context lock.
+ */
+static inline size_t
+mem_inuse(isc__mem_t *ctx) {
+#if ISC_MEM_THREADCACHE
+	size_t cached = 0;
+	unsigned int i;
+
+	if (ctx->tcaches != NULL) {
+		for (i = 0; i < TCACHE_CLASSES; i++) {
+			if (ctx->tcached[i] > 0)
+				cached += (size_t)ctx->tcached[i] *
+					  (i + 1) * ALIGNMENT_SIZE;
+		}
+		return ((cached < ctx->inuse) ? ctx->inuse - cached : 0);
+	}
+#endif
+	return (ctx->inuse);
+}
+
+/*!
+ * The outstanding gets of stats[size], not counting blocks parked in
+ * thread caches.
+ */
+static inline unsigned long
+mem_statgets(isc__mem_t *ctx, size_t size) {
+	unsigned long gets = ctx->stats[size].gets;
+#if ISC_MEM_THREADCACHE
+	isc_int32_t cached;
+
+	if (ctx->tcaches != NULL && size != 0U && size <= TCACHE_MAXSIZE &&
+	    size < ctx->max_size && size % ALIGNMENT_SIZE == 0U)
+	{
+		cached = ctx->tcached[size / ALIGNMENT_SIZE - 1];
+		if (cached > 0)
+			gets = ((unsigned long)cached < gets) ?
+				gets - cached : 0;
+	}
+#endif
+	return (gets);
+}
+
+#if ISC_MEM_THREADCACHE
+/*!
+ * Get the calling thread's state, assigning it a slot on first use.
+ * Returns NULL if the thread cannot have caches.
+ */
+static memthread_t *
+memthread_get(void) {
+	memthread_t *mt;
+	unsigned int i;
+
+	mt = isc_thread_key_getspecific(tcache_key);
+	if (mt != NULL)
+		return ((mt->id == TCACHE_NOID) ? NULL : mt);
+
+	mt = malloc(sizeof(*mt));
+	if (mt == NULL)
+		return (NULL);
+	mt->id = TCACHE_NOID;
+	ISC_LIST_INIT(mt->caches);
+
+	LOCK(&contextslock);
+	for (i = 0; i < TCACHE_THREADS; i++) {
+		if (!tcache_ids[i]) {
+			tcache_ids[i] = ISC_TRUE;
+			mt->id = i;
+			break;
+		}
+	}
+	UNLOCK(&contextslock);
+
+	if (mt->id == TCACHE_NOID) {
+		free(mt);
+		mt = &tcache_noid;
+	}
+	if (isc_thread_key_setspecific(tcache_key, mt) != 0) {
+		if (mt != &tcache_noid) {
+			LOCK(&contextslock);
+			tcache_ids[mt->id] = ISC_FALSE;
+			UNLOCK(&contextslock);
+			free(mt);
+		}
+		return (NULL);
+	}
+
+	return ((mt->id == TCACHE_NOID) ? NULL : mt);
+}
+
+/*!
+ * Return all blocks in 'tc' to 'ctx'.  The caller must hold the context
+ * lock, or be the only one left using the context.
+ */
+static void
+tcache_drain(isc__mem_t *ctx, tcache_t *tc) {
+	unsigned int i;
+	element *e;
+
+	for (i = 0; i < TCACHE_CLASSES; i++) {
+		if (tc->freecount[i] != 0U)
+			(void)isc_atomic_xadd(&ctx->tcached[i],
+					      -(isc_int32_t)tc->freecount[i]);
+		while ((e = tc->freelists[i]) != NULL) {
+			tc->freelists[i] = e->next;
+			mem_putunlocked(ctx, e, (i + 1) * ALIGNMENT_SIZE);
+		}
+		tc->freecount[i] = 0;
+	}
+}
+
+/*!
+ * Thread exit: give the blocks back to the contexts that are still
+ * around, and free the slot.
+ */
+static void
+memthread_destroy(void *arg) {
+	memthread_t *mt = arg;
+	isc__mem_t *ctx;
+	tcache_t *tc;
+
+	if (mt == &tcache_noid)
+		return;
+
+	LOCK(&contextslock);
+	while ((tc = ISC_LIST_HEAD(mt->caches)) != NULL) {
+		ISC_LIST_UNLINK(mt->caches, tc, link);
+		ctx = tc->ctx;
+		if (ctx != NULL) {
+			MCTXLOCK(ctx, &ctx->lock);
+			tcache_drain(ctx, tc);
+			ctx->tcaches[mt->id] = NULL;
+			MCTXUNLOCK(ctx, &ctx->lock);
+		}
+		free(tc);
+	}
+	tcache_ids[mt->id] = ISC_FALSE;
+	UNLOCK(&contextslock);
+
+	free(mt);
+}
+
+static tcache_t *
+tcache_create(isc__mem_t *ctx, memthread_t *mt) {
+	tcache_t *tc, *next;
+
+	LOCK(&contextslock);
+
+	/*
+	 * Forget caches of contexts that have been destroyed.
+	 */
+	for (tc = ISC_LIST_HEAD(mt->caches); tc != NULL; tc = next) {
+		next = ISC_LIST_NEXT(tc, link);
+		if (tc->ctx == NULL) {
+			ISC_LIST_UNLINK(mt->caches, tc, link);
+			free(tc);
+		}
+	}
+
+	tc = malloc(sizeof(*tc));
+	if (tc != NULL) {
+		memset(tc, 0, sizeof(*tc));
+		tc->ctx = ctx;
+		ISC_LINK_INIT(tc, link);
+		ISC_LIST_APPEND(mt->caches, tc, link);
+		ctx->tcaches[mt->id] = tc;
+	}
+
+	UNLOCK(&contextslock);
+
+	return (tc);
+}
+
+/*!
+ * Find the calling thread's cache for 'ctx', if blocks of 'size' can
+ * be cached.
+ */
+static inline tcache_t *
+tcache_lookup(isc__mem_t *ctx, size_t size) {
+	size_t new_size = quantize(size);
+	memthread_t *mt;
+	tcache_t *tc;
+
+	if (ctx->tcaches == NULL || new_size > TCACHE_MAXSIZE ||
+	    new_size >= ctx->max_size)
+		return (NULL);
+
+	mt = memthread_get();
+	if (mt == NULL)
+		return (NULL);
+	tc = ctx->tcaches[mt->id];
+	if (tc == NULL)
+		tc = tcache_create(ctx, mt);
+	return (tc);
+}
+
+/*!
+ * Take a block from the thread cache without locking.
+ */
+static inline void *
+tcache_get(tcache_t *tc, size_t size) {
+	unsigned int i = TCACHE_CLASS(size);
+	element *e;
+
+	e = tc->freelists[i];
+	if (e == NULL)
+		return (NULL);
+	tc->freelists[i] = e->next;
+	tc->freecount[i]--;
+	(void)isc_atomic_xadd(&tc->ctx->tcached[i], -1);
+
+#if ISC_MEM_FILL
+	memset(e, 0xbe, quantize(size)); /* Mnemonic for "beef". */
+#endif
+
+	return (e);
+}
+
+/*!
+ * Put a block into the thread cache without locking.  Returns ISC_FALSE
+ * if the cache for this size is full.
+ */
+static inline isc_boolean_t
+tcache_put(tcache_t *tc, void *mem, size_t size) {
+	unsigned int i = TCACHE_CLASS(size);
+
+	if (tc->freecount[i] >= TCACHE_MAXFREE)
+		return (ISC_FALSE);
+
+#if ISC_MEM_FILL
+#if ISC_MEM_CHECKOVERRUN
+	check_overrun(mem, size, quantize(size));
+#endif
+	memset(mem, 0xde, quantize(size)); /* Mnemonic for "dead". */
+#endif
+
+	((element *)mem)->next = tc->freelists[i];
+	tc->freelists[i] = (element *)mem;
+	tc->freecount[i]++;
+	(void)isc_atomic_xadd(&tc->ctx->tcached[i], 1);
+
+	return (ISC_TRUE);
+}
+
+/*!
+ * Refill the thread cache from the context and return one block.  The
+ * context lock must be held.
+ */
+static inline void *
+tcache_fill(isc__mem_t *ctx, tcache_t *tc, size_t size) {
+	size_t new_size = quantize(size);
+	unsigned int i = TCACHE_CLASS(size);
+	element *e;
+	int n;
+
+	for (n = 0; n < TCACHE_FILL; n++) {
+		e = mem_getunlocked(ctx, new_size);
+		if (e == NULL)
+			break;
+		e->next = tc->freelists[i];
+		tc->freelists[i] = e;
+		tc->freecount[i]++;
+	}
+	if (n != 0)
+		(void)isc_atomic_xadd(&ctx->tcached[i], n);
+
+	return (tcache_get(tc, size));
+}
+
+/*!
+ * Return 'mem' and half of the full thread cache for its size to the
+ * context.  The context lock must be held.
+ */
+static inline void
+tcache_flush(isc__mem_t *ctx, tcache_t *tc, void *mem, size_t size) {
+	size_t new_size = quantize(size);
+	unsigned int i = TCACHE_CLASS(size);
+	element *e;
+
+	mem_putunlocked(ctx, mem, size);
+	while (tc->freecount[i] > TCACHE_MAXFREE / 2) {
+		e = tc->freelists[i];
+		tc->freelists[i] = e->next;
+		tc->freecount[i]--;
+		(void)isc_atomic_xadd(&ctx->tcached[i], -1);
+		mem_putunlocked(ctx, e, new_size);
+	}
+}
+#endif /* ISC_MEM_THREADCACHE */
+
 /*
  * Private.
  */
@@ -868,6 +1243,10 @@ initialize_action(void) {
 	RUNTIME_CHECK(isc_mutex_init(&contextslock) == ISC_R_SUCCESS);
 	ISC_LIST_INIT(contexts);
 	totallost = 0;
+#if ISC_MEM_THREADCACHE
+	RUNTIME_CHECK(isc_thread_key_create(&tcache_key,
+					    memthread_destroy) == 0);
+#endif
 }
 
 /*
@@ -952,6 +1331,10 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->basic_table_size = 0;
 	ctx->lowest = NULL;
 	ctx->highest = NULL;
+#if ISC_MEM_THREADCACHE
+	ctx->tcaches = NULL;
+	memset(ctx->tcached, 0, sizeof(ctx->tcached));
+#endif
 
 	ctx->stats = (memalloc)(arg,
 				(ctx->max_size+1) * sizeof(struct stats));
@@ -976,6 +1359,25 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 		       ctx->max_size * sizeof(element *));
 	}
 
+#if ISC_MEM_THREADCACHE
+	/*
+	 * Per-thread caches are only worthwhile for shared contexts, and
+	 * would hide allocations from ISC_MEM_DEBUGRECORD.
+	 */
+	if ((flags & ISC_MEMFLAG_INTERNAL) != 0 &&
+	    (flags & ISC_MEMFLAG_NOLOCK) == 0 &&
+	    (isc_mem_debugging & ISC_MEM_DEBUGRECORD) == 0)
+	{
+		ctx->tcaches = (memalloc)(arg, TCACHE_THREADS *
+					       sizeof(tcache_t *));
+		if (ctx->tcaches == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto error;
+		}
+		memset(ctx->tcaches, 0, TCACHE_THREADS * sizeof(tcache_t *));
+	}
+#endif
+
 #if ISC_MEM_TRACKLINES
 	if ((isc_mem_debugging & ISC_MEM_DEBUGRECORD) != 0) {
 		unsigned int i;
@@ -1006,6 +1408,10 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 			(memfree)(arg, ctx->stats);
 		if (ctx->freelists != NULL)
 			(memfree)(arg, ctx->freelists);
+#if ISC_MEM_THREADCACHE
+		if (ctx->tcaches != NULL)
+			(memfree)(arg, ctx->tcaches);
+#endif
 #if ISC_MEM_TRACKLINES
 		if (ctx->debuglist != NULL)
 			(ctx->memfree)(ctx->arg, ctx->debuglist);
@@ -1025,6 +1431,20 @@ destroy(isc__mem_t *ctx) {
 
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
+#if ISC_MEM_THREADCACHE
+	if (ctx->tcaches != NULL) {
+		/*
+		 * No one uses the context any more; take back the blocks
+		 * held by thread caches and disown the caches.
+		 */
+		for (i = 0; i < TCACHE_THREADS; i++) {
+			if (ctx->tcaches[i] == NULL)
+				continue;
+			tcache_drain(ctx, ctx->tcaches[i]);
+			ctx->tcaches[i]->ctx = NULL;
+		}
+	}
+#endif
 	totallost += ctx->inuse;
 	UNLOCK(&contextslock);
 
@@ -1083,6 +1503,10 @@ destroy(isc__mem_t *ctx) {
 		if (ctx->basic_table != NULL)
 			(ctx->memfree)(ctx->arg, ctx->basic_table);
 	}
+#if ISC_MEM_THREADCACHE
+	if (ctx->tcaches != NULL)
+		(ctx->memfree)(ctx->arg, ctx->tcaches);
+#endif
 
 	ondest = ctx->ondestroy;
 
@@ -1244,6 +1668,10 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	void *ptr;
 	isc_boolean_t call_water = ISC_FALSE;
+	size_t inuse;
+#if ISC_MEM_THREADCACHE
+	tcache_t *tc;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
 
@@ -1251,8 +1679,29 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+#if ISC_MEM_THREADCACHE
+		tc = tcache_lookup(ctx, size);
+		if (tc != NULL) {
+			ptr = tcache_get(tc, size);
+			if (ptr != NULL)
+				return (ptr);
+		}
+#endif
 		MCTXLOCK(ctx, &ctx->lock);
-		ptr = mem_getunlocked(ctx, size);
+#if ISC_MEM_THREADCACHE
+		/*
+		 * Over the high water mark, give the blocks this thread
+		 * keeps back to the context instead of taking more.
+		 */
+		if (tc != NULL && ctx->is_overmem) {
+			tcache_drain(ctx, tc);
+			tc = NULL;
+		}
+		if (tc != NULL)
+			ptr = tcache_fill(ctx, tc, size);
+		else
+#endif
+			ptr = mem_getunlocked(ctx, size);
 	} else {
 		ptr = mem_get(ctx, size);
 		MCTXLOCK(ctx, &ctx->lock);
@@ -1261,17 +1710,18 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	}
 
 	ADD_TRACE(ctx, ptr, size, file, line);
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
+	inuse = mem_inuse(ctx);
+	if (ctx->hi_water != 0U && inuse > ctx->hi_water) {
 		ctx->is_overmem = ISC_TRUE;
 		if (!ctx->hi_called)
 			call_water = ISC_TRUE;
 	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	if (inuse > ctx->maxinuse) {
+		ctx->maxinuse = inuse;
+		if (ctx->hi_water != 0U && inuse > ctx->hi_water &&
 		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
 			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
+				(unsigned long)inuse);
 	}
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1287,6 +1737,9 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	isc_boolean_t call_water = ISC_FALSE;
 	size_info *si;
 	size_t oldsize;
+#if ISC_MEM_THREADCACHE
+	tcache_t *tc = NULL;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
 	REQUIRE(ptr != NULL);
@@ -1303,12 +1756,28 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#if ISC_MEM_THREADCACHE
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+		tc = tcache_lookup(ctx, size);
+		if (tc != NULL && !ctx->is_overmem &&
+		    tcache_put(tc, ptr, size))
+			return;
+	}
+#endif
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
 
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-		mem_putunlocked(ctx, ptr, size);
+#if ISC_MEM_THREADCACHE
+		if (tc != NULL && ctx->is_overmem)
+			tcache_drain(ctx, tc);
+		if (tc != NULL)
+			tcache_flush(ctx, tc, ptr, size);
+		else
+#endif
+			mem_putunlocked(ctx, ptr, size);
 	} else {
 		mem_putstats(ctx, ptr, size);
 		mem_put(ctx, ptr, size);
@@ -1319,7 +1788,7 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	 * when the context was pushed over hi_water but then had
 	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
 	 */
-	if ((ctx->inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
+	if ((mem_inuse(ctx) < ctx->lo_water) || (ctx->lo_water == 0U)) {
 		ctx->is_overmem = ISC_FALSE;
 		if (ctx->hi_called)
 			call_water = ISC_TRUE;
@@ -1406,7 +1875,8 @@ isc_mem_stats(isc_mem_t *ctx0, FILE *out) {
 			continue;
 		fprintf(out, "%s%5lu: %11lu gets, %11lu rem",
 			(i == ctx->max_size) ? ">=" : "  ",
-			(unsigned long) i, s->totalgets, s->gets);
+			(unsigned long) i, s->totalgets,
+			mem_statgets(ctx, i));
 		if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0 &&
 		    (s->blocks != 0U || s->freefrags != 0U))
 			fprintf(out, " (%lu bl, %lu ff)",
@@ -1500,6 +1970,7 @@ isc___mem_allocate(isc_mem_t *ctx0, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	size_info *si;
 	isc_boolean_t call_water = ISC_FALSE;
+	size_t inuse;
 
 	REQUIRE(VALID_CONTEXT(ctx));
 
@@ -1511,22 +1982,23 @@ isc___mem_allocate(isc_mem_t *ctx0, size_t size FLARG) {
 #if ISC_MEM_TRACKLINES
 	ADD_TRACE(ctx, si, si[-1].u.size, file, line);
 #endif
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	inuse = mem_inuse(ctx);
+	if (ctx->hi_water != 0U && inuse > ctx->hi_water &&
 	    !ctx->is_overmem) {
 		ctx->is_overmem = ISC_TRUE;
 	}
 
 	if (ctx->hi_water != 0U && !ctx->hi_called &&
-	    ctx->inuse > ctx->hi_water) {
+	    inuse > ctx->hi_water) {
 		ctx->hi_called = ISC_TRUE;
 		call_water = ISC_TRUE;
 	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	if (inuse > ctx->maxinuse) {
+		ctx->maxinuse = inuse;
+		if (ctx->hi_water != 0U && inuse > ctx->hi_water &&
 		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
 			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
+				(unsigned long)inuse);
 	}
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1579,7 +2051,7 @@ void
 isc___mem_free(isc_mem_t *ctx0, void *ptr FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	size_info *si;
-	size_t size;
+	size_t size, inuse;
 	isc_boolean_t call_water= ISC_FALSE;
 
 	REQUIRE(VALID_CONTEXT(ctx));
@@ -1610,13 +2082,14 @@ isc___mem_free(isc_mem_t *ctx0, void *ptr FLARG) {
 	 * when the context was pushed over hi_water but then had
 	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
 	 */
+	inuse = mem_inuse(ctx);
 	if (ctx->is_overmem &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+	    (inuse < ctx->lo_water || ctx->lo_water == 0U)) {
 		ctx->is_overmem = ISC_FALSE;
 	}
 
 	if (ctx->hi_called &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+	    (inuse < ctx->lo_water || ctx->lo_water == 0U)) {
 		ctx->hi_called = ISC_FALSE;
 
 		if (ctx->water != NULL)
@@ -1703,7 +2176,7 @@ isc__mem_inuse(isc_mem_t *ctx0) {
 	REQUIRE(VALID_CONTEXT(ctx));
 	MCTXLOCK(ctx, &ctx->lock);
 
-	inuse = ctx->inuse;
+	inuse = mem_inuse(ctx);
 
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1764,7 +2237,7 @@ isc__mem_setwater(isc_mem_t *ctx0, isc_mem_water_t water, void *water_arg,
 	} else {
 		if (ctx->hi_called &&
 		    (ctx->water != water || ctx->water_arg != water_arg ||
-		     ctx->inuse < lowater || lowater == 0U))
+		     mem_inuse(ctx) < lowater || lowater == 0U))
 			callwater = ISC_TRUE;
 		ctx->water = water;
 		ctx->water_arg = water_arg;
@@ -2374,11 +2847,11 @@ xml_renderctx(isc__mem_t *ctx, summarystat_t *summary,
 					    (isc_uint64_t)ctx->total));
 	TRY0(xmlTextWriterEndElement(writer)); /* total */
 
-	summary->inuse += ctx->inuse;
+	summary->inuse += mem_inuse(ctx);
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "inuse"));
 	TRY0(xmlTextWriterWriteFormatString(writer,
 					    "%" ISC_PRINT_QUADFORMAT "u",
-					    (isc_uint64_t)ctx->inuse));
+					    (isc_uint64_t)mem_inuse(ctx)));
 	TRY0(xmlTextWriterEndElement(writer)); /* inuse */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "maxinuse"));
@@ -2518,7 +2991,7 @@ json_renderctx(isc__mem_t *ctx, summarystat_t *summary, json_object *array) {
 		ctx->max_size * sizeof(element *) +
 		ctx->basic_table_count * sizeof(char *);
 	summary->total += ctx->total;
-	summary->inuse += ctx->inuse;
+	summary->inuse += mem_inuse(ctx);
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0)
 		summary->blocksize += ctx->basic_table_count *
 			NUM_BASIC_BLOCKS * ctx->mem_target;
@@ -2552,7 +3025,7 @@ json_renderctx(isc__mem_t *ctx, summarystat_t *summary, json_object *array) {
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "total", obj);
 
-	obj = json_object_new_int64(ctx->inuse);
+	obj = json_object_new_int64(mem_inuse(ctx));
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "inuse", obj);
 
@@ -301,6 +301,13 @@ isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	return (isc__socketmgr_create2(mctx, managerp, maxsocks));
 }
 
+isc_result_t
+isc_socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, int nthreads)
+{
+	return (isc__socketmgr_create3(mctx, managerp, maxsocks, nthreads));
+}
+
 isc_result_t
 isc_socket_recvv(isc_socket_t *sock, isc_bufferlist_t *buflist,
 		 unsigned int minimum, isc_task_t *task,
@@ -18,10 +18,12 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/once.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC			ISC_MAGIC('S', 't', 'a', 't')
@@ -76,6 +78,27 @@ typedef struct {
 typedef isc_uint64_t isc_stat_t;
 #endif
 
+/*%
+ * Sharded statistics keep ISC_STATS_SHARDS copies of the counters, each
+ * starting on its own cache line, and every thread updates the copy
+ * picked by its thread number.  Readers add the copies up.  Threads may
+ * share a copy, so updates are still atomic, but they no longer contend
+ * for a single cache line.
+ */
+#ifdef ISC_PLATFORM_USETHREADS
+#define ISC_STATS_SHARDS		16
+#else
+#define ISC_STATS_SHARDS		1
+#endif
+#define ISC_STATS_LINESIZE		64
+
+#if ISC_STATS_SHARDS > 1
+static isc_once_t		shard_once = ISC_ONCE_INIT;
+static isc_thread_key_t		shard_key;
+static isc_mutex_t		shard_lock;
+static unsigned int		shard_next;	/* locked by shard_lock */
+#endif
+
 struct isc_stats {
 	/*% Unlocked */
 	unsigned int	magic;
@@ -94,6 +117,15 @@ struct isc_stats {
 #endif
 	isc_stat_t	*counters;
 
+	/*%
+	 * Number of copies of the counters, and the distance in counters
+	 * between two copies.
+	 */
+	unsigned int	nshards;
+	unsigned int	stride;
+	void		*base;
+	size_t		basesize;
+
 	/*%
 	 * We don't want to lock the counters while we are dumping, so we first
 	 * copy the current counter values into a local array.  This buffer
@@ -108,13 +140,63 @@ struct isc_stats {
 	isc_uint64_t	*copiedcounters;
 };
 
+#if ISC_STATS_SHARDS > 1
+static void
+initialize_shards(void) {
+	RUNTIME_CHECK(isc_mutex_init(&shard_lock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_thread_key_create(&shard_key, NULL) == 0);
+}
+
+/*!
+ * Return the calling thread's shard number, assigning shards to threads
+ * round robin on first use.
+ */
+static inline unsigned int
+getshard(void) {
+	void *value;
+	unsigned int shard;
+
+	value = isc_thread_key_getspecific(shard_key);
+	if (value != NULL)
+		return ((unsigned int)((unsigned long)value - 1));
+
+	LOCK(&shard_lock);
+	shard = shard_next++ % ISC_STATS_SHARDS;
+	UNLOCK(&shard_lock);
+
+	(void)isc_thread_key_setspecific(shard_key,
+					 (void *)(unsigned long)(shard + 1));
+	return (shard);
+}
+#endif
+
+/*%
+ * The calling thread's copy of the counters.
+ */
+static inline isc_stat_t *
+mycounters(isc_stats_t *stats) {
+#if ISC_STATS_SHARDS > 1
+	if (stats->nshards > 1)
+		return (stats->counters + getshard() * stats->stride);
+#endif
+	return (stats->counters);
+}
+
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, unsigned int options,
+	     isc_stats_t **statsp)
+{
 	isc_stats_t *stats;
 	isc_result_t result = ISC_R_SUCCESS;
+	size_t linesize;
 
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
+#if ISC_STATS_SHARDS > 1
+	RUNTIME_CHECK(isc_once_do(&shard_once, initialize_shards)
+		      == ISC_R_SUCCESS);
+#endif
+
 	stats = isc_mem_get(mctx, sizeof(*stats));
 	if (stats == NULL)
 		return (ISC_R_NOMEMORY);
@@ -123,11 +205,35 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	stats->counters = isc_mem_get(mctx, sizeof(isc_stat_t) * ncounters);
-	if (stats->counters == NULL) {
+	if ((options & ISC_STATS_SHARDED) != 0 && ISC_STATS_SHARDS > 1) {
+		linesize = ISC_STATS_LINESIZE / sizeof(isc_stat_t);
+		stats->nshards = ISC_STATS_SHARDS;
+		stats->stride = (ncounters + linesize - 1) / linesize *
+				linesize;
+		stats->basesize = sizeof(isc_stat_t) * stats->stride *
+				  stats->nshards + ISC_STATS_LINESIZE;
+	} else {
+		stats->nshards = 1;
+		stats->stride = ncounters;
+		stats->basesize = sizeof(isc_stat_t) * ncounters;
+	}
+	stats->base = isc_mem_get(mctx, stats->basesize);
+	if (stats->base == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto clean_mutex;
 	}
+	if (stats->nshards > 1) {
+		/* Start the first copy on a cache line boundary. */
+		size_t misalign = (unsigned long)stats->base &
+				  (ISC_STATS_LINESIZE - 1);
+
+		stats->counters = (isc_stat_t *)
+			((char *)stats->base +
+			 (ISC_STATS_LINESIZE - misalign) %
+			 ISC_STATS_LINESIZE);
+	} else
+		stats->counters = stats->base;
+
 	stats->copiedcounters = isc_mem_get(mctx,
 					    sizeof(isc_uint64_t) * ncounters);
 	if (stats->copiedcounters == NULL) {
@@ -142,7 +248,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 #endif
 
 	stats->references = 1;
-	memset(stats->counters, 0, sizeof(isc_stat_t) * ncounters);
+	memset(stats->base, 0, stats->basesize);
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -153,7 +259,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	return (result);
 
 clean_counters:
-	isc_mem_put(mctx, stats->counters, sizeof(isc_stat_t) * ncounters);
+	isc_mem_put(mctx, stats->base, stats->basesize);
 
 #if ISC_STATS_LOCKCOUNTERS
 clean_copiedcounters:
@@ -197,8 +303,7 @@ isc_stats_detach(isc_stats_t **statsp) {
 	if (stats->references == 0) {
 		isc_mem_put(stats->mctx, stats->copiedcounters,
 			    sizeof(isc_stat_t) * stats->ncounters);
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc_stat_t) * stats->ncounters);
+		isc_mem_put(stats->mctx, stats->base, stats->basesize);
 		UNLOCK(&stats->lock);
 		DESTROYLOCK(&stats->lock);
 #if ISC_STATS_LOCKCOUNTERS
@@ -220,6 +325,7 @@ isc_stats_ncounters(isc_stats_t *stats) {
 
 static inline void
 incrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = mycounters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -232,7 +338,7 @@ incrementcounter(isc_stats_t *stats, int counter) {
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, 1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, 1);
 	/*
 	 * If the lower 32-bit field overflows, increment the higher field.
 	 * Note that it's *theoretically* possible that the lower field
@@ -242,13 +348,13 @@ incrementcounter(isc_stats_t *stats, int counter) {
 	 * by the write (exclusive) lock.
 	 */
 	if (prev == (isc_int32_t)0xffffffff)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi, 1);
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi, 1);
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], 1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], 1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]++;
+	counters[counter]++;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -258,6 +364,7 @@ incrementcounter(isc_stats_t *stats, int counter) {
 
 static inline void
 decrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = mycounters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -265,16 +372,16 @@ decrementcounter(isc_stats_t *stats, int counter) {
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, -1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, -1);
 	if (prev == 0)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi,
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi,
 				-1);
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], -1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], -1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]--;
+	counters[counter]--;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -284,6 +391,9 @@ decrementcounter(isc_stats_t *stats, int counter) {
 
 static void
 copy_counters(isc_stats_t *stats) {
+	isc_stat_t *counters;
+	isc_uint64_t value;
+	unsigned int shard;
 	int i;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -294,18 +404,28 @@ copy_counters(isc_stats_t *stats) {
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
+	/*
+	 * A counter may have been decremented on a different copy than it
+	 * was incremented on, so a single copy can wrap; the sum is still
+	 * right modulo 2^64.
+	 */
 	for (i = 0; i < stats->ncounters; i++) {
+		stats->copiedcounters[i] = 0;
+		for (shard = 0; shard < stats->nshards; shard++) {
+			counters = stats->counters + shard * stats->stride;
 #if ISC_STATS_USEMULTIFIELDS
-		stats->copiedcounters[i] =
-			(isc_uint64_t)(stats->counters[i].hi) << 32 |
-			stats->counters[i].lo;
+			value = (isc_uint64_t)(counters[i].hi) << 32 |
+				counters[i].lo;
 #elif ISC_STATS_HAVEATOMICQ
-		/* use xaddq(..., 0) as an atomic load */
-		stats->copiedcounters[i] =
-			(isc_uint64_t)isc_atomic_xaddq((isc_int64_t *)&stats->counters[i], 0);
+			/* use xaddq(..., 0) as an atomic load */
+			value = (isc_uint64_t)
+				isc_atomic_xaddq((isc_int64_t *)&counters[i],
+						 0);
 #else
-		stats->copiedcounters[i] = stats->counters[i];
+			value = counters[i];
 #endif
+			stats->copiedcounters[i] += value;
+		}
 	}
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -317,7 +437,16 @@ isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 0, statsp));
+}
+
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options)
+{
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, ncounters, options, statsp));
 }
 
 void
@@ -358,6 +487,8 @@ void
 isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	      isc_statscounter_t counter)
 {
+	unsigned int shard;
+
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
@@ -369,14 +500,23 @@ isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
+	/*
+	 * The first copy takes the value and the others are cleared.
+	 */
+	for (shard = 0; shard < stats->nshards; shard++) {
+		isc_stat_t *counters = stats->counters + shard * stats->stride;
+
 #if ISC_STATS_USEMULTIFIELDS
-	stats->counters[counter].hi = (isc_uint32_t)((val >> 32) & 0xffffffff);
-	stats->counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
+		counters[counter].hi = (isc_uint32_t)((val >> 32) &
+						      0xffffffff);
+		counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
 #elif ISC_STATS_HAVEATOMICQ
-	isc_atomic_storeq((isc_int64_t *)&stats->counters[counter], val);
+		isc_atomic_storeq((isc_int64_t *)&counters[counter], val);
 #else
-	stats->counters[counter] = val;
+		counters[counter] = val;
 #endif
+		val = 0;
+	}
 
 #if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_write);
@@ -91,6 +91,7 @@ static const char *statenames[] = {
 
 typedef struct isc__task isc__task_t;
 typedef struct isc__taskmgr isc__taskmgr_t;
+typedef struct isc__taskqueue isc__taskqueue_t;
 
 struct isc__task {
 	/* Not locked. */
@@ -111,6 +112,8 @@ struct isc__task {
 	void *				tag;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the lock of the ready queue 'threadid'. */
+	unsigned int			threadid;
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
 };
@@ -126,6 +129,37 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+/*%
+ * Each worker thread owns a ready queue.  A task stays on the queue of
+ * the worker that last ran it (its 'threadid'); idle workers steal ready
+ * tasks from the queues of busy workers.  The queue lock is the only lock
+ * taken on the normal send/dispatch path, so workers do not contend on
+ * the task manager lock.
+ *
+ * Lock order: task manager lock, task lock, queue lock.  No more than
+ * one queue lock is held at a time, except by set_mode() and
+ * check_privileged(), which take all of them in index order while
+ * holding the task manager lock.
+ */
+struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			tasks_ready;
+	unsigned int			halts;
+	isc_boolean_t			running;
+	isc_boolean_t			sleeping;
+	isc_boolean_t			finished;
+#ifdef USE_WORKER_THREADS
+	isc_condition_t			work_available;
+	isc_condition_t			halted;
+#endif /* USE_WORKER_THREADS */
+};
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -135,19 +169,18 @@ struct isc__taskmgr {
 	unsigned int			workers;
 	isc_thread_t *			threads;
 #endif /* ISC_PLATFORM_USETHREADS */
+	unsigned int			nqueues;
+	isc__taskqueue_t *		queues;
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			nextqueue;
+	/*
+	 * Locked by task manager lock for reading; writers must also hold
+	 * every queue lock (see set_mode()).
+	 */
 	isc_taskmgrmode_t		mode;
-#ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
-	isc_condition_t			exclusive_granted;
-	isc_condition_t			paused;
-#endif /* ISC_PLATFORM_USETHREADS */
-	unsigned int			tasks_running;
-	unsigned int			tasks_ready;
+	/* Locked by task manager lock. */
 	isc_boolean_t			pause_requested;
 	isc_boolean_t			exclusive_requested;
 	isc_boolean_t			exiting;
@@ -244,13 +277,16 @@ isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskqueue_t *queue);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskqueue_t *queue, unsigned int threadid);
 
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task);
+
+static void
+finish_queues(isc__taskmgr_t *manager);
 
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
@@ -313,7 +349,6 @@ task_finished(isc__task_t *task) {
 
 	LOCK(&manager->lock);
 	UNLINK(manager->tasks, task, link);
-#ifdef USE_WORKER_THREADS
 	if (FINISHED(manager)) {
 		/*
 		 * All tasks have completed and the
@@ -321,9 +356,8 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
+		finish_queues(manager);
 	}
-#endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
 
 	DESTROYLOCK(&task->lock);
@@ -374,6 +408,13 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+		/*
+		 * Spread new tasks over the worker queues; after the first
+		 * run a task stays with whichever worker last ran it.
+		 */
+		task->threadid = manager->nextqueue;
+		manager->nextqueue = (manager->nextqueue + 1) %
+				     manager->nqueues;
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = ISC_TRUE;
@@ -452,6 +493,37 @@ task_shutdown(isc__task_t *task) {
 	return (was_idle);
 }
 
+#ifdef USE_WORKER_THREADS
+/*
+ * The worker owning queue 'busy' is running a task and cannot pick up
+ * new work right away; wake an idle worker so it can steal it.
+ *
+ * 'sleeping' is only used as a hint here; it is rechecked under the
+ * queue lock before signalling.  A missed wakeup only costs parallelism,
+ * since the owner of the queue will still run the task.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+wake_idle_worker(isc__taskmgr_t *manager, unsigned int busy) {
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	for (i = 1; i < manager->nqueues; i++) {
+		queue = &manager->queues[(busy + i) % manager->nqueues];
+		if (!queue->sleeping)
+			continue;
+		LOCK(&queue->lock);
+		if (queue->sleeping && queue->halts == 0) {
+			SIGNAL(&queue->work_available);
+			UNLOCK(&queue->lock);
+			return;
+		}
+		UNLOCK(&queue->lock);
+	}
+}
+#endif /* USE_WORKER_THREADS */
+
 /*
  * Moves a task onto the appropriate run queue.
  *
@@ -460,8 +532,10 @@ task_shutdown(isc__task_t *task) {
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 #ifdef USE_WORKER_THREADS
 	isc_boolean_t has_privilege = isc__task_privilege((isc_task_t *) task);
+	isc_boolean_t steal = ISC_FALSE;
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
@@ -469,13 +543,27 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
-	push_readyq(manager, task);
+	/*
+	 * The task is in ready state and on no queue, so nobody else
+	 * can change 'threadid' until it has been run.
+	 */
+	queue = &manager->queues[task->threadid];
+	LOCK(&queue->lock);
+	push_readyq(queue, task);
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	if (manager->mode == isc_taskmgrmode_normal || has_privilege) {
+		if (queue->sleeping)
+			SIGNAL(&queue->work_available);
+		else if (queue->running && queue->halts == 0)
+			steal = ISC_TRUE;
+	}
+#endif /* USE_WORKER_THREADS */
+	UNLOCK(&queue->lock);
+
+#ifdef USE_WORKER_THREADS
+	if (steal)
+		wake_idle_worker(manager, queue->threadid);
 #endif /* USE_WORKER_THREADS */
-	UNLOCK(&manager->lock);
 }
 
 static inline isc_boolean_t
@@ -936,46 +1024,48 @@ isc__task_getcurrenttimex(isc_task_t *task0, isc_time_t *t) {
  ***/
 
 /*
- * Return ISC_TRUE if the current ready list for the manager, which is
+ * Return ISC_TRUE if the current ready list for 'queue', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
  * the manager is currently in normal or privileged execution mode.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskqueue_t *queue) {
+	isc__tasklist_t list;
 
-	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+	if (queue->manager->mode == isc_taskmgrmode_normal)
+		list = queue->ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		list = queue->ready_priority_tasks;
 
-	return (ISC_TF(EMPTY(queue)));
+	return (ISC_TF(EMPTY(list)));
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list for 'queue', and make it affine to the worker 'threadid'.
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskqueue_t *queue, unsigned int threadid) {
 	isc__task_t *task;
 
-	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+	if (queue->manager->mode == isc_taskmgrmode_normal)
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
 	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
+		DEQUEUE(queue->ready_tasks, task, ready_link);
 		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
+			DEQUEUE(queue->ready_priority_tasks, task,
 				ready_priority_link);
+		queue->tasks_ready--;
+		task->threadid = threadid;
 	}
 
 	return (task);
@@ -985,317 +1075,469 @@ pop_readyq(isc__taskmgr_t *manager) {
  * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
  * flag set, then also push it onto the ready_priority_tasks queue.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task) {
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	manager->tasks_ready++;
+	queue->tasks_ready++;
 }
 
+/*
+ * Set the execution mode.  Readers of 'mode' hold either the task
+ * manager lock or a queue lock, so all of them are taken here.
+ *
+ * Caller must hold the task manager lock.
+ */
 static void
-dispatch(isc__taskmgr_t *manager) {
-	isc__task_t *task;
-#ifndef USE_WORKER_THREADS
-	unsigned int total_dispatch_count = 0;
-	isc__tasklist_t new_ready_tasks;
-	isc__tasklist_t new_priority_tasks;
-	unsigned int tasks_ready = 0;
+set_mode(isc__taskmgr_t *manager, isc_taskmgrmode_t mode) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++)
+		LOCK(&manager->queues[i].lock);
+	manager->mode = mode;
+#ifdef USE_WORKER_THREADS
+	for (i = 0; i < manager->nqueues; i++)
+		BROADCAST(&manager->queues[i].work_available);
 #endif /* USE_WORKER_THREADS */
+	for (i = manager->nqueues; i > 0; i--)
+		UNLOCK(&manager->queues[i - 1].lock);
+}
+
+/*
+ * Tell every worker that the manager has finished and wake them up.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+finish_queues(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		queue->finished = ISC_TRUE;
+#ifdef USE_WORKER_THREADS
+		BROADCAST(&queue->work_available);
+#endif /* USE_WORKER_THREADS */
+		UNLOCK(&queue->lock);
+	}
+}
+
+#if defined(HAVE_LIBXML2) || defined(HAVE_JSON)
+/*
+ * Sum the per-queue counters for statistics.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+count_tasks(isc__taskmgr_t *manager, unsigned int *runningp,
+	    unsigned int *readyp)
+{
+	isc__taskqueue_t *queue;
+	unsigned int i, running = 0, ready = 0;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		if (queue->running)
+			running++;
+		ready += queue->tasks_ready;
+		UNLOCK(&queue->lock);
+	}
+
+	*runningp = running;
+	*readyp = ready;
+}
+#endif /* HAVE_LIBXML2 || HAVE_JSON */
+
+/*
+ * Run up to one quantum of events for 'task', which the caller has
+ * just dequeued.  Returns ISC_TRUE if the task still has events and
+ * must be requeued.
+ *
+ * Caller must not hold the task manager lock or any queue lock.
+ */
+static isc_boolean_t
+execute_task(isc__task_t *task, unsigned int *dispatchedp) {
+	unsigned int dispatch_count = 0;
+	isc_boolean_t done = ISC_FALSE;
+	isc_boolean_t requeue = ISC_FALSE;
+	isc_boolean_t finished = ISC_FALSE;
+	isc_event_t *event;
+
+	INSIST(VALID_TASK(task));
+
+	LOCK(&task->lock);
+	INSIST(task->state == task_state_ready);
+	task->state = task_state_running;
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+			      ISC_MSG_RUNNING, "running"));
+	TIME_NOW(&task->tnow);
+	task->now = isc_time_seconds(&task->tnow);
+	do {
+		if (!EMPTY(task->events)) {
+			event = HEAD(task->events);
+			DEQUEUE(task->events, event, ev_link);
+			task->nevents--;
+
+			/*
+			 * Execute the event action.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					      ISC_MSG_EXECUTE,
+					      "execute action"));
+			if (event->ev_action != NULL) {
+				UNLOCK(&task->lock);
+				(event->ev_action)((isc_task_t *)task, event);
+				LOCK(&task->lock);
+			}
+			dispatch_count++;
+		}
+
+		if (task->references == 0 &&
+		    EMPTY(task->events) &&
+		    !TASK_SHUTTINGDOWN(task)) {
+			isc_boolean_t was_idle;
+
+			/*
+			 * There are no references and no
+			 * pending events for this task,
+			 * which means it will not become
+			 * runnable again via an external
+			 * action (such as sending an event
+			 * or detaching).
+			 *
+			 * We initiate shutdown to prevent
+			 * it from becoming a zombie.
+			 *
+			 * We do this here instead of in
+			 * the "if EMPTY(task->events)" block
+			 * below because:
+			 *
+			 *	If we post no shutdown events,
+			 *	we want the task to finish.
+			 *
+			 *	If we did post shutdown events,
+			 *	will still want the task's
+			 *	quantum to be applied.
+			 */
+			was_idle = task_shutdown(task);
+			INSIST(!was_idle);
+		}
+
+		if (EMPTY(task->events)) {
+			/*
+			 * Nothing else to do for this task
+			 * right now.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					      ISC_MSG_EMPTY, "empty"));
+			if (task->references == 0 &&
+			    TASK_SHUTTINGDOWN(task)) {
+				/*
+				 * The task is done.
+				 */
+				XTRACE(isc_msgcat_get(isc_msgcat,
+						      ISC_MSGSET_TASK,
+						      ISC_MSG_DONE, "done"));
+				finished = ISC_TRUE;
+				task->state = task_state_done;
+			} else
+				task->state = task_state_idle;
+			done = ISC_TRUE;
+		} else if (dispatch_count >= task->quantum) {
+			/*
+			 * Our quantum has expired, but
+			 * there is more work to be done.
+			 * We'll requeue it to the ready
+			 * queue later.
+			 *
+			 * We don't check quantum until
+			 * dispatching at least one event,
+			 * so the minimum quantum is one.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					      ISC_MSG_QUANTUM, "quantum"));
+			task->state = task_state_ready;
+			requeue = ISC_TRUE;
+			done = ISC_TRUE;
+		}
+	} while (!done);
+	UNLOCK(&task->lock);
+
+	if (finished)
+		task_finished(task);
+
+	if (dispatchedp != NULL)
+		*dispatchedp += dispatch_count;
+
+	return (requeue);
+}
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Take a ready task from the queue of some other worker that is busy
+ * running a task.  Idle workers' queues are left alone: their owners
+ * will get to them, and the tasks stay affine to them.
+ *
+ * Caller must hold no queue lock.
+ */
+static isc__task_t *
+steal_task(isc__taskqueue_t *queue) {
+	isc__taskmgr_t *manager = queue->manager;
+	isc__taskqueue_t *victim;
+	isc__task_t *task;
+	unsigned int i;
+
+	for (i = 1; i < manager->nqueues; i++) {
+		victim = &manager->queues[(queue->threadid + i) %
+					  manager->nqueues];
+		/* Unlocked hints; rechecked below. */
+		if (victim->tasks_ready == 0 || !victim->running)
+			continue;
+		LOCK(&victim->lock);
+		task = NULL;
+		if (victim->running && victim->halts == 0)
+			task = pop_readyq(victim, queue->threadid);
+		UNLOCK(&victim->lock);
+		if (task != NULL) {
+			XTTRACE(task, "stolen");
+			return (task);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * If we are in privileged execution mode, no worker is running a task
+ * and there are no privileged tasks left on any ready queue, then
+ * we're stuck.  Automatically drop privileges at that point and
+ * continue with the regular ready queues.
+ *
+ * Caller must hold no queue lock.
+ */
+static void
+check_privileged(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue;
+	isc_boolean_t stuck = ISC_TRUE;
+	unsigned int i;
+
+	LOCK(&manager->lock);
+	if (manager->mode != isc_taskmgrmode_privileged) {
+		UNLOCK(&manager->lock);
+		return;
+	}
+
+	for (i = 0; i < manager->nqueues; i++)
+		LOCK(&manager->queues[i].lock);
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		if (queue->running || !EMPTY(queue->ready_priority_tasks)) {
+			stuck = ISC_FALSE;
+			break;
+		}
+	}
+	if (stuck) {
+		manager->mode = isc_taskmgrmode_normal;
+		for (i = 0; i < manager->nqueues; i++)
+			BROADCAST(&manager->queues[i].work_available);
+	}
+	for (i = manager->nqueues; i > 0; i--)
+		UNLOCK(&manager->queues[i - 1].lock);
+	UNLOCK(&manager->lock);
+}
+
+/*
+ * Stop the workers from starting new tasks and wait until every
+ * worker other than the one owning 'self' (if any) is idle.
+ *
+ * Caller must hold no locks.
+ */
+static void
+halt_queues(isc__taskmgr_t *manager, isc__taskqueue_t *self) {
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		queue->halts++;
+		while (queue != self && queue->running)
+			WAIT(&queue->halted, &queue->lock);
+		UNLOCK(&queue->lock);
+	}
+}
+
+/*
+ * Undo a previous halt_queues().
+ *
+ * Caller must hold no locks.
+ */
+static void
+resume_queues(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		INSIST(queue->halts > 0);
+		if (--queue->halts == 0)
+			BROADCAST(&queue->work_available);
+		UNLOCK(&queue->lock);
+	}
+}
+
+static void
+dispatch(isc__taskqueue_t *queue) {
+	isc__taskmgr_t *manager = queue->manager;
+	isc__task_t *task;
+	isc_boolean_t requeue;
 
 	REQUIRE(VALID_MANAGER(manager));
 
 	/*
-	 * Again we're trying to hold the lock for as short a time as possible
-	 * and to do as little locking and unlocking as possible.
-	 *
-	 * In both while loops, the appropriate lock must be held before the
-	 * while body starts.  Code which acquired the lock at the top of
-	 * the loop would be more readable, but would result in a lot of
-	 * extra locking.  Compare:
-	 *
-	 * Straightforward:
-	 *
-	 *	LOCK();
-	 *	...
-	 *	UNLOCK();
-	 *	while (expression) {
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *	}
-	 *
-	 * Note how if the loop continues we unlock and then immediately lock.
-	 * For N iterations of the loop, this code does 2N+1 locks and 2N+1
-	 * unlocks.  Also note that the lock is not held when the while
-	 * condition is tested, which may or may not be important, depending
-	 * on the expression.
-	 *
-	 * As written:
-	 *
-	 *	LOCK();
-	 *	while (expression) {
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *	}
-	 *	UNLOCK();
-	 *
-	 * For N iterations of the loop, this code does N+1 locks and N+1
-	 * unlocks.  The while expression is always protected by the lock.
+	 * The queue lock is held whenever the loop condition is tested;
+	 * it is dropped only while stealing and while running a task.
 	 */
+	LOCK(&queue->lock);
+	while (!queue->finished) {
+		/*
+		 * If a pause or exclusive access has been requested, don't
+		 * do any work until it's been released.
+		 */
+		if (queue->halts > 0) {
+			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+						    ISC_MSGSET_GENERAL,
+						    ISC_MSG_WAIT, "wait"));
+			queue->sleeping = ISC_TRUE;
+			WAIT(&queue->work_available, &queue->lock);
+			queue->sleeping = ISC_FALSE;
+			continue;
+		}
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_INIT(new_ready_tasks);
-	ISC_LIST_INIT(new_priority_tasks);
-#endif
-	LOCK(&manager->lock);
+		/*
+		 * Mark ourselves as running before dropping the lock to
+		 * steal, so that halt_queues() waits for us.
+		 */
+		queue->running = ISC_TRUE;
+		task = pop_readyq(queue, queue->threadid);
+		if (task == NULL && manager->nqueues > 1) {
+			UNLOCK(&queue->lock);
+			task = steal_task(queue);
+			LOCK(&queue->lock);
+		}
+
+		if (task == NULL) {
+			queue->running = ISC_FALSE;
+			if (queue->halts > 0)
+				BROADCAST(&queue->halted);
+			if (manager->mode == isc_taskmgrmode_privileged) {
+				UNLOCK(&queue->lock);
+				check_privileged(manager);
+				LOCK(&queue->lock);
+			}
+			if (!queue->finished && queue->halts == 0 &&
+			    empty_readyq(queue))
+			{
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_GENERAL,
+							    ISC_MSG_WAIT,
+							    "wait"));
+				queue->sleeping = ISC_TRUE;
+				WAIT(&queue->work_available, &queue->lock);
+				queue->sleeping = ISC_FALSE;
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_TASK,
+							    ISC_MSG_AWAKE,
+							    "awake"));
+			}
+			continue;
+		}
 
-	while (!FINISHED(manager)) {
-#ifdef USE_WORKER_THREADS
 		/*
 		 * For reasons similar to those given in the comment in
 		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
+		 * the task while only holding the queue lock, and then
 		 * change the task to running state while only holding the
 		 * task lock.
-		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
 		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_GENERAL,
-						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_TASK,
-						    ISC_MSG_AWAKE, "awake"));
+		UNLOCK(&queue->lock);
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_WORKING, "working"));
+		requeue = execute_task(task, NULL);
+		LOCK(&queue->lock);
+
+		queue->running = ISC_FALSE;
+		if (queue->halts > 0)
+			BROADCAST(&queue->halted);
+		if (requeue) {
+			/*
+			 * We know we're awake, so we don't have to wake
+			 * anyone up; the task stays with us.
+			 */
+			push_readyq(queue, task);
 		}
+	}
+	UNLOCK(&queue->lock);
+}
 #else /* USE_WORKER_THREADS */
+static void
+dispatch(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue = &manager->queues[0];
+	isc__task_t *task;
+	unsigned int total_dispatch_count = 0;
+	isc__tasklist_t new_ready_tasks;
+	isc__tasklist_t new_priority_tasks;
+	unsigned int tasks_ready = 0;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	ISC_LIST_INIT(new_ready_tasks);
+	ISC_LIST_INIT(new_priority_tasks);
+
+	LOCK(&queue->lock);
+	while (!FINISHED(manager)) {
 		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
+		    empty_readyq(queue))
 			break;
-#endif /* USE_WORKER_THREADS */
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
 
-		task = pop_readyq(manager);
+		task = pop_readyq(queue, 0);
 		if (task != NULL) {
-			unsigned int dispatch_count = 0;
-			isc_boolean_t done = ISC_FALSE;
-			isc_boolean_t requeue = ISC_FALSE;
-			isc_boolean_t finished = ISC_FALSE;
-			isc_event_t *event;
+			queue->running = ISC_TRUE;
+			UNLOCK(&queue->lock);
 
-			INSIST(VALID_TASK(task));
-
-			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
-			 * lock before exiting the 'if (task != NULL)' block.
-			 */
-			manager->tasks_ready--;
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
-
-			LOCK(&task->lock);
-			INSIST(task->state == task_state_ready);
-			task->state = task_state_running;
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-					      ISC_MSG_RUNNING, "running"));
-			TIME_NOW(&task->tnow);
-			task->now = isc_time_seconds(&task->tnow);
-			do {
-				if (!EMPTY(task->events)) {
-					event = HEAD(task->events);
-					DEQUEUE(task->events, event, ev_link);
-					task->nevents--;
-
-					/*
-					 * Execute the event action.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							    ISC_MSGSET_TASK,
-							    ISC_MSG_EXECUTE,
-							    "execute action"));
-					if (event->ev_action != NULL) {
-						UNLOCK(&task->lock);
-						(event->ev_action)(
-							(isc_task_t *)task,
-							event);
-						LOCK(&task->lock);
-					}
-					dispatch_count++;
-#ifndef USE_WORKER_THREADS
-					total_dispatch_count++;
-#endif /* USE_WORKER_THREADS */
-				}
-
-				if (task->references == 0 &&
-				    EMPTY(task->events) &&
-				    !TASK_SHUTTINGDOWN(task)) {
-					isc_boolean_t was_idle;
-
-					/*
-					 * There are no references and no
-					 * pending events for this task,
-					 * which means it will not become
-					 * runnable again via an external
-					 * action (such as sending an event
-					 * or detaching).
-					 *
-					 * We initiate shutdown to prevent
-					 * it from becoming a zombie.
-					 *
-					 * We do this here instead of in
-					 * the "if EMPTY(task->events)" block
-					 * below because:
-					 *
-					 *	If we post no shutdown events,
-					 *	we want the task to finish.
-					 *
-					 *	If we did post shutdown events,
-					 *	will still want the task's
-					 *	quantum to be applied.
-					 */
-					was_idle = task_shutdown(task);
-					INSIST(!was_idle);
-				}
-
-				if (EMPTY(task->events)) {
-					/*
-					 * Nothing else to do for this task
-					 * right now.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_EMPTY,
-							      "empty"));
-					if (task->references == 0 &&
-					    TASK_SHUTTINGDOWN(task)) {
-						/*
-						 * The task is done.
-						 */
-						XTRACE(isc_msgcat_get(
-							       isc_msgcat,
-							       ISC_MSGSET_TASK,
-							       ISC_MSG_DONE,
-							       "done"));
-						finished = ISC_TRUE;
-						task->state = task_state_done;
-					} else
-						task->state = task_state_idle;
-					done = ISC_TRUE;
-				} else if (dispatch_count >= task->quantum) {
-					/*
-					 * Our quantum has expired, but
-					 * there is more work to be done.
-					 * We'll requeue it to the ready
-					 * queue later.
-					 *
-					 * We don't check quantum until
-					 * dispatching at least one event,
-					 * so the minimum quantum is one.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_QUANTUM,
-							      "quantum"));
-					task->state = task_state_ready;
-					requeue = ISC_TRUE;
-					done = ISC_TRUE;
-				}
-			} while (!done);
-			UNLOCK(&task->lock);
-
-			if (finished)
-				task_finished(task);
-
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
-			}
-#endif /* USE_WORKER_THREADS */
-			if (requeue) {
-				/*
-				 * We know we're awake, so we don't have
-				 * to wakeup any sleeping threads if the
-				 * ready queue is empty before we requeue.
-				 *
-				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
-				 */
-#ifdef USE_WORKER_THREADS
-				push_readyq(manager, task);
-#else
+			if (execute_task(task, &total_dispatch_count)) {
 				ENQUEUE(new_ready_tasks, task, ready_link);
 				if ((task->flags & TASK_F_PRIVILEGED) != 0)
 					ENQUEUE(new_priority_tasks, task,
 						ready_priority_link);
 				tasks_ready++;
-#endif
 			}
-		}
 
-#ifdef USE_WORKER_THREADS
-		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
-		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
-			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
+			LOCK(&queue->lock);
+			queue->running = ISC_FALSE;
 		}
-#endif
 	}
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
-	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
+	ISC_LIST_APPENDLIST(queue->ready_tasks, new_ready_tasks, ready_link);
+	ISC_LIST_APPENDLIST(queue->ready_priority_tasks, new_priority_tasks,
 			    ready_priority_link);
-	manager->tasks_ready += tasks_ready;
-	if (empty_readyq(manager))
+	queue->tasks_ready += tasks_ready;
+	if (empty_readyq(queue))
 		manager->mode = isc_taskmgrmode_normal;
-#endif
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
+#endif /* USE_WORKER_THREADS */
 
 #ifdef USE_WORKER_THREADS
 static isc_threadresult_t
@@ -1303,12 +1545,12 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(queue);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1321,14 +1563,68 @@ run(void *uap) {
 }
 #endif /* USE_WORKER_THREADS */
 
+static isc_result_t
+queue_init(isc__taskmgr_t *manager, isc__taskqueue_t *queue,
+	   unsigned int threadid)
+{
+	isc_result_t result;
+
+	result = isc_mutex_init(&queue->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_WORKER_THREADS
+	if (isc_condition_init(&queue->work_available) != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		DESTROYLOCK(&queue->lock);
+		return (ISC_R_UNEXPECTED);
+	}
+	if (isc_condition_init(&queue->halted) != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		(void)isc_condition_destroy(&queue->work_available);
+		DESTROYLOCK(&queue->lock);
+		return (ISC_R_UNEXPECTED);
+	}
+#endif /* USE_WORKER_THREADS */
+	queue->manager = manager;
+	queue->threadid = threadid;
+	INIT_LIST(queue->ready_tasks);
+	INIT_LIST(queue->ready_priority_tasks);
+	queue->tasks_ready = 0;
+	queue->halts = 0;
+	queue->running = ISC_FALSE;
+	queue->sleeping = ISC_FALSE;
+	queue->finished = ISC_FALSE;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+queue_destroy(isc__taskqueue_t *queue) {
+	INSIST(EMPTY(queue->ready_tasks));
+	INSIST(EMPTY(queue->ready_priority_tasks));
+#ifdef USE_WORKER_THREADS
+	(void)isc_condition_destroy(&queue->halted);
+	(void)isc_condition_destroy(&queue->work_available);
+#endif /* USE_WORKER_THREADS */
+	DESTROYLOCK(&queue->lock);
+}
+
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
+	unsigned int i;
 
+	for (i = 0; i < manager->nqueues; i++)
+		queue_destroy(&manager->queues[i]);
+	isc_mem_put(manager->mctx, manager->queues,
+		    manager->nqueues * sizeof(isc__taskqueue_t));
 #ifdef USE_WORKER_THREADS
-	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
-	(void)isc_condition_destroy(&manager->paused);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
 	DESTROYLOCK(&manager->lock);
@@ -1349,7 +1645,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		    unsigned int default_quantum, isc_taskmgr_t **managerp)
 {
 	isc_result_t result;
-	unsigned int i, started = 0;
+	unsigned int i, nqueues, started = 0;
 	isc__taskmgr_t *manager;
 
 	/*
@@ -1360,7 +1656,6 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
 #ifndef USE_WORKER_THREADS
-	UNUSED(i);
 	UNUSED(started);
 #endif
 
@@ -1392,6 +1687,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	}
 
 #ifdef USE_WORKER_THREADS
+	nqueues = workers;
 	manager->workers = 0;
 	manager->threads = isc_mem_allocate(mctx,
 					    workers * sizeof(isc_thread_t));
@@ -1399,39 +1695,27 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_NOMEMORY;
 		goto cleanup_lock;
 	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
+#else
+	nqueues = 1;
+#endif /* USE_WORKER_THREADS */
+	manager->nqueues = 0;
+	manager->queues = isc_mem_get(mctx,
+				      nqueues * sizeof(isc__taskqueue_t));
+	if (manager->queues == NULL) {
+		result = ISC_R_NOMEMORY;
 		goto cleanup_threads;
 	}
-	if (isc_condition_init(&manager->exclusive_granted) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
-	}
-	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_exclusivegranted;
+	for (i = 0; i < nqueues; i++) {
+		result = queue_init(manager, &manager->queues[i], i);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_queues;
+		manager->nqueues++;
 	}
-#endif /* USE_WORKER_THREADS */
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
-	manager->tasks_running = 0;
-	manager->tasks_ready = 0;
+	manager->nextqueue = 0;
 	manager->exclusive_requested = ISC_FALSE;
 	manager->pause_requested = ISC_FALSE;
 	manager->exiting = ISC_FALSE;
@@ -1442,10 +1726,11 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
 	LOCK(&manager->lock);
 	/*
-	 * Start workers.
+	 * Start workers.  Worker N runs ready queue N; tasks are only
+	 * assigned to the queues of workers that were actually started.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run, &manager->queues[manager->workers],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			manager->workers++;
@@ -1458,6 +1743,8 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		manager_free(manager);
 		return (ISC_R_NOTHREADS);
 	}
+	while (manager->nqueues > started)
+		queue_destroy(&manager->queues[--manager->nqueues]);
 	isc_thread_setconcurrency(workers);
 #endif /* USE_WORKER_THREADS */
 #ifdef USE_SHARED_MANAGER
@@ -1469,16 +1756,17 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 
 	return (ISC_R_SUCCESS);
 
-#ifdef USE_WORKER_THREADS
- cleanup_exclusivegranted:
-	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
+ cleanup_queues:
+	while (manager->nqueues > 0)
+		queue_destroy(&manager->queues[--manager->nqueues]);
+	isc_mem_put(mctx, manager->queues, nqueues * sizeof(isc__taskqueue_t));
  cleanup_threads:
+#ifdef USE_WORKER_THREADS
 	isc_mem_free(mctx, manager->threads);
  cleanup_lock:
-	DESTROYLOCK(&manager->lock);
 #endif
+	DESTROYLOCK(&manager->excl_lock);
+	DESTROYLOCK(&manager->lock);
  cleanup_mgr:
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	return (result);
@@ -1487,6 +1775,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 void
 isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	isc__taskmgr_t *manager;
+	isc__taskqueue_t *queue;
 	isc__task_t *task;
 	unsigned int i;
 
@@ -1498,10 +1787,6 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	manager = (isc__taskmgr_t *)*managerp;
 	REQUIRE(VALID_MANAGER(manager));
 
-#ifndef USE_WORKER_THREADS
-	UNUSED(i);
-#endif /* USE_WORKER_THREADS */
-
 #ifdef USE_SHARED_MANAGER
 	manager->refs--;
 	if (manager->refs > 0) {
@@ -1547,7 +1832,7 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	/*
 	 * If privileged mode was on, turn it off.
 	 */
-	manager->mode = isc_taskmgrmode_normal;
+	set_mode(manager, isc_taskmgrmode_normal);
 
 	/*
 	 * Post shutdown event(s) to every task (if they haven't already been
@@ -1557,17 +1842,30 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	     task != NULL;
 	     task = NEXT(task, link)) {
 		LOCK(&task->lock);
-		if (task_shutdown(task))
-			push_readyq(manager, task);
+		if (task_shutdown(task)) {
+			queue = &manager->queues[task->threadid];
+			LOCK(&queue->lock);
+			push_readyq(queue, task);
+			UNLOCK(&queue->lock);
+		}
 		UNLOCK(&task->lock);
 	}
 #ifdef USE_WORKER_THREADS
 	/*
 	 * Wake up any sleeping workers.  This ensures we get work done if
 	 * there's work left to do, and if there are already no tasks left
-	 * it will cause the workers to see manager->exiting.
+	 * it will cause the workers to see that the manager has finished.
 	 */
-	BROADCAST(&manager->work_available);
+	if (FINISHED(manager))
+		finish_queues(manager);
+	else {
+		for (i = 0; i < manager->nqueues; i++) {
+			queue = &manager->queues[i];
+			LOCK(&queue->lock);
+			BROADCAST(&queue->work_available);
+			UNLOCK(&queue->lock);
+		}
+	}
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1576,6 +1874,8 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	for (i = 0; i < manager->workers; i++)
 		(void)isc_thread_join(manager->threads[i], NULL);
 #else /* USE_WORKER_THREADS */
+	UNUSED(i);
+
 	/*
 	 * Dispatch the shutdown events.
 	 */
@@ -1600,7 +1900,7 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
 	LOCK(&manager->lock);
-	manager->mode = mode;
+	set_mode(manager, mode);
 	UNLOCK(&manager->lock);
 }
 
@@ -1627,9 +1927,9 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_FALSE);
 
-	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
-	UNLOCK(&manager->lock);
+	LOCK(&manager->queues[0].lock);
+	is_ready = !empty_readyq(&manager->queues[0]);
+	UNLOCK(&manager->queues[0].lock);
 
 	return (is_ready);
 }
@@ -1654,24 +1954,27 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
-	manager->pause_requested = ISC_TRUE;
+
 	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
-		WAIT(&manager->paused, &manager->lock);
-	}
+	INSIST(!manager->pause_requested);
+	manager->pause_requested = ISC_TRUE;
 	UNLOCK(&manager->lock);
+
+	halt_queues(manager, NULL);
 }
 
 void
 isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
+	isc_boolean_t resume;
 
 	LOCK(&manager->lock);
-	if (manager->pause_requested) {
-		manager->pause_requested = ISC_FALSE;
-		BROADCAST(&manager->work_available);
-	}
+	resume = manager->pause_requested;
+	manager->pause_requested = ISC_FALSE;
 	UNLOCK(&manager->lock);
+
+	if (resume)
+		resume_queues(manager);
 }
 #endif /* USE_WORKER_THREADS */
 
@@ -1725,10 +2028,12 @@ isc__task_beginexclusive(isc_task_t *task0) {
 		return (ISC_R_LOCKBUSY);
 	}
 	manager->exclusive_requested = ISC_TRUE;
-	while (manager->tasks_running > 1) {
-		WAIT(&manager->exclusive_granted, &manager->lock);
-	}
 	UNLOCK(&manager->lock);
+
+	/*
+	 * The task is running, so 'threadid' is the worker we are on.
+	 */
+	halt_queues(manager, &manager->queues[task->threadid]);
 #else
 	UNUSED(task0);
 #endif
@@ -1745,8 +2050,9 @@ isc__task_endexclusive(isc_task_t *task0) {
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
 	manager->exclusive_requested = ISC_FALSE;
-	BROADCAST(&manager->work_available);
 	UNLOCK(&manager->lock);
+
+	resume_queues(manager);
 #else
 	UNUSED(task0);
 #endif
@@ -1756,7 +2062,9 @@ void
 isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 	isc_boolean_t oldpriv;
+	unsigned int threadid;
 
 	LOCK(&task->lock);
 	oldpriv = ISC_TF((task->flags & TASK_F_PRIVILEGED) != 0);
@@ -1769,14 +2077,25 @@ isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	/*
+	 * 'threadid' may change under us if the task is stolen; retry
+	 * until we hold the lock of the queue it is on.
+	 */
+	for (;;) {
+		threadid = task->threadid;
+		queue = &manager->queues[threadid];
+		LOCK(&queue->lock);
+		if (task->threadid == threadid)
+			break;
+		UNLOCK(&queue->lock);
+	}
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 isc_boolean_t
@@ -1810,9 +2129,11 @@ int
 isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	unsigned int tasks_running, tasks_ready;
 	int xmlrc;
 
 	LOCK(&mgr->lock);
+	count_tasks(mgr, &tasks_running, &tasks_ready);
 
 	/*
 	 * Write out the thread-model, and some details about each depending
@@ -1843,11 +2164,11 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u", tasks_running));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-ready"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_ready));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u", tasks_ready));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
 
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
@@ -1921,8 +2242,10 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
 	json_object *obj = NULL, *array = NULL, *taskobj = NULL;
+	unsigned int tasks_running, tasks_ready;
 
 	LOCK(&mgr->lock);
+	count_tasks(mgr, &tasks_running, &tasks_ready);
 
 	/*
 	 * Write out the thread-model, and some details about each depending
@@ -1950,11 +2273,11 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "default-quantum", obj);
 
-	obj = json_object_new_int(mgr->tasks_running);
+	obj = json_object_new_int(tasks_running);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-running", obj);
 
-	obj = json_object_new_int(mgr->tasks_ready);
+	obj = json_object_new_int(tasks_ready);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-ready", obj);
 
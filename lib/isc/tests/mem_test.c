@@ -18,6 +18,8 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/result.h>
+#include <isc/thread.h>
+#include <isc/util.h>
 
 static void *
 default_memalloc(void *arg, size_t size) {
@@ -141,12 +143,117 @@ ATF_TC_BODY(isc_mem_inuse, tc) {
 	isc_test_end();
 }
 
+#ifdef ISC_PLATFORM_USETHREADS
+#define NTHREADS	4
+#define NHANDOFF	64
+
+static isc_mem_t *tcmctx = NULL;
+static void *handoff[NTHREADS][NHANDOFF];
+
+static void *
+handoff_get(void * arg) {
+	unsigned int i, j;
+
+	UNUSED(arg);
+
+	for (i = 0; i < NTHREADS; i++)
+		for (j = 0; j < NHANDOFF; j++)
+			handoff[i][j] = isc_mem_get(tcmctx, j + 1);
+	return (NULL);
+}
+
+static void *
+churn(void * arg) {
+	void *ptr[32];
+	unsigned int i, j, n = *(unsigned int *)arg;
+
+	for (i = 0; i < 10000; i++) {
+		for (j = 0; j < 32; j++)
+			ptr[j] = isc_mem_get(tcmctx, (i + j * 7) % 300 + 1);
+		for (j = 0; j < 32; j++)
+			isc_mem_put(tcmctx, ptr[j], (i + j * 7) % 300 + 1);
+	}
+
+	/* Free blocks that another thread allocated. */
+	for (j = 0; j < NHANDOFF; j++)
+		isc_mem_put(tcmctx, handoff[n][j], j + 1);
+	return (NULL);
+}
+
+ATF_TC(isc_mem_threadcache);
+ATF_TC_HEAD(isc_mem_threadcache, tc) {
+	atf_tc_set_md_var(tc, "descr", "test per-thread caching");
+}
+
+ATF_TC_BODY(isc_mem_threadcache, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	unsigned int ids[NTHREADS];
+	unsigned int debugging;
+	size_t before;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Thread caches are disabled while allocations are recorded. */
+	debugging = isc_mem_debugging;
+	isc_mem_debugging = 0;
+	result = isc_mem_create(0, 0, &tcmctx);
+	isc_mem_debugging = debugging;
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	before = isc_mem_inuse(tcmctx);
+
+	/*
+	 * Blocks freed into this thread's cache are not in use.
+	 */
+	for (i = 0; i < NHANDOFF; i++)
+		handoff[0][i] = isc_mem_get(tcmctx, 64);
+	ATF_CHECK(isc_mem_inuse(tcmctx) >= before + NHANDOFF * 64);
+	for (i = 0; i < NHANDOFF; i++)
+		isc_mem_put(tcmctx, handoff[0][i], 64);
+	ATF_CHECK_EQ(isc_mem_inuse(tcmctx), before);
+
+	result = isc_thread_create(handoff_get, NULL, &threads[0]);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_thread_join(threads[0], NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NTHREADS; i++) {
+		ids[i] = i;
+		result = isc_thread_create(churn, &ids[i], &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_join(threads[i], NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Exiting threads hand their cached blocks back, so nothing
+	 * should be in use any more; destroying the context checks the
+	 * per-size statistics as well.
+	 */
+	ATF_CHECK_EQ(isc_mem_inuse(tcmctx), before);
+
+	isc_mem_destroy(&tcmctx);
+
+	isc_test_end();
+}
+#endif
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_mem_total);
 	ATF_TP_ADD_TC(tp, isc_mem_inuse);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, isc_mem_threadcache);
+#endif
 
 	return (atf_no_error());
 }
@@ -212,6 +212,361 @@ ATF_TC_BODY(udp_sendto, tc) {
 	isc_test_end();
 }
 
+/* Test UDP sendto/recv with several socket watcher threads */
+ATF_TC(udp_threads);
+ATF_TC_HEAD(udp_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto/recv, multiple watchers");
+}
+ATF_TC_BODY(udp_threads, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr[4];
+	struct in_addr in;
+	isc_socket_t *s[4] = { NULL, NULL, NULL, NULL };
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[4][BUFSIZ];
+	completion_t sent[4], completion[4];
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Replace the default manager with one running four watchers;
+	 * consecutive descriptors land on different watchers.
+	 */
+	isc_socketmgr_destroy(&socketmgr);
+	result = isc_socketmgr_create3(mctx, &socketmgr, 0, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	for (i = 0; i < 4; i++) {
+		isc_sockaddr_fromin(&addr[i], &in, 0);
+		result = isc_socket_create(socketmgr, PF_INET,
+					   isc_sockettype_udp, &s[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_bind(s[i], &addr[i], 0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_getsockname(s[i], &addr[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE(isc_sockaddr_getport(&addr[i]) != 0);
+	}
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 4; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s[i], &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	strcpy(sendbuf, "Hello");
+	r.base = (void *) sendbuf;
+	r.length = strlen(sendbuf) + 1;
+	for (i = 0; i < 4; i++) {
+		completion_init(&sent[i]);
+		result = isc_socket_sendto(s[i], &r, task, event_done,
+					   &sent[i], &addr[(i + 1) % 4], NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 4; i++) {
+		waitfor2(&sent[i], &completion[i]);
+		ATF_CHECK(sent[i].done);
+		ATF_CHECK_EQ(sent[i].result, ISC_R_SUCCESS);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[i], "Hello");
+	}
+
+	isc_task_detach(&task);
+
+	for (i = 0; i < 4; i++)
+		isc_socket_detach(&s[i]);
+
+	isc_test_end();
+}
+
+/* Test batched UDP sends and receives */
+ATF_TC(udp_batch);
+ATF_TC_HEAD(udp_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto2/recv, batched");
+}
+ATF_TC_BODY(udp_batch, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	isc_socketevent_t *dev;
+	char sendbuf[4][BUFSIZ], recvbuf[4][BUFSIZ], expect[BUFSIZ];
+	completion_t sent[4], completion[4];
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(isc_sockaddr_getport(&addr1) != 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Several receives queued on one socket can be satisfied by a
+	 * single recvmmsg() call.
+	 */
+	for (i = 0; i < 4; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s1, &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 4; i++) {
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Hello %d", i);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&sent[i]);
+		dev = isc_socket_socketevent(mctx, s2, ISC_SOCKEVENT_SENDDONE,
+					     event_done, &sent[i]);
+		ATF_REQUIRE(dev != NULL);
+		result = isc_socket_sendto2(s2, &r, task, &addr1, NULL, dev,
+					    ISC_SOCKFLAG_BATCH);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 4; i++) {
+		waitfor2(&sent[i], &completion[i]);
+		ATF_CHECK(sent[i].done);
+		ATF_CHECK_EQ(sent[i].result, ISC_R_SUCCESS);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		snprintf(expect, sizeof(expect), "Hello %d", i);
+		ATF_CHECK_STREQ(recvbuf[i], expect);
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
+#define BATCH_SENDS	20
+
+static isc_socket_t *batch_socket;
+static isc_sockaddr_t batch_addr;
+static char batch_sendbuf[BATCH_SENDS][32];
+static completion_t batch_sent[BATCH_SENDS];
+static completion_t batch_queued;
+
+/*
+ * Send BATCH_SENDS datagrams from one task event, more than a single
+ * sendmmsg() call takes.
+ */
+static void
+batch_send(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *dev;
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_region_t r;
+	int i;
+
+	for (i = 0; i < BATCH_SENDS && result == ISC_R_SUCCESS; i++) {
+		snprintf(batch_sendbuf[i], sizeof(batch_sendbuf[i]),
+			 "Batch %d", i);
+		r.base = (void *) batch_sendbuf[i];
+		r.length = strlen(batch_sendbuf[i]) + 1;
+		dev = isc_socket_socketevent(mctx, batch_socket,
+					     ISC_SOCKEVENT_SENDDONE,
+					     event_done, &batch_sent[i]);
+		if (dev == NULL) {
+			result = ISC_R_NOMEMORY;
+			break;
+		}
+		result = isc_socket_sendto2(batch_socket, &r, task,
+					    &batch_addr, NULL, dev,
+					    ISC_SOCKFLAG_IMMEDIATE |
+					    ISC_SOCKFLAG_BATCH);
+		if (result == ISC_R_INPROGRESS)
+			result = ISC_R_SUCCESS;
+	}
+
+	batch_queued.result = result;
+	batch_queued.done = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+/* Test batched UDP sends made from within a task event */
+ATF_TC(udp_batch_event);
+ATF_TC_HEAD(udp_batch_event, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto2, batched from a task "
+				       "event");
+}
+ATF_TC_BODY(udp_batch_event, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	isc_event_t *event;
+	char recvbuf[BATCH_SENDS][BUFSIZ], expect[BUFSIZ];
+	completion_t completion[BATCH_SENDS];
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(isc_sockaddr_getport(&addr1) != 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < BATCH_SENDS; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s1, &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * The first full batch is sent while the event is still
+	 * running, and the rest when it has finished.
+	 */
+	batch_socket = s2;
+	batch_addr = addr1;
+	completion_init(&batch_queued);
+	for (i = 0; i < BATCH_SENDS; i++)
+		completion_init(&batch_sent[i]);
+	event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+				   batch_send, NULL, sizeof(*event));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(task, &event);
+
+	waitfor(&batch_queued);
+	ATF_REQUIRE(batch_queued.done);
+	ATF_CHECK_EQ(batch_queued.result, ISC_R_SUCCESS);
+
+	for (i = 0; i < BATCH_SENDS; i++) {
+		waitfor2(&batch_sent[i], &completion[i]);
+		ATF_CHECK(batch_sent[i].done);
+		ATF_CHECK_EQ(batch_sent[i].result, ISC_R_SUCCESS);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		snprintf(expect, sizeof(expect), "Batch %d", i);
+		ATF_CHECK_STREQ(recvbuf[i], expect);
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
+/* Test binding several UDP sockets to one port with SO_REUSEPORT */
+ATF_TC(udp_reuseport);
+ATF_TC_HEAD(udp_reuseport, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP bind with ISC_SOCKET_REUSEPORT");
+}
+ATF_TC_BODY(udp_reuseport, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, ISC_SOCKET_REUSEPORT);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		isc_test_end();
+		atf_tc_skip("SO_REUSEPORT not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(isc_sockaddr_getport(&addr1) != 0);
+
+	/*
+	 * A second socket can be bound to the same port only if it also
+	 * asks for SO_REUSEPORT.
+	 */
+	addr2 = addr1;
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, ISC_SOCKET_REUSEPORT);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	isc_socket_detach(&s2);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_CHECK_EQ_MSG(result, ISC_R_ADDRINUSE, "%s",
+			 isc_result_totext(result));
+	isc_socket_detach(&s2);
+
+	isc_socket_detach(&s1);
+
+	isc_test_end();
+}
+
 /* Test UDP sendto/recv with duplicated socket */
 ATF_TC(udp_dup);
 ATF_TC_HEAD(udp_dup, tc) {
@@ -780,6 +1135,10 @@ ATF_TC_BODY(net_probedscp, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_threads);
+	ATF_TP_ADD_TC(tp, udp_batch);
+	ATF_TP_ADD_TC(tp, udp_batch_event);
+	ATF_TP_ADD_TC(tp, udp_reuseport);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v4);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v6);
 	ATF_TP_ADD_TC(tp, udp_dscp_v4);
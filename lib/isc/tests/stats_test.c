@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+
+#include <isc/mem.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define NCOUNTERS	10
+#define NTHREADS	8
+#define NUPDATES	100000
+
+static isc_uint64_t values[NCOUNTERS];
+
+static void
+getvalue(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	UNUSED(arg);
+
+	values[counter] = value;
+}
+
+static void
+readstats(isc_stats_t *stats) {
+	memset(values, 0, sizeof(values));
+	isc_stats_dump(stats, getvalue, NULL, ISC_STATSDUMP_VERBOSE);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static void *
+update(void *arg) {
+	isc_stats_t *stats = arg;
+	int i;
+
+	for (i = 0; i < NUPDATES; i++) {
+		isc_stats_increment(stats, 0);
+		isc_stats_increment(stats, 2 + i % 2);
+		isc_stats_decrement(stats, 1);
+	}
+
+	return (NULL);
+}
+#endif
+
+static void
+counters(unsigned int options) {
+	isc_stats_t *stats = NULL;
+	isc_result_t result;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create2(mctx, &stats, NCOUNTERS, options);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_stats_ncounters(stats), NCOUNTERS);
+
+	isc_stats_increment(stats, 2);
+	isc_stats_increment(stats, 2);
+	isc_stats_decrement(stats, 2);
+	readstats(stats);
+	ATF_CHECK_EQ(values[2], 1);
+
+	isc_stats_set(stats, 42, 3);
+	isc_stats_increment(stats, 3);
+	readstats(stats);
+	ATF_CHECK_EQ(values[3], 43);
+
+	isc_stats_set(stats, 0, 2);
+	isc_stats_set(stats, 0, 3);
+	readstats(stats);
+	ATF_CHECK_EQ(values[2], 0);
+	ATF_CHECK_EQ(values[3], 0);
+
+#ifdef ISC_PLATFORM_USETHREADS
+	{
+		isc_thread_t threads[NTHREADS];
+		int i;
+
+		/*
+		 * Counter 1 is set here and brought back to zero by the
+		 * other threads, so their copies of it go "negative".
+		 */
+		isc_stats_set(stats, NTHREADS * NUPDATES, 1);
+		for (i = 0; i < NTHREADS; i++) {
+			result = isc_thread_create(update, stats, &threads[i]);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		for (i = 0; i < NTHREADS; i++)
+			isc_thread_join(threads[i], NULL);
+
+		readstats(stats);
+		ATF_CHECK_EQ(values[0], NTHREADS * NUPDATES);
+		ATF_CHECK_EQ(values[1], 0);
+		ATF_CHECK_EQ(values[2], NTHREADS * NUPDATES / 2);
+		ATF_CHECK_EQ(values[3], NTHREADS * NUPDATES / 2);
+	}
+#endif
+
+	isc_stats_detach(&stats);
+
+	isc_test_end();
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(counters);
+ATF_TC_HEAD(counters, tc) {
+	atf_tc_set_md_var(tc, "descr", "increment, decrement, set and dump");
+}
+ATF_TC_BODY(counters, tc) {
+	UNUSED(tc);
+
+	counters(0);
+}
+
+ATF_TC(sharded);
+ATF_TC_HEAD(sharded, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "increment, decrement, set and dump sharded "
+			  "counters");
+}
+ATF_TC_BODY(sharded, tc) {
+	UNUSED(tc);
+
+	counters(ISC_STATS_SHARDED);
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, counters);
+	ATF_TP_ADD_TC(tp, sharded);
+
+	return (atf_no_error());
+}
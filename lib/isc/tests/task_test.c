@@ -394,6 +394,103 @@ ATF_TC_BODY(privilege_drop, tc) {
 	isc_test_end();
 }
 
+/* task event handler, blocks until all the other events have run */
+static int blocked = 0;
+
+static void
+block(isc_task_t *task, isc_event_t *event) {
+	int *value = (int *) event->ev_arg;
+	int i = 0;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	blocked = 1;
+	UNLOCK(&set_lock);
+	while (counter < *value && i++ < 5000)
+		isc_test_nap(1000);
+	LOCK(&set_lock);
+	blocked = 2;
+	UNLOCK(&set_lock);
+}
+
+/* Ready tasks are stolen from a busy worker */
+ATF_TC(steal_tasks);
+ATF_TC_HEAD(steal_tasks, tc) {
+	atf_tc_set_md_var(tc, "descr", "idle workers run tasks queued "
+				       "behind a busy worker");
+}
+ATF_TC_BODY(steal_tasks, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_taskmgr_t *manager = NULL;
+	isc_task_t *tasks[9];
+	isc_event_t *event;
+	int values[9];
+	int i;
+
+	UNUSED(tc);
+
+	counter = 1;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Tasks are spread over the four worker queues, so tasks[4]
+	 * and tasks[8] share a queue with tasks[0].
+	 */
+	result = isc_taskmgr_create(mctx, 4, 0, &manager);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < 9; i++) {
+		tasks[i] = NULL;
+		values[i] = 0;
+		result = isc_task_create(manager, 0, &tasks[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/* Tie up the worker of tasks[0] until everything else has run. */
+	values[0] = 9;
+	event = isc_event_allocate(mctx, tasks[0], ISC_TASKEVENT_TEST,
+				   block, &values[0], sizeof (isc_event_t));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(tasks[0], &event);
+	for (i = 0; blocked == 0 && i < 5000; i++)
+		isc_test_nap(1000);
+	ATF_REQUIRE_EQ(blocked, 1);
+
+	for (i = 1; i < 9; i++) {
+		event = isc_event_allocate(mctx, tasks[i], ISC_TASKEVENT_TEST,
+					   set, &values[i],
+					   sizeof (isc_event_t));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(tasks[i], &event);
+	}
+
+	for (i = 0; blocked != 2 && i < 10000; i++)
+		isc_test_nap(1000);
+	ATF_CHECK_EQ(blocked, 2);
+
+	/* All the other events ran while tasks[0] was still blocked. */
+	ATF_CHECK_EQ(counter, 9);
+	for (i = 1; i < 9; i++)
+		ATF_CHECK(values[i] != 0);
+
+	for (i = 0; i < 9; i++)
+		isc_task_destroy(&tasks[i]);
+	isc_taskmgr_destroy(&manager);
+
+	isc_test_end();
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("Task stealing requires threads");
+#endif
+}
+
 /*
  * Main
  */
@@ -402,6 +499,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, all_events);
 	ATF_TP_ADD_TC(tp, privileged_events);
 	ATF_TP_ADD_TC(tp, privilege_drop);
+	ATF_TP_ADD_TC(tp, steal_tasks);
 
 	return (atf_no_error());
 }
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2016  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+
+#include <isc/random.h>
+#include <isc/task.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+/*
+ * Helper functions
+ */
+
+#define NTIMERS		1000
+
+static isc_mutex_t lock;
+static int ticks, idles, lives, early;
+
+static void
+count(isc_task_t *task, isc_event_t *event) {
+	isc_timerevent_t *tev = (isc_timerevent_t *)event;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	TIME_NOW(&now);
+
+	LOCK(&lock);
+	if (isc_time_compare(&now, &tev->due) < 0)
+		early++;
+	switch (event->ev_type) {
+	case ISC_TIMEREVENT_TICK:
+		ticks++;
+		break;
+	case ISC_TIMEREVENT_IDLE:
+		idles++;
+		break;
+	case ISC_TIMEREVENT_LIFE:
+		lives++;
+		break;
+	}
+	UNLOCK(&lock);
+
+	isc_event_free(&event);
+}
+
+static void
+setup(unsigned int options, isc_timermgr_t **managerp, isc_task_t **taskp) {
+	isc_result_t result;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ticks = idles = lives = early = 0;
+
+	result = isc_timermgr_create2(mctx, options, managerp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, taskp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+teardown(isc_timermgr_t **managerp, isc_task_t **taskp) {
+	isc_task_detach(taskp);
+	isc_timermgr_destroy(managerp);
+	DESTROYLOCK(&lock);
+	isc_test_end();
+}
+
+/*
+ * Wait up to five seconds for '*counter' to reach 'n'.
+ */
+static int
+waitfor(int *counter, int n) {
+	int i, value = 0;
+
+	for (i = 0; i < 5000; i++) {
+		LOCK(&lock);
+		value = *counter;
+		UNLOCK(&lock);
+		if (value >= n)
+			break;
+		usleep(1000);
+	}
+	return (value);
+}
+
+static void
+ticker(unsigned int options) {
+	isc_timermgr_t *manager = NULL;
+	isc_task_t *task = NULL;
+	isc_timer_t *timer = NULL;
+	isc_interval_t interval;
+	isc_time_t start, end;
+	isc_result_t result;
+
+	setup(options, &manager, &task);
+
+	TIME_NOW(&start);
+	isc_interval_set(&interval, 0, 20000000);
+	result = isc_timer_create(manager, isc_timertype_ticker, NULL,
+				  &interval, task, count, NULL, &timer);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK(waitfor(&ticks, 5) >= 5);
+	TIME_NOW(&end);
+	isc_timer_detach(&timer);
+
+	ATF_CHECK(isc_time_microdiff(&end, &start) >= 100000);
+	ATF_CHECK_EQ(early, 0);
+
+	teardown(&manager, &task);
+}
+
+static void
+once(unsigned int options) {
+	isc_timermgr_t *manager = NULL;
+	isc_task_t *task = NULL;
+	isc_timer_t *life = NULL, *idle = NULL;
+	isc_interval_t interval;
+	isc_time_t expires;
+	isc_result_t result;
+
+	setup(options, &manager, &task);
+
+	isc_interval_set(&interval, 0, 100000000);
+	result = isc_time_nowplusinterval(&expires, &interval);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_timer_create(manager, isc_timertype_once, &expires,
+				  NULL, task, count, NULL, &life);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_interval_set(&interval, 0, 50000000);
+	result = isc_timer_create(manager, isc_timertype_once, NULL,
+				  &interval, task, count, NULL, &idle);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(waitfor(&lives, 1), 1);
+	ATF_CHECK_EQ(waitfor(&idles, 1), 1);
+	ATF_CHECK_EQ(ticks, 0);
+	ATF_CHECK_EQ(early, 0);
+
+	isc_timer_detach(&life);
+	isc_timer_detach(&idle);
+
+	teardown(&manager, &task);
+}
+
+/*
+ * Start a lot of timers and stop half of them before they fire.
+ */
+static void
+reset(unsigned int options) {
+	isc_timermgr_t *manager = NULL;
+	isc_task_t *task = NULL;
+	isc_timer_t *timers[NTIMERS];
+	isc_interval_t interval;
+	isc_result_t result;
+	isc_uint32_t r;
+	int i;
+
+	setup(options, &manager, &task);
+
+	for (i = 0; i < NTIMERS; i++) {
+		isc_random_get(&r);
+		isc_interval_set(&interval, 0, 1000000 * (r % 400 + 100));
+		timers[i] = NULL;
+		result = isc_timer_create(manager, isc_timertype_once, NULL,
+					  &interval, task, count, NULL,
+					  &timers[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTIMERS; i += 2) {
+		result = isc_timer_reset(timers[i], isc_timertype_inactive,
+					 NULL, NULL, ISC_TRUE);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	ATF_CHECK_EQ(waitfor(&idles, NTIMERS / 2), NTIMERS / 2);
+	usleep(100000);
+	LOCK(&lock);
+	ATF_CHECK_EQ(idles, NTIMERS / 2);
+	ATF_CHECK_EQ(early, 0);
+	UNLOCK(&lock);
+
+	for (i = 0; i < NTIMERS; i++)
+		isc_timer_detach(&timers[i]);
+
+	teardown(&manager, &task);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(ticker);
+ATF_TC_HEAD(ticker, tc) {
+	atf_tc_set_md_var(tc, "descr", "ticker timer");
+}
+ATF_TC_BODY(ticker, tc) {
+	UNUSED(tc);
+
+	ticker(0);
+}
+
+ATF_TC(once);
+ATF_TC_HEAD(once, tc) {
+	atf_tc_set_md_var(tc, "descr", "once timer, lifetime and idle");
+}
+ATF_TC_BODY(once, tc) {
+	UNUSED(tc);
+
+	once(0);
+}
+
+ATF_TC(reset);
+ATF_TC_HEAD(reset, tc) {
+	atf_tc_set_md_var(tc, "descr", "stop timers before they fire");
+}
+ATF_TC_BODY(reset, tc) {
+	UNUSED(tc);
+
+	reset(0);
+}
+
+ATF_TC(wheel_ticker);
+ATF_TC_HEAD(wheel_ticker, tc) {
+	atf_tc_set_md_var(tc, "descr", "ticker timer on a timing wheel");
+}
+ATF_TC_BODY(wheel_ticker, tc) {
+	UNUSED(tc);
+
+	ticker(ISC_TIMERMGR_WHEEL);
+}
+
+ATF_TC(wheel_once);
+ATF_TC_HEAD(wheel_once, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "once timer, lifetime and idle, on a timing wheel");
+}
+ATF_TC_BODY(wheel_once, tc) {
+	UNUSED(tc);
+
+	once(ISC_TIMERMGR_WHEEL);
+}
+
+ATF_TC(wheel_reset);
+ATF_TC_HEAD(wheel_reset, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "stop timers before they fire on a timing wheel");
+}
+ATF_TC_BODY(wheel_reset, tc) {
+	UNUSED(tc);
+
+	reset(ISC_TIMERMGR_WHEEL);
+}
+
+ATF_TC(wheel_gap);
+ATF_TC_HEAD(wheel_gap, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "timers further apart than a turn of a timing wheel");
+}
+ATF_TC_BODY(wheel_gap, tc) {
+	isc_timermgr_t *manager = NULL;
+	isc_task_t *task = NULL;
+	isc_timer_t *tick = NULL, *life = NULL;
+	isc_interval_t interval;
+	isc_time_t expires;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup(ISC_TIMERMGR_WHEEL, &manager, &task);
+
+	/*
+	 * Nothing else is scheduled, so each dispatch comes well over
+	 * 256 ticks after the one before.
+	 */
+	isc_interval_set(&interval, 1, 500000000);
+	result = isc_time_nowplusinterval(&expires, &interval);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_timer_create(manager, isc_timertype_once, &expires,
+				  NULL, task, count, NULL, &life);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_interval_set(&interval, 0, 600000000);
+	result = isc_timer_create(manager, isc_timertype_ticker, NULL,
+				  &interval, task, count, NULL, &tick);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(waitfor(&lives, 1), 1);
+	ATF_CHECK(waitfor(&ticks, 2) >= 2);
+	ATF_CHECK_EQ(early, 0);
+
+	isc_timer_detach(&tick);
+	isc_timer_detach(&life);
+
+	teardown(&manager, &task);
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, ticker);
+	ATF_TP_ADD_TC(tp, once);
+	ATF_TP_ADD_TC(tp, reset);
+	ATF_TP_ADD_TC(tp, wheel_ticker);
+	ATF_TP_ADD_TC(tp, wheel_once);
+	ATF_TP_ADD_TC(tp, wheel_reset);
+	ATF_TP_ADD_TC(tp, wheel_gap);
+
+	return (atf_no_error());
+}
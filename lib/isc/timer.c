@@ -65,6 +65,31 @@
 
 typedef struct isc__timer isc__timer_t;
 typedef struct isc__timermgr isc__timermgr_t;
+typedef ISC_LIST(isc__timer_t) timerlist_t;
+
+/*%
+ * Timing wheel geometry: one millisecond ticks, a first level of 256
+ * slots, and four more levels of 64 slots each; together they cover
+ * 2^32 ticks.  Timers further out are parked in the last level and
+ * moved again when it cascades.
+ */
+#define WHEEL_TICK_NS			1000000
+#define WHEEL_L0_BITS			8
+#define WHEEL_LN_BITS			6
+#define WHEEL_LEVELS			5
+#define WHEEL_L0_SIZE			(1 << WHEEL_L0_BITS)
+#define WHEEL_LN_SIZE			(1 << WHEEL_LN_BITS)
+#define WHEEL_L0_MASK			(WHEEL_L0_SIZE - 1)
+#define WHEEL_LN_MASK			(WHEEL_LN_SIZE - 1)
+#define WHEEL_SLOTS			(WHEEL_L0_SIZE + \
+					 (WHEEL_LEVELS - 1) * WHEEL_LN_SIZE)
+#define WHEEL_SHIFT(n)			(WHEEL_L0_BITS + \
+					 ((n) - 1) * WHEEL_LN_BITS)
+#define WHEEL_SLOT(m, n, i)		(&(m)->wheel[WHEEL_L0_SIZE + \
+					 ((n) - 1) * WHEEL_LN_SIZE + (i)])
+#define WHEEL_FIRST(m, s)		((s) < &(m)->wheel[WHEEL_L0_SIZE])
+#define WHEEL_MAXDELTA			(((isc_uint64_t)WHEEL_LN_SIZE - 1) << \
+					 WHEEL_SHIFT(WHEEL_LEVELS - 1))
 
 struct isc__timer {
 	/*! Not locked. */
@@ -84,6 +109,8 @@ struct isc__timer {
 	unsigned int			index;
 	isc_time_t			due;
 	LINK(isc__timer_t)		link;
+	timerlist_t *			slot;
+	LINK(isc__timer_t)		slotlink;
 };
 
 #define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
@@ -107,6 +134,14 @@ struct isc__timermgr {
 	unsigned int			refs;
 #endif /* USE_SHARED_MANAGER */
 	isc_heap_t *			heap;
+	/*%
+	 * With ISC_TIMERMGR_WHEEL, scheduled timers are kept on 'wheel'
+	 * instead of 'heap'; 'wheeltick' is the next tick to expire, and
+	 * 'wheelfirst' counts the timers on the first level.
+	 */
+	timerlist_t *			wheel;
+	isc_uint64_t			wheeltick;
+	unsigned int			wheelfirst;
 };
 
 /*%
@@ -134,6 +169,9 @@ void
 isc__timer_detach(isc_timer_t **timerp);
 isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, unsigned int options,
+		      isc_timermgr_t **managerp);
 void
 isc_timermgr_poke(isc_timermgr_t *manager0);
 void
@@ -174,6 +212,122 @@ static struct isc__timermgrmethods {
 static isc__timermgr_t *timermgr = NULL;
 #endif /* USE_SHARED_MANAGER */
 
+static inline isc_uint64_t
+time2tick(const isc_time_t *t, isc_boolean_t roundup) {
+	unsigned int ns = isc_time_nanoseconds(t);
+	isc_uint64_t tick;
+
+	tick = (isc_uint64_t)isc_time_seconds(t) * 1000 + ns / WHEEL_TICK_NS;
+	if (roundup && (ns % WHEEL_TICK_NS) != 0)
+		tick++;
+	return (tick);
+}
+
+static inline void
+tick2time(isc_uint64_t tick, isc_time_t *t) {
+	isc_time_set(t, (unsigned int)(tick / 1000),
+		     (unsigned int)(tick % 1000) * WHEEL_TICK_NS);
+}
+
+/*!
+ * Put 'timer' into the wheel slot for its due time, rounded up to a
+ * whole tick so that it never fires early.
+ */
+static void
+wheel_insert(isc__timermgr_t *manager, isc__timer_t *timer) {
+	isc_uint64_t tick, delta;
+	timerlist_t *slot;
+	int n;
+
+	tick = time2tick(&timer->due, ISC_TRUE);
+	if (tick < manager->wheeltick)
+		tick = manager->wheeltick;
+	delta = tick - manager->wheeltick;
+
+	if (delta < WHEEL_L0_SIZE) {
+		slot = &manager->wheel[tick & WHEEL_L0_MASK];
+		manager->wheelfirst++;
+	} else {
+		if (delta > WHEEL_MAXDELTA) {
+			delta = WHEEL_MAXDELTA;
+			tick = manager->wheeltick + delta;
+		}
+		for (n = 1; n < WHEEL_LEVELS - 1; n++)
+			if (delta < ((isc_uint64_t)1 << WHEEL_SHIFT(n + 1)))
+				break;
+		slot = WHEEL_SLOT(manager, n,
+				  (tick >> WHEEL_SHIFT(n)) & WHEEL_LN_MASK);
+	}
+
+	APPEND(*slot, timer, slotlink);
+	timer->slot = slot;
+}
+
+static inline void
+wheel_remove(isc__timer_t *timer) {
+	if (WHEEL_FIRST(timer->manager, timer->slot))
+		timer->manager->wheelfirst--;
+	UNLINK(*timer->slot, timer, slotlink);
+	timer->slot = NULL;
+}
+
+/*!
+ * Re-file the timers in 'slot' relative to the current tick.
+ */
+static void
+wheel_cascade(isc__timermgr_t *manager, timerlist_t *slot) {
+	timerlist_t list;
+	isc__timer_t *timer;
+
+	list = *slot;
+	INIT_LIST(*slot);
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, slotlink);
+		wheel_insert(manager, timer);
+	}
+}
+
+/*!
+ * Restart the wheel at 'tick', e.g. after the clock has been set back.
+ */
+static void
+wheel_rebase(isc__timermgr_t *manager, isc_uint64_t tick) {
+	timerlist_t list;
+	isc__timer_t *timer;
+	unsigned int i;
+
+	INIT_LIST(list);
+	for (i = 0; i < WHEEL_SLOTS; i++) {
+		while ((timer = HEAD(manager->wheel[i])) != NULL) {
+			wheel_remove(timer);
+			APPEND(list, timer, slotlink);
+		}
+	}
+	manager->wheeltick = tick;
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, slotlink);
+		wheel_insert(manager, timer);
+	}
+}
+
+/*!
+ * Set manager->due to the first tick with something to do: a non-empty
+ * first level slot, or the next cascade, which may be this tick's.
+ */
+static void
+wheel_setdue(isc__timermgr_t *manager) {
+	isc_uint64_t tick = manager->wheeltick;
+
+	if (manager->wheelfirst == 0)
+		tick = (tick + WHEEL_L0_MASK) & ~(isc_uint64_t)WHEEL_L0_MASK;
+	else
+		while ((tick & WHEEL_L0_MASK) != 0 &&
+		       EMPTY(manager->wheel[tick & WHEEL_L0_MASK]))
+			tick++;
+
+	tick2time(tick, &manager->due);
+}
+
 static inline isc_result_t
 schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	isc_result_t result;
@@ -230,6 +384,43 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	 * Schedule the timer.
 	 */
 
+	if (manager->wheel != NULL) {
+		isc_boolean_t sooner;
+
+		if (timer->slot != NULL) {
+			wheel_remove(timer);
+			manager->nscheduled--;
+		}
+		if (manager->nscheduled == 0)
+			manager->wheeltick = time2tick(now, ISC_FALSE);
+		sooner = ISC_TF(manager->nscheduled == 0 ||
+				isc_time_compare(&due, &manager->due) < 0);
+		timer->due = due;
+		wheel_insert(manager, timer);
+		manager->nscheduled++;
+
+		XTRACETIMER(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+					   ISC_MSG_SCHEDULE, "schedule"),
+			    timer, due);
+
+		/*
+		 * Wake the run thread if it would sleep past this timer.
+		 */
+#ifdef USE_TIMER_THREAD
+		if (sooner && signal_ok) {
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+					      ISC_MSG_SIGNALSCHED,
+					      "signal (schedule)"));
+			SIGNAL(&manager->wakeup);
+		}
+#else
+		if (sooner)
+			manager->due = due;
+#endif /* USE_TIMER_THREAD */
+
+		return (ISC_R_SUCCESS);
+	}
+
 	if (timer->index > 0) {
 		/*
 		 * Already scheduled.
@@ -320,7 +511,15 @@ deschedule(isc__timer_t *timer) {
 	 */
 
 	manager = timer->manager;
-	if (timer->index > 0) {
+	if (timer->slot != NULL) {
+		/*
+		 * Waking up early is harmless, so there is no need to
+		 * signal the run thread.
+		 */
+		wheel_remove(timer);
+		INSIST(manager->nscheduled > 0);
+		manager->nscheduled--;
+	} else if (timer->index > 0) {
 #ifdef USE_TIMER_THREAD
 		if (timer->index == 1)
 			need_wakeup = ISC_TRUE;
@@ -448,6 +647,8 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	 */
 	DE_CONST(arg, timer->arg);
 	timer->index = 0;
+	timer->slot = NULL;
+	ISC_LINK_INIT(timer, slotlink);
 	result = isc_mutex_init(&timer->lock);
 	if (result != ISC_R_SUCCESS) {
 		isc_task_detach(&timer->task);
@@ -654,118 +855,217 @@ isc__timer_detach(isc_timer_t **timerp) {
 	*timerp = NULL;
 }
 
+/*!
+ * Post the event for 'timer', which has just been taken off the heap or
+ * the wheel because it is due, and schedule it again if necessary.
+ */
 static void
-dispatch(isc__timermgr_t *manager, isc_time_t *now) {
-	isc_boolean_t done = ISC_FALSE, post_event, need_schedule;
+expire(isc__timermgr_t *manager, isc__timer_t *timer, isc_time_t *now) {
+	isc_boolean_t post_event, need_schedule;
 	isc_timerevent_t *event;
 	isc_eventtype_t type = 0;
-	isc__timer_t *timer;
 	isc_result_t result;
 	isc_boolean_t idle;
 
+	if (timer->type == isc_timertype_ticker) {
+		type = ISC_TIMEREVENT_TICK;
+		post_event = ISC_TRUE;
+		need_schedule = ISC_TRUE;
+	} else if (timer->type == isc_timertype_limited) {
+		int cmp;
+		cmp = isc_time_compare(now, &timer->expires);
+		if (cmp >= 0) {
+			type = ISC_TIMEREVENT_LIFE;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_FALSE;
+		} else {
+			type = ISC_TIMEREVENT_TICK;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_TRUE;
+		}
+	} else if (!isc_time_isepoch(&timer->expires) &&
+		   isc_time_compare(now,
+				    &timer->expires) >= 0) {
+		type = ISC_TIMEREVENT_LIFE;
+		post_event = ISC_TRUE;
+		need_schedule = ISC_FALSE;
+	} else {
+		idle = ISC_FALSE;
+
+		LOCK(&timer->lock);
+		if (!isc_time_isepoch(&timer->idle) &&
+		    isc_time_compare(now,
+				     &timer->idle) >= 0) {
+			idle = ISC_TRUE;
+		}
+		UNLOCK(&timer->lock);
+		if (idle) {
+			type = ISC_TIMEREVENT_IDLE;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_FALSE;
+		} else {
+			/*
+			 * Idle timer has been touched;
+			 * reschedule.
+			 */
+			XTRACEID(isc_msgcat_get(isc_msgcat,
+						ISC_MSGSET_TIMER,
+						ISC_MSG_IDLERESCHED,
+						"idle reschedule"),
+				 timer);
+			post_event = ISC_FALSE;
+			need_schedule = ISC_TRUE;
+		}
+	}
+
+	if (post_event) {
+		XTRACEID(isc_msgcat_get(isc_msgcat,
+					ISC_MSGSET_TIMER,
+					ISC_MSG_POSTING,
+					"posting"), timer);
+		/*
+		 * XXX We could preallocate this event.
+		 */
+		event = (isc_timerevent_t *)
+			isc_event_allocate(manager->mctx, timer, type,
+					   timer->action, timer->arg,
+					   sizeof(*event));
+
+		if (event != NULL) {
+			event->due = timer->due;
+			isc_task_send(timer->task,
+				      ISC_EVENT_PTR(&event));
+		} else
+			UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
+				 isc_msgcat_get(isc_msgcat,
+					 ISC_MSGSET_TIMER,
+					 ISC_MSG_EVENTNOTALLOC,
+					 "couldn't "
+					 "allocate event"));
+	}
+
+	if (need_schedule) {
+		result = schedule(timer, now, ISC_FALSE);
+		if (result != ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "%s: %u",
+				isc_msgcat_get(isc_msgcat,
+					ISC_MSGSET_TIMER,
+					ISC_MSG_SCHEDFAIL,
+					"couldn't schedule "
+					"timer"),
+					 result);
+	}
+}
+
+/*!
+ * Expire everything on the wheel up to 'now', cascading the upper levels
+ * as the first level wraps, and set manager->due to the next tick that
+ * needs attention.  Empty first level slots are skipped, and while the
+ * first level is empty the wheel moves straight to the next cascade, so
+ * a long gap costs one step per turn of the first level.  Only if the
+ * clock has gone backwards is the wheel restarted at 'now'.
+ */
+static void
+wheel_dispatch(isc__timermgr_t *manager, isc_time_t *now) {
+	isc_uint64_t nowtick;
+	isc__timer_t *timer;
+	timerlist_t *slot, list;
+	unsigned int n;
+
+	nowtick = time2tick(now, ISC_FALSE);
+	if (nowtick + 1 < manager->wheeltick)
+		wheel_rebase(manager, nowtick);
+
+	while (manager->nscheduled > 0 && manager->wheeltick <= nowtick) {
+		if ((manager->wheeltick & WHEEL_L0_MASK) == 0) {
+			for (n = 1; n < WHEEL_LEVELS; n++) {
+				unsigned int idx;
+
+				idx = (manager->wheeltick >> WHEEL_SHIFT(n)) &
+				      WHEEL_LN_MASK;
+				wheel_cascade(manager,
+					      WHEEL_SLOT(manager, n, idx));
+				if (idx != 0)
+					break;
+			}
+		}
+
+		if (manager->wheelfirst == 0) {
+			/*
+			 * Nothing to walk until the next cascade, which
+			 * may be past 'now'.
+			 */
+			manager->wheeltick = ISC_MIN((manager->wheeltick |
+						      WHEEL_L0_MASK) + 1,
+						     nowtick + 1);
+			continue;
+		}
+
+		/*
+		 * Detach the slot first: expire() may put a ticker with a
+		 * short interval straight back into it.
+		 */
+		slot = &manager->wheel[manager->wheeltick & WHEEL_L0_MASK];
+		if (EMPTY(*slot)) {
+			/*
+			 * Move on to the next slot with timers in it, or
+			 * the next cascade, whichever comes first.
+			 */
+			do {
+				manager->wheeltick++;
+			} while (manager->wheeltick <= nowtick &&
+				 (manager->wheeltick & WHEEL_L0_MASK) != 0 &&
+				 EMPTY(manager->wheel[manager->wheeltick &
+						      WHEEL_L0_MASK]));
+			continue;
+		}
+		list = *slot;
+		INIT_LIST(*slot);
+		while ((timer = HEAD(list)) != NULL) {
+			UNLINK(list, timer, slotlink);
+			timer->slot = NULL;
+			manager->wheelfirst--;
+			INSIST(timer->type != isc_timertype_inactive);
+			if (isc_time_compare(now, &timer->due) < 0) {
+				/*
+				 * Not due yet; this lands in a later slot.
+				 */
+				wheel_insert(manager, timer);
+				continue;
+			}
+			manager->nscheduled--;
+			expire(manager, timer, now);
+		}
+		manager->wheeltick++;
+	}
+
+	if (manager->nscheduled > 0)
+		wheel_setdue(manager);
+}
+
+static void
+dispatch(isc__timermgr_t *manager, isc_time_t *now) {
+	isc_boolean_t done = ISC_FALSE;
+	isc__timer_t *timer;
+
 	/*!
 	 * The caller must be holding the manager lock.
 	 */
 
+	if (manager->wheel != NULL) {
+		wheel_dispatch(manager, now);
+		return;
+	}
+
 	while (manager->nscheduled > 0 && !done) {
 		timer = isc_heap_element(manager->heap, 1);
 		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
 		if (isc_time_compare(now, &timer->due) >= 0) {
-			if (timer->type == isc_timertype_ticker) {
-				type = ISC_TIMEREVENT_TICK;
-				post_event = ISC_TRUE;
-				need_schedule = ISC_TRUE;
-			} else if (timer->type == isc_timertype_limited) {
-				int cmp;
-				cmp = isc_time_compare(now, &timer->expires);
-				if (cmp >= 0) {
-					type = ISC_TIMEREVENT_LIFE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					type = ISC_TIMEREVENT_TICK;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_TRUE;
-				}
-			} else if (!isc_time_isepoch(&timer->expires) &&
-				   isc_time_compare(now,
-						    &timer->expires) >= 0) {
-				type = ISC_TIMEREVENT_LIFE;
-				post_event = ISC_TRUE;
-				need_schedule = ISC_FALSE;
-			} else {
-				idle = ISC_FALSE;
-
-				LOCK(&timer->lock);
-				if (!isc_time_isepoch(&timer->idle) &&
-				    isc_time_compare(now,
-						     &timer->idle) >= 0) {
-					idle = ISC_TRUE;
-				}
-				UNLOCK(&timer->lock);
-				if (idle) {
-					type = ISC_TIMEREVENT_IDLE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					/*
-					 * Idle timer has been touched;
-					 * reschedule.
-					 */
-					XTRACEID(isc_msgcat_get(isc_msgcat,
-								ISC_MSGSET_TIMER,
-								ISC_MSG_IDLERESCHED,
-								"idle reschedule"),
-						 timer);
-					post_event = ISC_FALSE;
-					need_schedule = ISC_TRUE;
-				}
-			}
-
-			if (post_event) {
-				XTRACEID(isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_POSTING,
-							"posting"), timer);
-				/*
-				 * XXX We could preallocate this event.
-				 */
-				event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
-							   timer,
-							   type,
-							   timer->action,
-							   timer->arg,
-							   sizeof(*event));
-
-				if (event != NULL) {
-					event->due = timer->due;
-					isc_task_send(timer->task,
-						      ISC_EVENT_PTR(&event));
-				} else
-					UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
-						 isc_msgcat_get(isc_msgcat,
-							 ISC_MSGSET_TIMER,
-							 ISC_MSG_EVENTNOTALLOC,
-							 "couldn't "
-							 "allocate event"));
-			}
-
 			timer->index = 0;
 			isc_heap_delete(manager->heap, 1);
 			manager->nscheduled--;
-
-			if (need_schedule) {
-				result = schedule(timer, now, ISC_FALSE);
-				if (result != ISC_R_SUCCESS)
-					UNEXPECTED_ERROR(__FILE__, __LINE__,
-							 "%s: %u",
-						isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_SCHEDFAIL,
-							"couldn't schedule "
-							"timer"),
-							 result);
-			}
+			expire(manager, timer, now);
 		} else {
 			manager->due = timer->due;
 			done = ISC_TRUE;
@@ -844,10 +1144,29 @@ set_index(void *what, unsigned int index) {
 	timer->index = index;
 }
 
+static void
+free_queue(isc__timermgr_t *manager, isc_mem_t *mctx) {
+	if (manager->heap != NULL)
+		isc_heap_destroy(&manager->heap);
+	if (manager->wheel != NULL) {
+		isc_mem_put(mctx, manager->wheel,
+			    WHEEL_SLOTS * sizeof(*manager->wheel));
+		manager->wheel = NULL;
+	}
+}
+
 isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
+	return (isc__timermgr_create2(mctx, 0, managerp));
+}
+
+isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, unsigned int options,
+		      isc_timermgr_t **managerp)
+{
 	isc__timermgr_t *manager;
 	isc_result_t result;
+	unsigned int i;
 
 	/*
 	 * Create a timer manager.
@@ -876,15 +1195,30 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	manager->nscheduled = 0;
 	isc_time_settoepoch(&manager->due);
 	manager->heap = NULL;
-	result = isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
-	if (result != ISC_R_SUCCESS) {
-		INSIST(result == ISC_R_NOMEMORY);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		return (ISC_R_NOMEMORY);
+	manager->wheel = NULL;
+	manager->wheeltick = 0;
+	manager->wheelfirst = 0;
+	if ((options & ISC_TIMERMGR_WHEEL) != 0) {
+		manager->wheel = isc_mem_get(mctx, WHEEL_SLOTS *
+					     sizeof(*manager->wheel));
+		if (manager->wheel == NULL) {
+			isc_mem_put(mctx, manager, sizeof(*manager));
+			return (ISC_R_NOMEMORY);
+		}
+		for (i = 0; i < WHEEL_SLOTS; i++)
+			INIT_LIST(manager->wheel[i]);
+	} else {
+		result = isc_heap_create(mctx, sooner, set_index, 0,
+					 &manager->heap);
+		if (result != ISC_R_SUCCESS) {
+			INSIST(result == ISC_R_NOMEMORY);
+			isc_mem_put(mctx, manager, sizeof(*manager));
+			return (ISC_R_NOMEMORY);
+		}
 	}
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS) {
-		isc_heap_destroy(&manager->heap);
+		free_queue(manager, mctx);
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (result);
 	}
@@ -893,7 +1227,7 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	if (isc_condition_init(&manager->wakeup) != ISC_R_SUCCESS) {
 		isc_mem_detach(&manager->mctx);
 		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
+		free_queue(manager, mctx);
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_condition_init() %s",
@@ -906,7 +1240,7 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 		isc_mem_detach(&manager->mctx);
 		(void)isc_condition_destroy(&manager->wakeup);
 		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
+		free_queue(manager, mctx);
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_thread_create() %s",
@@ -996,10 +1330,10 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	(void)isc_condition_destroy(&manager->wakeup);
 #endif /* USE_TIMER_THREAD */
 	DESTROYLOCK(&manager->lock);
-	isc_heap_destroy(&manager->heap);
+	mctx = manager->mctx;
+	free_queue(manager, mctx);
 	manager->common.impmagic = 0;
 	manager->common.magic = 0;
-	mctx = manager->mctx;
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	isc_mem_detach(&mctx);
 
@@ -1107,6 +1441,16 @@ isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	return (result);
 }
 
+isc_result_t
+isc_timermgr_create2(isc_mem_t *mctx, unsigned int options,
+		     isc_timermgr_t **managerp)
+{
+	if (isc_bind9)
+		return (isc__timermgr_create2(mctx, options, managerp));
+
+	return (isc_timermgr_create(mctx, managerp));
+}
+
 void
 isc_timermgr_destroy(isc_timermgr_t **managerp) {
 	REQUIRE(*managerp != NULL && ISCAPI_TIMERMGR_VALID(*managerp));
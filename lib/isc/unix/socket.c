@@ -318,8 +318,18 @@ typedef isc_event_t intev_t;
  */
 #define NRETRIES 10
 
+/*%
+ * The most datagrams moved by a single recvmmsg() or sendmmsg() call,
+ * and the control message space set aside for each of them.
+ */
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+#define MAXBATCH	16
+#define BATCHCMSGLEN	256
+#endif
+
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+typedef struct isc__socketthread isc__socketthread_t;
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -384,13 +394,21 @@ struct isc__socket {
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
 #define VALID_MANAGER(m)	ISC_MAGIC_VALID(m, SOCKET_MANAGER_MAGIC)
 
-struct isc__socketmgr {
+/*%
+ * A socket manager runs one or more watcher threads, each with its own
+ * kernel event set and control pipe.  Descriptors are partitioned over
+ * the watchers by descriptor number (see FDTHREAD()), so each watcher
+ * only ever sees events for its own share of the sockets.  The select()
+ * backend shares a single set of fd_sets and always uses one watcher.
+ */
+struct isc__socketthread {
 	/* Not locked. */
-	isc_socketmgr_t		common;
-	isc_mem_t	       *mctx;
-	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
-	isc_stats_t		*stats;
+	isc__socketmgr_t	*manager;
+	int			threadid;
+#ifdef USE_WATCHER_THREAD
+	isc_thread_t		thread;
+	int			pipe_fds[2];
+#endif	/* USE_WATCHER_THREAD */
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -408,13 +426,23 @@ struct isc__socketmgr {
 	int			nevents;
 	struct pollfd		*events;
 #endif	/* USE_DEVPOLL */
+};
+
+#define FDTHREAD(m, fd)		(&(m)->threads[(fd) % (m)->nthreads])
+
+struct isc__socketmgr {
+	/* Not locked. */
+	isc_socketmgr_t		common;
+	isc_mem_t	       *mctx;
+	isc_mutex_t		lock;
+	isc_mutex_t		*fdlock;
+	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
 	unsigned int		maxsocks;
-#ifdef ISC_PLATFORM_USETHREADS
-	int			pipe_fds[2];
-#endif
 
 	/* Locked by fdlock. */
 	isc__socket_t	       **fds;
@@ -437,7 +465,6 @@ struct isc__socketmgr {
 #endif	/* USE_SELECT */
 	int			reserved;	/* unlocked */
 #ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
 	isc_condition_t		shutdown_ok;
 #else /* USE_WATCHER_THREAD */
 	unsigned int		refs;
@@ -486,7 +513,7 @@ static void build_msghdr_send(isc__socket_t *, isc_socketevent_t *,
 static void build_msghdr_recv(isc__socket_t *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
 #ifdef USE_WATCHER_THREAD
-static isc_boolean_t process_ctlfd(isc__socketmgr_t *manager);
+static isc_boolean_t process_ctlfd(isc__socketthread_t *thread);
 #endif
 static void setdscp(isc__socket_t *sock, isc_dscp_t dscp);
 
@@ -598,6 +625,9 @@ isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks);
 isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, int nthreads);
+isc_result_t
 isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp);
 void
 isc_socketmgr_setstats(isc_socketmgr_t *manager0, isc_stats_t *stats);
@@ -894,12 +924,15 @@ dec_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 }
 
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
 	struct kevent evchange;
 
+	UNUSED(manager);
+
 	memset(&evchange, 0, sizeof(evchange));
 	if (msg == SELECT_POKE_READ)
 		evchange.filter = EVFILT_READ;
@@ -907,7 +940,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -928,7 +961,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (oldevents == 0U) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1) {
 		if (errno == EEXIST)
 			UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -950,7 +983,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	pfd.fd = fd;
 	pfd.revents = 0;
 	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -974,12 +1007,15 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
 	struct kevent evchange;
 
+	UNUSED(manager);
+
 	memset(&evchange, 0, sizeof(evchange));
 	if (msg == SELECT_POKE_READ)
 		evchange.filter = EVFILT_READ;
@@ -987,7 +1023,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -1006,7 +1042,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (event.events == 0U) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1 && errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -1043,7 +1079,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -1067,7 +1103,8 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static void
-wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+wakeup_socket(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
 
@@ -1083,8 +1120,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		/* No one should be updating fdstate, so no need to lock it */
 		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
 		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		(void)close(fd);
 		return;
 	}
@@ -1101,8 +1138,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 	if (manager->fdstate[fd] != MANAGED) {
@@ -1114,7 +1151,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1135,7 +1172,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+select_poke_thread(isc__socketthread_t *thread, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
@@ -1144,7 +1181,7 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(thread->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1170,16 +1207,30 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	INSIST(cc == sizeof(buf));
 }
 
+/*
+ * Poke the watcher responsible for 'fd', or all of them on shutdown.
+ */
+static void
+select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+	int i;
+
+	if (msg == SELECT_POKE_SHUTDOWN) {
+		for (i = 0; i < mgr->nthreads; i++)
+			select_poke_thread(&mgr->threads[i], fd, msg);
+	} else
+		select_poke_thread(FDTHREAD(mgr, fd), fd, msg);
+}
+
 /*
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1208,7 +1259,7 @@ select_poke(isc__socketmgr_t *manager, int fd, int msg) {
 	if (msg == SELECT_POKE_SHUTDOWN)
 		return;
 	else if (fd >= 0)
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(FDTHREAD(manager, fd), fd, msg);
 	return;
 }
 #endif /* USE_WATCHER_THREAD */
@@ -1849,89 +1900,17 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
 
+/*
+ * Finish a receive of 'cc' bytes into 'dev' whose message header was set
+ * up by build_msghdr_recv(): check the source, note truncation, pull out
+ * the control messages and update the buffers.
+ */
 static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
+doio_recvresult(isc__socket_t *sock, isc_socketevent_t *dev,
+		struct msghdr *msghdr, int cc, size_t read_count)
+{
 	size_t actual_count;
-	struct msghdr msghdr;
 	isc_buffer_t *buffer;
-	int recv_errno;
-	char strbuf[ISC_STRERRORSIZE];
-
-	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	if (cc < 0) {
-		if (SOFT_ERROR(recv_errno))
-			return (DOIO_SOFT);
-
-		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
-			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
-			socket_log(sock, NULL, IOEVENT,
-				   isc_msgcat, ISC_MSGSET_SOCKET,
-				   ISC_MSG_DOIORECV,
-				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
-				   sock->fd, cc, recv_errno, strbuf);
-		}
-
-#define SOFT_OR_HARD(_system, _isc) \
-	if (recv_errno == _system) { \
-		if (sock->connected) { \
-			dev->result = _isc; \
-			inc_stats(sock->manager->stats, \
-				  sock->statsindex[STATID_RECVFAIL]); \
-			return (DOIO_HARD); \
-		} \
-		return (DOIO_SOFT); \
-	}
-#define ALWAYS_HARD(_system, _isc) \
-	if (recv_errno == _system) { \
-		dev->result = _isc; \
-		inc_stats(sock->manager->stats, \
-			  sock->statsindex[STATID_RECVFAIL]); \
-		return (DOIO_HARD); \
-	}
-
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-		SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
-		/* HPUX 11.11 can return EADDRNOTAVAIL. */
-		SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		/* Should never get this one but it was seen. */
-#ifdef ENOPROTOOPT
-		SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
-#endif
-		/*
-		 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
-		 * errors.
-		 */
-#ifdef EPROTO
-		SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
-#endif
-		SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
-
-#undef SOFT_OR_HARD
-#undef ALWAYS_HARD
-
-		dev->result = isc__errno2result(recv_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_RECVFAIL]);
-		return (DOIO_HARD);
-	}
 
 	/*
 	 * On TCP and UNIX sockets, zero length reads indicate EOF,
@@ -1953,7 +1932,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	}
 
 	if (sock->type == isc_sockettype_udp) {
-		dev->address.length = msghdr.msg_namelen;
+		dev->address.length = msghdr->msg_namelen;
 		if (isc_sockaddr_getport(&dev->address) == 0) {
 			if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
 				socket_log(sock, &dev->address, IOEVENT,
@@ -1991,7 +1970,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * If there are control messages attached, run through them and pull
 	 * out the interesting bits.
 	 */
-	process_cmsg(sock, &msghdr, dev);
+	process_cmsg(sock, msghdr, dev);
 
 	/*
 	 * update the buffers (if any) and the i/o count
@@ -2031,6 +2010,163 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
+	struct msghdr msghdr;
+	int recv_errno;
+	char strbuf[ISC_STRERRORSIZE];
+
+	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	if (cc < 0) {
+		if (SOFT_ERROR(recv_errno))
+			return (DOIO_SOFT);
+
+		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
+			socket_log(sock, NULL, IOEVENT,
+				   isc_msgcat, ISC_MSGSET_SOCKET,
+				   ISC_MSG_DOIORECV,
+				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
+				   sock->fd, cc, recv_errno, strbuf);
+		}
+
+#define SOFT_OR_HARD(_system, _isc) \
+	if (recv_errno == _system) { \
+		if (sock->connected) { \
+			dev->result = _isc; \
+			inc_stats(sock->manager->stats, \
+				  sock->statsindex[STATID_RECVFAIL]); \
+			return (DOIO_HARD); \
+		} \
+		return (DOIO_SOFT); \
+	}
+#define ALWAYS_HARD(_system, _isc) \
+	if (recv_errno == _system) { \
+		dev->result = _isc; \
+		inc_stats(sock->manager->stats, \
+			  sock->statsindex[STATID_RECVFAIL]); \
+		return (DOIO_HARD); \
+	}
+
+		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+		SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+		SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+		SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
+		/* HPUX 11.11 can return EADDRNOTAVAIL. */
+		SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+		ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
+		/* Should never get this one but it was seen. */
+#ifdef ENOPROTOOPT
+		SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
+#endif
+		/*
+		 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
+		 * errors.
+		 */
+#ifdef EPROTO
+		SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
+#endif
+		SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
+
+#undef SOFT_OR_HARD
+#undef ALWAYS_HARD
+
+		dev->result = isc__errno2result(recv_errno);
+		inc_stats(sock->manager->stats,
+			  sock->statsindex[STATID_RECVFAIL]);
+		return (DOIO_HARD);
+	}
+
+	return (doio_recvresult(sock, dev, &msghdr, cc, read_count));
+}
+
+#ifdef HAVE_RECVMMSG
+/*
+ * Receive up to MAXBATCH datagrams with one recvmmsg() call, one into
+ * each of the events at the head of the receive queue, and post the
+ * events that completed.
+ *
+ * Returns:
+ *	DOIO_SUCCESS	Every event offered was filled; more datagrams
+ *			may be waiting.
+ *
+ *	DOIO_SOFT	The socket has been drained.
+ *
+ *	DOIO_HARD	recvmmsg() failed.  The caller should fall back to
+ *			doio_recv(), which knows how to report the error.
+ */
+static int
+doio_recvmmsg(isc__socket_t *sock) {
+	struct mmsghdr msgs[MAXBATCH];
+	struct iovec iov[MAXBATCH][MAXSCATTERGATHER_RECV];
+	size_t read_count[MAXBATCH];
+	isc_socketevent_t *devs[MAXBATCH];
+	isc_socketevent_t *dev;
+	union {
+		struct cmsghdr align;
+		char buf[MAXBATCH * BATCHCMSGLEN];
+	} cmsgs;
+	int i, n, cc;
+
+	INSIST(sock->type == isc_sockettype_udp);
+	INSIST(sock->recvcmsgbuflen <= BATCHCMSGLEN);
+
+	n = 0;
+	for (dev = ISC_LIST_HEAD(sock->recv_list);
+	     dev != NULL && n < MAXBATCH;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		build_msghdr_recv(sock, dev, &msgs[n].msg_hdr, iov[n],
+				  &read_count[n]);
+#if defined(ISC_NET_BSD44MSGHDR) && defined(USE_CMSG)
+		/*
+		 * Each datagram needs control message space of its own.
+		 */
+		if (msgs[n].msg_hdr.msg_control != NULL)
+			msgs[n].msg_hdr.msg_control =
+				cmsgs.buf + n * BATCHCMSGLEN;
+#endif
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+
+	cc = recvmmsg(sock->fd, msgs, n, 0, NULL);
+	if (cc < 0)
+		return (SOFT_ERROR(errno) ? DOIO_SOFT : DOIO_HARD);
+
+	for (i = 0; i < cc; i++) {
+		dev = devs[i];
+		switch (doio_recvresult(sock, dev, &msgs[i].msg_hdr,
+					(int)msgs[i].msg_len, read_count[i])) {
+		case DOIO_SUCCESS:
+		case DOIO_HARD:
+			send_recvdone_event(sock, &dev);
+			break;
+		default:
+			/* Dropped; the event stays on the queue. */
+			break;
+		}
+	}
+
+	return ((cc < n) ? DOIO_SOFT : DOIO_SUCCESS);
+}
+#endif /* HAVE_RECVMMSG */
+
 /*
  * Returns:
  *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
@@ -2157,6 +2293,75 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+#ifdef HAVE_SENDMMSG
+/*
+ * Send the datagrams of up to MAXBATCH events at the head of the send
+ * queue with one sendmmsg() call and post the events that completed.
+ *
+ * Returns:
+ *	DOIO_SUCCESS	Every datagram offered was sent.
+ *
+ *	DOIO_HARD	sendmmsg() failed or stopped early.  The caller
+ *			should fall back to doio_send() for the event at
+ *			the head of the queue, which knows how to report
+ *			the error.
+ */
+static int
+doio_sendmmsg(isc__socket_t *sock) {
+	struct mmsghdr msgs[MAXBATCH];
+	struct iovec iov[MAXBATCH][MAXSCATTERGATHER_SEND];
+	size_t write_count[MAXBATCH];
+	isc_socketevent_t *devs[MAXBATCH];
+	isc_socketevent_t *dev;
+	union {
+		struct cmsghdr align;
+		char buf[MAXBATCH * BATCHCMSGLEN];
+	} cmsgs;
+	int i, n, cc;
+
+	INSIST(sock->type == isc_sockettype_udp);
+	INSIST(sock->sendcmsgbuflen <= BATCHCMSGLEN);
+
+	n = 0;
+	for (dev = ISC_LIST_HEAD(sock->send_list);
+	     dev != NULL && n < MAXBATCH;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		build_msghdr_send(sock, dev, &msgs[n].msg_hdr, iov[n],
+				  &write_count[n]);
+#if defined(ISC_NET_BSD44MSGHDR) && defined(USE_CMSG)
+		/*
+		 * build_msghdr_send() always uses the socket's control
+		 * message buffer; give each datagram a copy of its own.
+		 */
+		if (msgs[n].msg_hdr.msg_controllen != 0) {
+			INSIST(msgs[n].msg_hdr.msg_controllen <= BATCHCMSGLEN);
+			memmove(cmsgs.buf + n * BATCHCMSGLEN,
+				msgs[n].msg_hdr.msg_control,
+				msgs[n].msg_hdr.msg_controllen);
+			msgs[n].msg_hdr.msg_control =
+				cmsgs.buf + n * BATCHCMSGLEN;
+		}
+#endif
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	if (cc < 0)
+		return (DOIO_HARD);
+
+	for (i = 0; i < cc; i++) {
+		dev = devs[i];
+		dev->n += msgs[i].msg_len;
+		dev->result = ISC_R_SUCCESS;
+		send_senddone_event(sock, &dev);
+	}
+
+	return ((cc < n) ? DOIO_HARD : DOIO_SUCCESS);
+}
+#endif /* HAVE_SENDMMSG */
+
 /*
  * Kill.
  *
@@ -2189,8 +2394,10 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 		 * solve this would be to dup() the watched descriptor, but we
 		 * take a simpler approach at this moment.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd,
+				 SELECT_POKE_READ);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd,
+				 SELECT_POKE_WRITE);
 	} else
 		select_poke(manager, fd, SELECT_POKE_CLOSE);
 
@@ -2222,8 +2429,8 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 			UNLOCK(&manager->fdlock[lockid]);
 		}
 #ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+		if (manager->maxfd < manager->threads[0].pipe_fds[0])
+			manager->maxfd = manager->threads[0].pipe_fds[0];
 #endif
 	}
 
@@ -3802,6 +4009,23 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 	 * limits here, currently.
 	 */
 	dev = ISC_LIST_HEAD(sock->recv_list);
+#ifdef HAVE_RECVMMSG
+	/*
+	 * With several receives posted on a UDP socket, fill as many of
+	 * them as possible per system call.
+	 */
+	while (dev != NULL && ISC_LIST_NEXT(dev, ev_link) != NULL &&
+	       sock->type == isc_sockettype_udp &&
+	       sock->recvcmsgbuflen <= BATCHCMSGLEN)
+	{
+		int io_state = doio_recvmmsg(sock);
+		if (io_state == DOIO_SOFT)
+			goto poke;
+		dev = ISC_LIST_HEAD(sock->recv_list);
+		if (io_state == DOIO_HARD)
+			break;
+	}
+#endif
 	while (dev != NULL) {
 		switch (doio_recv(sock, dev)) {
 		case DOIO_SOFT:
@@ -3870,9 +4094,33 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 * limits here, currently.
 	 */
 	dev = ISC_LIST_HEAD(sock->send_list);
+#ifdef HAVE_SENDMMSG
+	/*
+	 * Send queued UDP datagrams in batches.
+	 */
+	while (dev != NULL && ISC_LIST_NEXT(dev, ev_link) != NULL &&
+	       sock->type == isc_sockettype_udp &&
+	       sock->manager->maxudp == 0 &&
+	       sock->sendcmsgbuflen <= BATCHCMSGLEN)
+	{
+		int io_state = doio_sendmmsg(sock);
+		dev = ISC_LIST_HEAD(sock->send_list);
+		if (io_state == DOIO_HARD)
+			break;
+	}
+#endif
 	while (dev != NULL) {
 		switch (doio_send(sock, dev)) {
 		case DOIO_SOFT:
+			/*
+			 * Batched sends that are not to be retried are
+			 * dropped, as socket_send() would have done.
+			 */
+			if ((dev->attributes & ISC_SOCKEVENTATTR_NORETRY) != 0)
+			{
+				send_senddone_event(sock, &dev);
+				break;
+			}
 			goto poke;
 
 		case DOIO_HARD:
@@ -3978,9 +4226,10 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
+process_fd(isc__socketthread_t *thread, int fd, isc_boolean_t readable,
 	   isc_boolean_t writeable)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	isc__socket_t *sock;
 	isc_boolean_t unlock_sock;
 	isc_boolean_t unwatch_read = ISC_FALSE, unwatch_write = ISC_FALSE;
@@ -3993,8 +4242,8 @@ process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
 	if (manager->fdstate[fd] == CLOSE_PENDING) {
 		UNLOCK(&manager->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
@@ -4039,15 +4288,17 @@ check_write:
  unlock_fd:
 	UNLOCK(&manager->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents)
+{
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t readable, writable;
 	isc_boolean_t done = ISC_FALSE;
@@ -4055,7 +4306,7 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
@@ -4070,34 +4321,36 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].ident < manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
 		readable = ISC_TF(events[i].filter == EVFILT_READ);
 		writable = ISC_TF(events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events,
+	    int nevents)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4107,7 +4360,7 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
@@ -4124,28 +4377,30 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			int fd = events[i].data.fd;
 			events[i].events |= manager->epoll_events[fd];
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents)
+{
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4155,38 +4410,39 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
-		process_fd(manager, events[i].fd,
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 
 	REQUIRE(maxfd <= (int)manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
@@ -4194,13 +4450,13 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static isc_boolean_t
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
-		manager_log(manager, IOEVENT,
+		manager_log(thread->manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
 					   ISC_MSG_WATCHERMSG,
 					   "watcher got message %d "
@@ -4227,7 +4483,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
 		 * and decide if we need to watch on it now
 		 * or not.
 		 */
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(thread, fd, msg);
 	}
 
 	return (ISC_FALSE);
@@ -4242,7 +4498,8 @@ process_ctlfd(isc__socketmgr_t *manager) {
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
+	isc__socketmgr_t *manager = thread->manager;
 	isc_boolean_t done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -4268,34 +4525,34 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = ISC_FALSE;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -4305,7 +4562,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -4313,9 +4570,9 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
@@ -4370,16 +4627,16 @@ watcher(void *uap) {
 		} while (cc < 0);
 
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
+		process_fds(thread, maxfd, manager->read_fds_copy,
 			    manager->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
 		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+			done = process_ctlfd(thread);
 #endif
 	}
 
@@ -4414,20 +4671,23 @@ isc__socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
+#ifdef USE_SELECT
+	isc__socketmgr_t *manager = thread->manager;
+#endif
 	isc_result_t result;
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
 	char strbuf[ISC_STRERRORSIZE];
 #endif
 
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4435,28 +4695,28 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
 		return (result);
 	}
 
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+		close(thread->kqueue_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4464,44 +4724,32 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
 		return (result);
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+		close(thread->epoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	/*
-	 * Note: fdpollinfo should be able to support all possible FDs, so
-	 * it must have maxsocks entries (not nevents).
-	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4509,20 +4757,16 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
 		return (result);
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
+		close(thread->devpoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
@@ -4574,8 +4818,8 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	memset(manager->write_fds, 0, manager->fd_bufsize);
 
 #ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	manager->maxfd = thread->pipe_fds[0];
 #else /* USE_WATCHER_THREAD */
 	manager->maxfd = 0;
 #endif /* USE_WATCHER_THREAD */
@@ -4585,11 +4829,12 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 }
 
 static void
-cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+cleanup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
 #ifdef USE_WATCHER_THREAD
 	isc_result_t result;
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "epoll_ctl(DEL) %s",
@@ -4598,20 +4843,22 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	}
 #endif	/* USE_WATCHER_THREAD */
 
+#ifndef USE_SELECT
+	UNUSED(manager);
+#endif
+
 #ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
 #elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
 #elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
-	isc_mem_put(mctx, manager->fdpollinfo,
-		    sizeof(pollinfo_t) * manager->maxsocks);
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
 #elif defined(USE_SELECT)
 	if (manager->read_fds != NULL)
 		isc_mem_put(mctx, manager->read_fds, manager->fd_bufsize);
@@ -4626,21 +4873,85 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create3(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
 {
-	int i;
-	isc__socketmgr_t *manager;
+	return (isc__socketmgr_create3(mctx, managerp, maxsocks, 1));
+}
+
+/*
+ * Set up one watcher: its control pipe and its kernel event set.
+ */
+static isc_result_t
+setup_thread(isc_mem_t *mctx, isc__socketmgr_t *manager, int threadid) {
+	isc__socketthread_t *thread = &manager->threads[threadid];
+	isc_result_t result;
 #ifdef USE_WATCHER_THREAD
 	char strbuf[ISC_STRERRORSIZE];
 #endif
+
+	thread->manager = manager;
+	thread->threadid = threadid;
+
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		return (ISC_R_UNEXPECTED);
+	}
+
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
+#if 0
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[1]) == ISC_R_SUCCESS);
+#endif
+#endif	/* USE_WATCHER_THREAD */
+
+	/*
+	 * Set up initial state for the select loop
+	 */
+	result = setup_watcher(mctx, thread);
+#ifdef USE_WATCHER_THREAD
+	if (result != ISC_R_SUCCESS) {
+		(void)close(thread->pipe_fds[0]);
+		(void)close(thread->pipe_fds[1]);
+	}
+#endif	/* USE_WATCHER_THREAD */
+
+	return (result);
+}
+
+static void
+cleanup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
+	cleanup_watcher(mctx, thread);
+
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+}
+
+isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, int nthreads)
+{
+	int i;
+	isc__socketmgr_t *manager;
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
+	REQUIRE(nthreads > 0);
 
 #ifdef USE_SHARED_MANAGER
 	if (socketmgr != NULL) {
@@ -4657,6 +4968,14 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
 
+#if !defined(USE_WATCHER_THREAD) || defined(USE_SELECT)
+	/*
+	 * There is only one event loop without threads, and the select()
+	 * fd_sets are shared.
+	 */
+	nthreads = 1;
+#endif
+
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
 		return (ISC_R_NOMEMORY);
@@ -4686,6 +5005,25 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	}
 	memset(manager->epoll_events, 0, manager->maxsocks * sizeof(uint32_t));
 #endif
+#ifdef USE_DEVPOLL
+	/*
+	 * Note: fdpollinfo should be able to support all possible FDs, so
+	 * it must have maxsocks entries (not nevents).
+	 */
+	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  manager->maxsocks);
+	if (manager->fdpollinfo == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_manager;
+	}
+	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
+#endif
+	manager->threads = isc_mem_get(mctx, nthreads *
+				       sizeof(isc__socketthread_t));
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_manager;
+	}
 	manager->stats = NULL;
 
 	manager->common.methods = &socketmgrmethods;
@@ -4723,54 +5061,47 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_lock;
 	}
-
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
-#if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
-#endif
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 #endif /* USE_SHARED_MANAGER */
 
-	/*
-	 * Set up initial state for the select loop
-	 */
-	result = setup_watcher(mctx, manager);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+	for (i = 0; i < nthreads; i++) {
+		result = setup_thread(mctx, manager, i);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		manager->nthreads++;
+	}
 
 	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Start up the select/poll thread.
+	 * Start up the select/poll threads.
 	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_create(watcher, &manager->threads[i],
+				      &manager->threads[i].thread) !=
+		    ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			/*
+			 * Stop the watchers that are already running.
+			 */
+			while (--i >= 0) {
+				select_poke_thread(&manager->threads[i], 0,
+						   SELECT_POKE_SHUTDOWN);
+				(void)isc_thread_join(manager->threads[i].thread,
+						      NULL);
+			}
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
 	}
 #endif /* USE_WATCHER_THREAD */
 	isc_mem_attach(mctx, &manager->mctx);
@@ -4783,13 +5114,10 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	return (ISC_R_SUCCESS);
 
 cleanup:
-#ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
-#endif	/* USE_WATCHER_THREAD */
+	while (manager->nthreads > 0)
+		cleanup_thread(mctx, &manager->threads[--manager->nthreads]);
 
 #ifdef USE_WATCHER_THREAD
-cleanup_condition:
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif	/* USE_WATCHER_THREAD */
 
@@ -4806,6 +5134,16 @@ free_manager:
 		isc_mem_put(mctx, manager->fdlock,
 			    FDLOCK_COUNT * sizeof(isc_mutex_t));
 	}
+	if (manager->threads != NULL) {
+		isc_mem_put(mctx, manager->threads,
+			    nthreads * sizeof(isc__socketthread_t));
+	}
+#ifdef USE_DEVPOLL
+	if (manager->fdpollinfo != NULL) {
+		isc_mem_put(mctx, manager->fdpollinfo,
+			    sizeof(pollinfo_t) * manager->maxsocks);
+	}
+#endif
 #if defined(USE_EPOLL)
 	if (manager->epoll_events != NULL) {
 		isc_mem_put(mctx, manager->epoll_events,
@@ -4901,23 +5239,29 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Wait for the threads to exit.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_join(manager->threads[i].thread, NULL) !=
+		    ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+	}
 #endif /* USE_WATCHER_THREAD */
 
 	/*
 	 * Clean up.
 	 */
-	cleanup_watcher(manager->mctx, manager);
+	for (i = 0; i < manager->nthreads; i++)
+		cleanup_thread(manager->mctx, &manager->threads[i]);
+	isc_mem_put(manager->mctx, manager->threads,
+		    manager->nthreads * sizeof(isc__socketthread_t));
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
 
@@ -4928,6 +5272,10 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 #if defined(USE_EPOLL)
 	isc_mem_put(manager->mctx, manager->epoll_events,
 		    manager->maxsocks * sizeof(uint32_t));
+#endif
+#ifdef USE_DEVPOLL
+	isc_mem_put(manager->mctx, manager->fdpollinfo,
+		    sizeof(pollinfo_t) * manager->maxsocks);
 #endif
 	isc_mem_put(manager->mctx, manager->fds,
 		    manager->maxsocks * sizeof(isc__socket_t *));
@@ -5172,6 +5520,60 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 		}
 	}
 
+#ifdef HAVE_SENDMMSG
+	if (sock->type == isc_sockettype_udp &&
+	    (flags & ISC_SOCKFLAG_BATCH) != 0)
+	{
+		isc_socketevent_t *ev;
+		unsigned int n = 0;
+
+		/*
+		 * Defer the datagram until 'task' has finished its current
+		 * event: the queue is flushed from an event posted to that
+		 * task, so that responses sent in the meantime, by it or by
+		 * the other tasks that got queries from the same receive
+		 * batch, go out with this one in a single sendmmsg() call.
+		 * A full batch is sent at once.
+		 */
+		isc_task_attach(task, &ntask);
+		dev->attributes |= ISC_SOCKEVENTATTR_ATTACHED;
+		if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
+			dev->attributes |= ISC_SOCKEVENTATTR_NORETRY;
+
+		LOCK(&sock->lock);
+		if (ISC_LIST_EMPTY(sock->send_list) && !sock->pending_send) {
+			ISC_LIST_ENQUEUE(sock->send_list, dev, ev_link);
+			dispatch_send(sock);
+		} else {
+			ISC_LIST_ENQUEUE(sock->send_list, dev, ev_link);
+			/*
+			 * While waiting for the socket to become writable
+			 * nothing is flushed early.
+			 */
+			if (sock->pending_send &&
+			    sock->manager->maxudp == 0 &&
+			    sock->sendcmsgbuflen <= BATCHCMSGLEN)
+			{
+				for (ev = ISC_LIST_HEAD(sock->send_list);
+				     ev != NULL && n < MAXBATCH;
+				     ev = ISC_LIST_NEXT(ev, ev_link))
+					n++;
+				if (n == MAXBATCH)
+					(void)doio_sendmmsg(sock);
+			}
+		}
+		UNLOCK(&sock->lock);
+
+		socket_log(sock, NULL, EVENT, NULL, 0, 0,
+			   "socket_send: event %p -> task %p (batched)",
+			   dev, ntask);
+
+		if ((flags & ISC_SOCKFLAG_IMMEDIATE) != 0)
+			result = ISC_R_INPROGRESS;
+		return (result);
+	}
+#endif
+
 	if (sock->type == isc_sockettype_udp)
 		io_state = doio_send(sock, dev);
 	else {
@@ -5340,8 +5742,9 @@ isc__socket_sendto2(isc_socket_t *sock0, isc_region_t *region,
 	isc__socket_t *sock = (isc__socket_t *)sock0;
 
 	REQUIRE(VALID_SOCKET(sock));
-	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY)) == 0);
-	if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
+	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY|
+			   ISC_SOCKFLAG_BATCH)) == 0);
+	if ((flags & (ISC_SOCKFLAG_NORETRY|ISC_SOCKFLAG_BATCH)) != 0)
 		REQUIRE(sock->type == isc_sockettype_udp);
 	event->ev_sender = sock;
 	event->result = ISC_R_UNSET;
@@ -5349,7 +5752,8 @@ isc__socket_sendto2(isc_socket_t *sock0, isc_region_t *region,
 	event->region = *region;
 	event->n = 0;
 	event->offset = 0;
-	event->attributes &= ~ISC_SOCKEVENTATTR_ATTACHED;
+	event->attributes &= ~(ISC_SOCKEVENTATTR_ATTACHED|
+			       ISC_SOCKEVENTATTR_NORETRY);
 
 	return (socket_send(sock, event, task, address, pktinfo, flags));
 }
@@ -5574,6 +5978,22 @@ isc__socket_bind(isc_socket_t *sock0, isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT, (void *)&on,
+			       sizeof(on)) < 0) {
+			isc__strerror(errno, strbuf, sizeof(strbuf));
+			socket_log(sock, NULL, CREATION, isc_msgcat,
+				   ISC_MSGSET_GENERAL, ISC_MSG_FAILED,
+				   "setsockopt(SO_REUSEPORT): %s", strbuf);
+			UNLOCK(&sock->lock);
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -6397,6 +6817,9 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 	int pass;
 	struct dvpoll dvp;
 #endif
+#ifndef USE_SELECT
+	isc__socketthread_t *thread;
+#endif
 
 	REQUIRE(swaitp != NULL && *swaitp == NULL);
 
@@ -6407,6 +6830,10 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 	if (manager == NULL)
 		return (0);
 
+#ifndef USE_SELECT
+	thread = &manager->threads[0];
+#endif
+
 #ifdef USE_KQUEUE
 	if (tvp != NULL) {
 		ts.tv_sec = tvp->tv_sec;
@@ -6414,8 +6841,8 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		tsp = &ts;
 	} else
 		tsp = NULL;
-	swait_private.nevents = kevent(manager->kqueue_fd, NULL, 0,
-				       manager->events, manager->nevents,
+	swait_private.nevents = kevent(thread->kqueue_fd, NULL, 0,
+				       thread->events, thread->nevents,
 				       tsp);
 	n = swait_private.nevents;
 #elif defined(USE_EPOLL)
@@ -6423,32 +6850,32 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(thread->epoll_fd,
+					   thread->events,
+					   thread->nevents, timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	/*
 	 * Re-probe every thousand calls.
 	 */
-	if (manager->calls++ > 1000U) {
+	if (thread->calls++ > 1000U) {
 		result = isc_resource_getcurlimit(isc_resource_openfiles,
-						  &manager->open_max);
+						  &thread->open_max);
 		if (result != ISC_R_SUCCESS)
-			manager->open_max = 64;
-		manager->calls = 0;
+			thread->open_max = 64;
+		thread->calls = 0;
 	}
 	for (pass = 0; pass < 2; pass++) {
-		dvp.dp_fds = manager->events;
-		dvp.dp_nfds = manager->nevents;
-		if (dvp.dp_nfds >= manager->open_max)
-			dvp.dp_nfds = manager->open_max - 1;
+		dvp.dp_fds = thread->events;
+		dvp.dp_nfds = thread->nevents;
+		if (dvp.dp_nfds >= thread->open_max)
+			dvp.dp_nfds = thread->open_max - 1;
 		if (tvp != NULL) {
 			dvp.dp_timeout = tvp->tv_sec * 1000 +
 				(tvp->tv_usec + 999) / 1000;
 		} else
 			dvp.dp_timeout = -1;
-		n = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+		n = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 		if (n == -1 && errno == EINVAL) {
 			/*
 			 * {OPEN_MAX} may have dropped.  Look
@@ -6456,9 +6883,9 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			 */
 			result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 			if (result != ISC_R_SUCCESS)
-				manager->open_max = 64;
+				thread->open_max = 64;
 		} else
 			break;
 	}
@@ -6494,10 +6921,12 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 		return (ISC_R_NOTFOUND);
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+	(void)process_fds(&manager->threads[0], manager->threads[0].events,
+			  swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(&manager->threads[0], swait->maxfd, swait->readset,
+		    swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
@@ -2655,6 +2655,19 @@ isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
 	return (isc_socketmgr_create2(mctx, managerp, 0));
 }
 
+isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, int nthreads)
+{
+	/*
+	 * The completion port already spreads the work over its own
+	 * threads; 'nthreads' is unused here.
+	 */
+	REQUIRE(nthreads > 0);
+
+	return (isc__socketmgr_create2(mctx, managerp, maxsocks));
+}
+
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
@@ -3210,9 +3223,11 @@ isc__socket_sendto2(isc_socket_t *sock, isc_region_t *region,
 	LOCK(&sock->lock);
 	CONSISTENT(sock);
 
-	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY)) == 0);
-	if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
+	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY|
+			   ISC_SOCKFLAG_BATCH)) == 0);
+	if ((flags & (ISC_SOCKFLAG_NORETRY|ISC_SOCKFLAG_BATCH)) != 0)
 		REQUIRE(sock->type == isc_sockettype_udp);
+	flags &= ~ISC_SOCKFLAG_BATCH;	/* no batched sends here */
 	event->ev_sender = sock;
 	event->result = ISC_R_UNEXPECTED;
 	/*
@@ -3272,6 +3287,10 @@ isc__socket_bind(isc_socket_t *sock, isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	if (bind(sock->fd, &sockaddr->type.sa, sockaddr->length) < 0) {
 		bind_errno = WSAGetLastError();
 		UNLOCK(&sock->lock);